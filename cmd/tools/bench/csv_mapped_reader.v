@@ -0,0 +1,48 @@
+import benchmark
+import encoding.csv
+import os
+
+struct Row {
+	id    int
+	name  string
+	score f64
+}
+
+fn main() {
+	nr_rows := 1_000_000
+	path := os.join_path(os.vtmp_dir(), 'csv_mapped_reader_bench.csv')
+	mut lines := []string{cap: nr_rows + 1}
+	lines << 'id,name,score'
+	for i in 0 .. nr_rows {
+		lines << '${i},"name ${i}",${i}.25'
+	}
+	os.write_file(path, lines.join('\n'))!
+	defer {
+		os.rm(path) or {}
+	}
+	println('${nr_rows} rows, ${os.file_size(path) / 1024 / 1024} MB')
+
+	mut b := benchmark.start()
+	mut rar := csv.csv_reader(file_path: path)!
+	b.measure('RandomAccessReader index')
+	mut sum := 0
+	for y in 1 .. rar.csv_map.len {
+		sum += rar.get_cell(x: 0, y: y)!.int()
+	}
+	b.measure('RandomAccessReader read a column')
+	rar.dispose_csv_reader()
+
+	for nr_threads in [1, 0] {
+		mut mr := csv.csv_mapped_reader(file_path: path, nr_threads: nr_threads)!
+		b.measure('MappedReader index, nr_threads: ${nr_threads}')
+		mut msum := 0
+		for y in 1 .. mr.rows_count() {
+			msum += mr.get_cell(x: 0, y: y)!.int()
+		}
+		b.measure('MappedReader read a column')
+		assert msum == sum
+		rows := csv.decode_mapped[Row](mr)!
+		b.measure('MappedReader decode_mapped ${rows.len} rows')
+		mr.dispose_csv_reader()
+	}
+}
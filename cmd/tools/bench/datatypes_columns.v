@@ -0,0 +1,120 @@
+import benchmark
+import datatypes
+
+struct Trade {
+	symbol string
+	qty    int
+	price  f64
+	ts     i64
+	venue  string
+	filled bool
+}
+
+const symbols = ['AAA', 'BBB', 'CCC', 'DDD', 'EEE', 'FFF', 'GGG', 'HHH']
+
+fn main() {
+	n := 5_000_000
+	mut trades := []Trade{cap: n}
+	for i in 0 .. n {
+		trades << Trade{
+			symbol: symbols[i % symbols.len]
+			qty:    (i * 7919) % 100
+			price:  f64(i % 1000) * 0.25
+			ts:     i64(i)
+			venue:  'venue ${i % 3}'
+			filled: i % 2 == 0
+		}
+	}
+	rounds := 10
+	mut b := benchmark.start()
+	c := datatypes.columns_from(trades)
+	b.measure('columns_from, ${n} rows')
+	qty := c.column[int]('qty')!
+	price := c.column[f64]('price')!
+	syms := c.column[string]('symbol')!
+
+	// sum
+	mut aos_sum := 0.0
+	for _ in 0 .. rounds {
+		aos_sum = 0.0
+		for t in trades {
+			aos_sum += t.price
+		}
+	}
+	b.measure('sum, array of structs, ${rounds} rounds')
+	mut soa_sum := 0.0
+	for _ in 0 .. rounds {
+		soa_sum = datatypes.column_sum(price)
+	}
+	b.measure('sum, column_sum, ${rounds} rounds')
+	for _ in 0 .. rounds {
+		soa_sum = datatypes.column_sum_parallel(price)
+	}
+	b.measure('sum, column_sum_parallel, ${rounds} rounds')
+	assert soa_sum - aos_sum < 1e-3 && aos_sum - soa_sum < 1e-3
+
+	// min/max
+	mut aos_max := 0
+	for _ in 0 .. rounds {
+		aos_max = trades[0].qty
+		for t in trades {
+			if t.qty > aos_max {
+				aos_max = t.qty
+			}
+		}
+	}
+	b.measure('max, array of structs, ${rounds} rounds')
+	mut soa_max := 0
+	for _ in 0 .. rounds {
+		soa_max = datatypes.column_max(qty)?
+	}
+	b.measure('max, column_max, ${rounds} rounds')
+	for _ in 0 .. rounds {
+		soa_max = datatypes.column_max_parallel(qty)?
+	}
+	b.measure('max, column_max_parallel, ${rounds} rounds')
+	assert soa_max == aos_max
+
+	// filter + sum
+	mut aos_where := 0.0
+	for _ in 0 .. rounds {
+		aos_where = 0.0
+		for t in trades {
+			if t.qty >= 50 {
+				aos_where += t.price
+			}
+		}
+	}
+	b.measure('filter + sum, array of structs, ${rounds} rounds')
+	mut soa_where := 0.0
+	for _ in 0 .. rounds {
+		soa_where = datatypes.column_sum_where(price, datatypes.column_filter(qty, .ge, 50))
+	}
+	b.measure('filter + sum, column_filter + column_sum_where, ${rounds} rounds')
+	for _ in 0 .. rounds {
+		soa_where = datatypes.column_sum_where(price, datatypes.column_filter_parallel(qty,
+			.ge, 50))
+	}
+	b.measure('filter + sum, column_filter_parallel + column_sum_where, ${rounds} rounds')
+	assert soa_where == aos_where
+
+	// group by
+	mut aos_groups := map[string]int{}
+	for _ in 0 .. rounds {
+		aos_groups = map[string]int{}
+		for t in trades {
+			aos_groups[t.symbol] += t.qty
+		}
+	}
+	b.measure('group by, array of structs, ${rounds} rounds')
+	mut soa_groups := map[string]int{}
+	for _ in 0 .. rounds {
+		soa_groups = datatypes.column_group_sum(syms, qty)
+	}
+	b.measure('group by, column_group_sum, ${rounds} rounds')
+	for _ in 0 .. rounds {
+		soa_groups = datatypes.column_group_sum_parallel(syms, qty)
+	}
+	b.measure('group by, column_group_sum_parallel, ${rounds} rounds')
+	assert soa_groups == aos_groups
+}
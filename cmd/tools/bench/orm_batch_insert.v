@@ -0,0 +1,47 @@
+import benchmark
+import db.sqlite
+
+struct Reading {
+	id     int @[primary; sql: serial]
+	sensor string
+	value  f64
+}
+
+// inserts the same rows one by one with `insert r into Reading` (before), and as a single array
+// with `insert readings into Reading` (after)
+fn main() {
+	max_rows := arguments()[1] or { '1_000_000' }.int()
+	assert max_rows > 0
+	mut readings := []Reading{cap: max_rows}
+	for i in 0 .. max_rows {
+		readings << Reading{
+			sensor: 'sensor ${i % 100}'
+			value:  f64(i) * 0.5
+		}
+	}
+	mut b := benchmark.start()
+	for batch in [false, true] {
+		mut db := sqlite.connect(':memory:')!
+		sql db {
+			create table Reading
+		}!
+		b.measure('prepare')
+		if batch {
+			sql db {
+				insert readings into Reading
+			}!
+		} else {
+			for r in readings {
+				sql db {
+					insert r into Reading
+				}!
+			}
+		}
+		count := sql db {
+			select count from Reading
+		}!
+		label := if batch { 'insert array' } else { 'insert each row' }
+		b.measure('${label}, rows: ${count}')
+		db.close()!
+	}
+}
@@ -0,0 +1,91 @@
+import benchmark
+import sync
+import time
+import x.sessions
+
+struct User {
+	name string
+	age  int
+}
+
+// LockedStore is the way to share a `sessions.MemoryStore` between threads: a single lock
+struct LockedStore {
+mut:
+	mu    &sync.Mutex = sync.new_mutex()
+	store sessions.MemoryStore[User]
+}
+
+fn (mut s LockedStore) get(sid string) !User {
+	s.mu.@lock()
+	defer {
+		s.mu.unlock()
+	}
+	return s.store.get(sid, time.hour)
+}
+
+fn (mut s LockedStore) set(sid string, val User) ! {
+	s.mu.@lock()
+	defer {
+		s.mu.unlock()
+	}
+	s.store.set(sid, val)!
+}
+
+// each thread reads 9 sessions, and writes 1, for every 10 operations
+fn work_locked(mut s LockedStore, sids []string, t int, ops int) {
+	for i in 0 .. ops {
+		sid := sids[(i * 7919 + t * 104729) % sids.len]
+		if i % 10 == 0 {
+			s.set(sid, User{ age: i }) or { panic(err) }
+		} else {
+			s.get(sid) or { panic(err) }
+		}
+	}
+}
+
+fn work_sharded(mut s sessions.ShardedMemoryStore[User], sids []string, t int, ops int) {
+	for i in 0 .. ops {
+		sid := sids[(i * 7919 + t * 104729) % sids.len]
+		if i % 10 == 0 {
+			s.set(sid, User{ age: i }) or { panic(err) }
+		} else {
+			s.get(sid, time.hour) or { panic(err) }
+		}
+	}
+}
+
+fn main() {
+	nr_sessions := arguments()[1] or { '1_000_000' }.int()
+	nr_threads := arguments()[2] or { '8' }.int()
+	ops := 1_000_000
+	mut sids := []string{cap: nr_sessions}
+	for _ in 0 .. nr_sessions {
+		sid, _ := sessions.new_session_id('secret'.bytes())
+		sids << sid
+	}
+	mut b := benchmark.start()
+
+	mut locked := &LockedStore{}
+	for sid in sids {
+		locked.set(sid, User{})!
+	}
+	b.measure('MemoryStore with a lock, ${nr_sessions} sessions set')
+	mut threads := []thread{}
+	for t in 0 .. nr_threads {
+		threads << spawn work_locked(mut locked, sids, t, ops)
+	}
+	threads.wait()
+	b.measure('MemoryStore with a lock, ${nr_threads} threads x ${ops} operations')
+
+	mut sharded := sessions.new_sharded_memory_store[User](max_sessions: nr_sessions)
+	for sid in sids {
+		sharded.set(sid, User{})!
+	}
+	b.measure('ShardedMemoryStore, ${nr_sessions} sessions set')
+	threads.clear()
+	for t in 0 .. nr_threads {
+		threads << spawn work_sharded(mut sharded, sids, t, ops)
+	}
+	threads.wait()
+	b.measure('ShardedMemoryStore, ${nr_threads} threads x ${ops} operations')
+}
@@ -0,0 +1,50 @@
+import benchmark
+import db.sqlite
+
+struct User {
+	id   int @[primary]
+	name string
+	age  int
+}
+
+// runs the same queries with the statement cache disabled (before), and enabled (after)
+fn main() {
+	max_iterations := arguments()[1] or { '100_000' }.int()
+	assert max_iterations > 0
+	mut db := sqlite.connect(':memory:')!
+	sql db {
+		create table User
+	}!
+	for i in 0 .. 100 {
+		user := User{
+			id:   i
+			name: 'user ${i}'
+			age:  i % 50
+		}
+		sql db {
+			insert user into User
+		}!
+	}
+	for cache_size in [0, sqlite.default_stmt_cache_size] {
+		db.set_stmt_cache_size(cache_size)
+		label := if cache_size == 0 { 'no statement cache' } else { 'statement cache' }
+		mut volatile sum := u64(0)
+		mut b := benchmark.start()
+		for i in 0 .. max_iterations {
+			id := i % 100
+			users := sql db {
+				select from User where id == id
+			}!
+			sum += u64(users.len)
+		}
+		b.measure('${label}, ORM select, iterations: ${max_iterations}, sum: ${sum}')
+		for i in 0 .. max_iterations {
+			mut rows := db.query('select id, name, age from User where id = ?', i % 100)!
+			for row in rows {
+				sum += u64(row.int(2) + unsafe { row.text_view(1) }.len)
+			}
+		}
+		b.measure('${label}, query, iterations: ${max_iterations}, sum: ${sum}')
+	}
+	db.close()!
+}
@@ -0,0 +1,54 @@
+import benchmark
+import strings
+import toml
+
+struct Server {
+	host string
+	port int
+}
+
+struct Config {
+	name    string
+	version int
+	debug   bool
+	ratio   f64
+	server  Server
+	tags    []string
+	limits  map[string]int
+}
+
+fn main() {
+	n := 20_000
+	mut sb := strings.new_builder(n * 40)
+	sb.writeln('name = "bench"\nversion = 3\ndebug = true\nratio = 0.75')
+	sb.write_string('tags = [')
+	for i in 0 .. n {
+		sb.write_string('"tag${i}", ')
+	}
+	sb.writeln(']')
+	sb.writeln('[server]\nhost = "localhost"\nport = 8080')
+	sb.writeln('[limits]')
+	for i in 0 .. n {
+		sb.writeln('key${i} = ${i}')
+	}
+	text := sb.str()
+	println('${text.len / 1024} KB of TOML')
+
+	rounds := 20
+	mut b := benchmark.start()
+	for _ in 0 .. rounds {
+		toml.parse_text(text)!
+	}
+	b.measure('parse_text only, ${rounds} rounds')
+	for _ in 0 .. rounds {
+		doc := toml.parse_text(text)!
+		c := doc.to_any().reflect[Config]()
+		assert c.tags.len == n
+	}
+	b.measure('parse_text + to_any + reflect, ${rounds} rounds')
+	for _ in 0 .. rounds {
+		c := toml.decode[Config](text)!
+		assert c.tags.len == n && c.limits.len == n && c.server.port == 8080
+	}
+	b.measure('decode (direct from the parsed table), ${rounds} rounds')
+}
@@ -0,0 +1,305 @@
+module main
+
+// http_bench is a small HTTP/1.1 load generator, in the spirit of `wrk`.
+// It keeps `-c` connections open to the server (each in its own thread), sends
+// requests on them back to back, reusing each connection while the server keeps
+// it alive, and reports the throughput and the latency percentiles.
+// With `--http2`, the `-c` concurrent requests are multiplexed instead as streams of a single
+// HTTP/2 connection (h2c for http:// urls, h2 negotiated with ALPN for https:// ones). Usage:
+// v -prod cmd/tools/http_bench.v
+// cmd/tools/http_bench -c 64 -d 10 http://localhost:9009/
+// cmd/tools/http_bench --http2 -c 64 -d 10 http://localhost:9009/
+import os
+import flag
+import net
+import net.http
+import net.urllib
+import time
+import math
+import runtime
+
+const tool_version = '0.0.1'
+
+struct Config {
+mut:
+	connections int
+	duration    time.Duration
+	timeout     time.Duration
+	method      string
+	headers     []string
+	body        string
+	http2       bool
+	show_help   bool
+}
+
+// Stats are collected by each connection separately, and merged at the end.
+struct Stats {
+mut:
+	requests    i64
+	bytes       i64
+	errors      i64
+	non_2xx     i64
+	connections i64
+	latencies   []i64 // in microseconds
+}
+
+fn main() {
+	mut fp := flag.new_flag_parser(os.args#[1..])
+	fp.application(os.file_name(os.executable()))
+	fp.version(tool_version)
+	fp.description('HTTP benchmark tool: measures the throughput and the latency percentiles of an HTTP server, over HTTP/1.1 keep-alive connections, or multiplexed HTTP/2 streams.')
+	fp.arguments_description('URL')
+	fp.skip_executable()
+	fp.limit_free_args(1, 1)!
+	mut c := Config{}
+	c.show_help = fp.bool('help', `h`, false, 'Show this help screen.')
+	c.connections = fp.int('connections', `c`, 2 * runtime.nr_cpus(), 'Number of connections to keep open. Default: 2 x the number of CPUs')
+	c.duration = fp.int('duration', `d`, 10, 'Duration of the test, in seconds. Default: 10') * time.second
+	c.timeout = fp.int('timeout', `t`, 5000, 'Timeout for each request, in milliseconds. Default: 5000') * time.millisecond
+	c.method = fp.string('method', `m`, 'GET', 'The HTTP method. Default: GET')
+	c.headers = fp.string_multi('header', `H`, 'An additional header, for example: -H "Accept: text/html". Can be repeated.')
+	c.body = fp.string('body', `b`, '', 'The request body.')
+	c.http2 = fp.bool('http2', `2`, false, 'Multiplex the requests over a single HTTP/2 connection, instead of using -c HTTP/1.1 connections.')
+	if c.show_help {
+		println(fp.usage())
+		exit(0)
+	}
+	args := fp.finalize() or {
+		eprintln('Error: ${err}')
+		println(fp.usage())
+		exit(1)
+	}
+	url := urllib.parse(args[0]) or {
+		eprintln('Error: invalid url `${args[0]}`: ${err}')
+		exit(1)
+	}
+	if url.scheme != 'http' && !(c.http2 && url.scheme == 'https') {
+		eprintln('Error: only http:// urls are supported, and https:// ones with --http2')
+		exit(1)
+	}
+	port := if url.port() == '' { '80' } else { url.port() }
+	address := '${url.hostname()}:${port}'
+	request := build_request(c, url)
+
+	println('Running ${c.duration.seconds():.0f}s test @ ${args[0]}')
+	if c.http2 {
+		println('  ${c.connections} concurrent streams, over HTTP/2')
+	} else {
+		println('  ${c.connections} connections')
+	}
+	deadline := time.now().add(c.duration)
+	mut client := &http.Client{
+		http2: true
+	}
+	mut threads := []thread Stats{cap: c.connections}
+	for _ in 0 .. c.connections {
+		if c.http2 {
+			threads << spawn run_http2_stream(mut client, c, args[0], deadline)
+		} else {
+			threads << spawn run_connection(address, request, deadline, c.timeout)
+		}
+	}
+	mut total := Stats{}
+	for stats in threads.wait() {
+		total.requests += stats.requests
+		total.bytes += stats.bytes
+		total.errors += stats.errors
+		total.non_2xx += stats.non_2xx
+		total.connections += stats.connections
+		total.latencies << stats.latencies
+	}
+	if c.http2 {
+		total.connections = i64(client.stats().dials)
+		client.close()
+	}
+	report(total, c.duration)
+}
+
+fn build_request(c Config, url urllib.URL) string {
+	mut path := url.escaped_path()
+	if path == '' {
+		path = '/'
+	}
+	if url.raw_query != '' {
+		path += '?' + url.raw_query
+	}
+	mut req := '${c.method} ${path} HTTP/1.1\r\nHost: ${url.host}\r\n'
+	for h in c.headers {
+		req += '${h}\r\n'
+	}
+	if c.body != '' {
+		req += 'Content-Length: ${c.body.len}\r\n'
+	}
+	return req + '\r\n' + c.body
+}
+
+// run_connection sends requests on a single connection till the deadline, and reconnects when the server closes it
+fn run_connection(address string, request string, deadline time.Time, timeout time.Duration) Stats {
+	mut stats := Stats{
+		latencies: []i64{cap: 100_000}
+	}
+	mut buf := []u8{len: 64 * 1024}
+	for time.now() < deadline {
+		mut conn := net.dial_tcp(address) or {
+			stats.errors++
+			time.sleep(10 * time.millisecond)
+			continue
+		}
+		conn.set_read_timeout(timeout)
+		conn.set_write_timeout(timeout)
+		for time.now() < deadline {
+			sw := time.new_stopwatch()
+			conn.write_string(request) or {
+				stats.errors++
+				break
+			}
+			status, size, keep_alive := read_response(mut conn, mut buf) or {
+				stats.errors++
+				break
+			}
+			stats.latencies << sw.elapsed().microseconds()
+			stats.requests++
+			stats.bytes += size
+			if status < 200 || status > 299 {
+				stats.non_2xx++
+			}
+			if !keep_alive {
+				break
+			}
+		}
+		conn.close() or {}
+		stats.connections++
+	}
+	return stats
+}
+
+// run_http2_stream sends requests one after the other till the deadline, with the shared client,
+// which multiplexes them with the ones of the other threads on its HTTP/2 connection
+fn run_http2_stream(mut client http.Client, c Config, url string, deadline time.Time) Stats {
+	mut stats := Stats{
+		latencies: []i64{cap: 100_000}
+	}
+	mut header := http.new_header()
+	for h in c.headers {
+		header.add_custom(h.all_before(':').trim_space(), h.all_after(':').trim_space()) or {}
+	}
+	for time.now() < deadline {
+		sw := time.new_stopwatch()
+		resp := client.fetch(
+			method: http.method_from_str(c.method)
+			url:    url
+			header: header
+			data:   c.body
+		) or {
+			stats.errors++
+			continue
+		}
+		stats.latencies << sw.elapsed().microseconds()
+		stats.requests++
+		stats.bytes += resp.body.len
+		if resp.status_code < 200 || resp.status_code > 299 {
+			stats.non_2xx++
+		}
+	}
+	return stats
+}
+
+// read_response reads a whole response, and returns its status code, its size in bytes, and
+// whether the server keeps the connection open
+fn read_response(mut conn net.TcpConn, mut buf []u8) !(int, i64, bool) {
+	mut len := 0
+	mut head_end := -1
+	for head_end < 0 {
+		if len == buf.len {
+			return error('the response head is too large')
+		}
+		n := conn.read(mut buf[len..])!
+		if n <= 0 {
+			return error('connection closed')
+		}
+		len += n
+		head_end = buf[..len].bytestr().index('\r\n\r\n') or { -1 }
+	}
+	head := buf[..head_end].bytestr()
+	lines := head.split('\r\n')
+	status_parts := lines[0].split(' ')
+	if status_parts.len < 2 || !status_parts[0].starts_with('HTTP/1.') {
+		return error('malformed status line: ${lines[0]}')
+	}
+	status := status_parts[1].int()
+	mut content_length := i64(-1)
+	mut keep_alive := status_parts[0] == 'HTTP/1.1'
+	for line in lines[1..] {
+		name := line.all_before(':').trim_space().to_lower()
+		value := line.all_after(':').trim_space()
+		match name {
+			'content-length' { content_length = value.i64() }
+			'connection' { keep_alive = value.to_lower() != 'close' }
+			'transfer-encoding' { return error('chunked responses are not supported') }
+			else {}
+		}
+	}
+	body_start := head_end + 4
+	if content_length < 0 {
+		// no length => the body lasts till the server closes the connection
+		mut total := i64(len)
+		for {
+			n := conn.read(mut buf) or { break }
+			if n <= 0 {
+				break
+			}
+			total += n
+		}
+		return status, total, false
+	}
+	mut remaining := content_length - (len - body_start)
+	for remaining > 0 {
+		n := conn.read(mut buf)!
+		if n <= 0 {
+			return error('connection closed')
+		}
+		remaining -= n
+	}
+	return status, i64(body_start) + content_length, keep_alive
+}
+
+fn report(s Stats, duration time.Duration) {
+	mut lat := s.latencies.clone()
+	lat.sort()
+	secs := duration.seconds()
+	println('  Latency:')
+	if lat.len > 0 {
+		mut sum := f64(0)
+		for x in lat {
+			sum += f64(x)
+		}
+		avg := sum / f64(lat.len)
+		mut variance := f64(0)
+		for x in lat {
+			variance += (f64(x) - avg) * (f64(x) - avg)
+		}
+		stdev := math.sqrt(variance / f64(lat.len))
+		println('    avg: ${format_us(avg)}  stdev: ${format_us(stdev)}  max: ${format_us(f64(lat.last()))}')
+		for p in [50.0, 75.0, 90.0, 99.0, 99.9] {
+			idx := math.min(lat.len - 1, int(f64(lat.len) * p / 100.0))
+			println('    ${p:5.1f}%: ${format_us(f64(lat[idx]))}')
+		}
+	}
+	println('  ${s.requests} requests in ${secs:.2f}s, ${f64(s.bytes) / 1048576.0:.2f}MB read')
+	if s.errors > 0 || s.non_2xx > 0 {
+		println('  Errors: ${s.errors}, non-2xx responses: ${s.non_2xx}')
+	}
+	println('  Connections opened: ${s.connections}')
+	println('Requests/sec: ${f64(s.requests) / secs:.2f}')
+	println('Transfer/sec: ${f64(s.bytes) / secs / 1048576.0:.2f}MB')
+}
+
+fn format_us(us f64) string {
+	if us >= 1_000_000 {
+		return '${us / 1_000_000:.2f}s'
+	}
+	if us >= 1000 {
+		return '${us / 1000:.2f}ms'
+	}
+	return '${us:.0f}us'
+}
@@ -219,11 +219,12 @@ pub fn new_test_session(_vargs string, will_compile bool) TestSession {
 		skip_files << 'examples/call_v_from_c/v_test_math.v'
 		skip_files << 'examples/call_v_from_python/test.v' // the example only makes sense to be compiled, when python is installed
 		skip_files << 'examples/call_v_from_ruby/test.v' // the example only makes sense to be compiled, when ruby is installed
-		// Skip the compilation of the coroutines example for now, since the Photon wrapper
-		// is only available on macos for now, and it is not yet trivial enough to
-		// build/install on the CI:
-		skip_files << 'examples/coroutines/simple_coroutines.v'
-		skip_files << 'examples/coroutines/coroutines_bench.v'
+		$if windows {
+			// the coroutines scheduler (vlib/coroutines/vcoro.c) needs pthreads and mmap
+			skip_files << 'examples/coroutines/simple_coroutines.v'
+			skip_files << 'examples/coroutines/coroutines_bench.v'
+			skip_files << 'examples/coroutines/coroutines_echo_server.v'
+		}
 		$if msvc {
 			skip_files << 'vlib/v/tests/consts/const_comptime_eval_before_vinit_test.v' // _constructor used
 			skip_files << 'vlib/v/tests/project_with_cpp_code/compiling_cpp_files_with_a_cplusplus_compiler_test.c.v'
@@ -491,6 +492,12 @@ fn worker_trunner(mut p pool.PoolProcessor, idx int, thread_id int) voidptr {
 	if relative_file.contains('global') && !is_fmt {
 		cmd_options << ' -enable-globals'
 	}
+	if produces_file_output {
+		test_vflags := get_test_details(file).vflags
+		if test_vflags != '' {
+			cmd_options << ' ${test_vflags}'
+		}
+	}
 	if ts.root_relative {
 		relative_file = relative_file.replace(ts.vroot + os.path_separator, '')
 	}
@@ -859,8 +866,9 @@ pub fn setup_new_vtmp_folder(hash string) string {
 
 pub struct TestDetails {
 pub mut:
-	retry int
-	flaky bool // when flaky tests fail, the whole run is still considered successful, unless VTEST_FAIL_FLAKY is 1
+	retry  int
+	flaky  bool   // when flaky tests fail, the whole run is still considered successful, unless VTEST_FAIL_FLAKY is 1
+	vflags string // the extra options, that the test file has to be compiled with
 }
 
 pub fn get_test_details(file string) TestDetails {
@@ -873,6 +881,9 @@ pub fn get_test_details(file string) TestDetails {
 		if line.starts_with('// vtest flaky:') {
 			res.flaky = line.all_after(':').trim_space().bool()
 		}
+		if line.starts_with('// vtest vflags:') {
+			res.vflags = line.all_after(':').trim_space()
+		}
 	}
 	return res
 }
@@ -165,6 +165,9 @@ const auto_complete_flags = [
 	'-prof',
 	'-profile',
 	'-profile-no-inline',
+	'-profile-callgraph',
+	'-profile-sampling',
+	'-profile-sampling-hz',
 	'-prod',
 	'-simulator',
 	'-stats',
@@ -174,6 +177,7 @@ const auto_complete_flags = [
 	'-nocolor',
 	'-showcc',
 	'-show-c-output',
+	'-show-bce',
 	'-experimental',
 	'-usecache',
 	'-prealloc',
@@ -0,0 +1,34 @@
+// Build with
+// v -use-coroutines coroutines_echo_server.v
+//
+// A TCP echo server, that starts a coroutine for each client. The reads and writes of
+// the coroutines park only the coroutine itself, not the worker thread that runs it, so
+// the server can keep many thousands of mostly idle connections open, with just a few
+// OS threads. Try it with many clients at once, for example:
+// for i in $(seq 1000); do (echo hello; sleep 5) | nc 127.0.0.1 12345 & done
+import net
+
+fn main() {
+	mut server := net.listen_tcp(.ip, ':12345')!
+	laddr := server.addr()!
+	eprintln('Listen on ${laddr} ...')
+	for {
+		mut socket := server.accept() or { continue }
+		go handle_client(mut socket)
+	}
+}
+
+fn handle_client(mut socket net.TcpConn) {
+	defer {
+		socket.close() or {}
+	}
+	socket.set_read_timeout(net.infinite_timeout)
+	mut buf := []u8{len: 4096}
+	for {
+		n := socket.read(mut buf) or { return }
+		if n == 0 {
+			return
+		}
+		socket.write(buf[..n]) or { return }
+	}
+}
@@ -0,0 +1,280 @@
+module builtin
+
+// Arena is a region based allocator. It hands out memory by bumping a pointer inside big chunks,
+// that it gets from the system as needed, and releases all of it at once, with .reset() or .free().
+// This makes it a good fit for memory, that has a clearly delimited lifetime, like the temporary
+// data of a single request in a server, or of a single frame in a game:
+// ```v
+// mut arena := new_arena()
+// for {
+//     handle_request(mut arena)
+//     arena.reset() // O(1), the chunks are kept, and reused by the next request
+// }
+// ```
+// Memory can be requested from an arena explicitly with `unsafe { arena.malloc(n) }`.
+// In programs compiled with `-prealloc`, all the V allocations of a thread (strings, arrays, maps,
+// `&Struct{}` ...) can also be redirected to an arena, between `arena.enter()` and `arena.leave()`.
+// Note: an arena is not thread safe by itself; use a separate arena for each thread.
+// Note: with the Boehm GC, the chunks are not collectable, but they are scanned for pointers to
+// GC allocated memory, so storing such pointers in arena memory is safe.
+@[heap]
+pub struct Arena {
+mut:
+	first      &VMemoryBlock = unsafe { nil }
+	current    &VMemoryBlock = unsafe { nil }
+	chunk_size isize
+	mallocs    u64
+	bytes      u64
+	saved      &Arena = unsafe { nil } // the arena, that was active before .enter()
+	next       &Arena = unsafe { nil } // used by -prealloc, for the list of the default arenas of all threads
+}
+
+// VMemoryBlock is the header of a single chunk of an Arena.
+// The chunks of an arena form a list, from the first one, to the ones kept for reuse after a .reset().
+struct VMemoryBlock {
+mut:
+	id        int
+	cap       isize
+	start     &u8 = unsafe { nil }
+	current   &u8 = unsafe { nil }
+	remaining isize
+	mallocs   int
+	next      &VMemoryBlock = unsafe { nil }
+}
+
+// ArenaStats describes the current state of an arena.
+pub struct ArenaStats {
+pub:
+	mallocs  u64 // the number of allocations, since the creation of the arena, or since its last .reset()
+	bytes    u64 // the number of bytes, requested by those allocations
+	chunks   int // the number of chunks, owned by the arena
+	capacity u64 // the total size of the chunks, in bytes
+}
+
+@[params]
+pub struct ArenaParams {
+pub:
+	chunk_size isize = arena_default_chunk_size // the minimum size of each chunk, requested from the system
+}
+
+const arena_default_chunk_size = 1024 * 1024
+
+// all arena allocations are aligned like the ones of libc's malloc
+const arena_align = 16
+
+@[inline]
+fn arena_align_size(n isize) isize {
+	return (n + arena_align - 1) & ~isize(arena_align - 1)
+}
+
+// new_arena creates a new, empty arena. Its first chunk is allocated on the first use.
+pub fn new_arena(params ArenaParams) &Arena {
+	return unsafe { new_raw_arena(params.chunk_size) }
+}
+
+// new_raw_arena allocates the arena itself outside of the V heap, so that it is usable
+// for -prealloc too, where the V heap is made of arenas
+@[unsafe]
+fn new_raw_arena(chunk_size isize) &Arena {
+	mut a := unsafe { &Arena(arena_chunk_alloc(isize(sizeof(Arena)))) }
+	unsafe { vmemset(a, 0, isize(sizeof(Arena))) }
+	a.chunk_size = chunk_size
+	return a
+}
+
+@[unsafe]
+fn arena_chunk_alloc(n isize) &u8 {
+	mut res := &u8(0)
+	$if gcboehm ? && !prealloc {
+		res = unsafe { C.GC_MALLOC_UNCOLLECTABLE(n) }
+	} $else {
+		res = unsafe { C.malloc(n) }
+	}
+	if res == 0 {
+		panic('arena: can not allocate a chunk')
+	}
+	return res
+}
+
+@[unsafe]
+fn arena_chunk_free(ptr voidptr) {
+	$if gcboehm ? && !prealloc {
+		unsafe { C.GC_FREE(ptr) }
+	} $else {
+		unsafe { C.free(ptr) }
+	}
+}
+
+// vmemory_block_new allocates a chunk, that can hold at least `at_least` bytes.
+// The VMemoryBlock header is stored at the start of the chunk itself.
+@[unsafe]
+fn vmemory_block_new(id int, at_least isize, chunk_size isize) &VMemoryBlock {
+	min_size := if chunk_size > 0 { chunk_size } else { arena_default_chunk_size }
+	block_size := if at_least < min_size { min_size } else { at_least }
+	header_size := arena_align_size(isize(sizeof(VMemoryBlock)))
+	mut v := unsafe { &VMemoryBlock(arena_chunk_alloc(header_size + block_size)) }
+	unsafe { vmemset(v, 0, isize(sizeof(VMemoryBlock))) }
+	v.id = id
+	v.start = unsafe { &u8(v) + header_size }
+	v.cap = block_size
+	v.remaining = block_size
+	v.current = v.start
+	return v
+}
+
+@[inline]
+fn (mut b VMemoryBlock) rewind() {
+	b.current = b.start
+	b.remaining = b.cap
+	b.mallocs = 0
+}
+
+// next_block makes the arena use a chunk, with at least `size` free bytes. It reuses the chunk after the
+// current one when possible, otherwise it inserts a new chunk there.
+@[unsafe]
+fn (mut a Arena) next_block(size isize) &VMemoryBlock {
+	mut cur := a.current
+	if cur == unsafe { nil } {
+		if a.first == unsafe { nil } {
+			a.first = unsafe { vmemory_block_new(0, size, a.chunk_size) }
+		}
+		a.current = a.first
+		a.current.rewind()
+		if a.current.remaining >= size {
+			return a.current
+		}
+		cur = a.current
+	}
+	mut next := cur.next
+	if next != unsafe { nil } && next.cap >= size {
+		next.rewind()
+	} else {
+		next = unsafe { vmemory_block_new(cur.id + 1, size, a.chunk_size) }
+		next.next = cur.next
+		cur.next = next
+	}
+	a.current = next
+	return next
+}
+
+// malloc returns a pointer to `n` bytes of uninitialised memory, that stays valid till the next
+// .reset() or .free() call of the arena.
+@[unsafe]
+pub fn (mut a Arena) malloc(n isize) &u8 {
+	if n < 0 {
+		panic('Arena.malloc(n < 0)')
+	}
+	size := arena_align_size(n)
+	mut b := a.current
+	if b == unsafe { nil } || b.remaining < size {
+		b = unsafe { a.next_block(size) }
+	}
+	res := b.current
+	b.current = unsafe { b.current + size }
+	b.remaining -= size
+	b.mallocs++
+	a.mallocs++
+	a.bytes += u64(n)
+	return res
+}
+
+// calloc is like .malloc(), but the returned memory is zeroed.
+@[unsafe]
+pub fn (mut a Arena) calloc(n isize) &u8 {
+	res := unsafe { a.malloc(n) }
+	unsafe { vmemset(res, 0, n) }
+	return res
+}
+
+// realloc returns a pointer to `new_size` bytes, with the contents of the `old_size` bytes at `old_data`.
+// When `old_data` is the last allocation of the arena, it is grown in place.
+@[unsafe]
+pub fn (mut a Arena) realloc(old_data &u8, old_size isize, new_size isize) &u8 {
+	mut b := a.current
+	if b != unsafe { nil } && old_data != unsafe { nil } {
+		old_end := unsafe { old_data + arena_align_size(old_size) }
+		grow := arena_align_size(new_size) - arena_align_size(old_size)
+		if old_end == b.current && grow <= b.remaining {
+			b.current = unsafe { b.current + grow }
+			b.remaining -= grow
+			if new_size > old_size {
+				a.bytes += u64(new_size - old_size)
+			}
+			return old_data
+		}
+	}
+	new_ptr := unsafe { a.malloc(new_size) }
+	if old_data != unsafe { nil } {
+		min_size := if old_size < new_size { old_size } else { new_size }
+		unsafe { vmemcpy(new_ptr, old_data, min_size) }
+	}
+	return new_ptr
+}
+
+// reset makes all the memory of the arena available for new allocations, in O(1).
+// The chunks are kept, and reused by the following allocations.
+// All the pointers returned by the arena before the reset, become invalid.
+pub fn (mut a Arena) reset() {
+	a.current = unsafe { nil }
+	a.mallocs = 0
+	a.bytes = 0
+}
+
+// free releases all the chunks of the arena, and the arena itself, back to the system.
+// The arena must not be used after that, and it must not be active (between .enter() and .leave()).
+@[unsafe]
+pub fn (mut a Arena) free() {
+	unsafe {
+		a.free_chunks()
+		arena_chunk_free(a)
+	}
+}
+
+// free_chunks releases all the chunks of the arena, but not the arena itself
+@[unsafe]
+fn (mut a Arena) free_chunks() {
+	mut b := a.first
+	for b != unsafe { nil } {
+		next := b.next
+		unsafe { arena_chunk_free(b) }
+		b = next
+	}
+	a.first = unsafe { nil }
+	a.reset()
+}
+
+// stats returns the number of allocations and bytes, served by the arena since its last reset,
+// and the number and total size of the chunks it owns.
+pub fn (a &Arena) stats() ArenaStats {
+	mut chunks := 0
+	mut capacity := u64(0)
+	mut b := a.first
+	for b != unsafe { nil } {
+		chunks++
+		capacity += u64(b.cap)
+		b = b.next
+	}
+	return ArenaStats{
+		mallocs:  a.mallocs
+		bytes:    a.bytes
+		chunks:   chunks
+		capacity: capacity
+	}
+}
+
+// enter makes the arena the target of all V allocations done by the current thread,
+// till the matching .leave() call. Calls to .enter() of different arenas can be nested.
+// Note: this has an effect only in programs compiled with `-prealloc`. Otherwise, the arena
+// can only be used explicitly, through .malloc(), .calloc() and .realloc().
+pub fn (mut a Arena) enter() {
+	$if prealloc {
+		unsafe { prealloc_enter(a) }
+	}
+}
+
+// leave restores the arena that was active before the matching .enter() call.
+pub fn (mut a Arena) leave() {
+	$if prealloc {
+		unsafe { prealloc_leave(a) }
+	}
+}
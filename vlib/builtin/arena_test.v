@@ -0,0 +1,73 @@
+fn test_arena_malloc_and_reset() {
+	mut a := new_arena(chunk_size: 4096)
+	p1 := unsafe { a.malloc(10) }
+	p2 := unsafe { a.malloc(10) }
+	assert p1 != p2
+	assert u64(p1) % 16 == 0
+	assert u64(p2) % 16 == 0
+	s := a.stats()
+	assert s.mallocs == 2
+	assert s.bytes == 20
+	assert s.chunks == 1
+	a.reset()
+	assert a.stats().mallocs == 0
+	assert a.stats().chunks == 1
+	p3 := unsafe { a.malloc(10) }
+	assert p3 == p1
+	assert a.stats().chunks == 1
+	// free releases the arena too, so it is not used after that
+	unsafe { a.free() }
+}
+
+fn test_arena_big_allocations_get_new_chunks() {
+	mut a := new_arena(chunk_size: 1024)
+	for _ in 0 .. 10 {
+		unsafe { a.malloc(1000) }
+	}
+	assert a.stats().chunks > 1
+	big := unsafe { a.malloc(100_000) }
+	assert big != unsafe { nil }
+	assert a.stats().capacity >= 100_000
+	a.reset()
+	chunks := a.stats().chunks
+	for _ in 0 .. 10 {
+		unsafe { a.malloc(1000) }
+	}
+	assert a.stats().chunks == chunks
+	unsafe { a.free() }
+}
+
+fn test_arena_calloc_and_realloc() {
+	mut a := new_arena()
+	p := unsafe { a.calloc(64) }
+	for i in 0 .. 64 {
+		assert unsafe { p[i] } == 0
+		unsafe {
+			p[i] = u8(i)
+		}
+	}
+	// the last allocation is grown in place
+	q := unsafe { a.realloc(p, 64, 128) }
+	assert q == p
+	unsafe { a.malloc(8) }
+	r := unsafe { a.realloc(q, 128, 256) }
+	assert r != q
+	for i in 0 .. 64 {
+		assert unsafe { r[i] } == u8(i)
+	}
+	unsafe { a.free() }
+}
+
+fn test_arena_enter_leave() {
+	mut a := new_arena()
+	a.enter()
+	s := 'abc'.repeat(10)
+	a.leave()
+	assert s.len == 30
+	$if prealloc {
+		assert a.stats().mallocs > 0
+	} $else {
+		assert a.stats().mallocs == 0
+	}
+	unsafe { a.free() }
+}
@@ -885,6 +885,88 @@ pub fn (mut a array) sort_with_compare(callback fn (voidptr, voidptr) int) {
 	}
 }
 
+// sort_stable_with_compare sorts the array in-place, like .sort_with_compare(), but
+// the elements, for which the callback returns `0`, keep their original relative order.
+// It uses a merge sort, and a temporary buffer, with the same size as the array.
+// Example:
+// ```v
+// mut a := ['bb', 'a', 'cc', 'd']
+// a.sort_stable_with_compare(fn (a &string, b &string) int {
+// 	return a.len - b.len
+// })
+// assert a == ['a', 'd', 'bb', 'cc']
+// ```
+pub fn (mut a array) sort_stable_with_compare(callback fn (voidptr, voidptr) int) {
+	$if freestanding {
+		panic('sort_stable_with_compare does not work with -freestanding')
+	} $else {
+		unsafe { merge_sort(a.data, a.len, a.element_size, callback) }
+	}
+}
+
+// merge_sort sorts `len` elements of size `esize` at `data` stably: runs of `merge_sort_run`
+// elements are sorted with insertion sort first, and then merged, back and forth between
+// `data` and a temporary buffer.
+@[unsafe]
+fn merge_sort(data voidptr, len int, esize int, callback fn (voidptr, voidptr) int) {
+	if len < 2 {
+		return
+	}
+	unsafe {
+		base := &u8(data)
+		tmp := malloc(isize(len) * esize + esize)
+		elem := tmp + isize(len) * esize
+		for start := 0; start < len; start += merge_sort_run {
+			end := if start + merge_sort_run < len { start + merge_sort_run } else { len }
+			for i := start + 1; i < end; i++ {
+				if callback(base + isize(i) * esize, base + isize(i - 1) * esize) >= 0 {
+					continue
+				}
+				vmemcpy(elem, base + isize(i) * esize, esize)
+				mut j := i
+				for j > start && callback(elem, base + isize(j - 1) * esize) < 0 {
+					j--
+				}
+				vmemmove(base + isize(j + 1) * esize, base + isize(j) * esize, isize(i - j) * esize)
+				vmemcpy(base + isize(j) * esize, elem, esize)
+			}
+		}
+		mut src := base
+		mut dst := tmp
+		for width := merge_sort_run; width < len; width *= 2 {
+			for left := 0; left < len; left += 2 * width {
+				mid := if left + width < len { left + width } else { len }
+				right := if mid + width < len { mid + width } else { len }
+				mut i, mut j, mut k := left, mid, left
+				for i < mid && j < right {
+					// take from the right run only when it is strictly smaller, so that equal elements keep their order
+					if callback(src + isize(j) * esize, src + isize(i) * esize) < 0 {
+						vmemcpy(dst + isize(k) * esize, src + isize(j) * esize, esize)
+						j++
+					} else {
+						vmemcpy(dst + isize(k) * esize, src + isize(i) * esize, esize)
+						i++
+					}
+					k++
+				}
+				if i < mid {
+					vmemcpy(dst + isize(k) * esize, src + isize(i) * esize, isize(mid - i) * esize)
+				}
+				if j < right {
+					vmemcpy(dst + isize(k) * esize, src + isize(j) * esize, isize(right - j) * esize)
+				}
+			}
+			src, dst = dst, src
+		}
+		if src != base {
+			vmemcpy(base, src, isize(len) * esize)
+		}
+		free(tmp)
+	}
+}
+
+const merge_sort_run = 16
+
 // sorted_with_compare sorts a clone of the array, using the results of the
 // given function to determine sort order. The original array is not modified.
 // See also .sort_with_compare()
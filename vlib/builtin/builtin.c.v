@@ -384,6 +384,9 @@ pub fn malloc(n isize) &u8 {
 		C.fprintf(C.stderr, c'_v_malloc %6d total %10d\n', n, total_m)
 		// print_backtrace()
 	}
+	$if trace_allocs ? {
+		C.vtrace_allocs_record(n)
+	}
 	vplayground_mlimit(n)
 	if n < 0 {
 		panic('malloc(${n} < 0)')
@@ -420,6 +423,9 @@ pub fn malloc_noscan(n isize) &u8 {
 		C.fprintf(C.stderr, c'malloc_noscan %6d total %10d\n', n, total_m)
 		// print_backtrace()
 	}
+	$if trace_allocs ? {
+		C.vtrace_allocs_record(n)
+	}
 	vplayground_mlimit(n)
 	if n < 0 {
 		panic('malloc_noscan(${n} < 0)')
@@ -472,6 +478,9 @@ pub fn malloc_uncollectable(n isize) &u8 {
 		C.fprintf(C.stderr, c'malloc_uncollectable %6d total %10d\n', n, total_m)
 		// print_backtrace()
 	}
+	$if trace_allocs ? {
+		C.vtrace_allocs_record(n)
+	}
 	vplayground_mlimit(n)
 	if n < 0 {
 		panic('malloc_uncollectable(${n} < 0)')
@@ -520,6 +529,9 @@ pub fn v_realloc(b &u8, n isize) &u8 {
 	} $else {
 		new_ptr = unsafe { C.realloc(b, n) }
 	}
+	$if trace_allocs ? {
+		C.vtrace_allocs_record(n)
+	}
 	if new_ptr == 0 {
 		panic('realloc(${n}) failed')
 	}
@@ -539,6 +551,11 @@ pub fn realloc_data(old_data &u8, old_size int, new_size int) &u8 {
 	$if trace_realloc ? {
 		C.fprintf(C.stderr, c'realloc_data old_size: %6d new_size: %6d\n', old_size, new_size)
 	}
+	$if trace_allocs ? {
+		$if !debug_realloc ? {
+			C.vtrace_allocs_record(new_size)
+		}
+	}
 	$if prealloc {
 		return unsafe { prealloc_realloc(old_data, old_size, new_size) }
 	}
@@ -580,6 +597,9 @@ pub fn vcalloc(n isize) &u8 {
 		total_m += n
 		C.fprintf(C.stderr, c'vcalloc %6d total %10d\n', n, total_m)
 	}
+	$if trace_allocs ? {
+		C.vtrace_allocs_record(n)
+	}
 	if n < 0 {
 		panic('calloc(${n} < 0)')
 	} else if n == 0 {
@@ -602,6 +622,12 @@ pub fn vcalloc_noscan(n isize) &u8 {
 		C.fprintf(C.stderr, c'vcalloc_noscan %6d total %10d\n', n, total_m)
 	}
 	vplayground_mlimit(n)
+	$if trace_allocs ? {
+		// without prealloc and gcboehm, vcalloc is called below, and it records the allocation itself
+		$if prealloc || gcboehm ? {
+			C.vtrace_allocs_record(n)
+		}
+	}
 	$if prealloc {
 		return unsafe { prealloc_calloc(n) }
 	} $else $if gcboehm ? {
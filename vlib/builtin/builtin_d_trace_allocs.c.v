@@ -0,0 +1,51 @@
+module builtin
+
+// This file is compiled only for `v -d trace_allocs program.v` .
+// See vlib/builtin/trace_allocs.h for the details.
+#include "@VEXEROOT/vlib/builtin/trace_allocs.h"
+
+fn C.vtrace_allocs_record(size i64)
+fn C.vtrace_allocs_write(path &char)
+fn C.vtrace_allocs_reset()
+fn C.vtrace_allocs_totals(count &u64, bytes &u64)
+
+// TraceAllocsStats is the total number of allocations, and the total number
+// of allocated bytes, for all threads, since the start of the program, or since
+// the last call to trace_allocs_reset().
+pub struct TraceAllocsStats {
+pub:
+	count u64
+	bytes u64
+}
+
+// trace_allocs_write writes a heap profile with the allocation sites recorded so far, to the file `path`.
+// The format is the legacy gperftools heap profile format, that pprof reads directly, for example:
+// `go tool pprof -sample_index=space -top ./program program.heap` .
+// Use `-` for the path, to write the profile to stdout.
+// Note: the profile can also be written by sending SIGUSR2 to the process. In that case, and at exit,
+// the file name is based on the V_TRACE_ALLOCS_FILE environment variable, and the process id.
+pub fn trace_allocs_write(path string) {
+	$if tinyc {
+		$compile_warn('-d trace_allocs needs backtrace(), that is not available with tcc; use `-cc gcc` or `-cc clang`, to get the call sites of the allocations')
+	} $else $if windows {
+		$compile_warn('-d trace_allocs needs backtrace(), that is not available on Windows, so the call sites of the allocations will not be known')
+	}
+	C.vtrace_allocs_write(&char(path.str))
+}
+
+// trace_allocs_reset forgets all the allocation sites recorded so far.
+// It is useful for excluding the allocations done during the startup of a program.
+pub fn trace_allocs_reset() {
+	C.vtrace_allocs_reset()
+}
+
+// trace_allocs_stats returns the total number of allocations, and allocated bytes.
+pub fn trace_allocs_stats() TraceAllocsStats {
+	mut count := u64(0)
+	mut bytes := u64(0)
+	C.vtrace_allocs_totals(&count, &bytes)
+	return TraceAllocsStats{
+		count: count
+		bytes: bytes
+	}
+}
@@ -0,0 +1,22 @@
+module builtin
+
+// TraceAllocsStats is the total number of allocations, and the total number
+// of allocated bytes, recorded by programs compiled with `-d trace_allocs`.
+pub struct TraceAllocsStats {
+pub:
+	count u64
+	bytes u64
+}
+
+// trace_allocs_write does nothing, without `-d trace_allocs`.
+pub fn trace_allocs_write(path string) {
+}
+
+// trace_allocs_reset does nothing, without `-d trace_allocs`.
+pub fn trace_allocs_reset() {
+}
+
+// trace_allocs_stats returns zeros, without `-d trace_allocs`.
+pub fn trace_allocs_stats() TraceAllocsStats {
+	return TraceAllocsStats{}
+}
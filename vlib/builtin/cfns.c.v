@@ -8,6 +8,8 @@ fn C.memcpy(dest voidptr, const_src voidptr, n usize) voidptr
 
 fn C.memcmp(const_s1 voidptr, const_s2 voidptr, n usize) int
 
+fn C.memchr(const_s voidptr, c int, n usize) voidptr
+
 fn C.memmove(dest voidptr, const_src voidptr, n usize) voidptr
 
 fn C.memset(str voidptr, c int, n usize) voidptr
@@ -76,6 +76,25 @@ pub fn vmemset(s voidptr, c int, n isize) voidptr {
 	}
 }
 
+// vmemchr_index returns the index of the first byte `c`, in the first `n` bytes of the memory
+// area `s`, or -1 when there is none. It uses libc's memchr, that is vectorized on most platforms,
+// and a portable SWAR search, 8 bytes at a time, with -freestanding.
+@[inline; unsafe]
+fn vmemchr_index(const_s voidptr, c u8, n int) int {
+	if n <= 0 {
+		return -1
+	}
+	$if freestanding {
+		return unsafe { swar_index_u8(const_s, n, c) }
+	} $else {
+		res := unsafe { C.memchr(const_s, c, n) }
+		if res == unsafe { nil } {
+			return -1
+		}
+		return int(u64(res) - u64(const_s))
+	}
+}
+
 type FnSortCB = fn (const_a voidptr, const_b voidptr) int
 
 @[inline; unsafe]
@@ -1,4 +1,3 @@
-@[has_globals]
 module builtin
 
 // With -prealloc, V calls libc's malloc to get chunks, each at least 16MB
@@ -6,58 +5,55 @@ module builtin
 // V code, that can fit inside the chunk, will use it instead, each bumping a
 // pointer, till the chunk is filled. Once a chunk is filled, a new chunk will
 // be allocated by calling libc's malloc, and the process continues.
-// Each new chunk has a pointer to the old one, and at the end of the program,
-// the entire linked list of chunks is freed.
+// The chunks are owned by an Arena (see vlib/builtin/arena.c.v). Each thread
+// gets its own default arena, on its first allocation, so that threads never
+// share chunks. At the end of the program, the chunks of all arenas are freed.
 // The goal of all this is to amortize the cost of calling libc's malloc,
-// trading higher memory usage for a compiler (or any single threaded batch
-// mode program), for a ~8-10% speed increase.
-// Note: `-prealloc` is NOT safe to be used for multithreaded programs!
+// trading higher memory usage for a ~8-10% speed increase.
+// A thread can also redirect its allocations temporarily to another arena,
+// with `arena.enter()` and `arena.leave()`, and then release all the memory
+// allocated in between at once, with `arena.reset()`.
+// Note: the C compiler has to support thread local storage (gcc, clang, msvc).
+// With tcc, all threads share a single default arena, and then `-prealloc`
+// is NOT safe to be used for multithreaded programs!
+#include "@VEXEROOT/vlib/builtin/prealloc.h"
+
+fn C.vprealloc_get_thread_arena() voidptr
+fn C.vprealloc_set_thread_arena(arena voidptr)
+fn C.vprealloc_get_active_arena() voidptr
+fn C.vprealloc_set_active_arena(arena voidptr)
+fn C.vprealloc_register(arena voidptr, next &voidptr)
+fn C.vprealloc_registered_arenas() voidptr
 
 // size of the preallocated chunk
 const prealloc_block_size = 16 * 1024 * 1024
 
-__global g_memory_block &VMemoryBlock
-@[heap]
-struct VMemoryBlock {
-mut:
-	id        int
-	cap       isize
-	start     &u8           = 0
-	previous  &VMemoryBlock = 0
-	remaining isize
-	current   &u8 = 0
-	mallocs   int
+// prealloc_arena returns the arena, that serves the allocations of the current thread
+@[inline; unsafe]
+fn prealloc_arena() &Arena {
+	mut a := unsafe { &Arena(C.vprealloc_get_active_arena()) }
+	if a != unsafe { nil } {
+		return a
+	}
+	a = unsafe { &Arena(C.vprealloc_get_thread_arena()) }
+	if a == unsafe { nil } {
+		a = unsafe { new_raw_arena(prealloc_block_size) }
+		C.vprealloc_set_thread_arena(a)
+		C.vprealloc_register(a, unsafe { &voidptr(&a.next) })
+	}
+	return a
 }
 
 @[unsafe]
-fn vmemory_block_new(prev &VMemoryBlock, at_least isize) &VMemoryBlock {
-	mut v := unsafe { &VMemoryBlock(C.calloc(1, sizeof(VMemoryBlock))) }
-	if unsafe { prev != 0 } {
-		v.id = prev.id + 1
-	}
-
-	v.previous = prev
-	block_size := if at_least < prealloc_block_size { prealloc_block_size } else { at_least }
-	v.start = unsafe { C.malloc(block_size) }
-	v.cap = block_size
-	v.remaining = block_size
-	v.current = v.start
-	return v
+fn prealloc_enter(mut a Arena) {
+	a.saved = unsafe { &Arena(C.vprealloc_get_active_arena()) }
+	C.vprealloc_set_active_arena(a)
 }
 
 @[unsafe]
-fn vmemory_block_malloc(n isize) &u8 {
-	unsafe {
-		if g_memory_block.remaining < n {
-			g_memory_block = vmemory_block_new(g_memory_block, n)
-		}
-		mut res := &u8(0)
-		res = g_memory_block.current
-		g_memory_block.remaining -= n
-		g_memory_block.mallocs++
-		g_memory_block.current += n
-		return res
-	}
+fn prealloc_leave(mut a Arena) {
+	C.vprealloc_set_active_arena(a.saved)
+	a.saved = unsafe { nil }
 }
 
 /////////////////////////////////////////////////
@@ -65,7 +61,7 @@ fn vmemory_block_malloc(n isize) &u8 {
 @[unsafe]
 fn prealloc_vinit() {
 	unsafe {
-		g_memory_block = vmemory_block_new(nil, prealloc_block_size)
+		prealloc_arena()
 		at_exit(prealloc_vcleanup) or {}
 	}
 }
@@ -74,41 +70,43 @@ fn prealloc_vinit() {
 fn prealloc_vcleanup() {
 	$if prealloc_stats ? {
 		// Note: we do 2 loops here, because string interpolation
-		// in the first loop may still use g_memory_block
+		// in the first loop may still use the arena of the main thread
 		// The second loop however should *not* allocate at all.
 		mut nr_mallocs := i64(0)
-		mut mb := g_memory_block
-		for unsafe { mb != 0 } {
-			nr_mallocs += mb.mallocs
-			eprintln('> freeing mb.id: ${mb.id:3} | cap: ${mb.cap:7} | rem: ${mb.remaining:7} | start: ${voidptr(mb.start)} | current: ${voidptr(mb.current)} | diff: ${u64(mb.current) - u64(mb.start):7} bytes | mallocs: ${mb.mallocs}')
-			mb = mb.previous
+		mut a := unsafe { &Arena(C.vprealloc_registered_arenas()) }
+		for unsafe { a != 0 } {
+			mut mb := a.first
+			for unsafe { mb != 0 } {
+				nr_mallocs += mb.mallocs
+				eprintln('> freeing mb.id: ${mb.id:3} | cap: ${mb.cap:7} | rem: ${mb.remaining:7} | start: ${voidptr(mb.start)} | current: ${voidptr(mb.current)} | diff: ${u64(mb.current) - u64(mb.start):7} bytes | mallocs: ${mb.mallocs}')
+				mb = mb.next
+			}
+			a = a.next
 		}
 		eprintln('> nr_mallocs: ${nr_mallocs}')
 	}
 	unsafe {
-		for g_memory_block != 0 {
-			C.free(g_memory_block.start)
-			g_memory_block = g_memory_block.previous
+		C.vprealloc_set_active_arena(nil)
+		mut a := &Arena(C.vprealloc_registered_arenas())
+		for a != 0 {
+			next := a.next
+			a.free()
+			a = next
 		}
 	}
 }
 
 @[unsafe]
 fn prealloc_malloc(n isize) &u8 {
-	return unsafe { vmemory_block_malloc(n) }
+	return unsafe { prealloc_arena().malloc(n) }
 }
 
 @[unsafe]
 fn prealloc_realloc(old_data &u8, old_size isize, new_size isize) &u8 {
-	new_ptr := unsafe { vmemory_block_malloc(new_size) }
-	min_size := if old_size < new_size { old_size } else { new_size }
-	unsafe { C.memcpy(new_ptr, old_data, min_size) }
-	return new_ptr
+	return unsafe { prealloc_arena().realloc(old_data, old_size, new_size) }
 }
 
 @[unsafe]
 fn prealloc_calloc(n isize) &u8 {
-	new_ptr := unsafe { vmemory_block_malloc(n) }
-	unsafe { C.memset(new_ptr, 0, n) }
-	return new_ptr
+	return unsafe { prealloc_arena().calloc(n) }
 }
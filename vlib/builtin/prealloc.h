@@ -0,0 +1,47 @@
+// The thread local state of `-prealloc`, see vlib/builtin/prealloc.c.v .
+// Each thread gets its own default Arena, created on its first allocation, and registered with a CAS
+// in a global list, so that all the arenas can be freed (and their stats shown) at exit.
+#ifndef V_PREALLOC_H
+#define V_PREALLOC_H
+
+#include "thread_local.h" // without TLS (tcc), all threads share a single arena, like before
+
+static V_THREAD_LOCAL void *vprealloc_thread_arena = NULL; // the default &Arena of the current thread
+static V_THREAD_LOCAL void *vprealloc_active_arena = NULL; // the &Arena set by Arena.enter(), if any
+static void *vprealloc_arenas = NULL; // the list of all the default arenas, linked through Arena.next
+
+static inline void *vprealloc_get_thread_arena(void) { return vprealloc_thread_arena; }
+static inline void vprealloc_set_thread_arena(void *arena) { vprealloc_thread_arena = arena; }
+static inline void *vprealloc_get_active_arena(void) { return vprealloc_active_arena; }
+static inline void vprealloc_set_active_arena(void *arena) { vprealloc_active_arena = arena; }
+
+// vprealloc_register prepends `arena` to the global list; `next` is the address of its link field
+static void vprealloc_register(void *arena, void **next) {
+#if defined(__TINYC__)
+	*next = vprealloc_arenas;
+	vprealloc_arenas = arena;
+#elif defined(_MSC_VER)
+	void *head;
+	do {
+		head = vprealloc_arenas;
+		*next = head;
+	} while (InterlockedCompareExchangePointer(&vprealloc_arenas, arena, head) != head);
+#else
+	void *head = __atomic_load_n(&vprealloc_arenas, __ATOMIC_ACQUIRE);
+	do {
+		*next = head;
+	} while (!__atomic_compare_exchange_n(&vprealloc_arenas, &head, arena, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+#endif
+}
+
+static inline void *vprealloc_registered_arenas(void) {
+#if defined(__TINYC__)
+	return vprealloc_arenas;
+#elif defined(_MSC_VER)
+	return InterlockedCompareExchangePointer(&vprealloc_arenas, NULL, NULL);
+#else
+	return __atomic_load_n(&vprealloc_arenas, __ATOMIC_ACQUIRE);
+#endif
+}
+
+#endif
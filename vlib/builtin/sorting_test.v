@@ -80,3 +80,91 @@ fn f(mut users []User) {
 fn z(mut users []User) {
 	users.sort(a.name < b.name)
 }
+
+fn is_sorted_asc(a []int) bool {
+	for i in 1 .. a.len {
+		if a[i - 1] > a[i] {
+			return false
+		}
+	}
+	return true
+}
+
+fn test_sorting_big_arrays_with_patterns() {
+	// the sizes cover the insertion sort, the median of 3, and the pseudomedian of 9 paths
+	for n in [0, 1, 2, 23, 24, 25, 100, 129, 1000, 10_000] {
+		mut seed := u32(12345)
+		mut patterns := [][]int{}
+		mut random := []int{len: n}
+		for i in 0 .. n {
+			seed = seed * 1103515245 + 12345
+			random[i] = int(seed >> 16) % 1000
+		}
+		patterns << random
+		patterns << []int{len: n, init: index}
+		patterns << []int{len: n, init: n - index}
+		patterns << []int{len: n, init: 7}
+		patterns << []int{len: n, init: index % 3}
+		patterns << []int{len: n, init: if index < n / 2 { index } else { n - index }}
+		for p in patterns {
+			mut asc := p.clone()
+			asc.sort()
+			assert asc.len == n
+			assert is_sorted_asc(asc)
+			mut desc := p.clone()
+			desc.sort(a > b)
+			desc.reverse_in_place()
+			assert desc == asc
+			mut with_compare := p.clone()
+			with_compare.sort_with_compare(fn (x &int, y &int) int {
+				return *x - *y
+			})
+			assert with_compare == asc
+		}
+	}
+}
+
+fn test_sorting_strings_and_structs() {
+	mut words := []string{len: 500, init: (index * 7919 % 500).str()}
+	mut expected := words.clone()
+	expected.sort_with_compare(fn (a &string, b &string) int {
+		return a.compare(b)
+	})
+	words.sort()
+	assert words == expected
+	mut users := []User{len: 300, init: User{
+		age:  index * 31 % 300
+		name: index.str()
+	}}
+	users.sort(a.age < b.age)
+	for i, u in users {
+		assert u.age == i
+	}
+}
+
+fn test_sort_stable_with_compare() {
+	mut a := ['bb', 'a', 'cc', 'd']
+	a.sort_stable_with_compare(fn (a &string, b &string) int {
+		return a.len - b.len
+	})
+	assert a == ['a', 'd', 'bb', 'cc']
+	// elements with the same key must keep their original order, also across merged runs
+	mut users := []User{len: 1000, init: User{
+		age:  index % 10
+		name: index.str()
+	}}
+	users.sort_stable_with_compare(fn (a &User, b &User) int {
+		return a.age - b.age
+	})
+	for i in 1 .. users.len {
+		assert users[i - 1].age <= users[i].age
+		if users[i - 1].age == users[i].age {
+			assert users[i - 1].name.int() < users[i].name.int()
+		}
+	}
+	mut empty := []int{}
+	empty.sort_stable_with_compare(fn (a &int, b &int) int {
+		return *a - *b
+	})
+	assert empty.len == 0
+}
@@ -966,36 +966,19 @@ pub fn (s string) split_nth(delim string, nth int) []string {
 				res << ch.ascii_str()
 			}
 		}
-		1 {
-			delim_byte := delim[0]
-			mut start := 0
-			for i, ch in s {
-				if ch == delim_byte {
-					if nth > 0 && res.len == nth - 1 {
-						break
-					}
-					res << s.substr(start, i)
-					start = i + 1
-				}
-			}
-			if nth < 1 || res.len < nth {
-				res << s[start..]
-			}
-		}
 		else {
 			mut start := 0
 			// Add up to `nth` segments left of every occurrence of the delimiter.
-			for i := 0; i + delim.len <= s.len; {
-				if unsafe { s.substr_unsafe(i, i + delim.len) } == delim {
-					if nth > 0 && res.len == nth - 1 {
-						break
-					}
-					res << s.substr(start, i)
-					i += delim.len
-					start = i
-				} else {
-					i++
+			for {
+				i := s.index_after_(delim, start)
+				if i == -1 {
+					break
 				}
+				if nth > 0 && res.len == nth - 1 {
+					break
+				}
+				res << s.substr(start, i)
+				start = i + delim.len
 			}
 			// Then add the remaining part of the string as the last segment.
 			if nth < 1 || res.len < nth {
@@ -1073,22 +1056,18 @@ pub fn (s string) split_into_lines() []string {
 	if s.len == 0 {
 		return res
 	}
-	cr := `\r`
-	lf := `\n`
 	mut line_start := 0
-	for i := 0; i < s.len; i++ {
-		if line_start <= i {
-			if s[i] == lf {
-				res << if line_start == i { '' } else { s[line_start..i] }
-				line_start = i + 1
-			} else if s[i] == cr {
-				res << if line_start == i { '' } else { s[line_start..i] }
-				if (i + 1) < s.len && s[i + 1] == lf {
-					line_start = i + 2
-				} else {
-					line_start = i + 1
-				}
-			}
+	for line_start < s.len {
+		eol := unsafe { swar_index_eol(s.str + line_start, s.len - line_start) }
+		if eol == -1 {
+			break
+		}
+		i := line_start + eol
+		res << if line_start == i { '' } else { s[line_start..i] }
+		if s[i] == `\r` && i + 1 < s.len && s[i + 1] == `\n` {
+			line_start = i + 2
+		} else {
+			line_start = i + 1
 		}
 	}
 	if line_start < s.len {
@@ -1209,21 +1188,7 @@ fn (s string) index_(p string) int {
 	if p.len > s.len || p.len == 0 {
 		return -1
 	}
-	if p.len > 2 {
-		return s.index_kmp(p)
-	}
-	mut i := 0
-	for i < s.len {
-		mut j := 0
-		for j < p.len && unsafe { s.str[i + j] == p.str[j] } {
-			j++
-		}
-		if j == p.len {
-			return i
-		}
-		i++
-	}
-	return -1
+	return s.index_after_(p, 0)
 }
 
 // index returns the position of the first character of the first occurrence of the `needle` string in `s`.
@@ -1345,32 +1310,14 @@ pub fn (s string) index_after(p string, start int) int {
 	if start >= s.len {
 		return -1
 	}
-	mut i := strt
-	for i < s.len {
-		mut j := 0
-		mut ii := i
-		for j < p.len && unsafe { s.str[ii] == p.str[j] } {
-			j++
-			ii++
-		}
-		if j == p.len {
-			return i
-		}
-		i++
-	}
-	return -1
+	return s.index_after_(p, strt)
 }
 
 // index_u8 returns the index of byte `c` if found in the string.
 // index_u8 returns -1 if the byte can not be found.
-@[direct_array_access]
+@[inline]
 pub fn (s string) index_u8(c u8) int {
-	for i, b in s {
-		if b == c {
-			return i
-		}
-	}
-	return -1
+	return unsafe { vmemchr_index(s.str, c, s.len) }
 }
 
 // index_u8_last returns the index of the *last* occurrence of the byte `c` (if found) in the string.
@@ -1385,12 +1332,7 @@ pub fn (s string) index_u8_last(c u8) int {
 // last_index_u8 returns the index of the last occurrence of byte `c` if it was found in the string.
 @[inline]
 pub fn (s string) last_index_u8(c u8) int {
-	for i := s.len - 1; i >= 0; i-- {
-		if s[i] == c {
-			return i
-		}
-	}
-	return -1
+	return unsafe { swar_last_index_u8(s.str, s.len, c) }
 }
 
 // count returns the number of occurrences of `substr` in the string.
@@ -1407,15 +1349,7 @@ pub fn (s string) count(substr string) int {
 	mut n := 0
 
 	if substr.len == 1 {
-		target := substr[0]
-
-		for letter in s {
-			if letter == target {
-				n++
-			}
-		}
-
-		return n
+		return unsafe { swar_count_u8(s.str, s.len, substr[0]) }
 	}
 
 	mut i := 0
@@ -1432,13 +1366,9 @@ pub fn (s string) count(substr string) int {
 
 // contains_u8 returns `true` if the string contains the byte value `x`.
 // See also: [`string.index_u8`](#string.index_u8) , to get the index of the byte as well.
+@[inline]
 pub fn (s string) contains_u8(x u8) bool {
-	for c in s {
-		if x == c {
-			return true
-		}
-	}
-	return false
+	return s.index_u8(x) != -1
 }
 
 // contains returns `true` if the string contains `substr`.
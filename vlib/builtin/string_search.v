@@ -0,0 +1,152 @@
+module builtin
+
+// SWAR (SIMD within a register) helpers, for the byte and substring searches in strings.
+// They examine 8 bytes at a time, with plain u64 arithmetic, so they work on all targets,
+// including the ones without vector instructions, or without a libc (-freestanding, wasm).
+// Each function finds a block of 8 bytes that has a match first, and then looks at the
+// individual bytes of just that block, which also makes them independent of the endianness.
+
+const swar_ones = u64(0x0101010101010101)
+const swar_lows = u64(0x7f7f7f7f7f7f7f7f)
+
+// swar_load reads 8 bytes from `p`, that does not have to be aligned.
+@[inline; unsafe]
+fn swar_load(p &u8) u64 {
+	mut x := u64(0)
+	unsafe { vmemcpy(&x, p, 8) }
+	return x
+}
+
+// swar_zero_bytes returns a word, where the high bit of a byte is set, iff the same byte of `x` is 0.
+// Unlike the shorter `(x - ones) & ~x & highs`, it has no false positives, so the bits can be counted.
+@[inline]
+fn swar_zero_bytes(x u64) u64 {
+	return ~(((x & swar_lows) + swar_lows) | x | swar_lows)
+}
+
+// swar_index_u8 returns the index of the first byte `c` in the `n` bytes at `p`, or -1.
+@[direct_array_access; unsafe]
+fn swar_index_u8(p &u8, n int, c u8) int {
+	pattern := swar_ones * u64(c)
+	mut i := 0
+	for i + 8 <= n && swar_zero_bytes(unsafe { swar_load(p + i) } ^ pattern) == 0 {
+		i += 8
+	}
+	for ; i < n; i++ {
+		if unsafe { p[i] } == c {
+			return i
+		}
+	}
+	return -1
+}
+
+// swar_last_index_u8 returns the index of the last byte `c` in the `n` bytes at `p`, or -1.
+@[direct_array_access; unsafe]
+fn swar_last_index_u8(p &u8, n int, c u8) int {
+	pattern := swar_ones * u64(c)
+	mut i := n
+	for i >= 8 && swar_zero_bytes(unsafe { swar_load(p + i - 8) } ^ pattern) == 0 {
+		i -= 8
+	}
+	for i > 0 {
+		i--
+		if unsafe { p[i] } == c {
+			return i
+		}
+	}
+	return -1
+}
+
+// swar_index_eol returns the index of the first `\n` or `\r` byte in the `n` bytes at `p`, or -1.
+@[direct_array_access; unsafe]
+fn swar_index_eol(p &u8, n int) int {
+	lf := swar_ones * u64(`\n`)
+	cr := swar_ones * u64(`\r`)
+	mut i := 0
+	for i + 8 <= n {
+		x := unsafe { swar_load(p + i) }
+		if swar_zero_bytes(x ^ lf) | swar_zero_bytes(x ^ cr) != 0 {
+			break
+		}
+		i += 8
+	}
+	for ; i < n; i++ {
+		b := unsafe { p[i] }
+		if b == `\n` || b == `\r` {
+			return i
+		}
+	}
+	return -1
+}
+
+// swar_count_u8 returns the number of bytes `c` in the `n` bytes at `p`.
+@[direct_array_access; unsafe]
+fn swar_count_u8(p &u8, n int, c u8) int {
+	pattern := swar_ones * u64(c)
+	mut count := 0
+	mut i := 0
+	for ; i + 8 <= n; i += 8 {
+		// the matching bytes become 1, and the multiplication sums all bytes into the top one
+		z := swar_zero_bytes(unsafe { swar_load(p + i) } ^ pattern) >> 7
+		count += int((z * swar_ones) >> 56)
+	}
+	for ; i < n; i++ {
+		if unsafe { p[i] } == c {
+			count++
+		}
+	}
+	return count
+}
+
+// index_after_ returns the index of the first occurrence of `p` in `s`, at or after `start` (that must be >= 0),
+// or -1 when there is none. The candidate positions are the ones where both the first and the last byte of `p`
+// match, and they are found for 8 positions at a time, before being verified with vmemcmp. If there are too many
+// false candidates (needles like `aaab` in `aaaa...`), it switches to KMP, so that the worst case stays linear.
+@[direct_array_access]
+fn (s string) index_after_(p string, start int) int {
+	if p.len == 0 {
+		return if start <= s.len { start } else { -1 }
+	}
+	if start + p.len > s.len {
+		return -1
+	}
+	if p.len == 1 {
+		idx := unsafe { vmemchr_index(s.str + start, p.str[0], s.len - start) }
+		return if idx == -1 { -1 } else { start + idx }
+	}
+	k := p.len - 1
+	positions := s.len - k
+	first := unsafe { p.str[0] }
+	last := unsafe { p.str[k] }
+	first_pattern := swar_ones * u64(first)
+	last_pattern := swar_ones * u64(last)
+	mut wasted := 0
+	mut i := start
+	for i + 8 <= positions {
+		firsts := unsafe { swar_load(s.str + i) }
+		lasts := unsafe { swar_load(s.str + i + k) }
+		if swar_zero_bytes(firsts ^ first_pattern) & swar_zero_bytes(lasts ^ last_pattern) != 0 {
+			for j in i .. i + 8 {
+				if unsafe { s.str[j] == first && s.str[j + k] == last } {
+					if unsafe { vmemcmp(s.str + j + 1, p.str + 1, k - 1) } == 0 {
+						return j
+					}
+					wasted += k
+				}
+			}
+			if wasted > 2 * (i - start) + 1024 {
+				rest := unsafe { tos(s.str + i, s.len - i) }
+				idx := rest.index_kmp(p)
+				return if idx == -1 { -1 } else { i + idx }
+			}
+		}
+		i += 8
+	}
+	for ; i < positions; i++ {
+		if unsafe { s.str[i] == first && s.str[i + k] == last
+			&& vmemcmp(s.str + i + 1, p.str + 1, k - 1) == 0 } {
+			return i
+		}
+	}
+	return -1
+}
@@ -1546,6 +1546,56 @@ fn test_contains_byte() {
 	assert !'abc abca'.contains_u8(`A`)
 }
 
+fn test_search_in_long_strings() {
+	// the searches look at 8 bytes at a time, so check every position and every tail length
+	for n in 0 .. 40 {
+		for pos in 0 .. n {
+			mut buf := []u8{len: n, init: `.`}
+			buf[pos] = `x`
+			s := buf.bytestr()
+			assert s.index_u8(`x`) == pos
+			assert s.last_index_u8(`x`) == pos
+			assert s.contains_u8(`x`)
+			assert s.count('x') == 1
+			assert s.count('.') == n - 1
+			if pos + 3 <= n {
+				buf[pos + 1] = `y`
+				buf[pos + 2] = `z`
+				t := buf.bytestr()
+				assert t.index('xyz')? == pos
+				assert t.index_after('xyz', pos) == pos
+				assert t.index_after('xyz', pos + 1) == -1
+				assert t.contains('xyz')
+				assert !t.contains('xzy')
+			}
+		}
+		assert '.'.repeat(n).index_u8(`x`) == -1
+		assert '.'.repeat(n).last_index_u8(`x`) == -1
+	}
+	assert 'ab'.repeat(100).count('ab') == 100
+	assert 'ab'.repeat(100).count('b') == 100
+	assert 'aaa'.repeat(10).count('aa') == 15
+	assert ('a'.repeat(50) + 'abc' + 'a'.repeat(50)).index('aabc')? == 49
+}
+
+fn test_search_with_many_false_candidates() {
+	// needles, whose first and last bytes match almost everywhere, make the search switch to KMP
+	haystack := 'a'.repeat(100_000) + 'b'
+	assert haystack.index('a'.repeat(100) + 'b')? == 100_000 - 100
+	assert haystack.index_after('a'.repeat(50) + 'b', 10) == 100_000 - 50
+	assert !haystack.contains('a'.repeat(100) + 'c' + 'a'.repeat(100))
+	assert haystack.count('aab') == 1
+	assert haystack.replace('ab', 'c') == 'a'.repeat(99_999) + 'c'
+}
+
+fn test_split_with_long_delimiters() {
+	assert 'a--b--c'.split('--') == ['a', 'b', 'c']
+	assert 'a--b--c'.split_nth('--', 2) == ['a', 'b--c']
+	assert '--a----'.split('--') == ['', 'a', '', '']
+	lines := 'x'.repeat(20) + '\r\n' + 'y'.repeat(20) + '\n\r' + 'z'.repeat(20) + '\r'
+	assert lines.split_into_lines() == ['x'.repeat(20), 'y'.repeat(20), '', 'z'.repeat(20)]
+}
+
 fn test_camel_to_snake() {
 	assert 'Abcd'.camel_to_snake() == 'abcd'
 	assert 'aBcd'.camel_to_snake() == 'a_bcd'
@@ -0,0 +1,18 @@
+// V_THREAD_LOCAL marks the C globals, of which each thread has its own copy.
+// tcc has no TLS support, so there V_THREAD_LOCAL is empty, and V_HAS_THREAD_LOCAL is 0:
+// all threads share those globals, and the code using them is safe only for a single thread.
+#ifndef V_THREAD_LOCAL_H
+#define V_THREAD_LOCAL_H
+
+#if defined(_MSC_VER)
+	#define V_THREAD_LOCAL __declspec(thread)
+	#define V_HAS_THREAD_LOCAL 1
+#elif defined(__TINYC__)
+	#define V_THREAD_LOCAL
+	#define V_HAS_THREAD_LOCAL 0
+#else
+	#define V_THREAD_LOCAL __thread
+	#define V_HAS_THREAD_LOCAL 1
+#endif
+
+#endif
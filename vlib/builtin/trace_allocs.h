@@ -0,0 +1,315 @@
+// The allocation site recorder, used by `v -d trace_allocs program.v` .
+// Every allocation done through the builtin allocation functions, captures a short call stack,
+// and adds its size to a bucket keyed by the hash of that stack, in a table owned by the
+// current thread (the tables are registered in a global list with a CAS, and never freed).
+// Each table has a spin lock, that its thread takes while updating it (uncontended, except while
+// a profile is being written), and that the readers of all the tables take (totals, reset, write).
+// The tables are written in the legacy gperftools heap profile format, that `pprof` reads
+// directly: `go tool pprof -sample_index=space ./program program.heap` .
+// Note: all the memory used here comes from libc's calloc, not from V's malloc, so it is not traced.
+#ifndef V_TRACE_ALLOCS_H
+#define V_TRACE_ALLOCS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef VTRACE_ALLOCS_DEPTH
+#define VTRACE_ALLOCS_DEPTH 16
+#endif
+#ifndef VTRACE_ALLOCS_SLOTS
+#define VTRACE_ALLOCS_SLOTS 16384 // per thread, must be a power of 2
+#endif
+
+// Without backtrace() (tcc, musl, Windows), only the allocator frame is known, so all the allocations
+// end up in the same few buckets; a warning is printed at startup in that case.
+#if (defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)) && !defined(__TINYC__)
+	#include <execinfo.h>
+	#define VTRACE_ALLOCS_HAS_BACKTRACE 1
+#endif
+#if !defined(_WIN32)
+	#include <signal.h>
+	#include <unistd.h>
+	#include <sched.h>
+#endif
+
+#include "thread_local.h" // without TLS (tcc), the stats of different threads can race
+
+// the atomic operations on the flags and locks below; tcc has no atomics, and is not thread safe anyway
+#if defined(_MSC_VER)
+static inline int vtrace_allocs_cas(volatile long *p, long old, long new_) { return InterlockedCompareExchange(p, new_, old) == old; }
+static inline void vtrace_allocs_store(volatile long *p, long v) { InterlockedExchange(p, v); }
+static inline long vtrace_allocs_load(volatile long *p) { return InterlockedCompareExchange(p, 0, 0); }
+static inline long vtrace_allocs_fetch_add(volatile long *p) { return InterlockedIncrement(p) - 1; }
+static inline void vtrace_allocs_pause(void) { SwitchToThread(); }
+#elif defined(__TINYC__)
+static inline int vtrace_allocs_cas(volatile long *p, long old, long new_) { if (*p != old) { return 0; } *p = new_; return 1; }
+static inline void vtrace_allocs_store(volatile long *p, long v) { *p = v; }
+static inline long vtrace_allocs_load(volatile long *p) { return *p; }
+static inline long vtrace_allocs_fetch_add(volatile long *p) { return (*p)++; }
+static inline void vtrace_allocs_pause(void) {}
+#else
+static inline int vtrace_allocs_cas(volatile long *p, long old, long new_) { return __atomic_compare_exchange_n(p, &old, new_, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); }
+static inline void vtrace_allocs_store(volatile long *p, long v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static inline long vtrace_allocs_load(volatile long *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline long vtrace_allocs_fetch_add(volatile long *p) { return __atomic_fetch_add(p, 1, __ATOMIC_RELAXED); }
+static inline void vtrace_allocs_pause(void) { sched_yield(); }
+#endif
+
+typedef struct VTraceAllocsBucket {
+	uint64_t hash;
+	uint64_t count;
+	uint64_t bytes;
+	int depth;
+	void *pcs[VTRACE_ALLOCS_DEPTH]; // pcs[0] is the innermost frame
+} VTraceAllocsBucket;
+
+typedef struct VTraceAllocsThread {
+	struct VTraceAllocsThread *next;
+	uint64_t count;
+	uint64_t bytes;
+	uint64_t dropped; // allocations, whose stacks did not fit in the table
+	int busy; // set while recording, so that allocations done by backtrace() itself are not traced
+	volatile long lock; // held while the buckets and the counters are used
+	VTraceAllocsBucket buckets[VTRACE_ALLOCS_SLOTS];
+} VTraceAllocsThread;
+
+static VTraceAllocsThread *vtrace_allocs_threads = NULL;
+static V_THREAD_LOCAL VTraceAllocsThread *vtrace_allocs_self = NULL;
+static volatile long vtrace_allocs_dump_requested = 0;
+static volatile long vtrace_allocs_init_state = 0; // 0: not initialised, 1: being initialised, 2: initialised
+static volatile long vtrace_allocs_dump_counter = 0;
+
+static inline void vtrace_allocs_lock(VTraceAllocsThread *t) {
+	while (!vtrace_allocs_cas(&t->lock, 0, 1)) {
+		vtrace_allocs_pause();
+	}
+}
+
+static inline void vtrace_allocs_unlock(VTraceAllocsThread *t) {
+	vtrace_allocs_store(&t->lock, 0);
+}
+
+static void vtrace_allocs_write(const char *path);
+
+static void vtrace_allocs_dump_file(char *buf, size_t buflen) {
+	const char *prefix = getenv("V_TRACE_ALLOCS_FILE");
+#if defined(_WIN32)
+	int pid = 0;
+#else
+	int pid = (int)getpid();
+#endif
+	snprintf(buf, buflen, "%s.%d.%04d.heap", prefix != NULL && prefix[0] != 0 ? prefix : "vtrace_allocs", pid, (int)vtrace_allocs_fetch_add(&vtrace_allocs_dump_counter));
+}
+
+static void vtrace_allocs_at_exit(void) {
+	if (getenv("V_TRACE_ALLOCS_FILE") != NULL) {
+		char path[4096];
+		vtrace_allocs_dump_file(path, sizeof(path));
+		vtrace_allocs_write(path);
+	}
+}
+
+#if !defined(_WIN32)
+// Writing a file is not async signal safe, so the handler only sets a flag;
+// the profile is written by the next traced allocation, in the normal context.
+static void vtrace_allocs_on_signal(int sig) {
+	(void)sig;
+	vtrace_allocs_dump_requested = 1;
+}
+#endif
+
+static void vtrace_allocs_init(void) {
+#if !defined(VTRACE_ALLOCS_HAS_BACKTRACE)
+	fprintf(stderr, "trace_allocs: warning: backtrace() is not available for this target/C compiler, so the allocations can not be attributed to their call sites\n");
+#endif
+	atexit(vtrace_allocs_at_exit);
+#if !defined(_WIN32)
+	signal(SIGUSR2, vtrace_allocs_on_signal);
+#endif
+}
+
+// vtrace_allocs_init_once runs vtrace_allocs_init exactly once; the other threads wait till it is done
+static void vtrace_allocs_init_once(void) {
+	if (vtrace_allocs_load(&vtrace_allocs_init_state) == 2) {
+		return;
+	}
+	if (vtrace_allocs_cas(&vtrace_allocs_init_state, 0, 1)) {
+		vtrace_allocs_init();
+		vtrace_allocs_store(&vtrace_allocs_init_state, 2);
+		return;
+	}
+	while (vtrace_allocs_load(&vtrace_allocs_init_state) != 2) {
+		vtrace_allocs_pause();
+	}
+}
+
+static VTraceAllocsThread *vtrace_allocs_thread(void) {
+	VTraceAllocsThread *t = vtrace_allocs_self;
+	if (t != NULL) {
+		return t;
+	}
+	t = (VTraceAllocsThread *)calloc(1, sizeof(VTraceAllocsThread));
+	if (t == NULL) {
+		return NULL;
+	}
+#if defined(__TINYC__)
+	t->next = vtrace_allocs_threads;
+	vtrace_allocs_threads = t;
+#elif defined(_MSC_VER)
+	VTraceAllocsThread *head;
+	do {
+		head = vtrace_allocs_threads;
+		t->next = head;
+	} while (InterlockedCompareExchangePointer((void *volatile *)&vtrace_allocs_threads, t, head) != head);
+#else
+	VTraceAllocsThread *head = __atomic_load_n(&vtrace_allocs_threads, __ATOMIC_ACQUIRE);
+	do {
+		t->next = head;
+	} while (!__atomic_compare_exchange_n(&vtrace_allocs_threads, &head, t, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+#endif
+	vtrace_allocs_self = t;
+	return t;
+}
+
+static void vtrace_allocs_record(int64_t size) {
+	vtrace_allocs_init_once();
+	VTraceAllocsThread *t = vtrace_allocs_thread();
+	if (t == NULL || t->busy) {
+		return;
+	}
+	t->busy = 1;
+	void *pcs[VTRACE_ALLOCS_DEPTH + 1];
+	int depth = 0;
+#if defined(VTRACE_ALLOCS_HAS_BACKTRACE)
+	depth = backtrace(pcs, VTRACE_ALLOCS_DEPTH + 1);
+	// skip the frame of vtrace_allocs_record itself:
+	if (depth > 0) {
+		depth--;
+		memmove(&pcs[0], &pcs[1], depth * sizeof(void *));
+	}
+#elif defined(__GNUC__) || defined(__clang__)
+	pcs[0] = __builtin_return_address(0);
+	depth = 1;
+#endif
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < depth; i++) {
+		hash = (hash ^ (uint64_t)(uintptr_t)pcs[i]) * 0x100000001b3ULL; // FNV-1a over the pcs
+	}
+	vtrace_allocs_lock(t);
+	t->count++;
+	t->bytes += (uint64_t)size;
+	uint64_t mask = VTRACE_ALLOCS_SLOTS - 1;
+	uint64_t idx = hash & mask;
+	int recorded = 0;
+	for (int probe = 0; probe < 128; probe++, idx = (idx + 1) & mask) {
+		VTraceAllocsBucket *b = &t->buckets[idx];
+		if (b->count == 0) {
+			b->hash = hash;
+			b->depth = depth;
+			memcpy(b->pcs, pcs, depth * sizeof(void *));
+		} else if (b->hash != hash || b->depth != depth || memcmp(b->pcs, pcs, depth * sizeof(void *)) != 0) {
+			continue;
+		}
+		b->count++;
+		b->bytes += (uint64_t)size;
+		recorded = 1;
+		break;
+	}
+	if (!recorded) {
+		t->dropped++;
+	}
+	vtrace_allocs_unlock(t);
+	if (vtrace_allocs_load(&vtrace_allocs_dump_requested) && vtrace_allocs_cas(&vtrace_allocs_dump_requested, 1, 0)) {
+		char path[4096];
+		vtrace_allocs_dump_file(path, sizeof(path));
+		vtrace_allocs_write(path);
+	}
+	t->busy = 0;
+}
+
+// vtrace_allocs_first returns the head of the list of the tables, that other threads may be prepending to
+static inline VTraceAllocsThread *vtrace_allocs_first(void) {
+#if defined(__TINYC__)
+	return vtrace_allocs_threads;
+#elif defined(_MSC_VER)
+	return (VTraceAllocsThread *)InterlockedCompareExchangePointer((void *volatile *)&vtrace_allocs_threads, NULL, NULL);
+#else
+	return __atomic_load_n(&vtrace_allocs_threads, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void vtrace_allocs_totals(uint64_t *count, uint64_t *bytes) {
+	*count = 0;
+	*bytes = 0;
+	for (VTraceAllocsThread *t = vtrace_allocs_first(); t != NULL; t = t->next) {
+		vtrace_allocs_lock(t);
+		*count += t->count;
+		*bytes += t->bytes;
+		vtrace_allocs_unlock(t);
+	}
+}
+
+static void vtrace_allocs_reset(void) {
+	for (VTraceAllocsThread *t = vtrace_allocs_first(); t != NULL; t = t->next) {
+		vtrace_allocs_lock(t);
+		t->count = 0;
+		t->bytes = 0;
+		t->dropped = 0;
+		for (int i = 0; i < VTRACE_ALLOCS_SLOTS; i++) {
+			t->buckets[i].count = 0;
+			t->buckets[i].bytes = 0;
+		}
+		vtrace_allocs_unlock(t);
+	}
+}
+
+// vtrace_allocs_write writes the buckets of all threads in the legacy heap profile format.
+// Since the GC frees the memory behind our back, the in use values are the same as the allocated ones.
+static void vtrace_allocs_write(const char *path) {
+	FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "trace_allocs: can not open %s for writing\n", path);
+		return;
+	}
+	uint64_t count = 0, bytes = 0;
+	vtrace_allocs_totals(&count, &bytes);
+	fprintf(fp, "heap profile: %llu: %llu [%llu: %llu] @ heapprofile\n", (unsigned long long)count,
+		(unsigned long long)bytes, (unsigned long long)count, (unsigned long long)bytes);
+	for (VTraceAllocsThread *t = vtrace_allocs_first(); t != NULL; t = t->next) {
+		vtrace_allocs_lock(t);
+		for (int i = 0; i < VTRACE_ALLOCS_SLOTS; i++) {
+			VTraceAllocsBucket *b = &t->buckets[i];
+			if (b->count == 0) {
+				continue;
+			}
+			fprintf(fp, "%llu: %llu [%llu: %llu] @", (unsigned long long)b->count, (unsigned long long)b->bytes,
+				(unsigned long long)b->count, (unsigned long long)b->bytes);
+			for (int f = 0; f < b->depth; f++) {
+				fprintf(fp, " %p", b->pcs[f]);
+			}
+			fprintf(fp, "\n");
+		}
+		vtrace_allocs_unlock(t);
+	}
+	// pprof needs the memory mappings, to symbolize the addresses of position independent executables:
+	fprintf(fp, "\nMAPPED_LIBRARIES:\n");
+#if defined(__linux__)
+	FILE *maps = fopen("/proc/self/maps", "r");
+	if (maps != NULL) {
+		char line[4096];
+		while (fgets(line, sizeof(line), maps) != NULL) {
+			fputs(line, fp);
+		}
+		fclose(maps);
+	}
+#endif
+	if (fp == stdout) {
+		fflush(fp);
+	} else {
+		fclose(fp);
+	}
+}
+
+#endif
@@ -0,0 +1,193 @@
+// vtest vflags: -use-coroutines
+module coroutines
+
+import sync
+import time
+
+// the tests run the coroutines with `go`, and wait for them on the main thread (that is not a coroutine),
+// with channels and sync.WaitGroup, which block only the main thread.
+// Without -use-coroutines, `go` is the same as `spawn`, so the tests check that their code really ran
+// on a coroutine, i.e. that the scheduler and the poller were used.
+
+fn C.vcoro_wait_fd(fd int, write int, timeout i64) int
+fn C.vcoro_close(fd int) int
+fn C.vcoro_in_coroutine() int
+
+fn on_coroutine() bool {
+	return C.vcoro_in_coroutine() == 1
+}
+
+fn test_the_main_thread_is_not_a_coroutine() {
+	assert !on_coroutine()
+}
+
+@[heap]
+struct Counter {
+mut:
+	mu           sync.Mutex
+	n            int
+	on_coroutine int
+}
+
+fn count_with_yields(mut wg sync.WaitGroup, mut c Counter, n int) {
+	for _ in 0 .. n {
+		c.mu.@lock()
+		c.n++
+		if on_coroutine() {
+			c.on_coroutine++
+		}
+		c.mu.unlock()
+		yield()
+	}
+	wg.done()
+}
+
+fn test_go_yield_and_join() {
+	mut wg := sync.new_waitgroup()
+	mut c := &Counter{}
+	c.mu.init()
+	nr_coroutines := 100
+	wg.add(nr_coroutines)
+	for _ in 0 .. nr_coroutines {
+		go count_with_yields(mut wg, mut c, 100)
+	}
+	wg.wait()
+	assert c.n == nr_coroutines * 100
+	assert c.on_coroutine == c.n
+}
+
+// echo_twice replies -1, when it does not run on a coroutine
+fn echo_twice(requests chan int, replies chan int) {
+	for {
+		x := <-requests or { break }
+		replies <- if on_coroutine() { x * 2 } else { -1 }
+	}
+}
+
+fn test_channel_wakeups_across_threads() {
+	requests := chan int{}
+	replies := chan int{}
+	go echo_twice(requests, replies)
+	for i in 0 .. 1000 {
+		requests <- i
+		assert <-replies == i * 2
+	}
+	requests.close()
+}
+
+// sleep_and_report reports -1, when it does not run on a coroutine
+fn sleep_and_report(d time.Duration, done chan time.Duration) {
+	if !on_coroutine() {
+		done <- -1
+		return
+	}
+	sw := time.new_stopwatch()
+	sleep(d)
+	done <- sw.elapsed()
+}
+
+fn test_sleep() {
+	done := chan time.Duration{cap: 1}
+	go sleep_and_report(100 * time.millisecond, done)
+	elapsed := <-done
+	assert elapsed >= 100 * time.millisecond
+	assert elapsed < 2 * time.second
+}
+
+fn test_sleeping_coroutines_do_not_block_the_workers() {
+	// if each sleep blocked its worker thread, they would take 1000 * 200ms / nr_workers in total
+	nr_coroutines := 1000
+	done := chan time.Duration{cap: nr_coroutines}
+	sw := time.new_stopwatch()
+	for _ in 0 .. nr_coroutines {
+		go sleep_and_report(200 * time.millisecond, done)
+	}
+	for _ in 0 .. nr_coroutines {
+		assert <-done >= 200 * time.millisecond
+	}
+	assert sw.elapsed() < 5 * time.second
+}
+
+struct WaitResult {
+	res          int
+	code         int
+	elapsed      time.Duration
+	on_coroutine bool
+}
+
+fn wait_fd(fd int, write bool, timeout time.Duration, done chan WaitResult) {
+	sw := time.new_stopwatch()
+	res := C.vcoro_wait_fd(fd, int(write), i64(timeout))
+	done <- WaitResult{
+		res:          res
+		code:         if res < 0 { C.errno } else { 0 }
+		elapsed:      sw.elapsed()
+		on_coroutine: on_coroutine()
+	}
+}
+
+fn new_pipe() (int, int) {
+	mut fds := [2]int{}
+	assert C.pipe(&fds[0]) == 0
+	return fds[0], fds[1]
+}
+
+fn write_byte(fd int) {
+	b := u8(`x`)
+	assert C.write(fd, &b, 1) == 1
+}
+
+fn read_byte(fd int) {
+	mut b := u8(0)
+	assert C.read(fd, &b, 1) == 1
+}
+
+fn test_wait_fd_ready_and_timeout() {
+	rd, wr := new_pipe()
+	done := chan WaitResult{cap: 1}
+	// a pipe with no data times out
+	go wait_fd(rd, false, 100 * time.millisecond, done)
+	mut r := <-done
+	assert r.on_coroutine
+	assert r.res == -1
+	assert r.code == C.ETIMEDOUT
+	assert r.elapsed >= 100 * time.millisecond
+	// an empty pipe is writable right away
+	go wait_fd(wr, true, 5 * time.second, done)
+	r = <-done
+	assert r.res == 0
+	// a parked reader is woken up by a write from another thread
+	go wait_fd(rd, false, 5 * time.second, done)
+	time.sleep(100 * time.millisecond)
+	write_byte(wr)
+	r = <-done
+	assert r.on_coroutine
+	assert r.res == 0
+	assert r.elapsed < 5 * time.second
+	read_byte(rd)
+	C.vcoro_close(rd)
+	C.vcoro_close(wr)
+}
+
+fn test_wait_fd_does_not_see_the_readiness_of_a_closed_fd() {
+	rd, wr := new_pipe()
+	done := chan WaitResult{cap: 1}
+	go wait_fd(rd, false, 5 * time.second, done)
+	time.sleep(50 * time.millisecond)
+	write_byte(wr)
+	assert (<-done).res == 0
+	// nobody waits now, so the poller remembers that `rd` became readable
+	write_byte(wr)
+	time.sleep(100 * time.millisecond)
+	C.vcoro_close(rd)
+	C.vcoro_close(wr)
+	// the new pipe usually reuses the fd numbers, but it has no data
+	rd2, wr2 := new_pipe()
+	go wait_fd(rd2, false, 100 * time.millisecond, done)
+	r := <-done
+	assert r.on_coroutine
+	assert r.res == -1
+	assert r.code == C.ETIMEDOUT
+	C.vcoro_close(rd2)
+	C.vcoro_close(wr2)
+}
@@ -0,0 +1,1117 @@
+// The runtime of vlib/coroutines: stackful coroutines, multiplexed on a pool of OS threads (M:N).
+// - the context switch is a few lines of assembly on x86-64 and aarch64 (ucontext everywhere else),
+// - each worker thread has its own run queue; a worker without work steals half of the queue of another,
+// - the stacks are pooled, and with the Boehm GC, they are registered as roots, slab by slab,
+// - a single poller thread waits with epoll (kqueue on macOS and the BSDs) for the sockets and the timers,
+//   that the parked coroutines wait for, and makes them runnable again. It is the only thread that wakes
+//   parked coroutines, which keeps the wake up protocol simple: a waiter is touched by its coroutine
+//   before it parks, and by the poller thread after that, but never by both at the same time.
+// Note: a coroutine can continue on another thread after it parks, so it should not keep pointers to
+// thread local variables across calls to vcoro_sleep_ns, vcoro_wait_fd and the vcoro_ socket functions.
+#ifndef V_VCORO_C
+#define V_VCORO_C
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#if defined(__linux__)
+	#include <sys/epoll.h>
+	#define VCORO_EPOLL 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+	#include <sys/event.h>
+	#define VCORO_KQUEUE 1
+#else
+	#error "vlib/coroutines: unsupported platform, only Linux, macOS and the BSDs are supported"
+#endif
+
+#if (defined(__x86_64__) || defined(__aarch64__)) && !defined(VCORO_USE_UCONTEXT)
+	#define VCORO_ASM_SWITCH 1
+#else
+	#if defined(__APPLE__)
+		#define _XOPEN_SOURCE 600
+	#endif
+	#include <ucontext.h>
+#endif
+
+#ifndef VCORO_STACK_SIZE
+	#define VCORO_STACK_SIZE (128 * 1024) // the size of the stack of each coroutine, override with -cflags -DVCORO_STACK_SIZE=...
+#endif
+#define VCORO_MAX_WORKERS 256
+#define VCORO_RUNQ_SIZE 256 // per worker; when it is full, half of it moves to the global queue
+#define VCORO_STACK_CACHE 16 // the number of free stacks, that each worker keeps for itself
+#define VCORO_GC_SLAB 32 // with the Boehm GC, stacks are allocated (and registered as roots) in slabs of this many
+#define VCORO_FD_CHUNK 1024
+#define VCORO_FD_CHUNKS 4096 // supports fds up to 4M
+
+// atomics; tcc has no __atomic builtins, so there a mutex is used instead
+#if defined(__TINYC__)
+static pthread_mutex_t vcoro_atomic_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline int vcoro_atomic_add(int *p, int d) { pthread_mutex_lock(&vcoro_atomic_mutex); int r = (*p += d); pthread_mutex_unlock(&vcoro_atomic_mutex); return r; }
+static inline int vcoro_atomic_load(int *p) { pthread_mutex_lock(&vcoro_atomic_mutex); int r = *p; pthread_mutex_unlock(&vcoro_atomic_mutex); return r; }
+static inline void *vcoro_atomic_load_ptr(void **p) { pthread_mutex_lock(&vcoro_atomic_mutex); void *r = *p; pthread_mutex_unlock(&vcoro_atomic_mutex); return r; }
+static inline void vcoro_atomic_store_ptr(void **p, void *v) { pthread_mutex_lock(&vcoro_atomic_mutex); *p = v; pthread_mutex_unlock(&vcoro_atomic_mutex); }
+#else
+static inline int vcoro_atomic_add(int *p, int d) { return __atomic_add_fetch(p, d, __ATOMIC_SEQ_CST); }
+static inline int vcoro_atomic_load(int *p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static inline void *vcoro_atomic_load_ptr(void **p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void vcoro_atomic_store_ptr(void **p, void *v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// context switch
+
+typedef struct vcoro_ctx {
+	void *sp; // the saved stack pointer; the callee saved registers are stored on the stack itself
+#if !defined(VCORO_ASM_SWITCH)
+	ucontext_t uc;
+#endif
+} vcoro_ctx;
+
+#if defined(VCORO_ASM_SWITCH)
+	#if defined(__APPLE__)
+		#define VCORO_SYM(name) "_" #name
+		#define VCORO_FN_TYPE(name) ""
+	#else
+		#define VCORO_SYM(name) #name
+		#define VCORO_FN_TYPE(name) ".type " #name ", @function\n"
+	#endif
+
+// vcoro_switch saves the callee saved registers of the current context on its stack, stores its stack
+// pointer in *from_sp, and continues the context, whose stack pointer is to_sp.
+void vcoro_switch(void **from_sp, void *to_sp);
+// vcoro_trampoline is where new coroutines start: it calls fn(arg), with fn and arg in callee saved registers.
+void vcoro_trampoline(void);
+
+	#if defined(__x86_64__)
+__asm__(
+	".text\n"
+	".globl " VCORO_SYM(vcoro_switch) "\n"
+	VCORO_FN_TYPE(vcoro_switch)
+	VCORO_SYM(vcoro_switch) ":\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $8, %rsp\n"
+	"	stmxcsr (%rsp)\n"
+	"	fnstcw 4(%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	ldmxcsr (%rsp)\n"
+	"	fldcw 4(%rsp)\n"
+	"	addq $8, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".globl " VCORO_SYM(vcoro_trampoline) "\n"
+	VCORO_FN_TYPE(vcoro_trampoline)
+	VCORO_SYM(vcoro_trampoline) ":\n"
+	"	movq %r13, %rdi\n"
+	"	callq *%r12\n"
+	"	ud2\n"
+);
+
+static void vcoro_ctx_init(vcoro_ctx *ctx, char *stack_lo, char *stack_hi, void (*fn)(void *), void *arg) {
+	(void)stack_lo;
+	uint64_t *top = (uint64_t *)((uintptr_t)stack_hi & ~(uintptr_t)15);
+	uint64_t *sp = top - 8;
+	memset(sp, 0, 8 * sizeof(uint64_t));
+	sp[0] = 0x1F80 | ((uint64_t)0x037F << 32); // mxcsr, x87 control word: the defaults
+	sp[3] = (uint64_t)(uintptr_t)arg; // r13
+	sp[4] = (uint64_t)(uintptr_t)fn; // r12
+	sp[7] = (uint64_t)(uintptr_t)vcoro_trampoline; // the return address of vcoro_switch
+	ctx->sp = sp;
+}
+	#else // __aarch64__
+__asm__(
+	".text\n"
+	".globl " VCORO_SYM(vcoro_switch) "\n"
+	VCORO_FN_TYPE(vcoro_switch)
+	".p2align 2\n"
+	VCORO_SYM(vcoro_switch) ":\n"
+	"	sub sp, sp, #160\n"
+	"	stp x19, x20, [sp, #0]\n"
+	"	stp x21, x22, [sp, #16]\n"
+	"	stp x23, x24, [sp, #32]\n"
+	"	stp x25, x26, [sp, #48]\n"
+	"	stp x27, x28, [sp, #64]\n"
+	"	stp x29, x30, [sp, #80]\n"
+	"	stp d8, d9, [sp, #96]\n"
+	"	stp d10, d11, [sp, #112]\n"
+	"	stp d12, d13, [sp, #128]\n"
+	"	stp d14, d15, [sp, #144]\n"
+	"	mov x2, sp\n"
+	"	str x2, [x0]\n"
+	"	mov sp, x1\n"
+	"	ldp x19, x20, [sp, #0]\n"
+	"	ldp x21, x22, [sp, #16]\n"
+	"	ldp x23, x24, [sp, #32]\n"
+	"	ldp x25, x26, [sp, #48]\n"
+	"	ldp x27, x28, [sp, #64]\n"
+	"	ldp x29, x30, [sp, #80]\n"
+	"	ldp d8, d9, [sp, #96]\n"
+	"	ldp d10, d11, [sp, #112]\n"
+	"	ldp d12, d13, [sp, #128]\n"
+	"	ldp d14, d15, [sp, #144]\n"
+	"	add sp, sp, #160\n"
+	"	ret\n"
+	".globl " VCORO_SYM(vcoro_trampoline) "\n"
+	VCORO_FN_TYPE(vcoro_trampoline)
+	".p2align 2\n"
+	VCORO_SYM(vcoro_trampoline) ":\n"
+	"	mov x0, x20\n"
+	"	blr x19\n"
+	"	brk #0\n"
+);
+
+static void vcoro_ctx_init(vcoro_ctx *ctx, char *stack_lo, char *stack_hi, void (*fn)(void *), void *arg) {
+	(void)stack_lo;
+	uint64_t *top = (uint64_t *)((uintptr_t)stack_hi & ~(uintptr_t)15);
+	uint64_t *sp = top - 20;
+	memset(sp, 0, 20 * sizeof(uint64_t));
+	sp[0] = (uint64_t)(uintptr_t)fn; // x19
+	sp[1] = (uint64_t)(uintptr_t)arg; // x20
+	sp[11] = (uint64_t)(uintptr_t)vcoro_trampoline; // x30, the return address of vcoro_switch
+	ctx->sp = sp;
+}
+	#endif
+
+static inline void vcoro_ctx_switch(vcoro_ctx *from, vcoro_ctx *to) {
+	vcoro_switch(&from->sp, to->sp);
+}
+#else // ucontext
+
+static void vcoro_ucontext_entry(void);
+
+static void vcoro_ctx_init(vcoro_ctx *ctx, char *stack_lo, char *stack_hi, void (*fn)(void *), void *arg) {
+	(void)fn;
+	(void)arg;
+	getcontext(&ctx->uc);
+	ctx->uc.uc_stack.ss_sp = stack_lo;
+	ctx->uc.uc_stack.ss_size = (size_t)(stack_hi - stack_lo);
+	ctx->uc.uc_link = NULL;
+	makecontext(&ctx->uc, vcoro_ucontext_entry, 0);
+}
+
+static inline void vcoro_ctx_switch(vcoro_ctx *from, vcoro_ctx *to) {
+	swapcontext(&from->uc, &to->uc);
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// coroutines, workers and the scheduler
+
+enum {
+	VCORO_RUNNABLE,
+	VCORO_RUNNING,
+	VCORO_YIELDED,
+	VCORO_PARKED,
+	VCORO_DEAD,
+};
+
+// vcoro_t lives at the top of the stack of its coroutine, so it is allocated (and pooled) with the stack.
+typedef struct vcoro_t {
+	vcoro_ctx ctx;
+	void *(*fn)(void *);
+	void *arg;
+	char *stack_lo; // the lowest usable address of the stack
+	struct vcoro_t *next; // the link in the global run queue, and in the lists of free stacks
+	int state;
+} vcoro_t;
+
+typedef struct vcoro_worker vcoro_worker;
+typedef void (*vcoro_after_switch_fn)(vcoro_worker *w, vcoro_t *co, void *arg);
+
+struct vcoro_worker {
+	vcoro_ctx sched; // the context of the scheduler loop, on the stack of the thread
+	vcoro_t *current;
+	// after_switch is called by the scheduler, after `current` was switched out, see vcoro_park
+	vcoro_after_switch_fn after_switch;
+	void *after_switch_arg;
+	pthread_mutex_t lock; // protects runq, head and tail
+	vcoro_t *runq[VCORO_RUNQ_SIZE];
+	unsigned head, tail;
+	vcoro_t *stack_cache[VCORO_STACK_CACHE];
+	int nstack_cache;
+	int id;
+};
+
+typedef struct vcoro_waiter {
+	vcoro_t *co;
+	int fd; // -1 for timers
+	int write;
+	int64_t deadline; // in ns of CLOCK_MONOTONIC, 0 for none
+	int heap_index; // -1 when it is not in the timer heap
+	int timed_out;
+} vcoro_waiter;
+
+typedef struct vcoro_fd {
+	pthread_mutex_t lock;
+	vcoro_waiter *rd, *wr; // the parked readers and writers, if any
+	int rd_ready, wr_ready; // set by the poller, when the fd became ready, while nobody was waiting
+	int registered; // the fd was added to epoll/kqueue; cleared by vcoro_fd_reset, when its number is (re)used
+} vcoro_fd;
+
+static struct {
+	int initialized;
+	pthread_key_t worker_key;
+	// workers
+	pthread_mutex_t workers_lock;
+	vcoro_worker *workers[VCORO_MAX_WORKERS];
+	int nworkers;
+	// the global run queue, for coroutines made runnable outside of the workers (main thread, poller)
+	pthread_mutex_t global_lock;
+	vcoro_t *ghead, *gtail;
+	// idle workers sleep on idle_cond; nqueued counts the coroutines in all the run queues
+	pthread_mutex_t idle_lock;
+	pthread_cond_t idle_cond;
+	int nidle;
+	int nqueued;
+	// free stacks, shared by all the workers
+	pthread_mutex_t stacks_lock;
+	vcoro_t *free_stacks;
+	size_t page_size;
+	// the poller
+	int pollfd;
+	int wake_rd, wake_wr; // a pipe, to interrupt the poller, when a new timer expires before the current wait ends
+	void *fd_chunks[VCORO_FD_CHUNKS];
+	pthread_mutex_t fd_chunks_lock;
+	// the timers, a binary min heap ordered by deadline, owned by timer_lock
+	pthread_mutex_t timer_lock;
+	vcoro_waiter **heap;
+	int heap_len, heap_cap;
+	int64_t poller_deadline; // when the current wait of the poller ends, 0 when it waits without a timeout
+} vcoro_rt;
+
+static inline vcoro_worker *vcoro_self(void) {
+	// pthread_getspecific is used instead of __thread, since tcc has no TLS, and since the compilers can
+	// cache the address of a thread local variable, in a function that continues on another thread.
+	return (vcoro_worker *)pthread_getspecific(vcoro_rt.worker_key);
+}
+
+static int64_t vcoro_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// vcoro_deadline returns the absolute deadline for a timeout of `timeout_ns`, or 0 for no deadline
+// (timeout_ns <= 0, or too big to be represented, like the Duration `time.infinite`)
+static int64_t vcoro_deadline(int64_t timeout_ns) {
+	if (timeout_ns <= 0) {
+		return 0;
+	}
+	int64_t now = vcoro_now_ns();
+	return timeout_ns > INT64_MAX - now ? 0 : now + timeout_ns;
+}
+
+static void vcoro_wake_idle_worker(void) {
+	if (vcoro_atomic_load(&vcoro_rt.nidle) > 0) {
+		pthread_mutex_lock(&vcoro_rt.idle_lock);
+		pthread_cond_signal(&vcoro_rt.idle_cond);
+		pthread_mutex_unlock(&vcoro_rt.idle_lock);
+	}
+}
+
+static void vcoro_global_push_list(vcoro_t *head, vcoro_t *tail) {
+	pthread_mutex_lock(&vcoro_rt.global_lock);
+	tail->next = NULL;
+	if (vcoro_rt.gtail) {
+		vcoro_rt.gtail->next = head;
+	} else {
+		vcoro_rt.ghead = head;
+	}
+	vcoro_rt.gtail = tail;
+	pthread_mutex_unlock(&vcoro_rt.global_lock);
+}
+
+static vcoro_t *vcoro_global_pop(void) {
+	if (vcoro_atomic_load_ptr((void **)&vcoro_rt.ghead) == NULL) {
+		return NULL;
+	}
+	pthread_mutex_lock(&vcoro_rt.global_lock);
+	vcoro_t *co = vcoro_rt.ghead;
+	if (co) {
+		vcoro_rt.ghead = co->next;
+		if (!vcoro_rt.ghead) {
+			vcoro_rt.gtail = NULL;
+		}
+	}
+	pthread_mutex_unlock(&vcoro_rt.global_lock);
+	return co;
+}
+
+static void vcoro_local_push(vcoro_worker *w, vcoro_t *co) {
+	pthread_mutex_lock(&w->lock);
+	if (w->tail - w->head == VCORO_RUNQ_SIZE) {
+		// full: move the older half to the global queue, where the other workers can find it
+		vcoro_t *head = NULL, *tail = NULL;
+		for (int i = 0; i < VCORO_RUNQ_SIZE / 2; i++) {
+			vcoro_t *x = w->runq[w->head++ % VCORO_RUNQ_SIZE];
+			x->next = NULL;
+			if (tail) {
+				tail->next = x;
+			} else {
+				head = x;
+			}
+			tail = x;
+		}
+		vcoro_global_push_list(head, tail);
+	}
+	w->runq[w->tail++ % VCORO_RUNQ_SIZE] = co;
+	pthread_mutex_unlock(&w->lock);
+}
+
+static vcoro_t *vcoro_local_pop(vcoro_worker *w) {
+	vcoro_t *co = NULL;
+	pthread_mutex_lock(&w->lock);
+	if (w->head != w->tail) {
+		co = w->runq[w->head++ % VCORO_RUNQ_SIZE];
+	}
+	pthread_mutex_unlock(&w->lock);
+	return co;
+}
+
+// vcoro_steal moves half of the run queue of another worker to the queue of `w`, and returns one of them
+static vcoro_t *vcoro_steal(vcoro_worker *w) {
+	int n = vcoro_atomic_load(&vcoro_rt.nworkers);
+	for (int i = 1; i < n; i++) {
+		vcoro_worker *victim = vcoro_rt.workers[(w->id + i) % n];
+		if (!victim || victim == w) {
+			continue;
+		}
+		vcoro_t *stolen[VCORO_RUNQ_SIZE / 2];
+		int nstolen = 0;
+		pthread_mutex_lock(&victim->lock);
+		unsigned available = victim->tail - victim->head;
+		unsigned half = available - available / 2;
+		for (unsigned j = 0; j < half; j++) {
+			stolen[nstolen++] = victim->runq[victim->head++ % VCORO_RUNQ_SIZE];
+		}
+		pthread_mutex_unlock(&victim->lock);
+		if (nstolen > 0) {
+			pthread_mutex_lock(&w->lock);
+			for (int j = 1; j < nstolen; j++) {
+				w->runq[w->tail++ % VCORO_RUNQ_SIZE] = stolen[j];
+			}
+			pthread_mutex_unlock(&w->lock);
+			return stolen[0];
+		}
+	}
+	return NULL;
+}
+
+// vcoro_ready makes a parked (or a new) coroutine runnable
+static void vcoro_ready(vcoro_t *co) {
+	co->state = VCORO_RUNNABLE;
+	vcoro_atomic_add(&vcoro_rt.nqueued, 1);
+	vcoro_worker *w = vcoro_self();
+	if (w) {
+		vcoro_local_push(w, co);
+	} else {
+		vcoro_global_push_list(co, co);
+	}
+	vcoro_wake_idle_worker();
+}
+
+// stacks
+
+static vcoro_t *vcoro_stack_init(char *lo, size_t size) {
+	char *hi = lo + size;
+	vcoro_t *co = (vcoro_t *)(((uintptr_t)hi - sizeof(vcoro_t)) & ~(uintptr_t)63);
+	memset(co, 0, sizeof(vcoro_t));
+	co->stack_lo = lo;
+	return co;
+}
+
+static vcoro_t *vcoro_stack_alloc(vcoro_worker *w) {
+	if (w && w->nstack_cache > 0) {
+		return w->stack_cache[--w->nstack_cache];
+	}
+	pthread_mutex_lock(&vcoro_rt.stacks_lock);
+	vcoro_t *co = vcoro_rt.free_stacks;
+	if (co) {
+		vcoro_rt.free_stacks = co->next;
+		pthread_mutex_unlock(&vcoro_rt.stacks_lock);
+		return co;
+	}
+#if defined(_VGCBOEHM)
+	// The stacks are scanned by the GC as roots. There is a limit on the number of root sets,
+	// so they are allocated in slabs, and each slab is registered once. The guard pages are
+	// omitted here, since the GC would fault on them, while scanning the slab.
+	size_t slab_size = (size_t)VCORO_GC_SLAB * VCORO_STACK_SIZE;
+	char *slab = (char *)mmap(NULL, slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (slab == MAP_FAILED) {
+		pthread_mutex_unlock(&vcoro_rt.stacks_lock);
+		return NULL;
+	}
+	GC_add_roots(slab, slab + slab_size);
+	for (int i = 1; i < VCORO_GC_SLAB; i++) {
+		vcoro_t *x = vcoro_stack_init(slab + (size_t)i * VCORO_STACK_SIZE, VCORO_STACK_SIZE);
+		x->next = vcoro_rt.free_stacks;
+		vcoro_rt.free_stacks = x;
+	}
+	pthread_mutex_unlock(&vcoro_rt.stacks_lock);
+	return vcoro_stack_init(slab, VCORO_STACK_SIZE);
+#else
+	pthread_mutex_unlock(&vcoro_rt.stacks_lock);
+	// a guard page at the bottom turns a stack overflow into a crash, instead of a silent memory corruption
+	size_t guard = vcoro_rt.page_size;
+	char *mem = (char *)mmap(NULL, guard + VCORO_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+	mprotect(mem, guard, PROT_NONE);
+	return vcoro_stack_init(mem + guard, VCORO_STACK_SIZE);
+#endif
+}
+
+static void vcoro_stack_free(vcoro_worker *w, vcoro_t *co) {
+	if (w && w->nstack_cache < VCORO_STACK_CACHE) {
+		w->stack_cache[w->nstack_cache++] = co;
+		return;
+	}
+	pthread_mutex_lock(&vcoro_rt.stacks_lock);
+	co->next = vcoro_rt.free_stacks;
+	vcoro_rt.free_stacks = co;
+	pthread_mutex_unlock(&vcoro_rt.stacks_lock);
+}
+
+static void vcoro_exit(void);
+
+static void vcoro_entry(void *arg) {
+	vcoro_t *co = (vcoro_t *)arg;
+	co->fn(co->arg);
+	vcoro_exit();
+}
+
+#if !defined(VCORO_ASM_SWITCH)
+static void vcoro_ucontext_entry(void) {
+	vcoro_entry(vcoro_self()->current);
+}
+#endif
+
+// vcoro_go starts a new coroutine, that calls fn(arg)
+void vcoro_go(void *(*fn)(void *), void *arg) {
+	vcoro_worker *w = vcoro_self();
+	vcoro_t *co = vcoro_stack_alloc(w);
+	if (!co) {
+		fprintf(stderr, "vcoro_go: can not allocate a coroutine stack\n");
+		abort();
+	}
+	co->fn = fn;
+	co->arg = arg;
+	co->next = NULL;
+	vcoro_ctx_init(&co->ctx, co->stack_lo, (char *)co, vcoro_entry, co);
+	vcoro_ready(co);
+}
+
+// vcoro_park switches from the current coroutine to the scheduler. The scheduler calls after(w, co, arg),
+// once the coroutine is switched out, so `after` can publish the coroutine (for example, release the lock
+// that protects the waiter list, or add a timer), without the risk that it is resumed before it was suspended.
+static void vcoro_park(vcoro_after_switch_fn after, void *arg) {
+	vcoro_worker *w = vcoro_self();
+	vcoro_t *co = w->current;
+	co->state = VCORO_PARKED;
+	w->after_switch = after;
+	w->after_switch_arg = arg;
+	vcoro_ctx_switch(&co->ctx, &w->sched);
+}
+
+static void vcoro_exit(void) {
+	vcoro_worker *w = vcoro_self();
+	vcoro_t *co = w->current;
+	co->state = VCORO_DEAD;
+	vcoro_ctx_switch(&co->ctx, &w->sched);
+}
+
+// vcoro_yield lets the other runnable coroutines run first; outside of a coroutine, it yields the thread
+void vcoro_yield(void) {
+	vcoro_worker *w = vcoro_self();
+	if (!w || !w->current) {
+		sched_yield();
+		return;
+	}
+	vcoro_t *co = w->current;
+	co->state = VCORO_YIELDED;
+	vcoro_ctx_switch(&co->ctx, &w->sched);
+}
+
+// vcoro_in_coroutine returns 1, when it is called from a coroutine, that runs on a worker of the scheduler
+int vcoro_in_coroutine(void) {
+	vcoro_worker *w = vcoro_self();
+	return w && w->current ? 1 : 0;
+}
+
+static vcoro_t *vcoro_find_work(vcoro_worker *w) {
+	for (;;) {
+		vcoro_t *co = vcoro_local_pop(w);
+		if (!co) {
+			co = vcoro_global_pop();
+		}
+		if (!co) {
+			co = vcoro_steal(w);
+		}
+		if (co) {
+			vcoro_atomic_add(&vcoro_rt.nqueued, -1);
+			return co;
+		}
+		pthread_mutex_lock(&vcoro_rt.idle_lock);
+		vcoro_atomic_add(&vcoro_rt.nidle, 1);
+		if (vcoro_atomic_load(&vcoro_rt.nqueued) == 0) {
+			pthread_cond_wait(&vcoro_rt.idle_cond, &vcoro_rt.idle_lock);
+		}
+		vcoro_atomic_add(&vcoro_rt.nidle, -1);
+		pthread_mutex_unlock(&vcoro_rt.idle_lock);
+	}
+}
+
+// vcoro_worker_main runs the scheduler loop of a new worker, on the calling thread. It never returns.
+void vcoro_worker_main(void) {
+	vcoro_worker *w = (vcoro_worker *)calloc(1, sizeof(vcoro_worker));
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_setspecific(vcoro_rt.worker_key, w);
+	pthread_mutex_lock(&vcoro_rt.workers_lock);
+	w->id = vcoro_rt.nworkers;
+	vcoro_rt.workers[w->id] = w;
+	vcoro_atomic_add(&vcoro_rt.nworkers, 1);
+	pthread_mutex_unlock(&vcoro_rt.workers_lock);
+	for (;;) {
+		vcoro_t *co = vcoro_find_work(w);
+		w->current = co;
+		co->state = VCORO_RUNNING;
+		vcoro_ctx_switch(&w->sched, &co->ctx);
+		w->current = NULL;
+		switch (co->state) {
+			case VCORO_YIELDED:
+				vcoro_ready(co);
+				break;
+			case VCORO_PARKED: {
+				vcoro_after_switch_fn after = w->after_switch;
+				w->after_switch = NULL;
+				after(w, co, w->after_switch_arg);
+				break;
+			}
+			case VCORO_DEAD:
+				vcoro_stack_free(w, co);
+				break;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// timers
+
+static void vcoro_heap_swap(int i, int j) {
+	vcoro_waiter *t = vcoro_rt.heap[i];
+	vcoro_rt.heap[i] = vcoro_rt.heap[j];
+	vcoro_rt.heap[j] = t;
+	vcoro_rt.heap[i]->heap_index = i;
+	vcoro_rt.heap[j]->heap_index = j;
+}
+
+static void vcoro_heap_up(int i) {
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (vcoro_rt.heap[parent]->deadline <= vcoro_rt.heap[i]->deadline) {
+			break;
+		}
+		vcoro_heap_swap(i, parent);
+		i = parent;
+	}
+}
+
+static void vcoro_heap_down(int i) {
+	for (;;) {
+		int l = 2 * i + 1, r = l + 1, m = i;
+		if (l < vcoro_rt.heap_len && vcoro_rt.heap[l]->deadline < vcoro_rt.heap[m]->deadline) m = l;
+		if (r < vcoro_rt.heap_len && vcoro_rt.heap[r]->deadline < vcoro_rt.heap[m]->deadline) m = r;
+		if (m == i) {
+			return;
+		}
+		vcoro_heap_swap(i, m);
+		i = m;
+	}
+}
+
+static void vcoro_poller_wakeup(void) {
+	char c = 1;
+	while (write(vcoro_rt.wake_wr, &c, 1) < 0 && errno == EINTR) {}
+}
+
+// vcoro_timer_add is called with timer_lock held
+static void vcoro_timer_add(vcoro_waiter *t) {
+	if (vcoro_rt.heap_len == vcoro_rt.heap_cap) {
+		vcoro_rt.heap_cap = vcoro_rt.heap_cap ? 2 * vcoro_rt.heap_cap : 64;
+		vcoro_rt.heap = (vcoro_waiter **)realloc(vcoro_rt.heap, vcoro_rt.heap_cap * sizeof(vcoro_waiter *));
+	}
+	t->heap_index = vcoro_rt.heap_len;
+	vcoro_rt.heap[vcoro_rt.heap_len++] = t;
+	vcoro_heap_up(t->heap_index);
+	if (t->heap_index == 0 && (vcoro_rt.poller_deadline == 0 || t->deadline < vcoro_rt.poller_deadline)) {
+		vcoro_poller_wakeup();
+	}
+}
+
+// vcoro_timer_remove is called with timer_lock held
+static void vcoro_timer_remove(vcoro_waiter *t) {
+	int i = t->heap_index;
+	if (i < 0) {
+		return;
+	}
+	int last = --vcoro_rt.heap_len;
+	if (i != last) {
+		vcoro_heap_swap(i, last);
+		vcoro_heap_down(i);
+		vcoro_heap_up(i);
+	}
+	t->heap_index = -1;
+}
+
+static void vcoro_after_sleep(vcoro_worker *w, vcoro_t *co, void *arg) {
+	(void)w;
+	(void)co;
+	pthread_mutex_lock(&vcoro_rt.timer_lock);
+	vcoro_timer_add((vcoro_waiter *)arg);
+	pthread_mutex_unlock(&vcoro_rt.timer_lock);
+}
+
+// vcoro_sleep_ns parks the current coroutine for `ns` nanoseconds; outside of a coroutine, it sleeps the thread
+void vcoro_sleep_ns(int64_t ns) {
+	vcoro_worker *w = vcoro_self();
+	if (!w || !w->current) {
+		struct timespec ts = { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+		while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {}
+		return;
+	}
+	int64_t deadline = vcoro_deadline(ns);
+	if (deadline == 0) {
+		vcoro_yield();
+		return;
+	}
+	vcoro_waiter t = { .co = w->current, .fd = -1, .deadline = deadline, .heap_index = -1 };
+	vcoro_park(vcoro_after_sleep, &t);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// the netpoller
+
+static vcoro_fd *vcoro_fd_get(int fd) {
+	if (fd < 0 || fd >= VCORO_FD_CHUNK * VCORO_FD_CHUNKS) {
+		return NULL;
+	}
+	void **slot = &vcoro_rt.fd_chunks[fd / VCORO_FD_CHUNK];
+	vcoro_fd *chunk = (vcoro_fd *)vcoro_atomic_load_ptr(slot);
+	if (!chunk) {
+		pthread_mutex_lock(&vcoro_rt.fd_chunks_lock);
+		chunk = (vcoro_fd *)*slot;
+		if (!chunk) {
+			chunk = (vcoro_fd *)calloc(VCORO_FD_CHUNK, sizeof(vcoro_fd));
+			for (int i = 0; i < VCORO_FD_CHUNK; i++) {
+				pthread_mutex_init(&chunk[i].lock, NULL);
+			}
+			vcoro_atomic_store_ptr(slot, chunk);
+		}
+		pthread_mutex_unlock(&vcoro_rt.fd_chunks_lock);
+	}
+	return &chunk[fd % VCORO_FD_CHUNK];
+}
+
+// vcoro_fd_reset forgets the state of `fd`: the readiness left over from a previous socket with the same number,
+// and its registration in the poller (a closed fd is removed from epoll/kqueue automatically). It is called for
+// every new fd of vcoro_socket and vcoro_accept, and by vcoro_close.
+static void vcoro_fd_reset(int fd) {
+	vcoro_fd *d = vcoro_fd_get(fd);
+	if (!d) {
+		return;
+	}
+	pthread_mutex_lock(&d->lock);
+	d->rd_ready = 0;
+	d->wr_ready = 0;
+	d->registered = 0;
+	pthread_mutex_unlock(&d->lock);
+}
+
+// vcoro_poll_register adds `fd` to the poller, edge triggered, for both reading and writing, on its first wait.
+// It must be called with d->lock held.
+static void vcoro_poll_register(int fd, vcoro_fd *d) {
+	if (d->registered) {
+		return;
+	}
+	// the edge triggered registration reports the current state of the fd right away, so the old flags are stale
+	d->rd_ready = 0;
+	d->wr_ready = 0;
+#if defined(VCORO_EPOLL)
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.fd = fd;
+	if (epoll_ctl(vcoro_rt.pollfd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno == EEXIST) {
+		// the fd is still in the set (it was reset without being closed); re-arm it, to get its current state
+		epoll_ctl(vcoro_rt.pollfd, EPOLL_CTL_MOD, fd, &ev);
+	}
+#else
+	struct kevent evs[2];
+	EV_SET(&evs[0], fd, EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, NULL);
+	EV_SET(&evs[1], fd, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, NULL);
+	kevent(vcoro_rt.pollfd, evs, 2, NULL, 0, NULL);
+#endif
+	d->registered = 1;
+}
+
+static void vcoro_after_wait_fd(vcoro_worker *w, vcoro_t *co, void *arg) {
+	(void)w;
+	(void)co;
+	vcoro_waiter *waiter = (vcoro_waiter *)arg;
+	if (waiter->deadline) {
+		pthread_mutex_lock(&vcoro_rt.timer_lock);
+		vcoro_timer_add(waiter);
+		pthread_mutex_unlock(&vcoro_rt.timer_lock);
+	}
+	pthread_mutex_unlock(&vcoro_fd_get(waiter->fd)->lock);
+}
+
+// vcoro_wait_fd parks the current coroutine, till `fd` is ready for reading (or writing, when `write` is 1).
+// timeout_ns <= 0 (or time.infinite) means no timeout. It returns 0 when the fd is ready, and -1 with errno = ETIMEDOUT after the
+// timeout. Outside of a coroutine, it blocks the thread in poll().
+int vcoro_wait_fd(int fd, int write, int64_t timeout_ns) {
+	vcoro_worker *w = vcoro_self();
+	vcoro_fd *d = vcoro_fd_get(fd);
+	if (!w || !w->current || !d) {
+		struct pollfd p = { .fd = fd, .events = write ? POLLOUT : POLLIN };
+		int timeout_ms = vcoro_deadline(timeout_ns) == 0 ? -1 : timeout_ns >= (int64_t)INT32_MAX * 1000000 ? INT32_MAX : (int)((timeout_ns + 999999) / 1000000);
+		int res;
+		while ((res = poll(&p, 1, timeout_ms)) < 0 && errno == EINTR) {}
+		if (res == 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		return res < 0 ? -1 : 0;
+	}
+	pthread_mutex_lock(&d->lock);
+	vcoro_poll_register(fd, d);
+	int *ready = write ? &d->wr_ready : &d->rd_ready;
+	if (*ready) {
+		*ready = 0;
+		pthread_mutex_unlock(&d->lock);
+		return 0;
+	}
+	vcoro_waiter waiter = { .co = w->current, .fd = fd, .write = write, .heap_index = -1 };
+	waiter.deadline = vcoro_deadline(timeout_ns);
+	if (write) {
+		d->wr = &waiter;
+	} else {
+		d->rd = &waiter;
+	}
+	// d->lock is released by vcoro_after_wait_fd, after the switch
+	vcoro_park(vcoro_after_wait_fd, &waiter);
+	if (waiter.timed_out) {
+		errno = ETIMEDOUT;
+		return -1;
+	}
+	return 0;
+}
+
+// vcoro_fd_event is called by the poller thread, when `fd` became ready
+static void vcoro_fd_event(int fd, int readable, int writable) {
+	vcoro_fd *d = vcoro_fd_get(fd);
+	if (!d) {
+		return;
+	}
+	vcoro_t *wake[2] = { NULL, NULL };
+	pthread_mutex_lock(&d->lock);
+	for (int i = 0; i < 2; i++) {
+		if (!(i == 0 ? readable : writable)) {
+			continue;
+		}
+		vcoro_waiter **slot = i == 0 ? &d->rd : &d->wr;
+		vcoro_waiter *waiter = *slot;
+		if (waiter) {
+			*slot = NULL;
+			if (waiter->deadline) {
+				pthread_mutex_lock(&vcoro_rt.timer_lock);
+				vcoro_timer_remove(waiter);
+				pthread_mutex_unlock(&vcoro_rt.timer_lock);
+			}
+			wake[i] = waiter->co;
+		} else if (i == 0) {
+			d->rd_ready = 1;
+		} else {
+			d->wr_ready = 1;
+		}
+	}
+	pthread_mutex_unlock(&d->lock);
+	for (int i = 0; i < 2; i++) {
+		if (wake[i]) {
+			vcoro_ready(wake[i]);
+		}
+	}
+}
+
+// vcoro_timers_expire is called by the poller thread; it wakes the coroutines, whose deadline has passed,
+// and returns the deadline of the next timer, or 0 if there are none.
+static int64_t vcoro_timers_expire(void) {
+	int64_t now = vcoro_now_ns();
+	for (;;) {
+		pthread_mutex_lock(&vcoro_rt.timer_lock);
+		if (vcoro_rt.heap_len == 0 || vcoro_rt.heap[0]->deadline > now) {
+			int64_t next = vcoro_rt.heap_len == 0 ? 0 : vcoro_rt.heap[0]->deadline;
+			vcoro_rt.poller_deadline = next;
+			pthread_mutex_unlock(&vcoro_rt.timer_lock);
+			return next;
+		}
+		vcoro_waiter *t = vcoro_rt.heap[0];
+		vcoro_timer_remove(t);
+		pthread_mutex_unlock(&vcoro_rt.timer_lock);
+		vcoro_t *co = t->co;
+		if (t->fd >= 0) {
+			// a wait for an fd timed out; the fd events are handled by this thread too, so `t` is still registered
+			vcoro_fd *d = vcoro_fd_get(t->fd);
+			pthread_mutex_lock(&d->lock);
+			int registered = 1;
+			if (d->rd == t) {
+				d->rd = NULL;
+			} else if (d->wr == t) {
+				d->wr = NULL;
+			} else {
+				registered = 0;
+			}
+			if (registered) {
+				t->timed_out = 1;
+			}
+			pthread_mutex_unlock(&d->lock);
+			if (!registered) {
+				continue;
+			}
+		}
+		vcoro_ready(co);
+	}
+}
+
+// vcoro_poller_main runs the loop of the poller, on the calling thread. It never returns.
+void vcoro_poller_main(void) {
+#if defined(VCORO_EPOLL)
+	struct epoll_event evs[256];
+#else
+	struct kevent evs[256];
+#endif
+	for (;;) {
+		int64_t next = vcoro_timers_expire();
+		int64_t wait_ns = next == 0 ? -1 : next - vcoro_now_ns();
+		if (next != 0 && wait_ns < 0) {
+			wait_ns = 0;
+		}
+#if defined(VCORO_EPOLL)
+		int timeout_ms = wait_ns < 0 ? -1 : (int)((wait_ns + 999999) / 1000000);
+		int n = epoll_wait(vcoro_rt.pollfd, evs, 256, timeout_ms);
+		for (int i = 0; i < n; i++) {
+			int fd = evs[i].data.fd;
+			if (fd == vcoro_rt.wake_rd) {
+				char buf[64];
+				while (read(fd, buf, sizeof(buf)) > 0) {}
+				continue;
+			}
+			uint32_t e = evs[i].events;
+			int failed = (e & (EPOLLERR | EPOLLHUP)) != 0;
+			vcoro_fd_event(fd, failed || (e & (EPOLLIN | EPOLLRDHUP)), failed || (e & EPOLLOUT));
+		}
+#else
+		struct timespec ts = { .tv_sec = wait_ns / 1000000000, .tv_nsec = wait_ns % 1000000000 };
+		int n = kevent(vcoro_rt.pollfd, NULL, 0, evs, 256, wait_ns < 0 ? NULL : &ts);
+		for (int i = 0; i < n; i++) {
+			int fd = (int)evs[i].ident;
+			if (fd == vcoro_rt.wake_rd) {
+				char buf[64];
+				while (read(fd, buf, sizeof(buf)) > 0) {}
+				continue;
+			}
+			int failed = (evs[i].flags & (EV_EOF | EV_ERROR)) != 0;
+			vcoro_fd_event(fd, failed || evs[i].filter == EVFILT_READ, failed || evs[i].filter == EVFILT_WRITE);
+		}
+#endif
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// sockets; all of them are nonblocking, and park the calling coroutine, when they would block
+
+static int vcoro_set_nonblocking(int fd) {
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+int vcoro_socket(int domain, int type, int protocol) {
+	int fd = socket(domain, type, protocol);
+	if (fd >= 0 && vcoro_set_nonblocking(fd) < 0) {
+		close(fd);
+		return -1;
+	}
+	vcoro_fd_reset(fd);
+	return fd;
+}
+
+// vcoro_close closes `fd`, and forgets its state in the netpoller. The fds, that were waited for with
+// vcoro_wait_fd, should be closed with it, since their numbers are reused by the next sockets.
+int vcoro_close(int fd) {
+	vcoro_fd_reset(fd);
+	return close(fd);
+}
+
+int vcoro_connect(int fd, const struct sockaddr *addr, socklen_t addrlen, int64_t timeout_ns) {
+	int res = connect(fd, addr, addrlen);
+	if (res == 0 || (errno != EINPROGRESS && errno != EAGAIN && errno != EINTR)) {
+		return res;
+	}
+	int64_t deadline = vcoro_deadline(timeout_ns);
+	for (;;) {
+		int64_t wait_ns = 0;
+		if (deadline) {
+			wait_ns = deadline - vcoro_now_ns();
+			if (wait_ns <= 0) {
+				errno = ETIMEDOUT;
+				return -1;
+			}
+		}
+		if (vcoro_wait_fd(fd, 1, wait_ns) < 0) {
+			return -1;
+		}
+		// a wake up can be spurious (an event of an old socket with the same fd number), and SO_ERROR is 0
+		// while the connection is still in progress, so check that the socket is really writable
+		struct pollfd p = { .fd = fd, .events = POLLOUT };
+		int n;
+		while ((n = poll(&p, 1, 0)) < 0 && errno == EINTR) {}
+		if (n < 0) {
+			return -1;
+		}
+		if (n > 0) {
+			break;
+		}
+	}
+	int err = 0;
+	socklen_t len = sizeof(err);
+	if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+		return -1;
+	}
+	if (err != 0) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+int vcoro_accept(int fd, struct sockaddr *addr, socklen_t *addrlen, int64_t timeout_ns) {
+	for (;;) {
+		int res = accept(fd, addr, addrlen);
+		if (res >= 0) {
+			if (vcoro_set_nonblocking(res) < 0) {
+				close(res);
+				return -1;
+			}
+			vcoro_fd_reset(res);
+			return res;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		if ((errno != EAGAIN && errno != EWOULDBLOCK) || vcoro_wait_fd(fd, 0, timeout_ns) < 0) {
+			return -1;
+		}
+	}
+}
+
+ssize_t vcoro_send(int fd, const void *buf, size_t len, int flags, int64_t timeout_ns) {
+	for (;;) {
+		ssize_t res = send(fd, buf, len, flags);
+		if (res >= 0) {
+			return res;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		if ((errno != EAGAIN && errno != EWOULDBLOCK) || vcoro_wait_fd(fd, 1, timeout_ns) < 0) {
+			return -1;
+		}
+	}
+}
+
+ssize_t vcoro_recv(int fd, void *buf, size_t len, int flags, int64_t timeout_ns) {
+	for (;;) {
+		ssize_t res = recv(fd, buf, len, flags);
+		if (res >= 0) {
+			return res;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		if ((errno != EAGAIN && errno != EWOULDBLOCK) || vcoro_wait_fd(fd, 0, timeout_ns) < 0) {
+			return -1;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// vcoro_init prepares the runtime; the workers and the poller are started separately, on their own threads,
+// with vcoro_worker_main and vcoro_poller_main. It returns 0 on success, and -1 on failure.
+int vcoro_init(void) {
+	if (vcoro_rt.initialized) {
+		return 0;
+	}
+	pthread_key_create(&vcoro_rt.worker_key, NULL);
+	pthread_mutex_init(&vcoro_rt.workers_lock, NULL);
+	pthread_mutex_init(&vcoro_rt.global_lock, NULL);
+	pthread_mutex_init(&vcoro_rt.idle_lock, NULL);
+	pthread_cond_init(&vcoro_rt.idle_cond, NULL);
+	pthread_mutex_init(&vcoro_rt.stacks_lock, NULL);
+	pthread_mutex_init(&vcoro_rt.fd_chunks_lock, NULL);
+	pthread_mutex_init(&vcoro_rt.timer_lock, NULL);
+	vcoro_rt.page_size = (size_t)sysconf(_SC_PAGESIZE);
+	int pipefd[2];
+	if (pipe(pipefd) < 0) {
+		return -1;
+	}
+	vcoro_rt.wake_rd = pipefd[0];
+	vcoro_rt.wake_wr = pipefd[1];
+	vcoro_set_nonblocking(vcoro_rt.wake_rd);
+	vcoro_set_nonblocking(vcoro_rt.wake_wr);
+#if defined(VCORO_EPOLL)
+	vcoro_rt.pollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (vcoro_rt.pollfd < 0) {
+		return -1;
+	}
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = vcoro_rt.wake_rd;
+	epoll_ctl(vcoro_rt.pollfd, EPOLL_CTL_ADD, vcoro_rt.wake_rd, &ev);
+#else
+	vcoro_rt.pollfd = kqueue();
+	if (vcoro_rt.pollfd < 0) {
+		return -1;
+	}
+	struct kevent ev;
+	EV_SET(&ev, vcoro_rt.wake_rd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+	kevent(vcoro_rt.pollfd, &ev, 1, NULL, 0, NULL);
+#endif
+	vcoro_rt.initialized = 1;
+	return 0;
+}
+
+#endif
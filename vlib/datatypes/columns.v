@@ -0,0 +1,505 @@
+module datatypes
+
+import runtime
+
+// Columns stores the rows of the struct type `T` by columns (struct of arrays): each field of `T`
+// of type `int`, `i64`, `u64`, `f32`, `f64`, `bool` or `string` is kept in its own array. The
+// other fields are not stored.
+// The kernels (`column_sum`, `column_filter`, ...) work on the plain arrays returned by `column`,
+// with tight loops over contiguous values, that the C compiler can vectorize, unlike the same loops
+// over the fields of an array of structs.
+@[heap]
+pub struct Columns[T] {
+mut:
+	fields  []ColumnField
+	ints    [][]int
+	i64s    [][]i64
+	u64s    [][]u64
+	f32s    [][]f32
+	f64s    [][]f64
+	bools   [][]bool
+	strings [][]string
+	len     int
+}
+
+// ColumnKind is the type of the values of a column
+pub enum ColumnKind {
+	unsupported
+	int
+	i64
+	u64
+	f32
+	f64
+	bool
+	string
+}
+
+struct ColumnField {
+	name string
+	kind ColumnKind
+	slot int // the index of the column in the array of its kind, -1 for the fields that are not stored
+}
+
+// CompareOp is the comparison done by `column_filter`
+pub enum CompareOp {
+	eq
+	ne
+	lt
+	le
+	gt
+	ge
+}
+
+// ParallelConfig configures the `_parallel` kernels. The columns are cut in chunks, one for each thread.
+@[params]
+pub struct ParallelConfig {
+pub:
+	nr_threads int // 0 means one per CPU
+	// minimum number of values processed by each thread, smaller columns use less threads
+	min_chunk_len int = 64 * 1024
+}
+
+// new_columns creates an empty `Columns` container for the rows of type `T`
+pub fn new_columns[T]() &Columns[T] {
+	return init_columns[T](0)
+}
+
+// columns_from creates a `Columns` container holding `rows`
+pub fn columns_from[T](rows []T) &Columns[T] {
+	mut c := init_columns[T](rows.len)
+	for row in rows {
+		c.push(row)
+	}
+	return c
+}
+
+fn init_columns[T](cap int) &Columns[T] {
+	mut c := &Columns[T]{}
+	$for field in T.fields {
+		mut kind := ColumnKind.unsupported
+		mut slot := -1
+		$if field.typ is int {
+			kind = .int
+			slot = c.ints.len
+			c.ints << []int{cap: cap}
+		} $else $if field.typ is i64 {
+			kind = .i64
+			slot = c.i64s.len
+			c.i64s << []i64{cap: cap}
+		} $else $if field.typ is u64 {
+			kind = .u64
+			slot = c.u64s.len
+			c.u64s << []u64{cap: cap}
+		} $else $if field.typ is f32 {
+			kind = .f32
+			slot = c.f32s.len
+			c.f32s << []f32{cap: cap}
+		} $else $if field.typ is f64 {
+			kind = .f64
+			slot = c.f64s.len
+			c.f64s << []f64{cap: cap}
+		} $else $if field.typ is bool {
+			kind = .bool
+			slot = c.bools.len
+			c.bools << []bool{cap: cap}
+		} $else $if field.typ is string {
+			kind = .string
+			slot = c.strings.len
+			c.strings << []string{cap: cap}
+		}
+		c.fields << ColumnField{
+			name: field.name
+			kind: kind
+			slot: slot
+		}
+	}
+	return c
+}
+
+// push appends the row `row`
+pub fn (mut c Columns[T]) push(row T) {
+	mut fi := 0
+	$for field in T.fields {
+		slot := c.fields[fi].slot
+		$if field.typ is int {
+			c.ints[slot] << row.$(field.name)
+		} $else $if field.typ is i64 {
+			c.i64s[slot] << row.$(field.name)
+		} $else $if field.typ is u64 {
+			c.u64s[slot] << row.$(field.name)
+		} $else $if field.typ is f32 {
+			c.f32s[slot] << row.$(field.name)
+		} $else $if field.typ is f64 {
+			c.f64s[slot] << row.$(field.name)
+		} $else $if field.typ is bool {
+			c.bools[slot] << row.$(field.name)
+		} $else $if field.typ is string {
+			c.strings[slot] << row.$(field.name)
+		}
+		fi++
+	}
+	c.len++
+}
+
+// len returns the number of rows
+pub fn (c &Columns[T]) len() int {
+	return c.len
+}
+
+// is_empty checks if the container has no rows
+pub fn (c &Columns[T]) is_empty() bool {
+	return c.len == 0
+}
+
+// row returns the row at index `i`, put back together from the columns.
+// The fields that are not stored keep their default value.
+pub fn (c &Columns[T]) row(i int) !T {
+	if i < 0 || i >= c.len {
+		return error('row ${i} out of range, the container has ${c.len} rows')
+	}
+	mut row := T{}
+	mut fi := 0
+	$for field in T.fields {
+		slot := c.fields[fi].slot
+		$if field.typ is int {
+			row.$(field.name) = c.ints[slot][i]
+		} $else $if field.typ is i64 {
+			row.$(field.name) = c.i64s[slot][i]
+		} $else $if field.typ is u64 {
+			row.$(field.name) = c.u64s[slot][i]
+		} $else $if field.typ is f32 {
+			row.$(field.name) = c.f32s[slot][i]
+		} $else $if field.typ is f64 {
+			row.$(field.name) = c.f64s[slot][i]
+		} $else $if field.typ is bool {
+			row.$(field.name) = c.bools[slot][i]
+		} $else $if field.typ is string {
+			row.$(field.name) = c.strings[slot][i]
+		}
+		fi++
+	}
+	return row
+}
+
+// kind returns the type of the values of the column `name`
+pub fn (c &Columns[T]) kind(name string) ColumnKind {
+	for f in c.fields {
+		if f.name == name {
+			return f.kind
+		}
+	}
+	return .unsupported
+}
+
+// column returns the values of the field `name`, that must be of type `C`. The array shares its
+// memory with the container, so it must not be modified, and it is only valid until the next `push`.
+// Example: prices := c.column[f64]('price')!
+pub fn (c &Columns[T]) column[C](name string) ![]C {
+	for f in c.fields {
+		if f.name != name {
+			continue
+		}
+		$if C is int {
+			if f.kind == .int {
+				return c.ints[f.slot]
+			}
+		} $else $if C is i64 {
+			if f.kind == .i64 {
+				return c.i64s[f.slot]
+			}
+		} $else $if C is u64 {
+			if f.kind == .u64 {
+				return c.u64s[f.slot]
+			}
+		} $else $if C is f32 {
+			if f.kind == .f32 {
+				return c.f32s[f.slot]
+			}
+		} $else $if C is f64 {
+			if f.kind == .f64 {
+				return c.f64s[f.slot]
+			}
+		} $else $if C is bool {
+			if f.kind == .bool {
+				return c.bools[f.slot]
+			}
+		} $else $if C is string {
+			if f.kind == .string {
+				return c.strings[f.slot]
+			}
+		}
+		return error('column `${name}` is of type ${f.kind}, not ${typeof[C]().name}')
+	}
+	return error('no column `${name}`')
+}
+
+// column_sum returns the sum of the values of `col`. Four partial sums are kept, so for floats the
+// result can differ slightly from a sum done in order.
+@[direct_array_access]
+pub fn column_sum[N](col []N) N {
+	mut s0, mut s1, mut s2, mut s3 := N(0), N(0), N(0), N(0)
+	mut i := 0
+	for i + 4 <= col.len {
+		s0 += col[i]
+		s1 += col[i + 1]
+		s2 += col[i + 2]
+		s3 += col[i + 3]
+		i += 4
+	}
+	for i < col.len {
+		s0 += col[i]
+		i++
+	}
+	return s0 + s1 + s2 + s3
+}
+
+// column_min returns the smallest value of `col`, or `none` if it is empty
+pub fn column_min[N](col []N) ?N {
+	if col.len == 0 {
+		return none
+	}
+	return min_of(col)
+}
+
+// column_max returns the largest value of `col`, or `none` if it is empty
+pub fn column_max[N](col []N) ?N {
+	if col.len == 0 {
+		return none
+	}
+	return max_of(col)
+}
+
+@[direct_array_access]
+fn min_of[N](col []N) N {
+	mut m := col[0]
+	for v in col {
+		if v < m {
+			m = v
+		}
+	}
+	return m
+}
+
+@[direct_array_access]
+fn max_of[N](col []N) N {
+	mut m := col[0]
+	for v in col {
+		if v > m {
+			m = v
+		}
+	}
+	return m
+}
+
+// column_filter returns a mask, that is true for the values of `col` that compare to `value` with `op`.
+// Masks can be combined with `mask_and` and `mask_or`, and used with `column_sum_where` or `mask_indices`.
+// Example: cheap := datatypes.column_filter(prices, .lt, 10.0)
+pub fn column_filter[N](col []N, op CompareOp, value N) []bool {
+	mut mask := []bool{len: col.len}
+	filter_into(mut mask, col, op, value)
+	return mask
+}
+
+// filter_into is the loop of `column_filter`; the comparison is chosen once, outside of the loops
+@[direct_array_access]
+fn filter_into[N](mut mask []bool, col []N, op CompareOp, value N) {
+	match op {
+		.eq {
+			for i in 0 .. col.len {
+				mask[i] = col[i] == value
+			}
+		}
+		.ne {
+			for i in 0 .. col.len {
+				mask[i] = col[i] != value
+			}
+		}
+		.lt {
+			for i in 0 .. col.len {
+				mask[i] = col[i] < value
+			}
+		}
+		.le {
+			for i in 0 .. col.len {
+				mask[i] = col[i] <= value
+			}
+		}
+		.gt {
+			for i in 0 .. col.len {
+				mask[i] = col[i] > value
+			}
+		}
+		.ge {
+			for i in 0 .. col.len {
+				mask[i] = col[i] >= value
+			}
+		}
+	}
+}
+
+// mask_and returns a mask, that is true where both `a` and `b` are true
+@[direct_array_access]
+pub fn mask_and(a []bool, b []bool) []bool {
+	len := if a.len < b.len { a.len } else { b.len }
+	mut res := []bool{len: len}
+	for i in 0 .. len {
+		res[i] = a[i] && b[i]
+	}
+	return res
+}
+
+// mask_or returns a mask, that is true where `a` or `b` is true
+@[direct_array_access]
+pub fn mask_or(a []bool, b []bool) []bool {
+	len := if a.len < b.len { a.len } else { b.len }
+	mut res := []bool{len: len}
+	for i in 0 .. len {
+		res[i] = a[i] || b[i]
+	}
+	return res
+}
+
+// mask_indices returns the indexes, at which `mask` is true
+@[direct_array_access]
+pub fn mask_indices(mask []bool) []int {
+	mut res := []int{}
+	for i in 0 .. mask.len {
+		if mask[i] {
+			res << i
+		}
+	}
+	return res
+}
+
+// column_sum_where returns the sum of the values of `col`, for which `mask` is true
+@[direct_array_access]
+pub fn column_sum_where[N](col []N, mask []bool) N {
+	len := if col.len < mask.len { col.len } else { mask.len }
+	mut s := N(0)
+	for i in 0 .. len {
+		if mask[i] {
+			s += col[i]
+		}
+	}
+	return s
+}
+
+// column_group_sum groups the rows by their value in `keys`, and returns the sum of `values` for each group
+// Example: qty_by_symbol := datatypes.column_group_sum(symbols, quantities)
+@[direct_array_access]
+pub fn column_group_sum[K, N](keys []K, values []N) map[K]N {
+	len := if keys.len < values.len { keys.len } else { values.len }
+	mut res := map[K]N{}
+	for i in 0 .. len {
+		res[keys[i]] += values[i]
+	}
+	return res
+}
+
+// column_group_count returns the number of rows for each value of `keys`
+@[direct_array_access]
+pub fn column_group_count[K](keys []K) map[K]int {
+	mut res := map[K]int{}
+	for i in 0 .. keys.len {
+		res[keys[i]]++
+	}
+	return res
+}
+
+// chunk_bounds cuts `len` values in chunks, one for each thread, and returns their starts, followed by `len`
+fn chunk_bounds(len int, cfg ParallelConfig) []int {
+	nr_threads := if cfg.nr_threads > 0 { cfg.nr_threads } else { runtime.nr_jobs() }
+	mut nr_chunks := if cfg.min_chunk_len > 0 { len / cfg.min_chunk_len } else { nr_threads }
+	if nr_chunks > nr_threads {
+		nr_chunks = nr_threads
+	}
+	if nr_chunks < 1 {
+		nr_chunks = 1
+	}
+	mut bounds := []int{cap: nr_chunks + 1}
+	for c in 0 .. nr_chunks {
+		bounds << int(i64(len) * c / nr_chunks)
+	}
+	bounds << len
+	return bounds
+}
+
+// column_sum_parallel is like `column_sum`, with the column cut in chunks summed by several threads
+pub fn column_sum_parallel[N](col []N, cfg ParallelConfig) N {
+	bounds := chunk_bounds(col.len, cfg)
+	if bounds.len == 2 {
+		return column_sum(col)
+	}
+	mut threads := []thread N{}
+	for c in 0 .. bounds.len - 1 {
+		threads << spawn column_sum(col[bounds[c]..bounds[c + 1]])
+	}
+	return column_sum(threads.wait())
+}
+
+// column_min_parallel is like `column_min`, with the column cut in chunks processed by several threads
+pub fn column_min_parallel[N](col []N, cfg ParallelConfig) ?N {
+	bounds := chunk_bounds(col.len, cfg)
+	if bounds.len == 2 {
+		return column_min(col)
+	}
+	mut threads := []thread N{}
+	for c in 0 .. bounds.len - 1 {
+		threads << spawn min_of(col[bounds[c]..bounds[c + 1]])
+	}
+	return min_of(threads.wait())
+}
+
+// column_max_parallel is like `column_max`, with the column cut in chunks processed by several threads
+pub fn column_max_parallel[N](col []N, cfg ParallelConfig) ?N {
+	bounds := chunk_bounds(col.len, cfg)
+	if bounds.len == 2 {
+		return column_max(col)
+	}
+	mut threads := []thread N{}
+	for c in 0 .. bounds.len - 1 {
+		threads << spawn max_of(col[bounds[c]..bounds[c + 1]])
+	}
+	return max_of(threads.wait())
+}
+
+// column_filter_parallel is like `column_filter`, with the column cut in chunks processed by several threads
+pub fn column_filter_parallel[N](col []N, op CompareOp, value N, cfg ParallelConfig) []bool {
+	bounds := chunk_bounds(col.len, cfg)
+	if bounds.len == 2 {
+		return column_filter(col, op, value)
+	}
+	mut threads := []thread []bool{}
+	for c in 0 .. bounds.len - 1 {
+		threads << spawn column_filter(col[bounds[c]..bounds[c + 1]], op, value)
+	}
+	chunk_masks := threads.wait()
+	mut mask := []bool{cap: col.len}
+	for m in chunk_masks {
+		mask << m
+	}
+	return mask
+}
+
+// column_group_sum_parallel is like `column_group_sum`, with the groups of each chunk summed by a
+// thread, and then merged
+pub fn column_group_sum_parallel[K, N](keys []K, values []N, cfg ParallelConfig) map[K]N {
+	len := if keys.len < values.len { keys.len } else { values.len }
+	bounds := chunk_bounds(len, cfg)
+	if bounds.len == 2 {
+		return column_group_sum(keys, values)
+	}
+	mut threads := []thread map[K]N{}
+	for c in 0 .. bounds.len - 1 {
+		start, end := bounds[c], bounds[c + 1]
+		threads << spawn column_group_sum(keys[start..end], values[start..end])
+	}
+	chunk_groups := threads.wait()
+	mut res := chunk_groups[0].clone()
+	for groups in chunk_groups[1..] {
+		for k, v in groups {
+			res[k] += v
+		}
+	}
+	return res
+}
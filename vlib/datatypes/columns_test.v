@@ -0,0 +1,144 @@
+import datatypes
+
+struct Trade {
+mut:
+	symbol string
+	qty    int
+	price  f64
+	ts     i64
+	filled bool
+	notes  []string
+}
+
+fn sample_trades() []Trade {
+	return [
+		Trade{
+			symbol: 'AAA'
+			qty:    10
+			price:  1.5
+			ts:     100
+			filled: true
+		},
+		Trade{
+			symbol: 'BBB'
+			qty:    70
+			price:  3.0
+			ts:     101
+		},
+		Trade{
+			symbol: 'AAA'
+			qty:    55
+			price:  2.5
+			ts:     102
+			filled: true
+		},
+		Trade{
+			symbol: 'CCC'
+			qty:    5
+			price:  9.0
+			ts:     103
+			notes:  ['late']
+		},
+		Trade{
+			symbol: 'BBB'
+			qty:    30
+			price:  0.5
+			ts:     104
+			filled: true
+		},
+	]
+}
+
+fn test_push_and_row() {
+	trades := sample_trades()
+	mut c := datatypes.new_columns[Trade]()
+	assert c.is_empty()
+	for t in trades {
+		c.push(t)
+	}
+	assert c.len() == trades.len
+	row := c.row(2)!
+	assert row.symbol == 'AAA'
+	assert row.qty == 55
+	assert row.price == 2.5
+	assert row.ts == 102
+	assert row.filled
+	// arrays are not stored
+	assert c.row(3)!.notes.len == 0
+	c.row(5) or {
+		assert err.msg().contains('out of range')
+		return
+	}
+	assert false
+}
+
+fn test_column() {
+	c := datatypes.columns_from(sample_trades())
+	assert c.column[int]('qty')! == [10, 70, 55, 5, 30]
+	assert c.column[string]('symbol')! == ['AAA', 'BBB', 'AAA', 'CCC', 'BBB']
+	assert c.column[bool]('filled')! == [true, false, true, false, true]
+	assert c.kind('price') == .f64
+	assert c.kind('notes') == .unsupported
+	if _ := c.column[int]('price') {
+		assert false
+	}
+	if _ := c.column[int]('missing') {
+		assert false
+	}
+}
+
+fn test_kernels() {
+	c := datatypes.columns_from(sample_trades())
+	qty := c.column[int]('qty')!
+	price := c.column[f64]('price')!
+	assert datatypes.column_sum(qty) == 170
+	assert datatypes.column_sum(price) == 16.5
+	assert datatypes.column_min(qty)? == 5
+	assert datatypes.column_max(price)? == 9.0
+	if _ := datatypes.column_min([]int{}) {
+		assert false
+	}
+
+	big := datatypes.column_filter(qty, .ge, 30)
+	assert big == [false, true, true, false, true]
+	assert datatypes.mask_indices(big) == [1, 2, 4]
+	assert datatypes.column_sum_where(price, big) == 6.0
+	filled := c.column[bool]('filled')!
+	assert datatypes.mask_indices(datatypes.mask_and(big, filled)) == [2, 4]
+	assert datatypes.mask_indices(datatypes.mask_or(big, filled)) == [0, 1, 2, 4]
+	assert datatypes.mask_indices(datatypes.column_filter(c.column[string]('symbol')!, .eq,
+		'BBB')) == [1, 4]
+
+	symbols := c.column[string]('symbol')!
+	assert datatypes.column_group_sum(symbols, qty) == {
+		'AAA': 65
+		'BBB': 100
+		'CCC': 5
+	}
+	assert datatypes.column_group_count(symbols) == {
+		'AAA': 2
+		'BBB': 2
+		'CCC': 1
+	}
+}
+
+fn test_parallel_kernels() {
+	n := 10_007
+	mut keys := []int{cap: n}
+	mut values := []i64{cap: n}
+	for i in 0 .. n {
+		keys << i % 7
+		values << i64(i) - 5000
+	}
+	cfg := datatypes.ParallelConfig{
+		nr_threads:    4
+		min_chunk_len: 1000
+	}
+	assert datatypes.column_sum_parallel(values, cfg) == datatypes.column_sum(values)
+	assert datatypes.column_min_parallel(values, cfg)? == -5000
+	assert datatypes.column_max_parallel(values, cfg)? == 5006
+	assert datatypes.column_filter_parallel(values, .lt, 0, cfg) == datatypes.column_filter(values,
+		.lt, 0)
+	assert datatypes.column_group_sum_parallel(keys, values, cfg) == datatypes.column_group_sum(keys,
+		values)
+}
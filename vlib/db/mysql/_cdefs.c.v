@@ -2,6 +2,7 @@ module mysql
 
 @[typedef]
 pub struct C.MYSQL {
+	server_status u32
 }
 
 @[typedef]
@@ -22,6 +22,9 @@ struct SQLError {
 }
 
 pub struct DB {
+pub mut:
+	// the rows, that `insert xs into Table` sends in a single INSERT, at most; 0 means `orm.default_batch_size`
+	batch_size int
 mut:
 	conn &C.MYSQL = unsafe { nil }
 }
@@ -144,6 +144,47 @@ pub fn (db DB) insert(table string, data orm.QueryData) ! {
 	mysql_stmt_worker(db, query, converted_data, orm.QueryData{})!
 }
 
+// the maximum number of the parameters of a prepared statement
+const max_stmt_params = 65535
+
+// insert_batch is used internally by V's ORM for processing `insert xs into Table`. The rows are
+// inserted with multi-row VALUES, `batch_size` rows per statement, in a single transaction, unless
+// one is already open, or autocommit is off.
+pub fn (db DB) insert_batch(table string, data orm.BatchData) ! {
+	column_type_map := db.get_table_column_type_map(table)!
+	max_rows := if db.batch_size > 0 { db.batch_size } else { orm.default_batch_size }
+	status := db.conn.server_status
+	own_transaction := status & u32(C.SERVER_STATUS_IN_TRANS) == 0
+		&& status & u32(C.SERVER_STATUS_AUTOCOMMIT) != 0
+	if own_transaction {
+		db.exec_none('START TRANSACTION')
+	}
+	for group in data.groups(max_rows) {
+		mut rows := group.rows.len
+		if group.fields.len > 0 && rows * group.fields.len > max_stmt_params {
+			rows = max_stmt_params / group.fields.len
+		}
+		for start := 0; start < group.rows.len; start += rows {
+			end := if start + rows < group.rows.len { start + rows } else { group.rows.len }
+			query := orm.orm_batch_insert_gen(.default, table, '`', group.fields, end - start,
+				false, '?', 1)
+			mut values := []orm.Primitive{cap: (end - start) * group.fields.len}
+			for row in group.rows[start..end] {
+				values << convert_time_primitives(column_type_map, group.fields, row)
+			}
+			mysql_stmt_worker(db, query, orm.QueryData{ data: values }, orm.QueryData{}) or {
+				if own_transaction {
+					db.exec_none('ROLLBACK')
+				}
+				return err
+			}
+		}
+	}
+	if own_transaction {
+		db.commit()!
+	}
+}
+
 // update is used internally by V's ORM for processing `UPDATE ` queries
 pub fn (db DB) update(table string, data orm.QueryData, where orm.QueryData) ! {
 	query, _ := orm.orm_stmt_gen(.default, table, '`', .update, false, '?', 1, data, where)
@@ -367,18 +408,24 @@ fn mysql_type_from_v(typ int) !string {
 // convert_query_data_to_primitives converts the `data` representing the `QueryData`
 // into an array of `Primitive`.
 fn (db DB) convert_query_data_to_primitives(table string, data orm.QueryData) ![]orm.Primitive {
-	mut column_type_map := db.get_table_column_type_map(table)!
+	column_type_map := db.get_table_column_type_map(table)!
+	return convert_time_primitives(column_type_map, data.fields, data.data)
+}
+
+// convert_time_primitives converts the time.Time values of the `datetime` and `timestamp` columns
+// to strings
+fn convert_time_primitives(column_type_map map[string]string, fields []string, data []orm.Primitive) []orm.Primitive {
 	mut converted_data := []orm.Primitive{}
 
-	for i, field in data.fields {
-		if data.data[i].type_name() == 'time.Time' {
+	for i, field in fields {
+		if data[i].type_name() == 'time.Time' {
 			if column_type_map[field] in ['datetime', 'timestamp'] {
-				converted_data << orm.Primitive((data.data[i] as time.Time).str())
+				converted_data << orm.Primitive((data[i] as time.Time).str())
 			} else {
-				converted_data << data.data[i]
+				converted_data << data[i]
 			}
 		} else {
-			converted_data << data.data[i]
+			converted_data << data[i]
 		}
 	}
 
@@ -1,8 +1,20 @@
 module pg
 
 import orm
+import strings
 import time
+import math
 import net.conv
+import encoding.binary
+
+// the column types, whose binary format `binary_to_primitive` decodes; the results of prepared
+// ORM queries are read in binary format, when all their columns have one of these types
+const binary_oids = [u32(Oid.t_bool), u32(Oid.t_char), u32(Oid.t_name), u32(Oid.t_int8),
+	u32(Oid.t_int2), u32(Oid.t_int4), u32(Oid.t_text), u32(Oid.t_float4), u32(Oid.t_float8),
+	u32(Oid.t_bpchar), u32(Oid.t_varchar), u32(Oid.t_timestamp), u32(Oid.t_uuid)]
+
+// 2000-01-01, the epoch of the PostgreSQL timestamps, in Unix time
+const pg_epoch_unix = i64(946_684_800)
 
 // sql expr
 
@@ -10,17 +22,27 @@ import net.conv
 pub fn (db DB) @select(config orm.SelectConfig, data orm.QueryData, where orm.QueryData) ![][]orm.Primitive {
 	query := orm.orm_select_gen(config, '"', true, '$', 1, where)
 
-	rows := pg_stmt_worker(db, query, where, data)!
-
-	mut ret := [][]orm.Primitive{}
-
-	if config.is_count {
+	res, binary := pg_prepared_worker(db, query, where, data)!
+	defer {
+		C.PQclear(res)
 	}
 
-	for row in rows {
-		mut row_data := []orm.Primitive{}
-		for i, val in row.vals {
-			row_data << val_to_primitive(val, config.types[i])!
+	nr_rows := C.PQntuples(res)
+	nr_cols := C.PQnfields(res)
+	mut ret := [][]orm.Primitive{cap: nr_rows}
+	for i in 0 .. nr_rows {
+		mut row_data := []orm.Primitive{cap: nr_cols}
+		for j in 0 .. nr_cols {
+			// a count is read as an int, whatever the type of the first field is
+			typ := if config.is_count { orm.type_idx['int'] } else { config.types[j] }
+			if binary {
+				row_data << binary_to_primitive(res, i, j, typ)!
+			} else if C.PQgetisnull(res, i, j) != 0 {
+				row_data << orm.Null{}
+			} else {
+				row_data << val_to_primitive(unsafe { cstring_to_vstring(C.PQgetvalue(res, i,
+					j)) }, typ)!
+			}
 		}
 		ret << row_data
 	}
@@ -34,20 +56,175 @@ pub fn (db DB) @select(config orm.SelectConfig, data orm.QueryData, where orm.Qu
 pub fn (db DB) insert(table string, data orm.QueryData) ! {
 	query, converted_data := orm.orm_stmt_gen(.default, table, '"', .insert, true, '$',
 		1, data, orm.QueryData{})
-	pg_stmt_worker(db, query, converted_data, orm.QueryData{})!
+	res, _ := pg_prepared_worker(db, query, converted_data, orm.QueryData{})!
+	C.PQclear(res)
+}
+
+// insert_batch is used internally by V's ORM for processing `insert xs into Table`. The rows are
+// sent with COPY ... FROM STDIN, `batch_size` rows per COPY, in a single transaction, unless one is
+// already open.
+pub fn (db DB) insert_batch(table string, data orm.BatchData) ! {
+	max_rows := if db.batch_size > 0 { db.batch_size } else { orm.default_batch_size }
+	own_transaction := C.PQtransactionStatus(db.conn) == C.PQTRANS_IDLE
+	if own_transaction {
+		db.exec('BEGIN')!
+	}
+	for group in data.groups(max_rows) {
+		if group.fields.len == 0 {
+			// COPY needs at least one column: a row of default values only
+			db.exec('INSERT INTO "${table}" DEFAULT VALUES') or {
+				if own_transaction {
+					db.exec('ROLLBACK') or {}
+				}
+				return err
+			}
+			continue
+		}
+		db.copy_rows(table, group) or {
+			if own_transaction {
+				db.exec('ROLLBACK') or {}
+			}
+			return err
+		}
+	}
+	if own_transaction {
+		db.exec('COMMIT')!
+	}
+}
+
+// the size of the buffer of COPY data, that is sent to the server at once
+const copy_buffer_size = 64 * 1024
+
+// copy_rows sends the rows of `group` with a COPY, in its text format
+fn (db DB) copy_rows(table string, group orm.BatchGroup) ! {
+	columns := group.fields.map('"${it}"').join(', ')
+	query := 'COPY "${table}" (${columns}) FROM STDIN'
+	res := C.PQexec(db.conn, &char(query.str))
+	if unsafe { ExecStatusType(C.PQresultStatus(res)) } != .copy_in {
+		msg := unsafe { cstring_to_vstring(C.PQresultErrorMessage(res)) }
+		C.PQclear(res)
+		return error('pg copy error: ${msg}')
+	}
+	C.PQclear(res)
+	mut buf := strings.new_builder(copy_buffer_size + 1024)
+	defer {
+		unsafe { buf.free() }
+	}
+	mut sent := true
+	for row in group.rows {
+		for i, value in row {
+			if i > 0 {
+				buf.write_u8(`\t`)
+			}
+			pg_copy_value(mut buf, value)
+		}
+		buf.write_u8(`\n`)
+		if buf.len >= copy_buffer_size {
+			sent = C.PQputCopyData(db.conn, &char(buf.data), buf.len) == 1
+			buf.clear()
+			if !sent {
+				break
+			}
+		}
+	}
+	if sent && buf.len > 0 {
+		sent = C.PQputCopyData(db.conn, &char(buf.data), buf.len) == 1
+	}
+	if sent {
+		sent = C.PQputCopyEnd(db.conn, &char(0)) == 1
+	}
+	// the result of the COPY, and of its rows
+	mut msg := ''
+	for {
+		r := C.PQgetResult(db.conn)
+		if r == unsafe { nil } {
+			break
+		}
+		if unsafe { ExecStatusType(C.PQresultStatus(r)) } != .command_ok && msg == '' {
+			msg = unsafe { cstring_to_vstring(C.PQresultErrorMessage(r)) }
+		}
+		C.PQclear(r)
+	}
+	if !sent && msg == '' {
+		msg = unsafe { cstring_to_vstring(C.PQerrorMessage(db.conn)) }
+	}
+	if msg != '' {
+		return error('pg copy error: ${msg}')
+	}
+}
+
+// pg_copy_value writes `value` in the text format of COPY
+fn pg_copy_value(mut buf strings.Builder, value orm.Primitive) {
+	match value {
+		orm.Null {
+			buf.write_string('\\N')
+		}
+		bool {
+			buf.write_u8(if value { `t` } else { `f` })
+		}
+		string {
+			for c in value {
+				match c {
+					`\\` { buf.write_string('\\\\') }
+					`\n` { buf.write_string('\\n') }
+					`\r` { buf.write_string('\\r') }
+					`\t` { buf.write_string('\\t') }
+					else { buf.write_u8(c) }
+				}
+			}
+		}
+		time.Time {
+			buf.write_string(value.format_ss())
+		}
+		orm.InfixType {
+			pg_copy_value(mut buf, value.right)
+		}
+		i8 {
+			buf.write_string(value.str())
+		}
+		i16 {
+			buf.write_string(value.str())
+		}
+		int {
+			buf.write_string(value.str())
+		}
+		i64 {
+			buf.write_string(value.str())
+		}
+		u8 {
+			buf.write_string(value.str())
+		}
+		u16 {
+			buf.write_string(value.str())
+		}
+		u32 {
+			buf.write_string(value.str())
+		}
+		u64 {
+			buf.write_string(value.str())
+		}
+		f32 {
+			buf.write_string(value.str())
+		}
+		f64 {
+			buf.write_string(value.str())
+		}
+	}
 }
 
 // update is used internally by V's ORM for processing `UPDATE ` queries
 pub fn (db DB) update(table string, data orm.QueryData, where orm.QueryData) ! {
 	query, _ := orm.orm_stmt_gen(.default, table, '"', .update, true, '$', 1, data, where)
-	pg_stmt_worker(db, query, data, where)!
+	res, _ := pg_prepared_worker(db, query, data, where)!
+	C.PQclear(res)
 }
 
 // delete is used internally by V's ORM for processing `DELETE ` queries
 pub fn (db DB) delete(table string, where orm.QueryData) ! {
 	query, _ := orm.orm_stmt_gen(.default, table, '"', .delete, true, '$', 1, orm.QueryData{},
 		where)
-	pg_stmt_worker(db, query, orm.QueryData{}, where)!
+	res, _ := pg_prepared_worker(db, query, orm.QueryData{}, where)!
+	C.PQclear(res)
 }
 
 // last_id is used internally by V's ORM for post-processing `INSERT ` queries
@@ -62,12 +239,14 @@ pub fn (db DB) last_id() int {
 // create is used internally by V's ORM for processing table creation queries (DDL)
 pub fn (db DB) create(table string, fields []orm.TableField) ! {
 	query := orm.orm_table_gen(table, '"', true, 0, fields, pg_type_from_v, false) or { return err }
+	db.clear_statements()
 	pg_stmt_worker(db, query, orm.QueryData{}, orm.QueryData{})!
 }
 
 // drop is used internally by V's ORM for processing table destroying queries (DDL)
 pub fn (db DB) drop(table string) ! {
 	query := 'DROP TABLE "${table}";'
+	db.clear_statements()
 	pg_stmt_worker(db, query, orm.QueryData{}, orm.QueryData{})!
 }
 
@@ -298,3 +477,141 @@ fn val_to_primitive(val ?string, typ int) !orm.Primitive {
 		return orm.Null{}
 	}
 }
+
+// binary_to_primitive decodes the value of the column `col`, in the row `row` of a result in
+// binary format, straight into the V type `typ`, without going through its text form
+fn binary_to_primitive(res &C.PGresult, row int, col int, typ int) !orm.Primitive {
+	if C.PQgetisnull(res, row, col) != 0 {
+		return orm.Null{}
+	}
+	b := unsafe { (&u8(C.PQgetvalue(res, row, col))).vbytes(C.PQgetlength(res, row, col)) }
+	match C.PQftype(res, col) {
+		u32(Oid.t_bool) {
+			return val_to_primitive(if b[0] != 0 { 't' } else { 'f' }, typ)
+		}
+		u32(Oid.t_char) {
+			return int_to_primitive(i64(i8(b[0])), typ)
+		}
+		u32(Oid.t_int2) {
+			return int_to_primitive(i64(i16(binary.big_endian_u16(b))), typ)
+		}
+		u32(Oid.t_int4) {
+			return int_to_primitive(i64(int(binary.big_endian_u32(b))), typ)
+		}
+		u32(Oid.t_int8) {
+			return int_to_primitive(i64(binary.big_endian_u64(b)), typ)
+		}
+		u32(Oid.t_float4) {
+			return float_to_primitive(f64(math.f32_from_bits(binary.big_endian_u32(b))), typ)
+		}
+		u32(Oid.t_float8) {
+			return float_to_primitive(math.f64_from_bits(binary.big_endian_u64(b)), typ)
+		}
+		u32(Oid.t_timestamp) {
+			return timestamp_to_primitive(i64(binary.big_endian_u64(b)), typ)
+		}
+		u32(Oid.t_uuid) {
+			h := b.hex()
+			return val_to_primitive('${h[..8]}-${h[8..12]}-${h[12..16]}-${h[16..20]}-${h[20..]}',
+				typ)
+		}
+		else {
+			// the text types, whose binary format is their text
+			return val_to_primitive(b.bytestr(), typ)
+		}
+	}
+}
+
+fn int_to_primitive(n i64, typ int) !orm.Primitive {
+	match typ {
+		orm.type_idx['bool'] {
+			return orm.Primitive(n != 0)
+		}
+		orm.type_idx['i8'] {
+			return orm.Primitive(i8(n))
+		}
+		orm.type_idx['i16'] {
+			return orm.Primitive(i16(n))
+		}
+		orm.type_idx['int'] {
+			return orm.Primitive(int(n))
+		}
+		orm.type_idx['i64'], orm.enum_ {
+			return orm.Primitive(n)
+		}
+		orm.type_idx['u8'] {
+			return orm.Primitive(u8(n))
+		}
+		orm.type_idx['u16'] {
+			return orm.Primitive(u16(n))
+		}
+		orm.type_idx['u32'] {
+			return orm.Primitive(u32(n))
+		}
+		orm.type_idx['u64'] {
+			return orm.Primitive(u64(n))
+		}
+		orm.type_idx['f32'] {
+			return orm.Primitive(f32(n))
+		}
+		orm.type_idx['f64'] {
+			return orm.Primitive(f64(n))
+		}
+		orm.type_string {
+			return orm.Primitive(n.str())
+		}
+		orm.time_ {
+			return orm.Primitive(time.unix(n))
+		}
+		else {}
+	}
+	return error('Unknown field type ${typ}')
+}
+
+fn float_to_primitive(f f64, typ int) !orm.Primitive {
+	match typ {
+		orm.type_idx['f32'] {
+			return orm.Primitive(f32(f))
+		}
+		orm.type_idx['f64'] {
+			return orm.Primitive(f)
+		}
+		orm.type_string {
+			return orm.Primitive(f.str())
+		}
+		else {
+			return int_to_primitive(i64(f), typ)
+		}
+	}
+}
+
+// timestamp_to_primitive converts a timestamp, in microseconds since 2000-01-01, to the V type
+// `typ`; strings get the text format of PostgreSQL, e.g. `2024-01-31 12:30:00.25`
+fn timestamp_to_primitive(micros i64, typ int) !orm.Primitive {
+	if micros == max_i64 {
+		return val_to_primitive('infinity', typ)
+	} else if micros == min_i64 {
+		return val_to_primitive('-infinity', typ)
+	}
+	mut secs := micros / 1_000_000
+	mut us := int(micros % 1_000_000)
+	if us < 0 {
+		secs--
+		us += 1_000_000
+	}
+	t := time.unix_microsecond(secs + pg_epoch_unix, us)
+	match typ {
+		orm.time_ {
+			return orm.Primitive(t)
+		}
+		orm.type_string {
+			if us == 0 {
+				return orm.Primitive(t.format_ss())
+			}
+			return orm.Primitive('${t.format_ss()}.${us:06}'.trim_right('0'))
+		}
+		else {
+			return int_to_primitive(t.unix(), typ)
+		}
+	}
+}
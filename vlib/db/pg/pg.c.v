@@ -49,8 +49,13 @@ $if windows {
 #include "@VMODROOT/vlib/db/pg/compatibility.h"
 
 pub struct DB {
+pub mut:
+	// the rows, that `insert xs into Table` sends with a single COPY, at most; 0 means `orm.default_batch_size`
+	batch_size int
 mut:
 	conn voidptr = unsafe { nil }
+	// the statements prepared for the ORM queries, see `pg_prepared_worker`
+	stmt_cache &StmtCache = unsafe { nil }
 }
 
 pub struct Row {
@@ -116,6 +121,8 @@ fn C.PQconnectdb(const_conninfo &char) &C.PGconn
 
 fn C.PQstatus(const_conn &C.PGconn) int
 
+fn C.PQtransactionStatus(const_conn &C.PGconn) int
+
 fn C.PQerrorMessage(const_conn &C.PGconn) &char
 
 fn C.PQexec(res &C.PGconn, const_query &char) &C.PGresult
@@ -140,6 +147,36 @@ fn C.PQnfields(const_res &C.PGresult) int
 fn C.PQexecParams(conn &C.PGconn, const_command &char, nParams int, const_paramTypes &int, const_paramValues &char,
 	const_paramLengths &int, const_paramFormats &int, resultFormat int) &C.PGresult
 
+fn C.PQprepare(conn &C.PGconn, const_stmtName &char, const_query &char, nParams int, const_paramTypes &u32) &C.PGresult
+
+fn C.PQexecPrepared(conn &C.PGconn, const_stmtName &char, nParams int, const_paramValues &char, const_paramLengths &int,
+	const_paramFormats &int, resultFormat int) &C.PGresult
+
+fn C.PQdescribePrepared(conn &C.PGconn, const_stmtName &char) &C.PGresult
+
+fn C.PQftype(const_res &C.PGresult, field_num int) u32
+
+fn C.PQgetlength(const_res &C.PGresult, tup_num int, field_num int) int
+
+fn C.PQresultErrorMessage(const_res &C.PGresult) &char
+
+fn C.PQresultErrorField(const_res &C.PGresult, fieldcode int) &char
+
+// single-row mode
+
+fn C.PQsendQueryParams(conn &C.PGconn, const_command &char, nParams int, const_paramTypes &int, const_paramValues &char,
+	const_paramLengths &int, const_paramFormats &int, resultFormat int) int
+
+fn C.PQsetSingleRowMode(conn &C.PGconn) int
+
+fn C.PQgetResult(conn &C.PGconn) &C.PGresult
+
+fn C.PQgetCancel(conn &C.PGconn) voidptr
+
+fn C.PQcancel(cancel voidptr, errbuf &char, errbufsize int) int
+
+fn C.PQfreeCancel(cancel voidptr)
+
 fn C.PQputCopyData(conn &C.PGconn, const_buffer &char, nbytes int) int
 
 fn C.PQputCopyEnd(conn &C.PGconn, const_errmsg &char) int
@@ -182,7 +219,8 @@ pub fn connect_with_conninfo(conninfo string) !DB {
 		return error('Connection to a PG database failed: ${error_msg}')
 	}
 	return DB{
-		conn: conn
+		conn:       conn
+		stmt_cache: &StmtCache{}
 	}
 }
 
@@ -301,6 +339,94 @@ pub fn (db DB) exec_param2(query string, param string, param2 string) ![]Row {
 	return db.exec_param_many(query, [param, param2])
 }
 
+// RowIterator reads the rows of a query started with `exec_stream`, one at a time
+pub struct RowIterator {
+	db DB
+mut:
+	done bool
+	// the error of the query, when `next` stopped because of it
+	error_msg string
+}
+
+// exec_stream sends a query with the parameters provided as ($1), ($2), ($n), and returns an
+// iterator over its rows. The rows are fetched one at a time, with the single-row mode of libpq,
+// instead of reading the whole result set into memory. No other query can be run on the
+// connection, till the iterator is exhausted, or closed.
+// Example: mut rows := db.exec_stream('SELECT id, name FROM users WHERE age > $1', '18')!
+// for row in rows { println(row.vals) }
+pub fn (db DB) exec_stream(query string, params ...string) !RowIterator {
+	mut param_vals := []&char{len: params.len}
+	for i, param in params {
+		param_vals[i] = &char(param.str)
+	}
+	if C.PQsendQueryParams(db.conn, &char(query.str), params.len, 0, param_vals.data, 0, 0, 0) != 1 {
+		e := unsafe { C.PQerrorMessage(db.conn).vstring() }
+		return error('pg exec_stream error:\n${e}')
+	}
+	mut rows := RowIterator{
+		db: db
+	}
+	if C.PQsetSingleRowMode(db.conn) != 1 {
+		rows.close()
+		return error('pg exec_stream error: could not enable the single-row mode')
+	}
+	return rows
+}
+
+// next returns the next row, or none, once all the rows have been read, or the query failed.
+// See `check` for the latter case.
+pub fn (mut rows RowIterator) next() ?Row {
+	if rows.done {
+		return none
+	}
+	for {
+		res := C.PQgetResult(rows.db.conn)
+		if res == unsafe { nil } {
+			rows.done = true
+			return none
+		}
+		status := unsafe { ExecStatusType(C.PQresultStatus(res)) }
+		if status == .single_tuple {
+			return res_to_rows(res)[0]
+		}
+		if status != .tuples_ok && status != .command_ok {
+			rows.error_msg = unsafe { cstring_to_vstring(C.PQresultErrorMessage(res)) }
+		}
+		// the end of the rows: the next result is nil
+		C.PQclear(res)
+	}
+	return none
+}
+
+// check returns an error, when `next` stopped, because the query failed
+pub fn (rows &RowIterator) check() ! {
+	if rows.error_msg != '' {
+		return error('pg exec_stream error:\n${rows.error_msg}')
+	}
+}
+
+// close cancels the query, when not all of its rows have been read, so that the connection can
+// be used again
+pub fn (mut rows RowIterator) close() {
+	if rows.done {
+		return
+	}
+	cancel := C.PQgetCancel(rows.db.conn)
+	if cancel != unsafe { nil } {
+		mut errbuf := [256]char{}
+		C.PQcancel(cancel, &errbuf[0], errbuf.len)
+		C.PQfreeCancel(cancel)
+	}
+	for {
+		res := C.PQgetResult(rows.db.conn)
+		if res == unsafe { nil } {
+			break
+		}
+		C.PQclear(res)
+	}
+	rows.done = true
+}
+
 fn (db DB) handle_error_or_result(res voidptr, elabel string) ![]Row {
 	e := unsafe { C.PQerrorMessage(db.conn).vstring() }
 	if e != '' {
@@ -391,3 +517,183 @@ fn pg_stmt_worker(db DB, query string, data orm.QueryData, where orm.QueryData)
 		param_vals.data, param_lens.data, param_formats.data, 0) // here, the last 0 means require text results, 1 - binary results
 	return db.handle_error_or_result(res, 'orm_stmt_worker')
 }
+
+// the number of the ORM queries, that are kept prepared on a connection, unless it is changed with
+// `set_stmt_cache_size`; when there are more, the statement used least recently is deallocated
+pub const default_stmt_cache_size = 256
+
+// the SQLSTATE of the errors, after which a prepared statement has to be prepared again:
+// invalid_sql_statement_name (e.g. after DISCARD ALL), and feature_not_supported (for
+// "cached plan must not change result type", after the columns of a table changed)
+const stmt_invalid_sqlstates = ['26000', '0A000']
+
+@[heap]
+struct StmtCache {
+mut:
+	size  int = default_stmt_cache_size
+	stmts map[string]&PreparedStmt
+	next  int
+	tick  u64
+}
+
+@[heap]
+struct PreparedStmt {
+	name string
+	// the columns of the result all have a binary format, that `binary_to_primitive` decodes
+	binary bool
+mut:
+	last_used u64
+}
+
+// pg_prepared_worker runs an ORM query with a statement, that is prepared the first time the query
+// is run on the connection, with the same parameter types. The result is in binary format, when
+// `binary_to_primitive` can decode all its columns; the caller has to free it with C.PQclear.
+fn pg_prepared_worker(db DB, query string, data orm.QueryData, where orm.QueryData) !(&C.PGresult, bool) {
+	mut param_types := []u32{}
+	mut param_vals := []&char{}
+	mut param_lens := []int{}
+	mut param_formats := []int{}
+
+	pg_stmt_binder(mut param_types, mut param_vals, mut param_lens, mut param_formats,
+		data)
+	pg_stmt_binder(mut param_types, mut param_vals, mut param_lens, mut param_formats,
+		where)
+
+	mut stmt := db.prepare_cached(query, param_types)!
+	mut res := db.exec_stmt(stmt, query, param_types, param_vals, param_lens, param_formats)
+	if stmt.name != '' && unsafe { ExecStatusType(C.PQresultStatus(res)) } == .fatal_error {
+		sqlstate := unsafe { cstring_to_vstring(C.PQresultErrorField(res, C.PG_DIAG_SQLSTATE)) }
+		if sqlstate in stmt_invalid_sqlstates {
+			C.PQclear(res)
+			db.forget_statement(query, param_types)
+			stmt = db.prepare_cached(query, param_types)!
+			res = db.exec_stmt(stmt, query, param_types, param_vals, param_lens, param_formats)
+		}
+	}
+	return db.check_result(res, 'orm_stmt_worker')!, stmt.binary
+}
+
+// exec_stmt runs the prepared statement `stmt`, or `query` itself, when it is not prepared
+fn (db DB) exec_stmt(stmt &PreparedStmt, query string, param_types []u32, param_vals []&char, param_lens []int, param_formats []int) &C.PGresult {
+	if stmt.name == '' {
+		return C.PQexecParams(db.conn, &char(query.str), param_vals.len, param_types.data,
+			param_vals.data, param_lens.data, param_formats.data, 0)
+	}
+	return C.PQexecPrepared(db.conn, &char(stmt.name.str), param_vals.len, param_vals.data,
+		param_lens.data, param_formats.data, if stmt.binary { 1 } else { 0 })
+}
+
+// stmt_key returns the key of a query and its parameter types in the statement cache
+fn stmt_key(query string, param_types []u32) string {
+	return query + unsafe { tos(&u8(param_types.data), param_types.len * int(sizeof(u32))) }
+}
+
+// prepare_cached returns the statement prepared for `query`, preparing it, if it is not yet. The
+// name of the returned statement is empty, when the query should not be prepared.
+fn (db DB) prepare_cached(query string, param_types []u32) !&PreparedStmt {
+	if db.stmt_cache == unsafe { nil } || db.stmt_cache.size <= 0 {
+		return &PreparedStmt{}
+	}
+	mut cache := unsafe { db.stmt_cache }
+	cache.tick++
+	key := stmt_key(query, param_types)
+	if stmt := cache.stmts[key] {
+		mut used := unsafe { stmt }
+		used.last_used = cache.tick
+		return stmt
+	}
+	for cache.stmts.len >= cache.size {
+		db.evict_statement()
+	}
+
+	name := 'v_orm_${cache.next}'
+	cache.next++
+	res := C.PQprepare(db.conn, &char(name.str), &char(query.str), param_types.len, param_types.data)
+	db.check_result(res, 'orm_prepare')!
+	C.PQclear(res)
+
+	desc := C.PQdescribePrepared(db.conn, &char(name.str))
+	mut binary := unsafe { ExecStatusType(C.PQresultStatus(desc)) } == .command_ok
+	for i in 0 .. C.PQnfields(desc) {
+		if C.PQftype(desc, i) !in binary_oids {
+			binary = false
+			break
+		}
+	}
+	C.PQclear(desc)
+
+	stmt := &PreparedStmt{
+		name:      name
+		binary:    binary
+		last_used: cache.tick
+	}
+	cache.stmts[key] = stmt
+	return stmt
+}
+
+// evict_statement drops the statement used least recently from the cache, and from the server
+fn (db DB) evict_statement() {
+	mut cache := unsafe { db.stmt_cache }
+	mut oldest := ''
+	mut oldest_tick := u64(0)
+	for key, stmt in cache.stmts {
+		if oldest == '' || stmt.last_used < oldest_tick {
+			oldest = key
+			oldest_tick = stmt.last_used
+		}
+	}
+	stmt := cache.stmts[oldest] or { return }
+	cache.stmts.delete(oldest)
+	C.PQclear(C.PQexec(db.conn, &char('DEALLOCATE "${stmt.name}"'.str)))
+}
+
+// forget_statement drops the statement prepared for `query` from the cache, and from the server
+fn (db DB) forget_statement(query string, param_types []u32) {
+	key := stmt_key(query, param_types)
+	mut cache := unsafe { db.stmt_cache }
+	stmt := cache.stmts[key] or { return }
+	cache.stmts.delete(key)
+	C.PQclear(C.PQexec(db.conn, &char('DEALLOCATE "${stmt.name}"'.str)))
+}
+
+// set_stmt_cache_size sets the number of the ORM queries, that are kept prepared on the connection
+// of `db`. A size of 0 disables the preparing of the queries.
+pub fn (db DB) set_stmt_cache_size(size int) {
+	if db.stmt_cache == unsafe { nil } {
+		return
+	}
+	mut cache := unsafe { db.stmt_cache }
+	cache.size = size
+	for cache.stmts.len > size {
+		db.evict_statement()
+	}
+}
+
+// clear_statements drops the statements prepared by the cache, after the tables they use may have
+// changed. The statements prepared by the user, with `prepare`, are kept.
+fn (db DB) clear_statements() {
+	if db.stmt_cache == unsafe { nil } || db.stmt_cache.stmts.len == 0 {
+		return
+	}
+	mut cache := unsafe { db.stmt_cache }
+	for _, stmt in cache.stmts {
+		if stmt.name != '' {
+			C.PQclear(C.PQexec(db.conn, &char('DEALLOCATE "${stmt.name}"'.str)))
+		}
+	}
+	cache.stmts.clear()
+}
+
+// check_result returns `res`, or frees it, and returns an error, when the command failed
+fn (db DB) check_result(res &C.PGresult, elabel string) !&C.PGresult {
+	status := unsafe { ExecStatusType(C.PQresultStatus(res)) }
+	if status != .command_ok && status != .tuples_ok {
+		e := unsafe { C.PQerrorMessage(db.conn).vstring() }
+		C.PQclear(res)
+		$if trace_pg_error ? {
+			eprintln('pg error: ${e}')
+		}
+		return error('pg ${elabel} error:\n${e}')
+	}
+	return res
+}
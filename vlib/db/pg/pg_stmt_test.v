@@ -0,0 +1,255 @@
+module main
+
+import db.pg
+import time
+
+@[table: 'stmt_demo']
+struct StmtDemo {
+	id         int @[primary; sql: serial]
+	name       string
+	small      i16
+	big        i64
+	ratio      f64
+	flag       bool
+	created_at time.Time
+	note       ?string
+}
+
+fn test_prepared_orm_queries_with_binary_results() {
+	$if !network ? {
+		eprintln('> Skipping test ${@FN}, since `-d network` is not passed.')
+		eprintln('> This test requires a working postgres server running on localhost.')
+		return
+	}
+	db := pg.connect(pg.Config{ user: 'postgres', password: 'secret', dbname: 'postgres' })!
+	defer {
+		db.close()
+	}
+
+	sql db {
+		create table StmtDemo
+	}!
+	defer {
+		sql db {
+			drop table StmtDemo
+		} or {}
+	}
+
+	created_at := time.parse('2024-01-31 12:30:45')!
+	for i in 0 .. 10 {
+		row := StmtDemo{
+			name:       'row ${i}'
+			small:      i16(-i)
+			big:        i64(1) << 40 + i
+			ratio:      f64(i) / 4
+			flag:       i % 2 == 0
+			created_at: created_at
+			note:       if i % 3 == 0 { none } else { 'note ${i}' }
+		}
+		sql db {
+			insert row into StmtDemo
+		}!
+	}
+
+	// the same queries run again, with the statements prepared the first time
+	for _ in 0 .. 3 {
+		rows := sql db {
+			select from StmtDemo where big > i64(1) << 40 + 4 order by id
+		}!
+		assert rows.len == 5
+		assert rows[0].name == 'row 5'
+		assert rows[0].small == -5
+		assert rows[0].big == i64(1) << 40 + 5
+		assert rows[0].ratio == 1.25
+		assert rows[0].flag == false
+		assert rows[0].created_at == created_at
+		assert rows[0].note? == 'note 5'
+		assert rows[1].note == none
+
+		count := sql db {
+			select count from StmtDemo where flag == true
+		}!
+		assert count == 5
+	}
+
+	sql db {
+		update StmtDemo set name = 'renamed' where id == 1
+	}!
+	renamed := sql db {
+		select from StmtDemo where id == 1
+	}!
+	assert renamed[0].name == 'renamed'
+}
+
+fn test_exec_stream() {
+	$if !network ? {
+		eprintln('> Skipping test ${@FN}, since `-d network` is not passed.')
+		eprintln('> This test requires a working postgres server running on localhost.')
+		return
+	}
+	db := pg.connect(pg.Config{ user: 'postgres', password: 'secret', dbname: 'postgres' })!
+	defer {
+		db.close()
+	}
+
+	mut rows := db.exec_stream('SELECT n, n * 2 FROM generate_series(1, $1::int) AS n',
+		'10000')!
+	mut sum := 0
+	mut n := 0
+	for row in rows {
+		sum += (row.vals[1] or { '0' }).int()
+		n++
+	}
+	assert n == 10000
+	assert sum == 10000 * 10001
+	rows.check()!
+
+	// stopping early cancels the query, and leaves the connection usable
+	mut early := db.exec_stream('SELECT n FROM generate_series(1, 1000000) AS n')!
+	first := early.next() or { panic('no row') }
+	assert first.vals[0]? == '1'
+	early.close()
+	assert db.q_int('SELECT 42')! == 42
+
+	mut failed := db.exec_stream('SELECT 1 / 0')!
+	for _ in failed {
+		assert false
+	}
+	if _ := failed.check() {
+		assert false
+	}
+}
+
+@[table: 'stmt_types']
+struct StmtTypes {
+	id  int @[primary; sql: serial]
+	i2  i16
+	i4  int
+	i8  i64
+	f4  f32
+	f8  f64
+	at  time.Time
+	uid string @[sql_type: 'uuid']
+}
+
+fn test_binary_decoding_and_re_prepared_statements() {
+	$if !network ? {
+		eprintln('> Skipping test ${@FN}, since `-d network` is not passed.')
+		eprintln('> This test requires a working postgres server running on localhost.')
+		return
+	}
+	db := pg.connect(pg.Config{ user: 'postgres', password: 'secret', dbname: 'postgres' })!
+	defer {
+		db.close()
+	}
+
+	sql db {
+		create table StmtTypes
+	}!
+	defer {
+		sql db {
+			drop table StmtTypes
+		} or {}
+	}
+	at := time.parse('1999-12-31 23:59:58')!
+	row := StmtTypes{
+		i2:  -32768
+		i4:  -2_000_000_000
+		i8:  -(i64(1) << 62)
+		f4:  1.5
+		f8:  -0.1
+		at:  at
+		uid: '123e4567-e89b-12d3-a456-426614174000'
+	}
+	sql db {
+		insert row into StmtTypes
+	}!
+	check := fn [db, at] () ! {
+		rows := sql db {
+			select from StmtTypes where i2 < 0
+		}!
+		assert rows.len == 1
+		assert rows[0].i2 == -32768
+		assert rows[0].i4 == -2_000_000_000
+		assert rows[0].i8 == -(i64(1) << 62)
+		assert rows[0].f4 == 1.5
+		assert rows[0].f8 == -0.1
+		assert rows[0].at == at
+		assert rows[0].uid == '123e4567-e89b-12d3-a456-426614174000'
+	}
+	check()!
+	check()!
+
+	// the statements of the cache are gone from the server (26000), and prepared again
+	db.exec('DEALLOCATE ALL')!
+	check()!
+	// the type of a column changed (0A000, cached plan must not change result type)
+	db.exec('ALTER TABLE stmt_types ALTER COLUMN uid TYPE text')!
+	check()!
+}
+
+fn test_orm_ddl_keeps_the_statements_of_the_user() {
+	$if !network ? {
+		eprintln('> Skipping test ${@FN}, since `-d network` is not passed.')
+		eprintln('> This test requires a working postgres server running on localhost.')
+		return
+	}
+	db := pg.connect(pg.Config{ user: 'postgres', password: 'secret', dbname: 'postgres' })!
+	defer {
+		db.close()
+	}
+
+	db.exec('PREPARE user_stmt AS SELECT 7')!
+	sql db {
+		create table StmtTypes
+	}!
+	_ := sql db {
+		select from StmtTypes
+	}!
+	sql db {
+		drop table StmtTypes
+	}!
+	assert db.q_int('EXECUTE user_stmt')! == 7
+}
+
+fn test_stmt_cache_evicts_the_least_recently_used_statement() {
+	$if !network ? {
+		eprintln('> Skipping test ${@FN}, since `-d network` is not passed.')
+		eprintln('> This test requires a working postgres server running on localhost.')
+		return
+	}
+	db := pg.connect(pg.Config{ user: 'postgres', password: 'secret', dbname: 'postgres' })!
+	defer {
+		db.close()
+	}
+
+	sql db {
+		create table StmtTypes
+	}!
+	defer {
+		sql db {
+			drop table StmtTypes
+		} or {}
+	}
+	db.set_stmt_cache_size(2)
+	nr_prepared := "SELECT count(*) FROM pg_prepared_statements WHERE name LIKE 'v_orm_%'"
+	for _ in 0 .. 3 {
+		a := sql db {
+			select from StmtTypes where i2 < 0
+		}!
+		b := sql db {
+			select from StmtTypes where i4 < 0
+		}!
+		c := sql db {
+			select from StmtTypes where i8 < 0
+		}!
+		assert a.len + b.len + c.len == 0
+		assert db.q_int(nr_prepared)! == 2
+	}
+	db.set_stmt_cache_size(0)
+	assert db.q_int(nr_prepared)! == 0
+	_ := sql db {
+		select from StmtTypes where i2 < 0
+	}!
+	assert db.q_int(nr_prepared)! == 0
+}
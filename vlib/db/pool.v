@@ -0,0 +1,450 @@
+module db
+
+import orm
+import runtime
+import sync
+import time
+
+// PoolConfig configures a Pool of the connections of type `T`, e.g. `pg.DB`, `mysql.DB` or
+// `sqlite.DB`. Since the drivers close, and check their connections in different ways, the
+// functions for that are part of the configuration.
+pub struct PoolConfig[T] {
+pub:
+	connect fn () !T            @[required] // opens a new connection
+	close   fn (mut conn T)      = unsafe { nil } // closes a connection, that the pool no longer keeps
+	ping    fn (mut conn T) bool = unsafe { nil } // returns false, when a connection is no longer usable
+	// the connections, that the pool keeps open, even when they are idle
+	min_conns int = 1
+	// the maximum number of connections at once; `acquire` waits for one to be released, when all are in use
+	max_conns int = 10
+	// the idle connections are closed after that, as long as there are more than `min_conns`
+	idle_timeout time.Duration = 5 * time.minute
+	// the connections are closed after that, even when they are used; 0 means no limit
+	max_lifetime time.Duration
+	// how long `acquire` waits for a connection, when all `max_conns` are in use
+	acquire_timeout time.Duration = 5 * time.second
+	// the connections idle for longer are checked with `ping`, before they are handed out again
+	health_check_after time.Duration = 30 * time.second
+	// how often the idle connections are closed, or opened up to `min_conns`, in the background
+	maintenance_interval time.Duration = 30 * time.second
+	// the number of the lists of idle connections; 0 means one per CPU
+	shards int
+}
+
+// Pool shares up to `max_conns` connections between threads, e.g. the workers of a veb app.
+// A connection is taken with `acquire`, and given back with `release`.
+// The idle connections are kept in several lists (shards), and each thread takes from, and gives
+// back to, its own one first, so that the threads do not wait on a single lock, and usually get
+// the connection, that they used last, back.
+// A Pool implements `orm.Connection` too: each query takes a connection for its duration.
+// Example:
+// ```v ignore
+// mut pool := db.new_pool(db.PoolConfig[pg.DB]{
+// 	connect: fn () !pg.DB {
+// 		return pg.connect(user: 'postgres', dbname: 'app')
+// 	}
+// 	close:   fn (mut conn pg.DB) {
+// 		conn.close()
+// 	}
+// 	max_conns: 20
+// })!
+// users := sql pool {
+// 	select from User where age > 18
+// }!
+// mut pc := pool.acquire()!
+// defer {
+// 	pool.release(pc)
+// }
+// rows := pc.conn.exec('select 1')!
+// ```
+@[heap]
+pub struct Pool[T] {
+	config PoolConfig[T]
+mut:
+	mu       &sync.Mutex     = sync.new_mutex()
+	slots    &sync.Semaphore = unsafe { nil } // one for each connection, that can still be taken
+	shards   []&PoolShard[T]
+	stats    PoolStats
+	last_ids map[u64]int // the id of the last insert through the pool, by each thread
+	closed   bool        // guarded by `mu`, see `is_closed`
+}
+
+// PoolStats are the metrics of a Pool
+pub struct PoolStats {
+pub mut:
+	open      int           // the connections currently open
+	idle      int           // the connections currently idle in the pool
+	in_use    int           // the connections currently taken with `acquire`
+	waiting   int           // the threads currently waiting for a connection, because all are in use
+	acquires  u64           // the connections taken with `acquire`
+	waits     u64           // the acquires, that had to wait for a connection
+	timeouts  u64           // the acquires, that failed after `acquire_timeout`
+	wait_time time.Duration // the total time, that acquires have waited
+	max_wait  time.Duration // the longest time, that an acquire has waited
+	created   u64           // the connections opened
+	closed    u64           // the connections closed, because they were idle too long, too old, failed a health check, or were discarded
+}
+
+@[heap]
+struct PoolShard[T] {
+mut:
+	mu   &sync.Mutex = sync.new_mutex()
+	idle []&PooledConn[T] // the most recently used one last
+}
+
+// PooledConn is a connection taken from a Pool
+@[heap]
+pub struct PooledConn[T] {
+pub mut:
+	conn T
+mut:
+	created   time.Time
+	last_used time.Time
+}
+
+// new_pool creates a Pool, and opens its first `min_conns` connections
+pub fn new_pool[T](config PoolConfig[T]) !&Pool[T] {
+	if config.max_conns < 1 || config.min_conns > config.max_conns {
+		return error('db: invalid pool size, min_conns: ${config.min_conns}, max_conns: ${config.max_conns}')
+	}
+	nr_shards := if config.shards > 0 { config.shards } else { runtime.nr_cpus() }
+	mut p := &Pool[T]{
+		config: config
+		slots:  sync.new_semaphore_init(u32(config.max_conns))
+	}
+	for _ in 0 .. nr_shards {
+		p.shards << &PoolShard[T]{}
+	}
+	p.fill()!
+	if config.maintenance_interval > 0 {
+		spawn p.maintain()
+	}
+	return p
+}
+
+// acquire takes an idle connection from the pool, or opens a new one. When all `max_conns` are in
+// use, it waits up to `acquire_timeout` for one to be released. The connection has to be given
+// back with `release`, or with `discard`, when it is broken.
+pub fn (mut p Pool[T]) acquire() !&PooledConn[T] {
+	if p.is_closed() {
+		return error('db: the pool is closed')
+	}
+	if !p.slots.try_wait() {
+		p.mu.@lock()
+		p.stats.waiting++
+		p.mu.unlock()
+		started := time.now()
+		ok := p.slots.timed_wait(p.config.acquire_timeout)
+		waited := time.since(started)
+		p.mu.@lock()
+		p.stats.waiting--
+		p.stats.waits++
+		p.stats.wait_time += waited
+		if waited > p.stats.max_wait {
+			p.stats.max_wait = waited
+		}
+		if !ok {
+			p.stats.timeouts++
+		}
+		p.mu.unlock()
+		if !ok {
+			return error('db: no connection was released within ${p.config.acquire_timeout}, all ${p.config.max_conns} are in use')
+		}
+	}
+	home := p.home_shard()
+	for i in 0 .. p.shards.len {
+		mut pc := p.take_idle((home + i) % p.shards.len) or { continue }
+		if p.usable(mut pc) {
+			p.mu.@lock()
+			p.stats.idle--
+			p.stats.in_use++
+			p.stats.acquires++
+			p.mu.unlock()
+			return pc
+		}
+		p.mu.@lock()
+		p.stats.idle--
+		p.mu.unlock()
+		p.destroy(mut pc)
+	}
+	pc := p.open() or {
+		p.slots.post()
+		return err
+	}
+	p.mu.@lock()
+	p.stats.in_use++
+	p.stats.acquires++
+	p.mu.unlock()
+	return pc
+}
+
+// release gives a connection from `acquire` back to the pool, for the next `acquire` to reuse it
+pub fn (mut p Pool[T]) release(pc &PooledConn[T]) {
+	mut c := unsafe { pc }
+	c.last_used = time.now()
+	mut shard := p.shards[p.home_shard()]
+	// checked under the lock of the shard, so that `close` either sees the connection, or it is not added
+	shard.mu.@lock()
+	closed := p.is_closed()
+	if !closed {
+		shard.idle << c
+	}
+	shard.mu.unlock()
+	if closed {
+		p.mu.@lock()
+		p.stats.in_use--
+		p.mu.unlock()
+		p.destroy(mut c)
+		p.slots.post()
+		return
+	}
+	p.mu.@lock()
+	p.stats.in_use--
+	p.stats.idle++
+	p.mu.unlock()
+	// only after the connection is idle, so that the waiting `acquire` finds it
+	p.slots.post()
+}
+
+// discard closes a connection from `acquire`, instead of giving it back, e.g. because it failed
+pub fn (mut p Pool[T]) discard(pc &PooledConn[T]) {
+	mut c := unsafe { pc }
+	p.mu.@lock()
+	p.stats.in_use--
+	p.mu.unlock()
+	p.destroy(mut c)
+	p.slots.post()
+}
+
+// stats returns the current metrics of the pool
+pub fn (mut p Pool[T]) stats() PoolStats {
+	p.mu.@lock()
+	s := p.stats
+	p.mu.unlock()
+	return s
+}
+
+// close closes all the idle connections. The connections in use are closed, when they are released.
+pub fn (mut p Pool[T]) close() {
+	p.mu.@lock()
+	p.closed = true
+	p.mu.unlock()
+	for mut shard in p.shards {
+		shard.mu.@lock()
+		mut conns := shard.idle.clone()
+		shard.idle.clear()
+		shard.mu.unlock()
+		for mut pc in conns {
+			p.mu.@lock()
+			p.stats.idle--
+			p.mu.unlock()
+			p.destroy(mut pc)
+		}
+	}
+}
+
+// is_closed returns true, after `close` was called
+fn (mut p Pool[T]) is_closed() bool {
+	p.mu.@lock()
+	closed := p.closed
+	p.mu.unlock()
+	return closed
+}
+
+// home_shard returns the list of idle connections of the current thread
+@[inline]
+fn (p &Pool[T]) home_shard() int {
+	return int(sync.thread_id() % u64(p.shards.len))
+}
+
+fn (mut p Pool[T]) take_idle(idx int) ?&PooledConn[T] {
+	mut shard := p.shards[idx]
+	shard.mu.@lock()
+	defer {
+		shard.mu.unlock()
+	}
+	if shard.idle.len == 0 {
+		return none
+	}
+	return shard.idle.pop()
+}
+
+// usable returns false, when an idle connection is too old, or fails its health check
+fn (mut p Pool[T]) usable(mut pc PooledConn[T]) bool {
+	if p.config.max_lifetime > 0 && time.since(pc.created) > p.config.max_lifetime {
+		return false
+	}
+	if p.config.ping != unsafe { nil } && time.since(pc.last_used) > p.config.health_check_after {
+		return p.config.ping(mut pc.conn)
+	}
+	return true
+}
+
+fn (mut p Pool[T]) open() !&PooledConn[T] {
+	conn := p.config.connect()!
+	now := time.now()
+	p.mu.@lock()
+	p.stats.open++
+	p.stats.created++
+	p.mu.unlock()
+	return &PooledConn[T]{
+		conn:      conn
+		created:   now
+		last_used: now
+	}
+}
+
+fn (mut p Pool[T]) destroy(mut pc PooledConn[T]) {
+	if p.config.close != unsafe { nil } {
+		p.config.close(mut pc.conn)
+	}
+	p.mu.@lock()
+	p.stats.open--
+	p.stats.closed++
+	p.mu.unlock()
+}
+
+// fill opens idle connections, till there are `min_conns` open. Each one takes a slot while it is
+// opened, so that `max_conns` is never exceeded.
+fn (mut p Pool[T]) fill() ! {
+	for p.stats().open < p.config.min_conns && !p.is_closed() {
+		if !p.slots.try_wait() {
+			return
+		}
+		pc := p.open() or {
+			p.slots.post()
+			return err
+		}
+		p.mu.@lock()
+		p.stats.in_use++
+		p.mu.unlock()
+		p.release(pc)
+	}
+}
+
+// maintain closes the connections idle for longer than `idle_timeout`, or older than
+// `max_lifetime`, and opens new ones up to `min_conns`, every `maintenance_interval`
+fn (mut p Pool[T]) maintain() {
+	for !p.is_closed() {
+		time.sleep(p.config.maintenance_interval)
+		if p.is_closed() {
+			return
+		}
+		for mut shard in p.shards {
+			mut expired := []&PooledConn[T]{}
+			shard.mu.@lock()
+			// the least recently used connections are first
+			for shard.idle.len > 0 {
+				pc := shard.idle[0]
+				too_old := p.config.max_lifetime > 0
+					&& time.since(pc.created) > p.config.max_lifetime
+				idle_too_long := p.config.idle_timeout > 0
+					&& time.since(pc.last_used) > p.config.idle_timeout
+				if !too_old && !(idle_too_long && p.stats().open - expired.len > p.config.min_conns) {
+					break
+				}
+				expired << shard.idle[0]
+				shard.idle.delete(0)
+			}
+			shard.mu.unlock()
+			for mut pc in expired {
+				p.mu.@lock()
+				p.stats.idle--
+				p.mu.unlock()
+				p.destroy(mut pc)
+			}
+		}
+		p.fill() or {}
+	}
+}
+
+// last_id returns the id of the last row, inserted through the pool by the current thread
+pub fn (p &Pool[T]) last_id() int {
+	mut pool := unsafe { p }
+	tid := sync.thread_id()
+	pool.mu.@lock()
+	id := pool.last_ids[tid] or { 0 }
+	pool.mu.unlock()
+	return id
+}
+
+// @select is used internally by V's ORM for processing `SELECT` queries
+pub fn (p &Pool[T]) @select(config orm.SelectConfig, data orm.QueryData, where orm.QueryData) ![][]orm.Primitive {
+	mut pool := unsafe { p }
+	pc := pool.acquire()!
+	defer {
+		pool.release(pc)
+	}
+	return pc.conn.@select(config, data, where)
+}
+
+// insert is used internally by V's ORM for processing `INSERT` queries
+pub fn (p &Pool[T]) insert(table string, data orm.QueryData) ! {
+	mut pool := unsafe { p }
+	pc := pool.acquire()!
+	defer {
+		pool.release(pc)
+	}
+	pc.conn.insert(table, data)!
+	id := pc.conn.last_id()
+	tid := sync.thread_id()
+	pool.mu.@lock()
+	pool.last_ids[tid] = id
+	pool.mu.unlock()
+}
+
+// insert_batch is used internally by V's ORM for processing `insert xs into Table`. The rows are
+// inserted with the `insert_batch` of the connection, when it implements `orm.BatchConnection`.
+pub fn (p &Pool[T]) insert_batch(table string, data orm.BatchData) ! {
+	mut pool := unsafe { p }
+	pc := pool.acquire()!
+	defer {
+		pool.release(pc)
+	}
+	orm.insert_batch(pc.conn, table, data)!
+	id := pc.conn.last_id()
+	tid := sync.thread_id()
+	pool.mu.@lock()
+	pool.last_ids[tid] = id
+	pool.mu.unlock()
+}
+
+// update is used internally by V's ORM for processing `UPDATE` queries
+pub fn (p &Pool[T]) update(table string, data orm.QueryData, where orm.QueryData) ! {
+	mut pool := unsafe { p }
+	pc := pool.acquire()!
+	defer {
+		pool.release(pc)
+	}
+	pc.conn.update(table, data, where)!
+}
+
+// delete is used internally by V's ORM for processing `DELETE` queries
+pub fn (p &Pool[T]) delete(table string, where orm.QueryData) ! {
+	mut pool := unsafe { p }
+	pc := pool.acquire()!
+	defer {
+		pool.release(pc)
+	}
+	pc.conn.delete(table, where)!
+}
+
+// create is used internally by V's ORM for processing table creation queries (DDL)
+pub fn (p &Pool[T]) create(table string, fields []orm.TableField) ! {
+	mut pool := unsafe { p }
+	pc := pool.acquire()!
+	defer {
+		pool.release(pc)
+	}
+	pc.conn.create(table, fields)!
+}
+
+// drop is used internally by V's ORM for processing table destroying queries (DDL)
+pub fn (p &Pool[T]) drop(table string) ! {
+	mut pool := unsafe { p }
+	pc := pool.acquire()!
+	defer {
+		pool.release(pc)
+	}
+	pc.conn.drop(table)!
+}
@@ -0,0 +1,154 @@
+import db
+import orm
+import time
+
+struct FakeConn {
+	id      int
+	counter &Counter = unsafe { nil }
+mut:
+	alive bool = true
+}
+
+fn (c FakeConn) @select(config orm.SelectConfig, data orm.QueryData, where orm.QueryData) ![][]orm.Primitive {
+	return [[orm.Primitive(c.id)]]
+}
+
+fn (c FakeConn) insert(table string, data orm.QueryData) ! {}
+
+fn (c FakeConn) insert_batch(table string, data orm.BatchData) ! {
+	mut counter := unsafe { c.counter }
+	counter.batch_rows += data.rows.len
+}
+
+fn (c FakeConn) update(table string, data orm.QueryData, where orm.QueryData) ! {}
+
+fn (c FakeConn) delete(table string, where orm.QueryData) ! {}
+
+fn (c FakeConn) create(table string, fields []orm.TableField) ! {}
+
+fn (c FakeConn) drop(table string) ! {}
+
+fn (c FakeConn) last_id() int {
+	return c.id
+}
+
+@[heap]
+struct Counter {
+mut:
+	opened     int
+	closed     int
+	batch_rows int
+}
+
+fn new_fake_pool(mut counter Counter, max_conns int, acquire_timeout time.Duration) !&db.Pool[FakeConn] {
+	return db.new_pool(db.PoolConfig[FakeConn]{
+		connect:              fn [mut counter] () !FakeConn {
+			counter.opened++
+			return FakeConn{
+				id:      counter.opened
+				counter: counter
+			}
+		}
+		close:                fn [mut counter] (mut conn FakeConn) {
+			counter.closed++
+		}
+		ping:                 fn (mut conn FakeConn) bool {
+			return conn.alive
+		}
+		min_conns:            1
+		max_conns:            max_conns
+		acquire_timeout:      acquire_timeout
+		health_check_after:   0
+		maintenance_interval: 0
+		shards:               2
+	})
+}
+
+fn test_pool_reuses_connections() {
+	mut counter := &Counter{}
+	mut pool := new_fake_pool(mut counter, 2, 50 * time.millisecond)!
+	assert counter.opened == 1
+	assert pool.stats().idle == 1
+
+	pc := pool.acquire()!
+	assert pc.conn.id == 1
+	pool.release(pc)
+	again := pool.acquire()!
+	assert again.conn.id == 1
+	assert counter.opened == 1
+	second := pool.acquire()!
+	assert second.conn.id == 2
+	stats := pool.stats()
+	assert stats.in_use == 2
+	assert stats.open == 2
+	assert stats.acquires == 3
+
+	// both connections are in use => the next acquire times out
+	if _ := pool.acquire() {
+		assert false
+	}
+	assert pool.stats().timeouts == 1
+	pool.release(again)
+	pool.release(second)
+	assert pool.stats().idle == 2
+	pool.close()
+	assert counter.closed == 2
+	if _ := pool.acquire() {
+		assert false
+	}
+}
+
+fn test_pool_health_check_and_discard() {
+	mut counter := &Counter{}
+	mut pool := new_fake_pool(mut counter, 3, 50 * time.millisecond)!
+	mut pc := pool.acquire()!
+	pc.conn.alive = false
+	pool.release(pc)
+	// the broken connection fails its ping, and is replaced
+	fresh := pool.acquire()!
+	assert fresh.conn.id == 2
+	assert counter.closed == 1
+	pool.discard(fresh)
+	assert counter.closed == 2
+	assert pool.stats().open == 0
+	pool.close()
+}
+
+fn test_pool_as_orm_connection() {
+	mut counter := &Counter{}
+	pool := new_fake_pool(mut counter, 2, 50 * time.millisecond)!
+	conn := orm.Connection(pool)
+	rows := conn.@select(orm.SelectConfig{}, orm.QueryData{}, orm.QueryData{})!
+	assert rows == [[orm.Primitive(1)]]
+	conn.insert('users', orm.QueryData{})!
+	assert conn.last_id() == 1
+	// the rows go to the insert_batch of the connection, in a single call
+	orm.insert_batch(conn, 'users', orm.BatchData{
+		fields: ['id']
+		rows:   [[orm.Primitive(1)], [orm.Primitive(2)]]
+	})!
+	assert counter.batch_rows == 2
+	mut p := pool
+	assert p.stats().in_use == 0
+	p.close()
+}
+
+fn test_pool_threads() {
+	mut counter := &Counter{}
+	mut pool := new_fake_pool(mut counter, 4, 10 * time.second)!
+	mut threads := []thread{}
+	for _ in 0 .. 8 {
+		threads << spawn fn (mut pool db.Pool[FakeConn]) {
+			for _ in 0 .. 100 {
+				pc := pool.acquire() or { panic(err) }
+				pool.release(pc)
+			}
+		}(mut pool)
+	}
+	threads.wait()
+	stats := pool.stats()
+	assert stats.acquires == 800
+	assert stats.in_use == 0
+	assert stats.open <= 4
+	pool.close()
+}
@@ -10,9 +10,9 @@ pub fn (db DB) @select(config orm.SelectConfig, data orm.QueryData, where orm.Qu
 	$if trace_sqlite ? {
 		eprintln('> @select query: "${query}"')
 	}
-	stmt := db.new_init_stmt(query)!
+	stmt := db.acquire_stmt(query)!
 	defer {
-		stmt.finalize()
+		stmt.release()
 	}
 	mut c := 1
 	sqlite_stmt_binder(stmt, where, query, mut c)!
@@ -58,6 +58,43 @@ pub fn (db DB) insert(table string, data orm.QueryData) ! {
 	sqlite_stmt_worker(db, query, converted_data, orm.QueryData{})!
 }
 
+// insert_batch is used internally by V's ORM for processing `insert xs into Table`. The rows are
+// inserted with multi-row VALUES, `batch_size` rows per statement, in a single transaction, unless
+// one is already open.
+pub fn (db DB) insert_batch(table string, data orm.BatchData) ! {
+	// the statements can not have more parameters than SQLite allows
+	max_params := C.sqlite3_limit(db.conn, C.SQLITE_LIMIT_VARIABLE_NUMBER, -1)
+	max_rows := if db.batch_size > 0 { db.batch_size } else { orm.default_batch_size }
+	own_transaction := C.sqlite3_get_autocommit(db.conn) != 0
+	if own_transaction {
+		db.exec('BEGIN')!
+	}
+	for group in data.groups(max_rows) {
+		mut rows := group.rows.len
+		if group.fields.len > 0 && rows * group.fields.len > max_params {
+			rows = max_params / group.fields.len
+		}
+		for start := 0; start < group.rows.len; start += rows {
+			end := if start + rows < group.rows.len { start + rows } else { group.rows.len }
+			query := orm.orm_batch_insert_gen(.sqlite, table, '`', group.fields, end - start,
+				true, '?', 1)
+			mut values := []orm.Primitive{cap: (end - start) * group.fields.len}
+			for row in group.rows[start..end] {
+				values << row
+			}
+			sqlite_stmt_worker(db, query, orm.QueryData{ data: values }, orm.QueryData{}) or {
+				if own_transaction {
+					db.exec('ROLLBACK') or {}
+				}
+				return err
+			}
+		}
+	}
+	if own_transaction {
+		db.exec('COMMIT')!
+	}
+}
+
 // update is used internally by V's ORM for processing `UPDATE ` queries
 pub fn (db DB) update(table string, data orm.QueryData, where orm.QueryData) ! {
 	query, _ := orm.orm_stmt_gen(.sqlite, table, '`', .update, true, '?', 1, data, where)
@@ -101,9 +138,9 @@ fn sqlite_stmt_worker(db DB, query string, data orm.QueryData, where orm.QueryDa
 	$if trace_sqlite ? {
 		eprintln('> sqlite_stmt_worker query: "${query}"')
 	}
-	stmt := db.new_init_stmt(query)!
+	stmt := db.acquire_stmt(query)!
 	defer {
-		stmt.finalize()
+		stmt.release()
 	}
 	mut c := 1
 	sqlite_stmt_binder(stmt, data, query, mut c)!
@@ -60,6 +60,8 @@ pub struct C.sqlite3_stmt {
 pub struct Stmt {
 	stmt &C.sqlite3_stmt = unsafe { nil }
 	db   &DB             = unsafe { nil }
+	// set, when the statement comes from the statement cache of `db`, see `acquire_stmt`
+	cached &CachedStmt = unsafe { nil }
 }
 
 struct SQLError {
@@ -71,8 +73,11 @@ struct SQLError {
 pub struct DB {
 pub mut:
 	is_open bool
+	// the rows, that `insert xs into Table` sends in a single INSERT, at most; 0 means `orm.default_batch_size`
+	batch_size int
 mut:
-	conn &C.sqlite3 = unsafe { nil }
+	conn       &C.sqlite3 = unsafe { nil }
+	stmt_cache &StmtCache = unsafe { nil }
 }
 
 // str returns a text representation of the DB
@@ -101,6 +106,10 @@ fn C.sqlite3_step(&C.sqlite3_stmt) int
 
 fn C.sqlite3_finalize(&C.sqlite3_stmt) int
 
+fn C.sqlite3_reset(&C.sqlite3_stmt) int
+
+fn C.sqlite3_clear_bindings(&C.sqlite3_stmt) int
+
 //
 fn C.sqlite3_column_name(&C.sqlite3_stmt, int) &char
 
@@ -114,6 +123,12 @@ fn C.sqlite3_column_double(&C.sqlite3_stmt, int) f64
 
 fn C.sqlite3_column_count(&C.sqlite3_stmt) int
 
+fn C.sqlite3_get_autocommit(&C.sqlite3) int
+
+fn C.sqlite3_limit(&C.sqlite3, int, int) int
+
+fn C.sqlite3_column_bytes(&C.sqlite3_stmt, int) int
+
 fn C.sqlite3_column_type(&C.sqlite3_stmt, int) int
 
 //
@@ -136,8 +151,9 @@ pub fn connect(path string) !DB {
 		}
 	}
 	return DB{
-		conn:    db
-		is_open: true
+		conn:       db
+		is_open:    true
+		stmt_cache: &StmtCache{}
 	}
 }
 
@@ -145,6 +161,7 @@ pub fn connect(path string) !DB {
 // TODO: For all functions, determine whether the connection is
 // closed first, and determine what to do if it is
 pub fn (mut db DB) close() !bool {
+	db.clear_stmt_cache()
 	code := C.sqlite3_close(db.conn)
 	if code == 0 {
 		db.is_open = false
@@ -292,18 +309,14 @@ pub fn (db &DB) exec_none(query string) int {
 // exec_param_many executes a query with parameters provided as ?,
 // and returns either an error on failure, or the full result set on success
 pub fn (db &DB) exec_param_many(query string, params []string) ![]Row {
-	mut stmt := &C.sqlite3_stmt(unsafe { nil })
+	cached := db.acquire_stmt(query)!
 	defer {
-		C.sqlite3_finalize(stmt)
-	}
-
-	mut code := C.sqlite3_prepare_v2(db.conn, &char(query.str), -1, &stmt, 0)
-	if code != 0 {
-		return db.error_message(code, query)
+		cached.release()
 	}
+	stmt := cached.stmt
 
 	for i, param in params {
-		code = C.sqlite3_bind_text(stmt, i + 1, voidptr(param.str), param.len, 0)
+		code := C.sqlite3_bind_text(stmt, i + 1, voidptr(param.str), param.len, 0)
 		if code != 0 {
 			return db.error_message(code, query)
 		}
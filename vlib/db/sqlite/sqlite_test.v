@@ -114,3 +114,85 @@ fn test_exec_param_many() {
 	}
 	assert false
 }
+
+fn test_query_rows_and_stmt_cache() {
+	$if !linux {
+		return
+	}
+	mut db := sqlite.connect(':memory:') or { panic(err) }
+	db.exec('create table users (id integer primary key, name text, score real);')!
+	for i in 1 .. 6 {
+		db.exec_param_many('insert into users (id, name, score) values (?, ?, ?)', [
+			'${i}',
+			'user ${i}',
+			'${i}.5',
+		])!
+	}
+	db.exec('insert into users (id) values (6)')!
+	for _ in 0 .. 3 {
+		mut rows := db.query('select id, name, score from users where id > ? order by id',
+			2)!
+		mut ids := []int{}
+		for row in rows {
+			assert row.column_count() == 3
+			id := row.int(0)
+			ids << id
+			if id == 6 {
+				assert row.is_null(1)
+				assert row.text(1) == ''
+			} else {
+				assert row.text(1) == 'user ${id}'
+				assert row.f64(2) == f64(id) + 0.5
+				assert row.i64(0) == i64(id)
+			}
+		}
+		rows.check()!
+		assert ids == [3, 4, 5, 6]
+	}
+	// a statement that is still stepped through is not handed out again
+	mut first := db.query('select name from users where id = ?', 1)!
+	mut second := db.query('select name from users where id = ?', 2)!
+	assert first.next()?.text(0) == 'user 1'
+	assert second.next()?.text(0) == 'user 2'
+	first.close()
+	second.close()
+
+	if _ := db.query('select id from missing') {
+		assert false
+	}
+	db.set_stmt_cache_size(0)
+	mut rows := db.query('select count(*) from users')!
+	assert rows.next()?.int(0) == 6
+	rows.close()
+	db.close()!
+}
+
+fn count_users_concurrently(db sqlite.DB, n int) int {
+	mut total := 0
+	for i in 0 .. n {
+		mut rows := db.query('select count(*) from users where id > ?', i % 3) or { panic(err) }
+		total += rows.next() or { panic('no row') }.int(0)
+		rows.close()
+	}
+	return total
+}
+
+fn test_stmt_cache_shared_by_threads() {
+	$if !linux {
+		return
+	}
+	mut db := sqlite.connect(':memory:') or { panic(err) }
+	db.exec('create table users (id integer primary key);')!
+	for i in 1 .. 4 {
+		db.exec_param_many('insert into users (id) values (?)', ['${i}'])!
+	}
+	// the copies of db share its statement cache
+	mut threads := []thread int{}
+	for _ in 0 .. 8 {
+		threads << spawn count_users_concurrently(db, 300)
+	}
+	for total in threads.wait() {
+		assert total == 100 * (3 + 2 + 1)
+	}
+	db.close()!
+}
@@ -1,5 +1,8 @@
 module sqlite
 
+import orm
+import sync
+
 fn C.sqlite3_bind_null(&C.sqlite3_stmt, int) int
 fn C.sqlite3_bind_double(&C.sqlite3_stmt, int, f64) int
 fn C.sqlite3_bind_int(&C.sqlite3_stmt, int, int) int
@@ -19,7 +22,10 @@ fn (db &DB) new_init_stmt(query string) !Stmt {
 	if err != sqlite_ok {
 		return db.error_message(err, query)
 	}
-	return Stmt{stmt, db}
+	return Stmt{
+		stmt: stmt
+		db:   db
+	}
 }
 
 fn (stmt &Stmt) bind_null(idx int) int {
@@ -70,11 +76,11 @@ fn (stmt &Stmt) get_text(idx int) ?string {
 	if C.sqlite3_column_type(stmt.stmt, idx) == C.SQLITE_NULL {
 		return none
 	} else {
-		b := &char(C.sqlite3_column_text(stmt.stmt, idx))
-		if b == &char(0) {
+		b := C.sqlite3_column_text(stmt.stmt, idx)
+		if b == &u8(0) {
 			return ''
 		}
-		return unsafe { b.vstring() }
+		return unsafe { tos(b, C.sqlite3_column_bytes(stmt.stmt, idx)) }
 	}
 }
 
@@ -96,3 +102,258 @@ fn (stmt &Stmt) orm_step(query string) ! {
 fn (stmt &Stmt) finalize() {
 	C.sqlite3_finalize(stmt.stmt)
 }
+
+// the number of the prepared statements, that a DB keeps for reuse, unless it is changed with
+// `set_stmt_cache_size`
+pub const default_stmt_cache_size = 64
+
+// StmtCache keeps the statements prepared for the queries of a DB, so that running the same query
+// again only resets the statement, instead of compiling the SQL again. When it is full, the
+// statement used least recently is finalized.
+// The copies of a DB share its cache, and may be used by several threads at once (SQLite's
+// serialized mode), so the entries and their `in_use` flags are only used with `mu` locked.
+@[heap]
+struct StmtCache {
+mut:
+	mu      &sync.Mutex = sync.new_mutex()
+	size    int = default_stmt_cache_size
+	entries map[string]&CachedStmt
+	tick    u64
+}
+
+@[heap]
+struct CachedStmt {
+	cache &StmtCache = unsafe { nil }
+mut:
+	stmt      &C.sqlite3_stmt = unsafe { nil }
+	last_used u64
+	// a statement that is still stepped through, e.g. by `Rows`, is not handed out again
+	in_use bool
+}
+
+// acquire_stmt returns a prepared statement for `query`, from the statement cache of `db`, when it
+// has an unused one; `release` has to be called, once the statement is no longer needed
+fn (db &DB) acquire_stmt(query string) !Stmt {
+	if db.stmt_cache == unsafe { nil } {
+		return db.new_init_stmt(query)
+	}
+	mut cache := unsafe { db.stmt_cache }
+	cache.mu.@lock()
+	defer {
+		cache.mu.unlock()
+	}
+	if cache.size <= 0 {
+		return db.new_init_stmt(query)
+	}
+	cache.tick++
+	if cached := cache.entries[query] {
+		if !cached.in_use {
+			mut entry := unsafe { cached }
+			entry.in_use = true
+			entry.last_used = cache.tick
+			return Stmt{
+				stmt:   entry.stmt
+				db:     db
+				cached: entry
+			}
+		}
+		// the cached statement is busy: this use gets a statement of its own
+		return db.new_init_stmt(query)
+	}
+
+	stmt := db.new_init_stmt(query)!
+	if cache.entries.len >= cache.size && !cache.evict() {
+		return stmt
+	}
+	entry := &CachedStmt{
+		cache:     cache
+		stmt:      stmt.stmt
+		last_used: cache.tick
+		in_use:    true
+	}
+	cache.entries[query] = entry
+	return Stmt{
+		stmt:   stmt.stmt
+		db:     db
+		cached: entry
+	}
+}
+
+// release resets a statement from `acquire_stmt`, and clears its bindings, for its next use, or
+// finalizes it, when it is not cached
+fn (stmt &Stmt) release() {
+	if stmt.cached == unsafe { nil } {
+		stmt.finalize()
+		return
+	}
+	C.sqlite3_reset(stmt.stmt)
+	C.sqlite3_clear_bindings(stmt.stmt)
+	mut entry := unsafe { stmt.cached }
+	mut cache := unsafe { entry.cache }
+	cache.mu.@lock()
+	entry.in_use = false
+	cache.mu.unlock()
+}
+
+// evict finalizes the statement used least recently, that is not in use. It returns false, when
+// all the statements are in use. It is called with `cache.mu` locked.
+fn (mut cache StmtCache) evict() bool {
+	mut oldest := ''
+	mut oldest_tick := u64(0)
+	for query, entry in cache.entries {
+		if !entry.in_use && (oldest == '' || entry.last_used < oldest_tick) {
+			oldest = query
+			oldest_tick = entry.last_used
+		}
+	}
+	if oldest == '' {
+		return false
+	}
+	entry := cache.entries[oldest] or { return false }
+	C.sqlite3_finalize(entry.stmt)
+	cache.entries.delete(oldest)
+	return true
+}
+
+// clear_stmt_cache finalizes all the cached statements
+fn (db &DB) clear_stmt_cache() {
+	if db.stmt_cache == unsafe { nil } {
+		return
+	}
+	mut cache := unsafe { db.stmt_cache }
+	cache.mu.@lock()
+	for _, entry in cache.entries {
+		C.sqlite3_finalize(entry.stmt)
+	}
+	cache.entries.clear()
+	cache.mu.unlock()
+}
+
+// set_stmt_cache_size sets the number of the prepared statements, that `db` keeps for reuse by
+// the ORM, `query` and `exec_param_many`. A size of 0 disables the cache.
+pub fn (db &DB) set_stmt_cache_size(size int) {
+	if db.stmt_cache == unsafe { nil } {
+		return
+	}
+	mut cache := unsafe { db.stmt_cache }
+	cache.mu.@lock()
+	cache.size = size
+	for cache.entries.len > size && cache.evict() {
+	}
+	cache.mu.unlock()
+}
+
+// Rows is a lazy iterator over the result of `DB.query`. Each row is stepped to, when `next` is
+// called, and its columns are read with the typed accessors of `RowView`, instead of being
+// converted to strings up front.
+pub struct Rows {
+	query string
+mut:
+	stmt      Stmt
+	done      bool
+	code      int
+	error_msg string
+}
+
+// RowView gives access to the columns of the current row of `Rows`. It is only valid till the
+// next call of `next`.
+pub struct RowView {
+	stmt &C.sqlite3_stmt = unsafe { nil }
+}
+
+// query runs `query`, with the parameters `params` bound to its `?` placeholders, and returns an
+// iterator over its rows. The statement is taken from the statement cache of `db`, and goes back
+// to it, once all the rows have been read, or `close` is called.
+// Example: mut rows := db.query('select id, name from users where age > ?', 18)!
+// for row in rows { println('${row.int(0)} ${row.text(1)}') }
+pub fn (db &DB) query(query string, params ...orm.Primitive) !Rows {
+	stmt := db.acquire_stmt(query)!
+	mut c := 1
+	sqlite_stmt_binder(stmt, orm.QueryData{ data: params }, query, mut c) or {
+		stmt.release()
+		return err
+	}
+	return Rows{
+		query: query
+		stmt:  stmt
+	}
+}
+
+// next steps to the next row. It returns none, after the last row, or on an error; see `check`.
+pub fn (mut rows Rows) next() ?RowView {
+	if rows.done {
+		return none
+	}
+	code := rows.stmt.step()
+	if code == sqlite_row {
+		return RowView{
+			stmt: rows.stmt.stmt
+		}
+	}
+	if code != sqlite_done {
+		rows.code = code
+		rows.error_msg = unsafe { cstring_to_vstring(&char(C.sqlite3_errmsg(rows.stmt.db.conn))) }
+	}
+	rows.close()
+	return none
+}
+
+// check returns an error, when `next` stopped, because stepping to the next row failed
+pub fn (rows &Rows) check() ! {
+	if rows.error_msg != '' {
+		return SQLError{
+			msg:  '${rows.error_msg} (${rows.code}) (${rows.query})'
+			code: rows.code
+		}
+	}
+}
+
+// close gives the statement back to the cache. It has to be called, when not all the rows are
+// read; it is done automatically otherwise.
+pub fn (mut rows Rows) close() {
+	if !rows.done {
+		rows.done = true
+		rows.stmt.release()
+	}
+}
+
+// column_count returns the number of the columns of the row
+pub fn (row RowView) column_count() int {
+	return C.sqlite3_column_count(row.stmt)
+}
+
+// is_null returns true, when the column `idx` is NULL
+pub fn (row RowView) is_null(idx int) bool {
+	return C.sqlite3_column_type(row.stmt, idx) == C.SQLITE_NULL
+}
+
+// int returns the column `idx` as an int; NULL is 0
+pub fn (row RowView) int(idx int) int {
+	return C.sqlite3_column_int(row.stmt, idx)
+}
+
+// i64 returns the column `idx` as an i64; NULL is 0
+pub fn (row RowView) i64(idx int) i64 {
+	return C.sqlite3_column_int64(row.stmt, idx)
+}
+
+// f64 returns the column `idx` as an f64; NULL is 0.0
+pub fn (row RowView) f64(idx int) f64 {
+	return C.sqlite3_column_double(row.stmt, idx)
+}
+
+// text returns a copy of the column `idx`, as a string; NULL is ''
+pub fn (row RowView) text(idx int) string {
+	return unsafe { row.text_view(idx) }.clone()
+}
+
+// text_view returns the column `idx`, as a string, that points into the memory of SQLite, without
+// copying it. It is only valid till the next call of `next`, or `close`.
+@[unsafe]
+pub fn (row RowView) text_view(idx int) string {
+	b := C.sqlite3_column_text(row.stmt, idx)
+	if b == &u8(0) {
+		return ''
+	}
+	return unsafe { tos(b, C.sqlite3_column_bytes(row.stmt, idx)) }
+}
@@ -0,0 +1,431 @@
+/*
+csv memory-mapped reader
+
+Use of this source code is governed by an MIT license
+that can be found in the LICENSE file.
+
+Known limitations:
+- the index keeps 8 bytes for every cell of the file, and 24 bytes for every row
+- at most max_int rows, and max_int cells in a row
+- the separator and the quote must be single bytes
+*/
+module csv
+
+import runtime
+
+/******************************************************************************
+*
+* Consts
+*
+******************************************************************************/
+// used by the SWAR scan, to test 8 bytes at once
+const swar_ones = u64(0x0101010101010101)
+const swar_highs = u64(0x8080808080808080)
+// the longest chunk of the file, whose marks fit in a V array
+const max_chunk_len = i64(max_int)
+
+/******************************************************************************
+*
+* Structs
+*
+******************************************************************************/
+@[params]
+pub struct MappedReaderConfig {
+pub:
+	file_path  string
+	separator  u8 = `,`
+	comment    u8 = `#` // every line that start with the comment char is ignored, 0 to disable
+	quote      u8 = `"` // double quote is the standard quote char
+	nr_threads int // threads used to build the index, 0 means one per CPU
+	// minimum size of the chunk indexed by each thread, smaller files use less threads
+	min_chunk_size i64 = 1024 * 1024
+}
+
+// MappedReader reads a csv file mapped in memory. The positions of all the cells are indexed when it
+// is created, in parallel chunks, and the cells are then returned as views on the mapped file,
+// without copying them.
+pub struct MappedReader {
+pub:
+	separator u8 = `,`
+	comment   u8 = `#`
+	quote     u8 = `"`
+mut:
+	file MappedFile
+	// the positions of the separators and of the end of lines (as `-(pos + 1)`) of each chunk, as
+	// returned by `scan_chunk`
+	marks [][]i64
+	rows  []MappedRowRef
+}
+
+// MappedRowRef is the index of a row: its first cell starts at `start`, and the positions that end
+// its cells (its separators, then its end of line) are `nr_fields` marks, from `marks[chunk][index]`,
+// going on in the next chunks if needed
+struct MappedRowRef {
+	start     i64
+	chunk     int
+	index     int
+	nr_fields int
+}
+
+// ScanState is the state of the scan of the file at a position
+enum ScanState {
+	field   // in a cell, outside of quotes
+	quoted  // in a quoted cell
+	comment // in a comment line
+}
+
+// ChunkSummary is the result of the first pass on a chunk: for each state (in the order of
+// `ScanState`) that the scan may be in at its start, the state at its end, and the number of
+// marks that `scan_chunk` will find in it, so that their array is allocated once, exactly
+struct ChunkSummary {
+	end_states []ScanState
+	nr_marks   []int
+}
+
+struct ScanConfig {
+	data      &u8 = unsafe { nil }
+	len       i64
+	separator u8
+	comment   u8
+	quote     u8
+}
+
+/******************************************************************************
+*
+* Init, dispose
+*
+******************************************************************************/
+// csv_mapped_reader maps a csv file in memory, and indexes all its cells
+pub fn csv_mapped_reader(cfg MappedReaderConfig) !&MappedReader {
+	mut mr := &MappedReader{
+		separator: cfg.separator
+		comment:   cfg.comment
+		quote:     cfg.quote
+		file:      map_file(cfg.file_path)!
+	}
+	nr_threads := if cfg.nr_threads > 0 { cfg.nr_threads } else { runtime.nr_jobs() }
+	mr.map_csv(nr_threads, cfg.min_chunk_size) or {
+		mr.dispose_csv_reader()
+		return err
+	}
+	return mr
+}
+
+// dispose_csv_reader unmaps the file. The strings returned by the reader must not be used after it.
+pub fn (mut mr MappedReader) dispose_csv_reader() {
+	mr.file.unmap()
+	mr.marks = []
+	mr.rows = []
+}
+
+/******************************************************************************
+*
+* Csv mapper
+*
+******************************************************************************/
+// map_csv builds the index. The file is cut in chunks, one for each thread. A first parallel pass
+// finds the state of the scan (in a quoted cell, in a comment line, or not) at the end of each chunk,
+// and its number of marks, for each state it may start in, to know the state each chunk really starts
+// in. A second parallel pass finds the separators and the end of lines of each chunk, and the rows are
+// then indexed.
+fn (mut mr MappedReader) map_csv(nr_threads int, min_chunk_size i64) ! {
+	data := mr.file.data
+	len := mr.file.len
+	mut nr_chunks := if min_chunk_size > 0 { int(len / min_chunk_size) } else { nr_threads }
+	if nr_chunks > nr_threads {
+		nr_chunks = nr_threads
+	}
+	// the marks of a chunk are in a V array, so a chunk can not be longer than max_int bytes
+	min_nr_chunks := int((len + max_chunk_len - 1) / max_chunk_len)
+	if nr_chunks < min_nr_chunks {
+		nr_chunks = min_nr_chunks
+	}
+	if nr_chunks < 1 {
+		nr_chunks = 1
+	}
+	mut chunk_starts := []i64{cap: nr_chunks + 1}
+	for c in 0 .. nr_chunks {
+		chunk_starts << len * c / nr_chunks
+	}
+	chunk_starts << len
+
+	mut row_start := i64(0)
+	if len >= 3 && unsafe { data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF } {
+		row_start = 3 // skip the BOM
+	}
+	cfg := ScanConfig{
+		data:      data
+		len:       len
+		separator: mr.separator
+		comment:   mr.comment
+		quote:     mr.quote
+	}
+	mut summary_threads := []thread ChunkSummary{}
+	for c in 0 .. nr_chunks {
+		summary_threads << spawn cfg.chunk_summary(chunk_starts[c], chunk_starts[c + 1])
+	}
+	summaries := summary_threads.wait()
+	no_final_eol := row_start < len && unsafe { data[len - 1] } != `\n`
+
+	mut scan_threads := []thread []i64{}
+	mut state := if row_start < len && cfg.is_comment(row_start) {
+		ScanState.comment
+	} else {
+		ScanState.field
+	}
+	for c in 0 .. nr_chunks {
+		mut nr_marks := summaries[c].nr_marks[int(state)]
+		if c == nr_chunks - 1 && no_final_eol {
+			nr_marks++ // room for the end of the last row, added below
+		}
+		scan_threads << spawn cfg.scan_chunk(chunk_starts[c], chunk_starts[c + 1], state, nr_marks)
+		state = summaries[c].end_states[int(state)]
+	}
+	mr.marks = scan_threads.wait()
+	if state == .quoted {
+		return error('ERROR: quote not closed at the end of the file!')
+	}
+	if no_final_eol {
+		// the last row, without end of line
+		mr.marks[nr_chunks - 1] << -(len + 1)
+	}
+
+	mr.rows = []MappedRowRef{}
+	mut row_chunk := 0
+	mut row_index := 0
+	mut nr_separators := 0
+	for c, marks in mr.marks {
+		for i, m in marks {
+			if m >= 0 {
+				if nr_separators == max_int - 1 {
+					return error('ERROR: a row has more than ${max_int} cells')
+				}
+				nr_separators++
+				continue
+			}
+			// end of line
+			pos := -m - 1
+			if nr_separators > 0 || !mr.is_dropped_line(row_start, pos) {
+				if mr.rows.len == max_int {
+					return error('ERROR: the file has more than ${max_int} rows')
+				}
+				mr.rows << MappedRowRef{
+					start:     row_start
+					chunk:     row_chunk
+					index:     row_index
+					nr_fields: nr_separators + 1
+				}
+			}
+			row_start = pos + 1
+			row_chunk = c
+			row_index = i + 1
+			nr_separators = 0
+		}
+	}
+}
+
+// is_dropped_line returns true if the line without separators from `start` to `pos`, its end of
+// line, is empty, or a comment (the comment lines have no separators, see `scan_chunk`)
+fn (mr &MappedReader) is_dropped_line(start i64, pos i64) bool {
+	mut end := pos
+	if end > start && unsafe { mr.file.data[end - 1] } == `\r` {
+		end--
+	}
+	return end == start || (mr.comment != 0 && unsafe { mr.file.data[start] } == mr.comment)
+}
+
+// is_comment returns true if the line starting at `pos` is a comment
+@[inline]
+fn (cfg ScanConfig) is_comment(pos i64) bool {
+	return cfg.comment != 0 && pos < cfg.len && unsafe { cfg.data[pos] } == cfg.comment
+}
+
+// next_state returns the state of the scan after the byte `c` at `pos`, in the state `state`
+@[inline]
+fn (cfg ScanConfig) next_state(state ScanState, c u8, pos i64) ScanState {
+	if c == `\n` {
+		if state == .quoted {
+			return state
+		}
+		return if cfg.is_comment(pos + 1) { ScanState.comment } else { ScanState.field }
+	}
+	if c == cfg.quote && state != .comment {
+		return if state == .quoted { ScanState.field } else { ScanState.quoted }
+	}
+	return state
+}
+
+// chunk_summary returns the state of the scan at `end`, and the number of marks between `start`
+// and `end`, for each state it may be in at `start`. Only the separators, the quotes and the end of
+// lines matter, so the words without them are skipped 8 bytes at once (SWAR), like in `scan_chunk`.
+@[direct_array_access]
+fn (cfg ScanConfig) chunk_summary(start i64, end i64) ChunkSummary {
+	sep_mask := u64(cfg.separator) * swar_ones
+	quote_mask := u64(cfg.quote) * swar_ones
+	nl_mask := u64(`\n`) * swar_ones
+	mut states := [ScanState.field, .quoted, .comment]
+	mut nr_marks := []int{len: states.len}
+	mut i := start
+	unsafe {
+		for i < end {
+			mut stop := i + 8
+			if stop <= end {
+				mut w := u64(0)
+				vmemcpy(&w, cfg.data + i, 8)
+				if !swar_has_zero(w ^ sep_mask) && !swar_has_zero(w ^ quote_mask)
+					&& !swar_has_zero(w ^ nl_mask) {
+					i = stop
+					continue
+				}
+			} else {
+				stop = end
+			}
+			for i < stop {
+				c := cfg.data[i]
+				if c == cfg.separator || c == cfg.quote || c == `\n` {
+					for k in 0 .. states.len {
+						// the same marks as `scan_chunk`
+						if (states[k] == .field && c == cfg.separator)
+							|| (states[k] != .quoted && c == `\n`) {
+							nr_marks[k]++
+						}
+						states[k] = cfg.next_state(states[k], c, i)
+					}
+				}
+				i++
+			}
+		}
+	}
+	return ChunkSummary{
+		end_states: states
+		nr_marks:   nr_marks
+	}
+}
+
+// scan_chunk returns the positions of the separators and of the end of lines between `start` and
+// `end`, outside of the quoted cells, starting in the state `state`. The end of lines are stored as
+// `-(pos + 1)`. The comment lines have only their end of line. `nr_marks` is the capacity of the
+// result, as counted by `chunk_summary`.
+// The bytes are tested 8 at once (SWAR), and only the words with a special byte are looked at one
+// byte at a time.
+@[direct_array_access]
+fn (cfg ScanConfig) scan_chunk(start i64, end i64, state ScanState, nr_marks int) []i64 {
+	mut marks := []i64{cap: nr_marks}
+	sep_mask := u64(cfg.separator) * swar_ones
+	quote_mask := u64(cfg.quote) * swar_ones
+	nl_mask := u64(`\n`) * swar_ones
+	mut st := state
+	mut i := start
+	unsafe {
+		for i < end {
+			mut stop := i + 8
+			if stop <= end {
+				mut w := u64(0)
+				vmemcpy(&w, cfg.data + i, 8)
+				if !swar_has_zero(w ^ sep_mask) && !swar_has_zero(w ^ quote_mask)
+					&& !swar_has_zero(w ^ nl_mask) {
+					i = stop
+					continue
+				}
+			} else {
+				stop = end
+			}
+			for i < stop {
+				c := cfg.data[i]
+				if st == .field && c == cfg.separator {
+					marks << i
+				} else if st != .quoted && c == `\n` {
+					marks << -(i + 1)
+				}
+				st = cfg.next_state(st, c, i)
+				i++
+			}
+		}
+	}
+	return marks
+}
+
+// swar_has_zero returns true if one of the 8 bytes of `w` is 0
+@[inline]
+fn swar_has_zero(w u64) bool {
+	return (w - swar_ones) & ~w & swar_highs != 0
+}
+
+/******************************************************************************
+*
+* Mapped reader
+*
+******************************************************************************/
+// rows_count returns the number of rows, comments and empty lines excluded
+pub fn (mr &MappedReader) rows_count() int {
+	return mr.rows.len
+}
+
+// fields_count returns the number of cells of the row `y`
+pub fn (mr &MappedReader) fields_count(y int) int {
+	if y < 0 || y >= mr.rows.len {
+		return 0
+	}
+	return mr.rows[y].nr_fields
+}
+
+// mark returns the position that ends the cell `x` of `row`, and true if it is an end of line
+@[direct_array_access]
+fn (mr &MappedReader) mark(row MappedRowRef, x int) (i64, bool) {
+	mut chunk := row.chunk
+	mut index := i64(row.index) + x
+	for index >= mr.marks[chunk].len {
+		index -= mr.marks[chunk].len
+		chunk++
+	}
+	m := mr.marks[chunk][int(index)]
+	if m < 0 {
+		return -m - 1, true
+	}
+	return m, false
+}
+
+// get_cell returns the cell `x` of the row `y`. The quotes around the cell are removed.
+// The string is a view on the mapped file, valid until `dispose_csv_reader` is called, and it is not
+// 0 terminated; only the cells with escaped quotes (`""`) are copied.
+pub fn (mr &MappedReader) get_cell(cfg GetCellConfig) !string {
+	if cfg.y < 0 || cfg.x < 0 || cfg.x >= mr.fields_count(cfg.y) {
+		return error('ERROR: cell [${cfg.x},${cfg.y}] out of the csv boundaries')
+	}
+	row := mr.rows[cfg.y]
+	mut start := row.start
+	if cfg.x > 0 {
+		prev, _ := mr.mark(row, cfg.x - 1)
+		start = prev + 1 // skip the separator
+	}
+	end_pos, is_eol := mr.mark(row, cfg.x)
+	mut end := end_pos
+	data := mr.file.data
+	if is_eol && end > start && unsafe { data[end - 1] } == `\r` {
+		end--
+	}
+	if end <= start {
+		return ''
+	}
+	unsafe {
+		if data[start] == mr.quote && end - start >= 2 && data[end - 1] == mr.quote {
+			inner := tos(data + start + 1, int(end - start - 2))
+			if inner.contains_u8(mr.quote) {
+				q := mr.quote.ascii_str()
+				return inner.replace(q + q, q)
+			}
+			return inner
+		}
+		return tos(data + start, int(end - start))
+	}
+}
+
+// get_row returns the cells of the row `y`, as views on the mapped file (see `get_cell`)
+pub fn (mr &MappedReader) get_row(y int) ![]string {
+	nr_fields := mr.fields_count(y)
+	mut row := []string{cap: nr_fields}
+	for x in 0 .. nr_fields {
+		row << mr.get_cell(x: x, y: y)!
+	}
+	return row
+}
@@ -0,0 +1,117 @@
+import encoding.csv
+import os
+
+const mapped_test_dir = os.join_path(os.vtmp_dir(), 'csv_reader_mapped_test')
+
+const mapped_txt = '\xEF\xBB\xBFa,b,c\r
+# a comment\r
+1,"x, y",2.5\r
+\r
+2,"say ""hi""",3\r
+3,"multi
+line",-4.25'
+
+struct MappedRow {
+	a int
+	b string
+	c f64
+}
+
+fn testsuite_begin() {
+	os.mkdir_all(mapped_test_dir)!
+}
+
+fn testsuite_end() {
+	os.rmdir_all(mapped_test_dir) or {}
+}
+
+fn write_csv(name string, content string) string {
+	path := os.join_path(mapped_test_dir, name)
+	os.write_file(path, content) or { panic(err) }
+	return path
+}
+
+fn test_mapped_reader_cells() {
+	path := write_csv('cells.csv', mapped_txt)
+	mut mr := csv.csv_mapped_reader(file_path: path)!
+	assert mr.rows_count() == 4
+	assert mr.get_row(0)! == ['a', 'b', 'c']
+	assert mr.get_row(1)! == ['1', 'x, y', '2.5']
+	assert mr.get_row(2)! == ['2', 'say "hi"', '3']
+	assert mr.get_row(3)! == ['3', 'multi\nline', '-4.25']
+	assert mr.fields_count(1) == 3
+	if _ := mr.get_cell(x: 3, y: 1) {
+		assert false
+	}
+	mr.dispose_csv_reader()
+	assert mr.rows_count() == 0
+}
+
+fn test_mapped_reader_parallel_chunks() {
+	// the chunks are cut anywhere, also inside the quoted cells
+	mut rows := []string{}
+	for i in 0 .. 500 {
+		rows << '${i},"q,${i}\n""${i}""",${i}.5'
+	}
+	path := write_csv('chunks.csv', 'a,b,c\n' + rows.join('\n') + '\n')
+	for nr_threads in [1, 3, 8] {
+		mut mr := csv.csv_mapped_reader(file_path: path, nr_threads: nr_threads, min_chunk_size: 1)!
+		assert mr.rows_count() == 501
+		for i in 0 .. 500 {
+			assert mr.get_row(i + 1)! == ['${i}', 'q,${i}\n"${i}"', '${i}.5']
+		}
+		mr.dispose_csv_reader()
+	}
+}
+
+fn test_mapped_reader_quotes_in_comments() {
+	// the quotes of the comment lines are ignored, but a line starting with the comment char inside
+	// a quoted cell is not a comment
+	content := '# it\'s a "comment\na,b\n#"x\n"1\n#2",3\n# end "'
+	path := write_csv('comments.csv', content)
+	for nr_threads in [1, 2, 3, 5, 8] {
+		mut mr := csv.csv_mapped_reader(file_path: path, nr_threads: nr_threads, min_chunk_size: 1)!
+		assert mr.rows_count() == 2
+		assert mr.get_row(0)! == ['a', 'b']
+		assert mr.get_row(1)! == ['1\n#2', '3']
+		mr.dispose_csv_reader()
+	}
+}
+
+fn test_mapped_reader_errors() {
+	if _ := csv.csv_mapped_reader(file_path: os.join_path(mapped_test_dir, 'missing.csv')) {
+		assert false
+	}
+	path := write_csv('quote.csv', 'a,b\n1,"open\n')
+	if _ := csv.csv_mapped_reader(file_path: path) {
+		assert false
+	}
+	empty := write_csv('empty.csv', '')
+	mut mr := csv.csv_mapped_reader(file_path: empty)!
+	assert mr.rows_count() == 0
+	mr.dispose_csv_reader()
+}
+
+fn test_decode_mapped() {
+	path := write_csv('decode.csv', mapped_txt)
+	mut mr := csv.csv_mapped_reader(file_path: path, nr_threads: 2, min_chunk_size: 1)!
+	rows := csv.decode_mapped[MappedRow](mr)!
+	mr.dispose_csv_reader()
+	assert rows == [
+		MappedRow{
+			a: 1
+			b: 'x, y'
+			c: 2.5
+		},
+		MappedRow{
+			a: 2
+			b: 'say "hi"'
+			c: 3
+		},
+		MappedRow{
+			a: 3
+			b: 'multi\nline'
+			c: -4.25
+		},
+	]
+}
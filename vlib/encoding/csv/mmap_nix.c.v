@@ -0,0 +1,50 @@
+module csv
+
+import os
+
+#include <sys/mman.h>
+
+fn C.mmap(base voidptr, len usize, prot int, flags int, fd int, offset i64) voidptr
+
+fn C.munmap(base voidptr, len usize) int
+
+fn C.madvise(base voidptr, len usize, advice int) int
+
+// MappedFile is a file mapped read only in memory
+struct MappedFile {
+mut:
+	data &u8 = unsafe { nil }
+	len  i64
+}
+
+fn map_file(path string) !MappedFile {
+	if !os.exists(path) {
+		return error('ERROR: file ${path} not found!')
+	}
+	mut f := os.open(path)!
+	defer {
+		f.close()
+	}
+	len := i64(os.file_size(path))
+	if len == 0 {
+		return MappedFile{}
+	}
+	addr := C.mmap(unsafe { nil }, usize(len), C.PROT_READ, C.MAP_PRIVATE, f.fd, 0)
+	if addr == voidptr(-1) {
+		return error('ERROR: cannot map ${path}: ${os.posix_get_error_msg(C.errno)}')
+	}
+	// the file is read from start to end by the index threads
+	C.madvise(addr, usize(len), C.MADV_SEQUENTIAL)
+	return MappedFile{
+		data: unsafe { &u8(addr) }
+		len:  len
+	}
+}
+
+fn (mut mf MappedFile) unmap() {
+	if mf.data != unsafe { nil } {
+		C.munmap(mf.data, usize(mf.len))
+		mf.data = unsafe { nil }
+		mf.len = 0
+	}
+}
@@ -0,0 +1,29 @@
+module csv
+
+import os
+
+// MappedFile holds the whole file in memory. The file is read, instead of being mapped, on Windows.
+struct MappedFile {
+mut:
+	data &u8 = unsafe { nil }
+	len  i64
+	buf  []u8
+}
+
+fn map_file(path string) !MappedFile {
+	if !os.exists(path) {
+		return error('ERROR: file ${path} not found!')
+	}
+	buf := os.read_bytes(path)!
+	return MappedFile{
+		data: buf.data
+		len:  buf.len
+		buf:  buf
+	}
+}
+
+fn (mut mf MappedFile) unmap() {
+	mf.buf = []
+	mf.data = unsafe { nil }
+	mf.len = 0
+}
@@ -44,6 +44,49 @@ pub fn decode[T](data string) []T {
 	return result
 }
 
+// decode_mapped decodes the rows of a `MappedReader` into structs, using its first row as the header.
+// The columns of each field are looked up once, and the numbers are parsed directly from the mapped
+// file; only the `string` fields are copied.
+pub fn decode_mapped[T](mr &MappedReader) ![]T {
+	rows_count := mr.rows_count()
+	if rows_count == 0 {
+		return []T{}
+	}
+	columns_names := mr.get_row(0)!
+	mut columns := []int{}
+	$for field in T.fields {
+		columns << get_column(field.name, columns_names)
+	}
+	mut result := []T{cap: rows_count - 1}
+	for y in 1 .. rows_count {
+		fields_count := mr.fields_count(y)
+		mut t_val := T{}
+		mut i := 0
+		$for field in T.fields {
+			col := columns[i]
+			i++
+			if col > -1 && col < fields_count {
+				cell := mr.get_cell(x: col, y: y)!
+				$if field.typ is string {
+					t_val.$(field.name) = cell.clone()
+				} $else $if field.typ is int {
+					t_val.$(field.name) = cell.int()
+				} $else $if field.typ is i64 {
+					t_val.$(field.name) = cell.i64()
+				} $else $if field.typ is f32 {
+					t_val.$(field.name) = f32(strconv.atof64(cell) or { f32(0.0) })
+				} $else $if field.typ is f64 {
+					t_val.$(field.name) = strconv.atof64(cell) or { f64(0.0) }
+				} $else $if field.typ is bool {
+					t_val.$(field.name) = string_to_bool(cell)
+				}
+			}
+		}
+		result << t_val
+	}
+	return result
+}
+
 fn string_to_bool(val string) bool {
 	l_val := val.to_lower().trim_space()
 	if l_val == 'true' {
@@ -26,7 +26,8 @@ pub:
 @[params]
 pub struct BufferedReadLineConfig {
 pub:
-	delim u8 = `\n` // line delimiter
+	delim   u8 = `\n` // line delimiter
+	max_len int // the maximum length of the line; longer lines are an error. 0 means no limit.
 }
 
 // new_buffered_reader creates a new BufferedReader.
@@ -68,6 +69,23 @@ pub fn (mut r BufferedReader) read(mut buf []u8) !int {
 	return read
 }
 
+// reset makes the buffered reader read from `reader`, reusing its internal buffer.
+// Any data still buffered from the previous reader is discarded.
+pub fn (mut r BufferedReader) reset(reader Reader) {
+	r.reader = reader
+	r.offset = 0
+	r.len = 0
+	r.fails = 0
+	r.end_of_stream = false
+	r.total_read = 0
+}
+
+// buffered returns the number of bytes, that were already read from the upstream reader,
+// but not yet consumed; they can be read without blocking.
+pub fn (r &BufferedReader) buffered() int {
+	return r.len - r.offset
+}
+
 // free deallocates the memory for a buffered reader's internal buffer.
 pub fn (mut r BufferedReader) free() {
 	unsafe {
@@ -118,6 +136,7 @@ pub fn (r BufferedReader) end_of_stream() bool {
 // read_line attempts to read a line from the buffered reader.
 // It will read until it finds the specified line delimiter
 // such as (\n, the default or \0) or the end of stream.
+// With `max_len` > 0, it fails for lines longer than `max_len`, without buffering the whole line.
 pub fn (mut r BufferedReader) read_line(config BufferedReadLineConfig) !string {
 	if r.end_of_stream {
 		return Eof{}
@@ -150,11 +169,23 @@ pub fn (mut r BufferedReader) read_line(config BufferedReadLineConfig) !string {
 					line << r.buf[r.offset..i]
 				}
 				r.offset = i + 1
+				if config.max_len > 0 && line.len > config.max_len {
+					return NotExpected{
+						cause: 'line too long'
+						code:  -2
+					}
+				}
 				return line.bytestr()
 			}
 		}
 		line << r.buf[r.offset..i]
 		r.offset = i
+		if config.max_len > 0 && line.len > config.max_len {
+			return NotExpected{
+				cause: 'line too long'
+				code:  -2
+			}
+		}
 	}
 	return Eof{}
 }
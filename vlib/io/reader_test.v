@@ -184,3 +184,35 @@ fn test_read_line_until_zero_terminated() {
 	}
 	assert r.end_of_stream()
 }
+
+fn test_read_line_max_len() {
+	mut r := new_buffered_reader(
+		reader: StringReaderTest{
+			text: 'short\n' + 'x'.repeat(100) + '\nlast\n'
+		}
+		cap:    16
+	)
+	assert r.read_line(max_len: 10)! == 'short'
+	if _ := r.read_line(max_len: 10) {
+		assert false
+	} else {
+		assert err.msg() == 'line too long'
+	}
+}
+
+fn test_reset_and_buffered() {
+	mut r := new_buffered_reader(reader: StringReaderTest{
+		text: 'first\nsecond\n'
+	})
+	assert r.read_line()! == 'first'
+	assert r.buffered() == 'second\n'.len
+	r.reset(StringReaderTest{
+		text: 'third\n'
+	})
+	assert r.buffered() == 0
+	assert r.read_line()! == 'third'
+	if _ := r.read_line() {
+		assert false
+	}
+	assert r.end_of_stream()
+}
@@ -114,11 +114,14 @@ fn C.FD_ISSET(fd int, fdset &C.fd_set) int
 
 fn C.inet_pton(family AddrFamily, saddr &char, addr voidptr) int
 
-fn C.photon_socket(domain AddrFamily, typ SocketType, protocol int) int
-fn C.photon_connect(int, &Addr, u32, timeout u64) int
-fn C.photon_accept(int, voidptr, int, timeout u64) int
-fn C.photon_send(int, voidptr, int, int, timeout u64) int
-fn C.photon_recv(int, voidptr, int, int, timeout u64) int
+// the coroutine aware versions of the socket functions, used with `-use-coroutines` (see vlib/coroutines/vcoro.c)
+fn C.vcoro_socket(domain AddrFamily, typ SocketType, protocol int) int
+fn C.vcoro_connect(int, &Addr, u32, timeout i64) int
+fn C.vcoro_accept(int, voidptr, voidptr, timeout i64) int
+fn C.vcoro_send(int, voidptr, int, int, timeout i64) int
+fn C.vcoro_recv(int, voidptr, int, int, timeout i64) int
+fn C.vcoro_wait_fd(fd int, write int, timeout i64) int
+fn C.vcoro_close(fd int) int
 
 @[typedef]
 pub struct C.fd_set {}
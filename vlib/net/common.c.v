@@ -72,6 +72,8 @@ pub fn shutdown(handle int, config ShutdownConfig) int {
 pub fn close(handle int) ! {
 	res := $if windows {
 		C.closesocket(handle)
+	} $else $if is_coroutine ? {
+		C.vcoro_close(handle)
 	} $else {
 		C.close(handle)
 	}
@@ -107,6 +109,21 @@ pub fn close(handle int) ! {
 
 // Select waits for an io operation (specified by parameter `test`) to be available
 fn @select(handle int, test Select, timeout time.Duration) !bool {
+	$if is_coroutine ? {
+		// park only the calling coroutine, till the poller of the scheduler sees the socket ready,
+		// instead of blocking the whole thread in select()
+		if test != .except && timeout > 0 {
+			if C.vcoro_wait_fd(handle, int(test == .write), i64(timeout)) == 0 {
+				return true
+			}
+			code := error_code()
+			if code == C.ETIMEDOUT {
+				return false
+			}
+			wrap_error(code)!
+			return false
+		}
+	}
 	set := C.fd_set{}
 
 	C.FD_ZERO(&set)
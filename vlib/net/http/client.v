@@ -0,0 +1,612 @@
+// Copyright (c) 2019-2024 Alexander Medvednikov. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+module http
+
+import io
+import net
+import net.ssl
+import strconv
+import strings
+import sync
+import time
+
+const client_read_buffer_size = 16 * 1024
+
+// the error code, returned when a pooled connection was closed by the server, before the request was sent,
+// or when the server did not process the request (see client_no_response_code otherwise)
+const client_conn_closed_code = -33
+
+// the error code, returned when a request for HTTP/2 has to use HTTP/1.1 instead
+const client_h1_fallback_code = -34
+
+// the error code, returned when the connection was closed after the request was sent, but before the response
+// started. The server may have processed the request, so only the idempotent ones can be sent again.
+const client_no_response_code = -35
+
+// can_resend reports whether a request, that failed with the error code `code`, can be sent again on a new
+// connection: when the server did not get it, or when it is idempotent (RFC 9110, 9.2.2)
+fn can_resend(method Method, code int) bool {
+	return code == client_conn_closed_code || (code == client_no_response_code
+		&& method in [.get, .head, .options, .trace, .put, .delete])
+}
+
+// Client sends requests over persistent (keep-alive) connections. Once a response has been read
+// fully, its connection goes back to a pool of idle connections, and the next request to the same
+// scheme://host:port reuses it, instead of connecting (and for https, doing a full TLS handshake) again.
+// A new TLS connection to a host offers the session of the previous one, so that the servers,
+// that support it, can resume it with an abbreviated handshake.
+// With `http2: true`, the requests use HTTP/2, when the server supports it: over https, it is
+// negotiated with ALPN, and the server may still choose HTTP/1.1. Over http, it is used with prior
+// knowledge (h2c), so it is only for the servers known to support it. The concurrent requests to a host
+// are then multiplexed on a single connection.
+// A Client can be shared by several threads. Example:
+// ```v
+// mut client := http.Client{}
+// defer {
+// 	client.close()
+// }
+// for _ in 0 .. 10 {
+// 	resp := client.get('http://localhost:8080/')!
+// 	println(resp.body)
+// }
+// println(client.stats())
+// ```
+@[heap]
+pub struct Client {
+pub:
+	max_idle_per_host int           = 8   // the maximum number of idle connections, kept open for a single host
+	max_idle          int           = 128 // the maximum number of idle connections, kept open for all hosts together
+	max_per_host      int // the maximum number of connections in use at once for a single host; 0 means no limit. The requests over it wait for a connection to be released.
+	idle_timeout      time.Duration = 90 * time.second // the connections idle for longer are closed, instead of being reused
+	http2             bool // use HTTP/2, when the server supports it
+mut:
+	mu    &sync.Mutex = sync.new_mutex()
+	hosts map[string]&ClientHost
+	stats ClientStats
+}
+
+// ClientStats are the metrics of the connection pool of a Client
+pub struct ClientStats {
+pub mut:
+	requests    u64 // the requests sent
+	http2       u64 // the requests sent over HTTP/2
+	dials       u64 // the connections opened
+	reuses      u64 // the requests sent over an idle connection from the pool
+	retries     u64 // the requests sent again over a new connection, because the pooled one was closed by the server
+	tls_resumes u64 // the TLS connections, that offered the session of a previous one (the server may still do a full handshake)
+	closed      u64 // the connections closed, because the server asked for it, they failed, they were idle too long, or the pool was full
+	idle        int // the connections currently idle in the pool
+	active      int // the connections currently used by a request
+	waiting     int // the requests currently waiting for a connection, because of max_per_host
+}
+
+// ClientHost holds the pooled connections to a single scheme://host:port
+struct ClientHost {
+mut:
+	idle    []&ClientConn   // the idle connections, the most recently used one last
+	sem     &sync.Semaphore = unsafe { nil } // limits the connections in use to max_per_host
+	session voidptr // the TLS session of the last https connection, offered by the next new one
+	h2      []&H2ClientConn // the HTTP/2 connections, each one shared by several requests
+	h1_only bool // the server did not accept HTTP/2 with ALPN
+}
+
+// ClientConn is a plain or a TLS connection of a Client, with its read buffer
+@[heap]
+struct ClientConn {
+mut:
+	tcp        &net.TcpConn       = unsafe { nil }
+	tls        &ssl.SSLConn       = unsafe { nil }
+	reader     &io.BufferedReader = unsafe { nil }
+	idle_since time.Time
+	reused     bool
+}
+
+// do sends the request over a pooled connection, follows its redirects, and returns the response.
+// Requests through a proxy, or with progress callbacks, or copying/receiving limits, use a new
+// connection, like `Request.do()`.
+pub fn (mut c Client) do(req &Request) !Response {
+	return req.do_with_client(&c)
+}
+
+// fetch sends an HTTP request to the `url` with the given method and configuration, over a pooled connection
+pub fn (mut c Client) fetch(config FetchConfig) !Response {
+	req := prepare(config)!
+	return c.do(req)
+}
+
+// get sends a GET HTTP request to the given `url`, over a pooled connection
+pub fn (mut c Client) get(url string) !Response {
+	return c.fetch(method: .get, url: url)
+}
+
+// post sends the string `data` as an HTTP POST request to the given `url`, over a pooled connection
+pub fn (mut c Client) post(url string, data string) !Response {
+	return c.fetch(
+		method: .post
+		url:    url
+		data:   data
+		header: new_header(key: .content_type, value: content_type_default)
+	)
+}
+
+// stats returns the current metrics of the connection pool
+pub fn (mut c Client) stats() ClientStats {
+	c.mu.@lock()
+	s := c.stats
+	c.mu.unlock()
+	return s
+}
+
+// close closes all the idle connections, and releases the saved TLS sessions.
+// The connections in use are closed, when their requests finish.
+pub fn (mut c Client) close() {
+	mut conns := []&ClientConn{}
+	c.mu.@lock()
+	mut h2_conns := []&H2ClientConn{}
+	for _, mut h in c.hosts {
+		conns << h.idle
+		h.idle.clear()
+		h2_conns << h.h2
+		h.h2.clear()
+		ssl.free_session(h.session)
+		h.session = unsafe { nil }
+	}
+	c.stats.idle = 0
+	c.stats.closed += u64(conns.len)
+	c.mu.unlock()
+	for mut cc in conns {
+		cc.close()
+	}
+	for mut hc in h2_conns {
+		hc.shutdown()
+	}
+}
+
+// can_use_pool reports whether the request can be sent over a pooled connection.
+// The progress callbacks and the copying/receiving limits work on the raw stream of the
+// response, so these requests, and the ones through a proxy, use a connection of their own.
+fn (req &Request) can_use_pool() bool {
+	return req.proxy == unsafe { nil } && req.on_progress == unsafe { nil }
+		&& req.on_progress_body == unsafe { nil } && req.stop_copying_limit < 0
+		&& req.stop_receiving_limit < 0
+}
+
+// round_trip sends a single request over a pooled or a new connection, and reads its response
+fn (mut c Client) round_trip(req &Request, scheme string, host_name string, port int, method Method, path string) !Response {
+	mut h := c.host(client_host_key(req, scheme, host_name, port))
+	c.mu.@lock()
+	c.stats.requests++
+	c.mu.unlock()
+	if h.sem != unsafe { nil } {
+		c.mu.@lock()
+		c.stats.waiting++
+		c.mu.unlock()
+		h.sem.wait()
+		c.mu.@lock()
+		c.stats.waiting--
+		c.mu.unlock()
+	}
+	defer {
+		if h.sem != unsafe { nil } {
+			h.sem.post()
+		}
+	}
+	if c.http2 && !h.h1_only {
+		if resp := c.round_trip_h2(mut h, req, scheme, host_name, port, method, path) {
+			return resp
+		} else {
+			if err.code() != client_h1_fallback_code {
+				return err
+			}
+		}
+	}
+	data := req.build_request_headers_ex(method, host_name, path, true)
+	$if trace_http_request ? {
+		eprint('> ')
+		eprint(data)
+		eprintln('')
+	}
+	mut attempts := 0
+	mut retried := false
+	for {
+		mut cc := c.take_idle(mut h) or {
+			c.dial(mut h, req, scheme, host_name, port) or {
+				attempts++
+				if attempts >= req.max_retries || is_no_need_retry_error(err.code()) {
+					return err
+				}
+				continue
+			}
+		}
+		resp, keep_alive := cc.exchange(req, data, method) or {
+			cc.close()
+			c.release(mut h, mut cc, false)
+			if cc.reused && !retried && can_resend(method, err.code()) {
+				// the server closed the idle connection in the meantime => try once more, on a new one
+				retried = true
+				c.mu.@lock()
+				c.stats.retries++
+				c.mu.unlock()
+				continue
+			}
+			attempts++
+			if attempts >= req.max_retries || is_no_need_retry_error(err.code())
+				|| (err.code() == client_no_response_code && !can_resend(method, err.code())) {
+				return err
+			}
+			continue
+		}
+		if cc.tls != unsafe { nil } && !cc.reused {
+			c.save_session(mut h, mut cc)
+		}
+		if !keep_alive {
+			cc.close()
+		}
+		c.release(mut h, mut cc, keep_alive)
+		$if trace_http_response ? {
+			eprintln('< ${resp.http_version} ${resp.status_code} ${resp.status_msg}')
+		}
+		if req.on_finish != unsafe { nil } {
+			req.on_finish(req, u64(resp.body.len))!
+		}
+		return resp
+	}
+	return error('http.Client: unreachable')
+}
+
+// round_trip_h2 sends a request over an HTTP/2 connection of the host, that has room for one more
+// stream, or over a new one. It fails with client_h1_fallback_code, when the server chose HTTP/1.1
+// with ALPN; the new connection is then left in the idle pool, for the request to use it.
+fn (mut c Client) round_trip_h2(mut h ClientHost, req &Request, scheme string, host_name string, port int, method Method, path string) !Response {
+	fields := req.h2_request_fields(method, scheme, host_name, path)
+	mut retried := false
+	for {
+		mut hc := c.take_h2(mut h)
+		if hc == unsafe { nil } {
+			mut cc := c.dial(mut h, req, scheme, host_name, port)!
+			if cc.tls != unsafe { nil } {
+				c.save_session(mut h, mut cc)
+				if cc.tls.negotiated_protocol() != 'h2' {
+					c.mu.@lock()
+					h.h1_only = true
+					c.mu.unlock()
+					c.release(mut h, mut cc, true)
+					return error_with_code('http.Client: the server does not support HTTP/2',
+						client_h1_fallback_code)
+				}
+			}
+			hc = new_h2_client_conn(cc, c.idle_timeout) or {
+				cc.close()
+				c.release(mut h, mut cc, false)
+				return err
+			}
+			hc.reserve()
+			c.mu.@lock()
+			h.h2 << hc
+			c.mu.unlock()
+		}
+		resp := hc.round_trip(req, method, fields) or {
+			if !retried && can_resend(method, err.code()) {
+				// the server did not process the request, since it is closing the connection
+				retried = true
+				c.mu.@lock()
+				c.stats.retries++
+				c.mu.unlock()
+				continue
+			}
+			return err
+		}
+		c.mu.@lock()
+		c.stats.http2++
+		c.mu.unlock()
+		$if trace_http_response ? {
+			eprintln('< HTTP/2.0 ${resp.status_code} ${resp.status_msg}')
+		}
+		if req.on_finish != unsafe { nil } {
+			req.on_finish(req, u64(resp.body.len))!
+		}
+		return resp
+	}
+	return error('http.Client: unreachable')
+}
+
+// take_h2 reserves a stream on an HTTP/2 connection of the host, and forgets the closed ones
+fn (mut c Client) take_h2(mut h ClientHost) &H2ClientConn {
+	c.mu.@lock()
+	defer {
+		c.mu.unlock()
+	}
+	mut i := 0
+	for i < h.h2.len {
+		mut hc := h.h2[i]
+		if hc.is_closed() {
+			h.h2.delete(i)
+			c.stats.active--
+			c.stats.closed++
+			continue
+		}
+		if hc.reserve() {
+			c.stats.reuses++
+			return hc
+		}
+		i++
+	}
+	return unsafe { nil }
+}
+
+// client_host_key returns the pool key of the connections, that can be used for the request.
+// The TLS connections are pooled separately for each set of certificates/verification settings.
+fn client_host_key(req &Request, scheme string, host_name string, port int) string {
+	if scheme == 'https' && (req.validate || req.verify != '' || req.cert != '' || req.cert_key != '') {
+		return '${scheme}://${host_name}:${port}#${req.validate},${req.verify.hash()},${req.cert.hash()},${req.cert_key.hash()}'
+	}
+	return '${scheme}://${host_name}:${port}'
+}
+
+fn (mut c Client) host(key string) &ClientHost {
+	c.mu.@lock()
+	defer {
+		c.mu.unlock()
+	}
+	if h := c.hosts[key] {
+		return h
+	}
+	mut h := &ClientHost{}
+	if c.max_per_host > 0 {
+		h.sem = sync.new_semaphore_init(u32(c.max_per_host))
+	}
+	c.hosts[key] = h
+	return h
+}
+
+// take_idle returns the most recently used idle connection of the host, that has not timed out.
+// Since the older idle connections can only be more stale, they are closed too, when it has.
+fn (mut c Client) take_idle(mut h ClientHost) ?&ClientConn {
+	mut stale := []&ClientConn{}
+	mut conn := &ClientConn(unsafe { nil })
+	c.mu.@lock()
+	if h.idle.len > 0 {
+		cc := h.idle.pop()
+		c.stats.idle--
+		if c.idle_timeout > 0 && time.since(cc.idle_since) > c.idle_timeout {
+			stale << cc
+			stale << h.idle
+			c.stats.idle -= h.idle.len
+			h.idle.clear()
+		} else {
+			conn = cc
+			c.stats.active++
+			c.stats.reuses++
+		}
+	}
+	c.stats.closed += u64(stale.len)
+	c.mu.unlock()
+	for mut cc in stale {
+		cc.close()
+	}
+	if conn == unsafe { nil } {
+		return none
+	}
+	conn.reused = true
+	return conn
+}
+
+// dial opens a new connection to the host; a TLS one offers the last saved session of the host
+fn (mut c Client) dial(mut h ClientHost, req &Request, scheme string, host_name string, port int) !&ClientConn {
+	mut cc := &ClientConn{}
+	if scheme == 'https' {
+		mut tls := ssl.new_ssl_conn(
+			verify:                 req.verify
+			cert:                   req.cert
+			cert_key:               req.cert_key
+			validate:               req.validate
+			in_memory_verification: req.in_memory_verification
+			alpn_protocols:         if c.http2 && !h.h1_only { ['h2', 'http/1.1'] } else { []string{} }
+		)!
+		mut resumes := false
+		c.mu.@lock()
+		if h.session != unsafe { nil } {
+			// Note: done under the lock, since another connection may replace (and free) the session
+			tls.set_session(h.session) or {}
+			resumes = true
+		}
+		c.mu.unlock()
+		tls.dial(host_name, port)!
+		cc.tls = tls
+		if resumes {
+			c.mu.@lock()
+			c.stats.tls_resumes++
+			c.mu.unlock()
+		}
+	} else {
+		cc.tcp = net.dial_tcp('${host_name}:${port}')!
+	}
+	cc.reader = io.new_buffered_reader(reader: cc, cap: client_read_buffer_size)
+	c.mu.@lock()
+	c.stats.dials++
+	c.stats.active++
+	c.mu.unlock()
+	return cc
+}
+
+// save_session keeps the TLS session of a new connection, for the next connections to the host
+fn (mut c Client) save_session(mut h ClientHost, mut cc ClientConn) {
+	session := cc.tls.session()
+	if session == unsafe { nil } {
+		return
+	}
+	c.mu.@lock()
+	ssl.free_session(h.session)
+	h.session = session
+	c.mu.unlock()
+}
+
+// release returns the connection to the idle pool of its host, if `keep` is true, and there is room
+// for it there. Otherwise it closes it, if it is not already closed.
+fn (mut c Client) release(mut h ClientHost, mut cc ClientConn, keep bool) {
+	c.mu.@lock()
+	c.stats.active--
+	if keep && h.idle.len < c.max_idle_per_host && c.stats.idle < c.max_idle {
+		cc.idle_since = time.now()
+		h.idle << cc
+		c.stats.idle++
+		c.mu.unlock()
+		return
+	}
+	c.stats.closed++
+	c.mu.unlock()
+	if keep {
+		cc.close()
+	}
+}
+
+// exchange sends the request `data` over the connection, and reads the whole response to it.
+// It returns as well, whether the server will keep the connection open after it.
+fn (mut cc ClientConn) exchange(req &Request, data string, method Method) !(Response, bool) {
+	cc.set_timeouts(req.read_timeout, req.write_timeout)
+	cc.write_string(data) or {
+		return error_with_code('http.Client: cannot send the request: ${err}', client_conn_closed_code)
+	}
+	mut r := cc.reader
+	mut line := r.read_line() or {
+		return error_with_code('http.Client: the connection was closed before the response',
+			client_no_response_code)
+	}
+	mut version, mut status_code, mut status_msg := parse_status_line(line.trim_right('\r'))!
+	mut header := read_response_header(mut r)!
+	for status_code >= 100 && status_code < 200 {
+		// skip the interim responses, like `100 Continue`
+		line = r.read_line()!
+		version, status_code, status_msg = parse_status_line(line.trim_right('\r'))!
+		header = read_response_header(mut r)!
+	}
+	mut keep_alive := version != '1.0'
+	connection := (header.get(.connection) or { '' }).to_lower()
+	if connection.contains('close') {
+		keep_alive = false
+	} else if connection.contains('keep-alive') {
+		keep_alive = true
+	}
+	mut body := ''
+	if method == .head || status_code in [204, 304] {
+		// no body
+	} else if (header.get(.transfer_encoding) or { '' }).to_lower().contains('chunked') {
+		body = read_chunked_body(mut r)!
+	} else if content_length := header.get(.content_length) {
+		len := strconv.parse_int(content_length.trim_space(), 10, 64) or {
+			return error('http.Client: invalid Content-Length: `${content_length}`')
+		}
+		body = read_body_bytes(mut r, len)!.bytestr()
+	} else {
+		// no length => the body lasts till the server closes the connection
+		mut sb := strings.new_builder(4096)
+		mut buf := []u8{len: client_read_buffer_size}
+		for {
+			n := r.read(mut buf) or { break }
+			sb.write(buf[..n])!
+		}
+		body = sb.str()
+		keep_alive = false
+	}
+	return Response{
+		http_version: version
+		status_code:  status_code
+		status_msg:   status_msg
+		header:       header
+		body:         body
+	}, keep_alive
+}
+
+fn read_response_header(mut r io.BufferedReader) !Header {
+	mut sb := strings.new_builder(512)
+	for {
+		line := r.read_line()!.trim_right('\r')
+		if line.len == 0 {
+			break
+		}
+		sb.write_string(line)
+		sb.write_string('\r\n')
+	}
+	if sb.len == 0 {
+		return new_header()
+	}
+	return parse_headers(sb.str())
+}
+
+fn read_body_bytes(mut r io.BufferedReader, len i64) ![]u8 {
+	if len < 0 || len > max_i32 {
+		return error('http.Client: invalid body length: ${len}')
+	}
+	mut buf := []u8{len: int(len)}
+	mut pos := 0
+	for pos < buf.len {
+		pos += r.read(mut buf[pos..])!
+	}
+	return buf
+}
+
+fn read_chunked_body(mut r io.BufferedReader) !string {
+	mut body := strings.new_builder(4096)
+	for {
+		line := r.read_line()!
+		size := strconv.parse_int(line.all_before(';').trim_space(), 16, 64) or {
+			return error('http.Client: invalid chunk size: `${line}`')
+		}
+		if size == 0 {
+			break
+		}
+		body.write(read_body_bytes(mut r, size)!)!
+		r.read_line()! // the CRLF after the chunk data
+	}
+	// skip the trailer fields, till the final empty line
+	for {
+		line := r.read_line()!.trim_right('\r')
+		if line.len == 0 {
+			break
+		}
+	}
+	return body.str()
+}
+
+fn (mut cc ClientConn) read(mut buf []u8) !int {
+	if cc.tls != unsafe { nil } {
+		return cc.tls.read(mut buf)
+	}
+	return cc.tcp.read(mut buf)
+}
+
+fn (mut cc ClientConn) write_string(s string) ! {
+	if cc.tls != unsafe { nil } {
+		cc.tls.write_string(s)!
+	} else {
+		cc.tcp.write_string(s)!
+	}
+}
+
+// wait_for_read waits till the connection can be read, for at most `timeout`
+fn (cc &ClientConn) wait_for_read(timeout time.Duration) ! {
+	handle := if cc.tls != unsafe { nil } { cc.tls.handle } else { cc.tcp.sock.handle }
+	conn := net.TcpConn{
+		sock:         net.tcp_socket_from_handle_raw(handle)
+		read_timeout: timeout
+	}
+	conn.wait_for_read()!
+}
+
+fn (mut cc ClientConn) set_timeouts(read_timeout i64, write_timeout i64) {
+	if cc.tls != unsafe { nil } {
+		cc.tls.duration = time.Duration(read_timeout)
+	} else {
+		cc.tcp.set_read_timeout(time.Duration(read_timeout))
+		cc.tcp.set_write_timeout(time.Duration(write_timeout))
+	}
+}
+
+fn (mut cc ClientConn) close() {
+	if cc.tls != unsafe { nil } {
+		cc.tls.shutdown() or {}
+	} else if cc.tcp != unsafe { nil } {
+		cc.tcp.close() or {}
+	}
+}
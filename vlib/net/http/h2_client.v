@@ -0,0 +1,609 @@
+// Copyright (c) 2019-2024 Alexander Medvednikov. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+module http
+
+import net
+import strings
+import sync
+import time
+
+// the limit of the concurrent streams on a connection, till the server announces its own
+const h2_client_default_max_streams = 100
+
+// H2ClientConn is an HTTP/2 connection of a Client, shared by all the concurrent requests to its host.
+// Its own thread reads the frames from the server, and wakes up the requests, that they complete.
+// The frames are written under `mu`, and read without it, so that the requests can be sent while the
+// reading thread waits for a frame. A TLS connection can not be read and written by two threads at
+// once, so with TLS, each read and each write also holds `tls_mu` (always taken after `mu`).
+@[heap]
+struct H2ClientConn {
+mut:
+	mu      &sync.Mutex = sync.new_mutex()
+	tls_mu  &sync.Mutex = sync.new_mutex()
+	conn    &ClientConn
+	out     strings.Builder
+	enc     HpackEncoder
+	dec     HpackDecoder
+	streams map[u32]&H2ClientStream
+	next_id u32 = 1
+	// the requests, that got the connection with reserve(), but did not open their stream yet
+	reserved     int
+	max_streams  int = h2_client_default_max_streams
+	idle_timeout time.Duration
+	// the flow control of the connection
+	send_window         i64 = h2_default_window_size
+	recv_unacked        int
+	peer_initial_window i64 = h2_default_window_size
+	peer_max_frame      int = h2_default_max_frame_size
+	goaway              bool // no new streams can be opened on the connection
+	closed              bool
+	// the header block in progress, of a HEADERS frame, followed by CONTINUATION frames
+	block_stream     u32
+	block            []u8
+	block_end_stream bool
+}
+
+struct H2ClientStream {
+mut:
+	id           u32
+	done         &sync.Semaphore = sync.new_semaphore() // posted, when the response is complete, or the stream failed
+	window       &sync.Semaphore = sync.new_semaphore() // posted, when the send window of the stream may have grown
+	send_window  i64
+	recv_unacked int
+	sending      bool // the request body is still being sent
+	finished     bool
+	status       int
+	header       Header
+	got_header   bool
+	body         strings.Builder
+	err_msg      string
+	err_code     int
+}
+
+// new_h2_client_conn starts HTTP/2 on a new connection, and its reading thread
+fn new_h2_client_conn(cc &ClientConn, idle_timeout time.Duration) !&H2ClientConn {
+	mut hc := &H2ClientConn{
+		conn:         cc
+		out:          strings.new_builder(client_read_buffer_size)
+		idle_timeout: idle_timeout
+	}
+	hc.out.write_string(h2_preface)
+	write_h2_settings(mut hc.out, [
+		u32(h2_settings_enable_push),
+		u32(0),
+		u32(h2_settings_initial_window_size),
+		u32(h2_recv_window_size),
+	])
+	write_h2_window_update(mut hc.out, 0, u32(h2_recv_window_size - h2_default_window_size))
+	hc.flush()!
+	spawn hc.read_loop()
+	return hc
+}
+
+// reserve claims a stream on the connection for a request, when it has room for one more
+fn (mut hc H2ClientConn) reserve() bool {
+	hc.mu.@lock()
+	defer {
+		hc.mu.unlock()
+	}
+	if hc.closed || hc.goaway || hc.streams.len + hc.reserved >= hc.max_streams {
+		return false
+	}
+	hc.reserved++
+	return true
+}
+
+// is_closed reports whether no request can use the connection anymore
+fn (mut hc H2ClientConn) is_closed() bool {
+	hc.mu.@lock()
+	defer {
+		hc.mu.unlock()
+	}
+	return hc.closed || (hc.goaway && hc.streams.len + hc.reserved == 0)
+}
+
+// shutdown sends a GOAWAY frame, so that the server closes the connection, once its streams are done
+fn (mut hc H2ClientConn) shutdown() {
+	hc.mu.@lock()
+	if !hc.closed && !hc.goaway {
+		hc.goaway = true
+		write_h2_goaway(mut hc.out, 0, .no_error, '')
+		hc.flush() or {}
+	}
+	hc.mu.unlock()
+}
+
+// round_trip sends a request on a stream, reserved earlier with reserve(), and waits for its response
+fn (mut hc H2ClientConn) round_trip(req &Request, method Method, fields []HpackField) !Response {
+	mut s := &H2ClientStream{
+		body: strings.new_builder(0)
+	}
+	body := if method == .head { '' } else { req.data }
+	hc.mu.@lock()
+	hc.reserved--
+	if hc.closed || hc.goaway {
+		hc.mu.unlock()
+		return error_with_code('http.Client: the HTTP/2 connection was closed', client_conn_closed_code)
+	}
+	s.id = hc.next_id
+	hc.next_id += 2
+	s.send_window = hc.peer_initial_window
+	s.sending = body.len > 0
+	hc.streams[s.id] = s
+	mut block := []u8{cap: 256}
+	hc.enc.encode(mut block, fields)
+	write_h2_headers(mut hc.out, s.id, block, body.len == 0, hc.peer_max_frame)
+	hc.flush() or {
+		hc.mu.unlock()
+		// the other streams were sent already
+		hc.fail('cannot send the request: ${err}', client_no_response_code)
+		return error_with_code('http.Client: cannot send the request: ${err}', client_conn_closed_code)
+	}
+	hc.mu.unlock()
+	timeout := time.Duration(req.read_timeout)
+	mut pos := 0
+	for pos < body.len {
+		hc.mu.@lock()
+		if s.finished {
+			// reset by the server, or the connection failed
+			hc.mu.unlock()
+			break
+		}
+		mut n := body.len - pos
+		if n > hc.peer_max_frame {
+			n = hc.peer_max_frame
+		}
+		if i64(n) > hc.send_window {
+			n = int(hc.send_window)
+		}
+		if i64(n) > s.send_window {
+			n = int(s.send_window)
+		}
+		if n <= 0 {
+			hc.mu.unlock()
+			if !h2_wait(mut s.window, timeout) {
+				hc.cancel(mut s)
+				return error('http.Client: timed out, while sending the request body')
+			}
+			continue
+		}
+		end := pos + n == body.len
+		write_h2_frame_header(mut hc.out, n, .data, if end { h2_flag_end_stream } else { 0 },
+			s.id)
+		unsafe { hc.out.write_ptr(body.str + pos, n) }
+		pos += n
+		hc.send_window -= n
+		s.send_window -= n
+		s.sending = !end
+		hc.flush() or {
+			hc.mu.unlock()
+			hc.fail('cannot send the request: ${err}', 0)
+			return error('http.Client: cannot send the request: ${err}')
+		}
+		hc.mu.unlock()
+	}
+	if !h2_wait(mut s.done, timeout) {
+		hc.cancel(mut s)
+		return error('http.Client: timed out, while waiting for the response')
+	}
+	if s.err_msg != '' {
+		return error_with_code(s.err_msg, s.err_code)
+	}
+	return Response{
+		http_version: '2.0'
+		status_code:  s.status
+		status_msg:   status_from_int(s.status).str()
+		header:       s.header
+		body:         s.body.str()
+	}
+}
+
+fn h2_wait(mut sem sync.Semaphore, timeout time.Duration) bool {
+	if timeout <= 0 {
+		sem.wait()
+		return true
+	}
+	return sem.timed_wait(timeout)
+}
+
+// cancel resets a stream, that the request does not wait for anymore
+fn (mut hc H2ClientConn) cancel(mut s H2ClientStream) {
+	hc.mu.@lock()
+	if !s.finished && !hc.closed {
+		s.finished = true
+		hc.streams.delete(s.id)
+		write_h2_rst_stream(mut hc.out, s.id, .cancel)
+		hc.flush() or {}
+	}
+	hc.mu.unlock()
+}
+
+// read_loop reads and handles the frames from the server, till the connection is closed.
+// It waits for them, and reads them, without holding `mu`, so that the requests can be sent meanwhile;
+// only this thread uses the reader of the connection. With TLS, a frame is read only once the socket
+// is readable, and while holding `tls_mu`, so the writes wait only for the rest of that frame.
+fn (mut hc H2ClientConn) read_loop() {
+	mut r := hc.conn.reader
+	is_tls := hc.conn.tls != unsafe { nil }
+	for {
+		if r.buffered() == 0 {
+			hc.conn.wait_for_read(hc.idle_timeout) or {
+				if err.code() == net.err_timed_out_code && !hc.is_idle() {
+					continue
+				}
+				break
+			}
+		}
+		if is_tls {
+			hc.tls_mu.@lock()
+		}
+		frame := read_h2_frame(mut r, h2_default_max_frame_size) or {
+			if is_tls {
+				hc.tls_mu.unlock()
+			}
+			break
+		}
+		if is_tls {
+			hc.tls_mu.unlock()
+		}
+		hc.mu.@lock()
+		hc.handle_frame(frame) or {
+			code := if err.code() > 0 {
+				unsafe { H2ErrorCode(err.code()) }
+			} else {
+				H2ErrorCode.protocol_error
+			}
+			write_h2_goaway(mut hc.out, 0, code, err.msg())
+			hc.flush() or {}
+			hc.mu.unlock()
+			hc.fail('http.Client: ${err}', 0)
+			break
+		}
+		hc.flush() or {}
+		done := hc.goaway && hc.streams.len + hc.reserved == 0
+		hc.mu.unlock()
+		if done {
+			break
+		}
+	}
+	hc.fail('http.Client: the HTTP/2 connection was closed', client_no_response_code)
+	hc.tls_mu.@lock()
+	hc.conn.close()
+	hc.tls_mu.unlock()
+}
+
+// is_idle reports whether no request uses the connection, so that it can be closed after the idle timeout
+fn (mut hc H2ClientConn) is_idle() bool {
+	hc.mu.@lock()
+	defer {
+		hc.mu.unlock()
+	}
+	return hc.streams.len + hc.reserved == 0
+}
+
+// fail closes the connection for the new requests, and fails all the pending ones
+fn (mut hc H2ClientConn) fail(msg string, code int) {
+	hc.mu.@lock()
+	hc.closed = true
+	for _, mut s in hc.streams {
+		hc.finish(mut s, msg, code)
+	}
+	hc.streams.clear()
+	hc.mu.unlock()
+}
+
+// finish completes a stream, with an error, if `msg` is not empty, and wakes up its request
+fn (mut hc H2ClientConn) finish(mut s H2ClientStream, msg string, code int) {
+	if s.finished {
+		return
+	}
+	s.finished = true
+	s.err_msg = msg
+	s.err_code = code
+	s.done.post()
+	s.window.post()
+}
+
+fn (mut hc H2ClientConn) handle_frame(f H2Frame) ! {
+	if hc.block_stream != 0 && f.typ != .continuation {
+		return h2_error(.protocol_error, 'expected a CONTINUATION frame')
+	}
+	match f.typ {
+		.data {
+			hc.on_data(f)!
+		}
+		.headers {
+			if f.stream_id == 0 {
+				return h2_error(.protocol_error, 'HEADERS frame on stream 0')
+			}
+			mut block := f.data()!
+			if f.has(h2_flag_priority) {
+				if block.len < 5 {
+					return h2_error(.frame_size_error, 'invalid HEADERS frame')
+				}
+				block = block[5..]
+			}
+			hc.block_stream = f.stream_id
+			hc.block = block.clone()
+			hc.block_end_stream = f.has(h2_flag_end_stream)
+			if f.has(h2_flag_end_headers) {
+				hc.end_headers()!
+			}
+		}
+		.continuation {
+			if f.stream_id != hc.block_stream || hc.block_stream == 0 {
+				return h2_error(.protocol_error, 'unexpected CONTINUATION frame')
+			}
+			hc.block << f.payload
+			if f.has(h2_flag_end_headers) {
+				hc.end_headers()!
+			}
+		}
+		.rst_stream {
+			if f.stream_id == 0 || f.payload.len != 4 {
+				return h2_error(.protocol_error, 'invalid RST_STREAM frame')
+			}
+			mut s := hc.streams[f.stream_id] or { return }
+			code := h2_u32(f.payload, 0)
+			hc.streams.delete(s.id)
+			if code == u32(H2ErrorCode.refused_stream) {
+				// the server did not process the request, so it can be sent again
+				hc.finish(mut s, 'http.Client: the server refused the HTTP/2 stream', client_conn_closed_code)
+			} else if code != u32(H2ErrorCode.no_error) || !s.got_header {
+				hc.finish(mut s, 'http.Client: the server reset the HTTP/2 stream, error code ${code}',
+					0)
+			} else {
+				// the server does not need the rest of the request body, after a complete response
+				hc.finish(mut s, '', 0)
+			}
+		}
+		.settings {
+			hc.on_settings(f)!
+		}
+		.push_promise {
+			return h2_error(.protocol_error, 'PUSH_PROMISE, while push is disabled')
+		}
+		.ping {
+			if f.stream_id != 0 || f.payload.len != 8 {
+				return h2_error(.protocol_error, 'invalid PING frame')
+			}
+			if !f.has(h2_flag_ack) {
+				write_h2_frame(mut hc.out, .ping, h2_flag_ack, 0, f.payload)
+			}
+		}
+		.goaway {
+			if f.payload.len < 8 {
+				return h2_error(.frame_size_error, 'invalid GOAWAY frame')
+			}
+			last_id := h2_u32(f.payload, 0) & 0x7fffffff
+			hc.goaway = true
+			// the streams after the last one are not processed by the server, so they can be sent again
+			mut ids := []u32{}
+			for id, _ in hc.streams {
+				if id > last_id {
+					ids << id
+				}
+			}
+			for id in ids {
+				mut s := hc.streams[id] or { continue }
+				hc.streams.delete(id)
+				hc.finish(mut s, 'http.Client: the server is closing the HTTP/2 connection',
+					client_conn_closed_code)
+			}
+		}
+		.window_update {
+			increment := h2_window_increment(f)!
+			if increment == 0 {
+				return h2_error(.protocol_error, 'WINDOW_UPDATE with a 0 increment')
+			}
+			if f.stream_id == 0 {
+				hc.send_window += increment
+				for _, mut s in hc.streams {
+					if s.sending {
+						s.window.post()
+					}
+				}
+			} else if f.stream_id in hc.streams {
+				mut s := hc.streams[f.stream_id] or { return }
+				s.send_window += increment
+				s.window.post()
+			}
+		}
+		else {
+			// PRIORITY is deprecated, and the unknown frame types have to be ignored
+		}
+	}
+}
+
+// end_headers handles a complete header block: the response headers, or the trailers after the body
+fn (mut hc H2ClientConn) end_headers() ! {
+	id := hc.block_stream
+	hc.block_stream = 0
+	fields := hc.dec.decode(hc.block)!
+	hc.block = []u8{}
+	mut s := hc.streams[id] or {
+		// a stream, that was cancelled meanwhile; the block is decoded anyway, to keep the HPACK state in sync
+		return
+	}
+	if !s.got_header {
+		mut header := new_header()
+		mut status := 0
+		for f in fields {
+			if f.name == ':status' {
+				status = f.value.int()
+			} else if !f.name.starts_with(':') {
+				header.add_custom(f.name, f.value)!
+			}
+		}
+		if status >= 100 && status < 200 {
+			// an interim response, like `100 Continue`
+			return
+		}
+		if status < 200 || status > 999 {
+			hc.streams.delete(id)
+			write_h2_rst_stream(mut hc.out, id, .protocol_error)
+			hc.finish(mut s, 'http.Client: invalid HTTP/2 response status `${status}`', 0)
+			return
+		}
+		s.status = status
+		s.header = header
+		s.got_header = true
+	}
+	if hc.block_end_stream {
+		hc.streams.delete(id)
+		hc.finish(mut s, '', 0)
+	}
+}
+
+fn (mut hc H2ClientConn) on_data(f H2Frame) ! {
+	if f.stream_id == 0 {
+		return h2_error(.protocol_error, 'DATA frame on stream 0')
+	}
+	hc.recv_unacked += f.payload.len
+	if hc.recv_unacked >= h2_recv_window_size / 2 {
+		write_h2_window_update(mut hc.out, 0, u32(hc.recv_unacked))
+		hc.recv_unacked = 0
+	}
+	mut s := hc.streams[f.stream_id] or { return }
+	if !s.got_header {
+		return h2_error(.protocol_error, 'DATA frame before HEADERS')
+	}
+	s.body.write(f.data()!) or {}
+	if f.has(h2_flag_end_stream) {
+		hc.streams.delete(s.id)
+		hc.finish(mut s, '', 0)
+		return
+	}
+	s.recv_unacked += f.payload.len
+	if s.recv_unacked >= h2_recv_window_size / 2 {
+		write_h2_window_update(mut hc.out, s.id, u32(s.recv_unacked))
+		s.recv_unacked = 0
+	}
+}
+
+fn (mut hc H2ClientConn) on_settings(f H2Frame) ! {
+	if f.stream_id != 0 {
+		return h2_error(.protocol_error, 'SETTINGS frame on stream ${f.stream_id}')
+	}
+	if f.has(h2_flag_ack) {
+		return
+	}
+	if f.payload.len % 6 != 0 {
+		return h2_error(.frame_size_error, 'invalid SETTINGS frame')
+	}
+	for i := 0; i < f.payload.len; i += 6 {
+		id := (int(f.payload[i]) << 8) | int(f.payload[i + 1])
+		value := h2_u32(f.payload, i + 2)
+		match id {
+			h2_settings_header_table_size {
+				hc.enc.set_max_table_size(if value > hpack_default_table_size {
+					hpack_default_table_size
+				} else {
+					int(value)
+				})
+			}
+			h2_settings_max_concurrent_streams {
+				hc.max_streams = if value > 1000 { 1000 } else { int(value) }
+			}
+			h2_settings_initial_window_size {
+				if value > h2_max_window_size {
+					return h2_error(.flow_control_error, 'invalid SETTINGS_INITIAL_WINDOW_SIZE')
+				}
+				delta := i64(value) - hc.peer_initial_window
+				hc.peer_initial_window = i64(value)
+				for _, mut s in hc.streams {
+					s.send_window += delta
+					if s.sending {
+						s.window.post()
+					}
+				}
+			}
+			h2_settings_max_frame_size {
+				if value < h2_default_max_frame_size || value > h2_max_frame_size {
+					return h2_error(.protocol_error, 'invalid SETTINGS_MAX_FRAME_SIZE')
+				}
+				hc.peer_max_frame = if value > 4 * h2_default_max_frame_size {
+					4 * h2_default_max_frame_size
+				} else {
+					int(value)
+				}
+			}
+			else {}
+		}
+	}
+	write_h2_frame_header(mut hc.out, 0, .settings, h2_flag_ack, 0)
+}
+
+fn (mut hc H2ClientConn) flush() ! {
+	if hc.out.len == 0 {
+		return
+	}
+	defer {
+		hc.out.go_back_to(0)
+	}
+	is_tls := hc.conn.tls != unsafe { nil }
+	if is_tls {
+		hc.tls_mu.@lock()
+	}
+	hc.conn.write_string(unsafe { tos(hc.out.data, hc.out.len) }) or {
+		if is_tls {
+			hc.tls_mu.unlock()
+		}
+		return err
+	}
+	if is_tls {
+		hc.tls_mu.unlock()
+	}
+}
+
+// h2_request_fields returns the header fields of a request, sent over HTTP/2
+fn (req &Request) h2_request_fields(method Method, scheme string, host_name string, path string) []HpackField {
+	mut fields := []HpackField{cap: req.header.cur_pos + 8}
+	fields << HpackField{
+		name:  ':method'
+		value: method.str()
+	}
+	fields << HpackField{
+		name:  ':scheme'
+		value: scheme
+	}
+	fields << HpackField{
+		name:  ':authority'
+		value: req.header.get(.host) or { host_name }
+	}
+	fields << HpackField{
+		name:  ':path'
+		value: path
+	}
+	if !req.header.contains(.user_agent) {
+		fields << HpackField{
+			name:  'user-agent'
+			value: req.user_agent
+		}
+	}
+	if req.data.len > 0 && !req.header.contains(.content_length) {
+		fields << HpackField{
+			name:  'content-length'
+			value: req.data.len.str()
+		}
+	}
+	for i := 0; i < req.header.cur_pos; i++ {
+		kv := req.header.data[i]
+		name := kv.key.to_lower()
+		if kv.value == '' || name == 'host' || name in h2_connection_headers {
+			continue
+		}
+		fields << HpackField{
+			name:  name
+			value: kv.value
+		}
+	}
+	for name, value in req.cookies {
+		fields << HpackField{
+			name:  'cookie'
+			value: '${name}=${value}'
+		}
+	}
+	return fields
+}
@@ -0,0 +1,198 @@
+// Copyright (c) 2019-2024 Alexander Medvednikov. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+module http
+
+import io
+import strings
+
+// The framing layer of HTTP/2 (RFC 9113), shared by the server and the client.
+
+// the first bytes, sent by a client on a new HTTP/2 connection
+const h2_preface = 'PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n'
+
+const h2_frame_header_size = 9
+const h2_default_window_size = 65535
+const h2_max_window_size = 0x7fffffff
+const h2_default_max_frame_size = 16384
+const h2_max_frame_size = 16777215
+
+// the receive window of the connections and of each stream, announced by the server and the client.
+// The bodies are buffered in memory anyway, so the received data is acknowledged as soon as it arrives.
+const h2_recv_window_size = 1 << 20
+
+const h2_flag_end_stream = u8(0x01)
+const h2_flag_ack = u8(0x01)
+const h2_flag_end_headers = u8(0x04)
+const h2_flag_padded = u8(0x08)
+const h2_flag_priority = u8(0x20)
+
+const h2_settings_header_table_size = 0x1
+const h2_settings_enable_push = 0x2
+const h2_settings_max_concurrent_streams = 0x3
+const h2_settings_initial_window_size = 0x4
+const h2_settings_max_frame_size = 0x5
+const h2_settings_max_header_list_size = 0x6
+
+// the header fields, that are specific to an HTTP/1 connection, and are not allowed in HTTP/2
+const h2_connection_headers = ['connection', 'keep-alive', 'proxy-connection', 'transfer-encoding',
+	'upgrade']
+
+enum H2FrameType as u8 {
+	data
+	headers
+	priority
+	rst_stream
+	settings
+	push_promise
+	ping
+	goaway
+	window_update
+	continuation
+}
+
+// H2ErrorCode is the error code of the RST_STREAM and GOAWAY frames, RFC 9113, 7
+pub enum H2ErrorCode {
+	no_error
+	protocol_error
+	internal_error
+	flow_control_error
+	settings_timeout
+	stream_closed
+	frame_size_error
+	refused_stream
+	cancel
+	compression_error
+	connect_error
+	enhance_your_calm
+	inadequate_security
+	http_1_1_required
+}
+
+struct H2Frame {
+	typ       H2FrameType
+	flags     u8
+	stream_id u32
+	payload   []u8
+}
+
+@[inline]
+fn (f &H2Frame) has(flag u8) bool {
+	return f.flags & flag != 0
+}
+
+// data returns the payload of a DATA or HEADERS frame, without its padding
+fn (f &H2Frame) data() ![]u8 {
+	if !f.has(h2_flag_padded) {
+		return f.payload
+	}
+	if f.payload.len == 0 || int(f.payload[0]) >= f.payload.len {
+		return h2_error(.protocol_error, 'invalid padding')
+	}
+	return f.payload[1..f.payload.len - int(f.payload[0])]
+}
+
+// h2_error returns a connection error, that is reported to the peer with a GOAWAY frame
+fn h2_error(code H2ErrorCode, msg string) IError {
+	return error_with_code('http2: ${msg}', int(code))
+}
+
+// read_h2_frame reads the next frame; a frame bigger than `max_size` is a connection error
+fn read_h2_frame(mut r io.BufferedReader, max_size int) !H2Frame {
+	head := read_body_bytes(mut r, h2_frame_header_size)!
+	len := (int(head[0]) << 16) | (int(head[1]) << 8) | int(head[2])
+	if len > max_size {
+		return h2_error(.frame_size_error, 'frame too large: ${len}')
+	}
+	return H2Frame{
+		typ:       unsafe { H2FrameType(head[3]) }
+		flags:     head[4]
+		stream_id: h2_u32(head, 5) & 0x7fffffff
+		payload:   read_body_bytes(mut r, len)!
+	}
+}
+
+@[inline]
+fn h2_u32(b []u8, pos int) u32 {
+	return (u32(b[pos]) << 24) | (u32(b[pos + 1]) << 16) | (u32(b[pos + 2]) << 8) | u32(b[pos + 3])
+}
+
+fn write_h2_u32(mut out strings.Builder, v u32) {
+	out.write_u8(u8(v >> 24))
+	out.write_u8(u8(v >> 16))
+	out.write_u8(u8(v >> 8))
+	out.write_u8(u8(v))
+}
+
+fn write_h2_frame_header(mut out strings.Builder, len int, typ H2FrameType, flags u8, stream_id u32) {
+	out.write_u8(u8(len >> 16))
+	out.write_u8(u8(len >> 8))
+	out.write_u8(u8(len))
+	out.write_u8(u8(typ))
+	out.write_u8(flags)
+	write_h2_u32(mut out, stream_id)
+}
+
+fn write_h2_frame(mut out strings.Builder, typ H2FrameType, flags u8, stream_id u32, payload []u8) {
+	write_h2_frame_header(mut out, payload.len, typ, flags, stream_id)
+	unsafe { out.write_ptr(payload.data, payload.len) }
+}
+
+// write_h2_headers writes a header block as a HEADERS frame, followed by as many CONTINUATION
+// frames, as needed to keep each frame within `max_frame_size`
+fn write_h2_headers(mut out strings.Builder, stream_id u32, block []u8, end_stream bool, max_frame_size int) {
+	mut pos := 0
+	mut typ := H2FrameType.headers
+	for {
+		n := if block.len - pos > max_frame_size { max_frame_size } else { block.len - pos }
+		mut flags := u8(0)
+		if typ == .headers && end_stream {
+			flags |= h2_flag_end_stream
+		}
+		if pos + n == block.len {
+			flags |= h2_flag_end_headers
+		}
+		write_h2_frame_header(mut out, n, typ, flags, stream_id)
+		unsafe { out.write_ptr(&u8(block.data) + pos, n) }
+		pos += n
+		if pos == block.len {
+			break
+		}
+		typ = .continuation
+	}
+}
+
+// write_h2_settings writes a SETTINGS frame; `settings` holds pairs of identifiers and values
+fn write_h2_settings(mut out strings.Builder, settings []u32) {
+	write_h2_frame_header(mut out, settings.len / 2 * 6, .settings, 0, 0)
+	for i := 0; i + 1 < settings.len; i += 2 {
+		out.write_u8(u8(settings[i] >> 8))
+		out.write_u8(u8(settings[i]))
+		write_h2_u32(mut out, settings[i + 1])
+	}
+}
+
+fn write_h2_window_update(mut out strings.Builder, stream_id u32, increment u32) {
+	write_h2_frame_header(mut out, 4, .window_update, 0, stream_id)
+	write_h2_u32(mut out, increment)
+}
+
+fn write_h2_rst_stream(mut out strings.Builder, stream_id u32, code H2ErrorCode) {
+	write_h2_frame_header(mut out, 4, .rst_stream, 0, stream_id)
+	write_h2_u32(mut out, u32(code))
+}
+
+fn write_h2_goaway(mut out strings.Builder, last_stream_id u32, code H2ErrorCode, debug string) {
+	write_h2_frame_header(mut out, 8 + debug.len, .goaway, 0, 0)
+	write_h2_u32(mut out, last_stream_id)
+	write_h2_u32(mut out, u32(code))
+	out.write_string(debug)
+}
+
+// h2_window_increment parses the payload of a WINDOW_UPDATE frame
+fn h2_window_increment(f &H2Frame) !u32 {
+	if f.payload.len != 4 {
+		return h2_error(.frame_size_error, 'invalid WINDOW_UPDATE frame')
+	}
+	return h2_u32(f.payload, 0) & 0x7fffffff
+}
@@ -0,0 +1,426 @@
+// Copyright (c) 2019-2024 Alexander Medvednikov. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+module http
+
+// HPACK, the header compression of HTTP/2 (RFC 7541)
+
+// HpackField is a single decoded header field; the names are always in lower case
+struct HpackField {
+	name  string
+	value string
+}
+
+const hpack_default_table_size = 4096
+
+// the overhead of each entry in the dynamic table, RFC 7541, 4.1
+const hpack_entry_overhead = 32
+
+// the static table, RFC 7541, Appendix A. The HPACK index of an entry is its position + 1.
+const hpack_static_table = [
+	[':authority', ''],
+	[':method', 'GET'],
+	[':method', 'POST'],
+	[':path', '/'],
+	[':path', '/index.html'],
+	[':scheme', 'http'],
+	[':scheme', 'https'],
+	[':status', '200'],
+	[':status', '204'],
+	[':status', '206'],
+	[':status', '304'],
+	[':status', '400'],
+	[':status', '404'],
+	[':status', '500'],
+	['accept-charset', ''],
+	['accept-encoding', 'gzip, deflate'],
+	['accept-language', ''],
+	['accept-ranges', ''],
+	['accept', ''],
+	['access-control-allow-origin', ''],
+	['age', ''],
+	['allow', ''],
+	['authorization', ''],
+	['cache-control', ''],
+	['content-disposition', ''],
+	['content-encoding', ''],
+	['content-language', ''],
+	['content-length', ''],
+	['content-location', ''],
+	['content-range', ''],
+	['content-type', ''],
+	['cookie', ''],
+	['date', ''],
+	['etag', ''],
+	['expect', ''],
+	['expires', ''],
+	['from', ''],
+	['host', ''],
+	['if-match', ''],
+	['if-modified-since', ''],
+	['if-none-match', ''],
+	['if-range', ''],
+	['if-unmodified-since', ''],
+	['last-modified', ''],
+	['link', ''],
+	['location', ''],
+	['max-forwards', ''],
+	['proxy-authenticate', ''],
+	['proxy-authorization', ''],
+	['range', ''],
+	['referer', ''],
+	['refresh', ''],
+	['retry-after', ''],
+	['server', ''],
+	['set-cookie', ''],
+	['strict-transport-security', ''],
+	['transfer-encoding', ''],
+	['user-agent', ''],
+	['vary', ''],
+	['via', ''],
+	['www-authenticate', ''],
+]
+
+// the decoding tree of the Huffman code, see build_hpack_huffman_tree
+const hpack_huffman_tree = build_hpack_huffman_tree()
+
+// HpackTable is the dynamic table of an encoder or a decoder. The newest entry is the last one.
+struct HpackTable {
+mut:
+	entries  []HpackField
+	size     int // the sum of the sizes of the entries
+	max_size int = hpack_default_table_size
+}
+
+// add inserts a new entry, evicting the oldest entries to make room for it.
+// An entry bigger than the whole table just empties it.
+fn (mut t HpackTable) add(name string, value string) {
+	esize := name.len + value.len + hpack_entry_overhead
+	t.evict(t.max_size - esize)
+	if esize <= t.max_size {
+		t.entries << HpackField{
+			name:  name
+			value: value
+		}
+		t.size += esize
+	}
+}
+
+// evict drops the oldest entries, till the size of the table is at most `size`
+fn (mut t HpackTable) evict(size int) {
+	mut n := 0
+	for t.size > size && n < t.entries.len {
+		e := t.entries[n]
+		t.size -= e.name.len + e.value.len + hpack_entry_overhead
+		n++
+	}
+	if n > 0 {
+		t.entries.delete_many(0, n)
+	}
+}
+
+fn (mut t HpackTable) set_max_size(size int) {
+	t.max_size = size
+	t.evict(size)
+}
+
+// get returns the field at an HPACK index: 1..61 are in the static table, and the next ones
+// in the dynamic table, the newest entry first
+fn (t &HpackTable) get(index int) !HpackField {
+	if index >= 1 && index <= hpack_static_table.len {
+		e := hpack_static_table[index - 1]
+		return HpackField{
+			name:  e[0]
+			value: e[1]
+		}
+	}
+	i := index - hpack_static_table.len - 1
+	if i >= 0 && i < t.entries.len {
+		return t.entries[t.entries.len - 1 - i]
+	}
+	return hpack_error('invalid index ${index}')
+}
+
+// HpackDecoder decodes the header blocks, received on a connection
+struct HpackDecoder {
+mut:
+	table          HpackTable
+	max_table_size int = hpack_default_table_size // the limit for the table size updates, announced with SETTINGS_HEADER_TABLE_SIZE
+}
+
+// decode decodes a complete header block. All the blocks of a connection have to be decoded in
+// the order they were received, even the ones that are rejected later, to keep the dynamic table in sync.
+fn (mut d HpackDecoder) decode(block []u8) ![]HpackField {
+	mut fields := []HpackField{cap: 16}
+	mut pos := 0
+	for pos < block.len {
+		b := block[pos]
+		if b & 0x80 != 0 {
+			// indexed field
+			index := hpack_decode_int(block, mut pos, 7)!
+			fields << d.table.get(index)!
+		} else if b & 0xc0 == 0x40 {
+			// literal field, added to the dynamic table
+			f := d.decode_literal(block, mut pos, 6)!
+			d.table.add(f.name, f.value)
+			fields << f
+		} else if b & 0xe0 == 0x20 {
+			// dynamic table size update
+			size := hpack_decode_int(block, mut pos, 5)!
+			if size > d.max_table_size {
+				return hpack_error('table size update over the limit: ${size}')
+			}
+			d.table.set_max_size(size)
+		} else {
+			// literal field without indexing (0000xxxx), or never indexed (0001xxxx)
+			fields << d.decode_literal(block, mut pos, 4)!
+		}
+	}
+	return fields
+}
+
+fn (mut d HpackDecoder) decode_literal(block []u8, mut pos int, prefix int) !HpackField {
+	index := hpack_decode_int(block, mut pos, prefix)!
+	name := if index == 0 { hpack_decode_string(block, mut pos)! } else { d.table.get(index)!.name }
+	value := hpack_decode_string(block, mut pos)!
+	return HpackField{
+		name:  name
+		value: value
+	}
+}
+
+// HpackEncoder encodes the header blocks, sent on a connection
+struct HpackEncoder {
+mut:
+	table          HpackTable
+	pending_update bool // the next block has to start with a dynamic table size update
+}
+
+// set_max_table_size applies the SETTINGS_HEADER_TABLE_SIZE of the peer. The encoder never uses more
+// than the default size, even when the peer allows it.
+fn (mut e HpackEncoder) set_max_table_size(size int) {
+	new_size := if size < hpack_default_table_size { size } else { hpack_default_table_size }
+	if new_size != e.table.max_size {
+		e.table.set_max_size(new_size)
+		e.pending_update = true
+	}
+}
+
+// encode appends the header block of `fields` to `out`. The names have to be in lower case.
+fn (mut e HpackEncoder) encode(mut out []u8, fields []HpackField) {
+	if e.pending_update {
+		hpack_encode_int(mut out, e.table.max_size, 5, 0x20)
+		e.pending_update = false
+	}
+	for f in fields {
+		index, name_index := e.find(f.name, f.value)
+		if index > 0 {
+			hpack_encode_int(mut out, index, 7, 0x80)
+			continue
+		}
+		esize := f.name.len + f.value.len + hpack_entry_overhead
+		if f.name in ['authorization', 'proxy-authorization'] {
+			// never indexed, so that the intermediaries do not index them either
+			hpack_encode_int(mut out, name_index, 4, 0x10)
+		} else if esize > e.table.max_size / 2 {
+			// too big to be worth evicting the other entries for
+			hpack_encode_int(mut out, name_index, 4, 0x00)
+		} else {
+			hpack_encode_int(mut out, name_index, 6, 0x40)
+			e.table.add(f.name, f.value)
+		}
+		if name_index == 0 {
+			hpack_encode_string(mut out, f.name)
+		}
+		hpack_encode_string(mut out, f.value)
+	}
+}
+
+// find returns the index of an entry with the same name and value, or 0, and the index of
+// an entry with the same name, or 0
+fn (e &HpackEncoder) find(name string, value string) (int, int) {
+	mut name_index := 0
+	for i, entry in hpack_static_table {
+		if entry[0] == name {
+			if entry[1] == value {
+				return i + 1, i + 1
+			}
+			if name_index == 0 {
+				name_index = i + 1
+			}
+		}
+	}
+	n := e.table.entries.len
+	for j := n - 1; j >= 0; j-- {
+		entry := e.table.entries[j]
+		if entry.name == name {
+			index := hpack_static_table.len + n - j
+			if entry.value == value {
+				return index, index
+			}
+			if name_index == 0 {
+				name_index = index
+			}
+		}
+	}
+	return 0, name_index
+}
+
+fn hpack_error(msg string) IError {
+	return error_with_code('hpack: ${msg}', int(H2ErrorCode.compression_error))
+}
+
+// hpack_decode_int decodes an integer with a `prefix` bits prefix, at block[pos], RFC 7541, 5.1
+fn hpack_decode_int(block []u8, mut pos int, prefix int) !int {
+	if pos >= block.len {
+		return hpack_error('truncated integer')
+	}
+	mask := (1 << prefix) - 1
+	mut value := int(block[pos]) & mask
+	pos++
+	if value < mask {
+		return value
+	}
+	mut shift := 0
+	for {
+		if pos >= block.len {
+			return hpack_error('truncated integer')
+		}
+		if shift > 21 {
+			return hpack_error('integer overflow')
+		}
+		b := block[pos]
+		pos++
+		value += int(b & 0x7f) << shift
+		shift += 7
+		if b & 0x80 == 0 {
+			break
+		}
+	}
+	return value
+}
+
+fn hpack_encode_int(mut out []u8, value int, prefix int, first u8) {
+	mask := (1 << prefix) - 1
+	if value < mask {
+		out << (first | u8(value))
+		return
+	}
+	out << (first | u8(mask))
+	mut v := value - mask
+	for v >= 0x80 {
+		out << (u8(v & 0x7f) | 0x80)
+		v >>= 7
+	}
+	out << u8(v)
+}
+
+// hpack_decode_string decodes a string literal, plain or Huffman coded, at block[pos], RFC 7541, 5.2
+fn hpack_decode_string(block []u8, mut pos int) !string {
+	if pos >= block.len {
+		return hpack_error('truncated string')
+	}
+	huffman := block[pos] & 0x80 != 0
+	len := hpack_decode_int(block, mut pos, 7)!
+	if len > block.len - pos {
+		return hpack_error('truncated string')
+	}
+	raw := block[pos..pos + len]
+	pos += len
+	if huffman {
+		return hpack_huffman_decode(raw)
+	}
+	return raw.bytestr()
+}
+
+// hpack_encode_string appends a string literal, Huffman coded when that makes it shorter
+fn hpack_encode_string(mut out []u8, s string) {
+	hlen := hpack_huffman_len(s)
+	if hlen < s.len {
+		hpack_encode_int(mut out, hlen, 7, 0x80)
+		hpack_huffman_encode(mut out, s)
+	} else {
+		hpack_encode_int(mut out, s.len, 7, 0x00)
+		unsafe { out.push_many(s.str, s.len) }
+	}
+}
+
+// build_hpack_huffman_tree builds the binary tree, used to decode the Huffman code bit by bit.
+// The node `i` has its children at [2 * i] (bit 0) and [2 * i + 1] (bit 1); a child is
+// either the index of another node, or a leaf -(symbol + 1), or 0 when there is no such code.
+fn build_hpack_huffman_tree() []int {
+	mut tree := []int{len: 2, cap: 1024}
+	for sym in 0 .. 256 {
+		code := hpack_huffman_codes[sym]
+		len := int(hpack_huffman_lens[sym])
+		mut node := 0
+		for i := len - 1; i > 0; i-- {
+			bit := int((code >> u32(i)) & 1)
+			if tree[2 * node + bit] == 0 {
+				tree[2 * node + bit] = tree.len / 2
+				tree << [0, 0]
+			}
+			node = tree[2 * node + bit]
+		}
+		tree[2 * node + int(code & 1)] = -(sym + 1)
+	}
+	return tree
+}
+
+fn hpack_huffman_decode(data []u8) !string {
+	mut out := []u8{cap: data.len * 8 / 5 + 1}
+	mut node := 0
+	mut nbits := 0 // the bits read since the last complete symbol
+	mut all_ones := true
+	for b in data {
+		for i := 7; i >= 0; i-- {
+			bit := int((b >> u8(i)) & 1)
+			next := hpack_huffman_tree[2 * node + bit]
+			nbits++
+			if bit == 0 {
+				all_ones = false
+			}
+			if next < 0 {
+				out << u8(-next - 1)
+				node = 0
+				nbits = 0
+				all_ones = true
+			} else if next == 0 {
+				return hpack_error('invalid Huffman code')
+			} else {
+				node = next
+			}
+		}
+	}
+	// the padding has to be a prefix of EOS (all ones), shorter than a byte
+	if nbits > 7 || !all_ones {
+		return hpack_error('invalid Huffman padding')
+	}
+	return out.bytestr()
+}
+
+fn hpack_huffman_len(s string) int {
+	mut bits := 0
+	for c in s {
+		bits += int(hpack_huffman_lens[c])
+	}
+	return (bits + 7) / 8
+}
+
+fn hpack_huffman_encode(mut out []u8, s string) {
+	mut acc := u64(0)
+	mut nbits := 0
+	for c in s {
+		len := int(hpack_huffman_lens[c])
+		acc = (acc << u64(len)) | u64(hpack_huffman_codes[c])
+		nbits += len
+		for nbits >= 8 {
+			nbits -= 8
+			out << u8(acc >> u64(nbits))
+		}
+	}
+	if nbits > 0 {
+		// pad with the most significant bits of EOS
+		out << (u8(acc << u64(8 - nbits)) | u8(0xff >> nbits))
+	}
+}
@@ -0,0 +1,165 @@
+module http
+
+import encoding.hex
+
+// the requests of RFC 7541, C.4, encoded with Huffman coding, on a single connection
+const rfc_requests = [
+	[
+		HpackField{
+			name:  ':method'
+			value: 'GET'
+		},
+		HpackField{
+			name:  ':scheme'
+			value: 'http'
+		},
+		HpackField{
+			name:  ':path'
+			value: '/'
+		},
+		HpackField{
+			name:  ':authority'
+			value: 'www.example.com'
+		},
+	],
+	[
+		HpackField{
+			name:  ':method'
+			value: 'GET'
+		},
+		HpackField{
+			name:  ':scheme'
+			value: 'http'
+		},
+		HpackField{
+			name:  ':path'
+			value: '/'
+		},
+		HpackField{
+			name:  ':authority'
+			value: 'www.example.com'
+		},
+		HpackField{
+			name:  'cache-control'
+			value: 'no-cache'
+		},
+	],
+	[
+		HpackField{
+			name:  ':method'
+			value: 'GET'
+		},
+		HpackField{
+			name:  ':scheme'
+			value: 'https'
+		},
+		HpackField{
+			name:  ':path'
+			value: '/index.html'
+		},
+		HpackField{
+			name:  ':authority'
+			value: 'www.example.com'
+		},
+		HpackField{
+			name:  'custom-key'
+			value: 'custom-value'
+		},
+	],
+]
+
+const rfc_blocks = ['828684418cf1e3c2e5f23a6ba0ab90f4ff', '828684be5886a8eb10649cbf',
+	'828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf']
+
+fn test_hpack_decode_rfc_examples() {
+	mut d := HpackDecoder{}
+	for i, block in rfc_blocks {
+		fields := d.decode(hex.decode(block)!)!
+		assert fields == rfc_requests[i]
+	}
+	assert d.table.size == 164
+	assert d.table.entries.len == 3
+}
+
+fn test_hpack_encode_rfc_examples() {
+	mut e := HpackEncoder{}
+	for i, fields in rfc_requests {
+		mut block := []u8{}
+		e.encode(mut block, fields)
+		assert hex.encode(block) == rfc_blocks[i]
+	}
+	assert e.table.size == 164
+}
+
+fn test_hpack_round_trip() {
+	mut e := HpackEncoder{}
+	mut d := HpackDecoder{}
+	e.set_max_table_size(256)
+	d.max_table_size = 256
+	for i in 0 .. 50 {
+		fields := [
+			HpackField{
+				name:  ':status'
+				value: '200'
+			},
+			HpackField{
+				name:  'content-type'
+				value: 'text/plain'
+			},
+			HpackField{
+				name:  'x-request'
+				value: 'request ${i}'
+			},
+			HpackField{
+				name:  'set-cookie'
+				value: 'id=${i % 3}'
+			},
+			HpackField{
+				name:  'authorization'
+				value: 'secret'
+			},
+			HpackField{
+				name:  'x-binary'
+				value: '\x01\x7f\xff ${'a'.repeat(i * 10)}'
+			},
+		]
+		mut block := []u8{}
+		e.encode(mut block, fields)
+		assert d.decode(block)! == fields
+		assert d.table.size <= 256
+	}
+	// `authorization` is never indexed
+	for entry in e.table.entries {
+		assert entry.name != 'authorization'
+	}
+}
+
+fn test_hpack_decode_errors() {
+	mut d := HpackDecoder{}
+	// an index out of the static and the dynamic tables
+	if _ := d.decode([u8(0xbf)]) {
+		assert false
+	} else {
+		assert err.code() == int(H2ErrorCode.compression_error)
+	}
+	// a string longer than the block
+	if _ := d.decode([u8(0x40), 0x05, 0x61]) {
+		assert false
+	}
+	// a table size update over the limit, announced with SETTINGS_HEADER_TABLE_SIZE
+	if _ := d.decode([u8(0x3f), 0xe1, 0x3f]) {
+		assert false
+	}
+}
+
+fn test_hpack_integers() {
+	for prefix in [4, 5, 6, 7] {
+		for value in [0, 1, 14, 15, 30, 31, 62, 63, 126, 127, 128, 1337, 65535, 1 << 24] {
+			mut out := []u8{}
+			hpack_encode_int(mut out, value, prefix, 0)
+			mut pos := 0
+			assert hpack_decode_int(out, mut pos, prefix)! == value
+			assert pos == out.len
+		}
+	}
+}
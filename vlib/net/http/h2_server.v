@@ -0,0 +1,623 @@
+// Copyright (c) 2019-2024 Alexander Medvednikov. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+module http
+
+import io
+import net
+import strings
+import time
+
+// the maximum number of concurrent streams, that a client can open on a connection
+const h2_server_max_streams = 100
+
+@[params]
+pub struct ServeHttp2Config {
+pub:
+	max_header_size int           = 16 * 1024 // the maximum size of the decoded request headers; bigger requests get a 431 response
+	max_body_size   int           = 16 * 1024 * 1024 // the maximum size of a request body; bigger requests get a 413 response
+	read_timeout    time.Duration = 30 * time.second
+	idle_timeout    time.Duration = 30 * time.second // how long the connection can stay without any open stream
+}
+
+// serve_http2 serves an HTTP/2 connection with cleartext prior knowledge (h2c), with `handler`,
+// till the client closes it, or it stays idle for longer than `config.idle_timeout`.
+// The client preface has to be consumed already; `preread` are the bytes, that were read from
+// `conn` after it. The `Server` does this by itself; serve_http2 is for the other servers, like veb.
+// The streams of the connection are multiplexed, but the handler is called for one request at a time.
+pub fn serve_http2(mut conn net.TcpConn, preread []u8, mut handler Handler, config ServeHttp2Config) {
+	mut reader := io.new_buffered_reader(
+		reader: &H2PrereadReader{
+			preread: preread
+			conn:    conn
+		}
+		cap:    worker_buffer_size
+	)
+	mut c := &H2ServerConn{
+		config:    config
+		remote_ip: conn.peer_ip() or { '0.0.0.0' }
+		conn:      conn
+		reader:    reader
+		handler:   handler
+		out:       strings.new_builder(worker_buffer_size)
+	}
+	c.serve()
+	conn.close() or {}
+}
+
+// H2PrereadReader returns the bytes already read from a connection, before reading from it again
+struct H2PrereadReader {
+mut:
+	preread []u8
+	conn    &net.TcpConn
+}
+
+fn (mut r H2PrereadReader) read(mut buf []u8) !int {
+	if r.preread.len > 0 {
+		n := copy(mut buf, r.preread)
+		r.preread = r.preread[n..]
+		return n
+	}
+	return r.conn.read(mut buf)
+}
+
+// serve_h2 serves the HTTP/2 connection, after the `PRI * HTTP/2.0` line of the client preface,
+// that parses like an HTTP/1 request, has been read already
+fn (mut w HandlerWorker) serve_h2(mut conn net.TcpConn, remote_ip string) {
+	// the rest of the preface is `SM\r\n\r\n`
+	sm := w.reader.read_line() or { return }
+	empty := w.reader.read_line() or { return }
+	if sm != 'SM' || empty != '' {
+		return
+	}
+	mut c := &H2ServerConn{
+		config:    ServeHttp2Config{
+			max_header_size: w.max_header_size
+			max_body_size:   w.max_body_size
+			read_timeout:    w.read_timeout
+			idle_timeout:    w.idle_timeout
+		}
+		remote_ip: remote_ip
+		conn:      conn
+		reader:    w.reader
+		handler:   w.handler
+		out:       strings.new_builder(worker_buffer_size)
+	}
+	c.serve()
+}
+
+struct H2ServerStream {
+	id u32
+mut:
+	method       Method
+	fields       []HpackField
+	body         []u8
+	recv_done    bool // the client has sent its whole request
+	recv_unacked int  // the received bytes, not acknowledged yet with a WINDOW_UPDATE
+	responded    bool
+	out          string // the response body
+	out_pos      int
+	send_window  i64
+}
+
+// H2ServerConn is the state of an HTTP/2 connection, served by a Server
+@[heap]
+struct H2ServerConn {
+	config    ServeHttp2Config
+	remote_ip string
+mut:
+	conn    &net.TcpConn
+	reader  &io.BufferedReader
+	handler Handler
+	out     strings.Builder
+	enc     HpackEncoder
+	dec     HpackDecoder
+	streams map[u32]&H2ServerStream
+	// the flow control of the connection
+	send_window         i64 = h2_default_window_size
+	recv_unacked        int
+	peer_initial_window i64 = h2_default_window_size
+	peer_max_frame      int = h2_default_max_frame_size
+	last_stream_id      u32
+	got_settings        bool
+	goaway              bool // the client is going away, or the server is closing the connection
+	// the header block in progress, of a HEADERS frame, followed by CONTINUATION frames
+	block_stream     u32
+	block            []u8
+	block_end_stream bool
+}
+
+// serve reads and handles the frames of the connection, till it is closed
+fn (mut c H2ServerConn) serve() {
+	write_h2_settings(mut c.out, [
+		u32(h2_settings_max_concurrent_streams),
+		u32(h2_server_max_streams),
+		u32(h2_settings_initial_window_size),
+		u32(h2_recv_window_size),
+		u32(h2_settings_max_header_list_size),
+		u32(c.config.max_header_size),
+	])
+	write_h2_window_update(mut c.out, 0, u32(h2_recv_window_size - h2_default_window_size))
+	c.flush() or { return }
+	for {
+		if c.streams.len == 0 {
+			if c.goaway {
+				break
+			}
+			c.conn.set_read_timeout(c.config.idle_timeout)
+		} else {
+			c.conn.set_read_timeout(c.config.read_timeout)
+		}
+		frame := read_h2_frame(mut c.reader, h2_default_max_frame_size) or {
+			if err.code() == int(H2ErrorCode.frame_size_error) {
+				c.close_with_error(err)
+			}
+			break
+		}
+		c.handle_frame(frame) or {
+			c.close_with_error(err)
+			break
+		}
+		// the frames, that are already buffered, are handled before the responses are sent together
+		if c.reader.buffered() == 0 || c.out.len >= worker_buffer_size {
+			c.flush() or { break }
+		}
+	}
+	c.flush() or {}
+}
+
+fn (mut c H2ServerConn) handle_frame(f H2Frame) ! {
+	if !c.got_settings && f.typ != .settings {
+		return h2_error(.protocol_error, 'the preface has to be followed by SETTINGS')
+	}
+	if c.block_stream != 0 && f.typ != .continuation {
+		return h2_error(.protocol_error, 'expected a CONTINUATION frame')
+	}
+	match f.typ {
+		.data {
+			c.on_data(f)!
+		}
+		.headers {
+			c.on_headers(f)!
+		}
+		.continuation {
+			if f.stream_id != c.block_stream || c.block_stream == 0 {
+				return h2_error(.protocol_error, 'unexpected CONTINUATION frame')
+			}
+			c.block << f.payload
+			if c.block.len > c.max_block_size() {
+				return h2_error(.enhance_your_calm, 'header block too large')
+			}
+			if f.has(h2_flag_end_headers) {
+				c.end_headers()!
+			}
+		}
+		.rst_stream {
+			if f.stream_id == 0 || f.payload.len != 4 {
+				return h2_error(.protocol_error, 'invalid RST_STREAM frame')
+			}
+			c.streams.delete(f.stream_id)
+		}
+		.settings {
+			c.on_settings(f)!
+		}
+		.ping {
+			if f.stream_id != 0 || f.payload.len != 8 {
+				return h2_error(.protocol_error, 'invalid PING frame')
+			}
+			if !f.has(h2_flag_ack) {
+				write_h2_frame(mut c.out, .ping, h2_flag_ack, 0, f.payload)
+			}
+		}
+		.goaway {
+			c.goaway = true
+		}
+		.window_update {
+			c.on_window_update(f)!
+		}
+		.push_promise {
+			return h2_error(.protocol_error, 'PUSH_PROMISE from a client')
+		}
+		else {
+			// PRIORITY is deprecated, and the unknown frame types have to be ignored
+		}
+	}
+}
+
+// max_block_size limits the encoded header blocks; they can be somewhat bigger than the decoded headers,
+// since the literals may not be compressed at all
+fn (c &H2ServerConn) max_block_size() int {
+	return if c.config.max_header_size > 0 { 2 * c.config.max_header_size + 1024 } else { 1 << 20 }
+}
+
+fn (mut c H2ServerConn) on_headers(f H2Frame) ! {
+	if f.stream_id == 0 || f.stream_id % 2 == 0 {
+		return h2_error(.protocol_error, 'invalid stream id ${f.stream_id} in HEADERS')
+	}
+	mut block := f.data()!
+	if f.has(h2_flag_priority) {
+		if block.len < 5 {
+			return h2_error(.frame_size_error, 'invalid HEADERS frame')
+		}
+		block = block[5..]
+	}
+	if s := c.streams[f.stream_id] {
+		// trailers, after the body of a request
+		if s.recv_done || !f.has(h2_flag_end_stream) {
+			return h2_error(.protocol_error, 'unexpected HEADERS frame on stream ${f.stream_id}')
+		}
+	} else if f.stream_id <= c.last_stream_id {
+		return h2_error(.stream_closed, 'HEADERS frame on the closed stream ${f.stream_id}')
+	} else {
+		c.last_stream_id = f.stream_id
+	}
+	c.block_stream = f.stream_id
+	c.block = block.clone()
+	c.block_end_stream = f.has(h2_flag_end_stream)
+	if c.block.len > c.max_block_size() {
+		return h2_error(.enhance_your_calm, 'header block too large')
+	}
+	if f.has(h2_flag_end_headers) {
+		c.end_headers()!
+	}
+}
+
+// end_headers handles a complete header block; it starts a new request, or ends one with trailers
+fn (mut c H2ServerConn) end_headers() ! {
+	id := c.block_stream
+	c.block_stream = 0
+	fields := c.dec.decode(c.block)!
+	c.block = []u8{}
+	if id in c.streams {
+		// the trailers are decoded, to keep the HPACK state in sync, but otherwise ignored
+		mut s := c.streams[id] or { return }
+		s.recv_done = true
+		c.dispatch(mut s)!
+		return
+	}
+	if c.goaway || c.streams.len >= h2_server_max_streams {
+		write_h2_rst_stream(mut c.out, id, .refused_stream)
+		return
+	}
+	mut s := &H2ServerStream{
+		id:          id
+		fields:      fields
+		send_window: c.peer_initial_window
+		recv_done:   c.block_end_stream
+	}
+	c.streams[id] = s
+	mut size := 0
+	for field in fields {
+		size += field.name.len + field.value.len + hpack_entry_overhead
+	}
+	if c.config.max_header_size > 0 && size > c.config.max_header_size {
+		c.respond_status(mut s, .request_header_fields_too_large)!
+		return
+	}
+	if s.recv_done {
+		c.dispatch(mut s)!
+	}
+}
+
+fn (mut c H2ServerConn) on_data(f H2Frame) ! {
+	if f.stream_id == 0 {
+		return h2_error(.protocol_error, 'DATA frame on stream 0')
+	}
+	// all the DATA frames count for the flow control of the connection, even the ones of closed streams
+	c.recv_unacked += f.payload.len
+	if c.recv_unacked >= h2_recv_window_size / 2 {
+		write_h2_window_update(mut c.out, 0, u32(c.recv_unacked))
+		c.recv_unacked = 0
+	}
+	mut s := c.streams[f.stream_id] or {
+		if f.stream_id > c.last_stream_id {
+			return h2_error(.protocol_error, 'DATA frame on the idle stream ${f.stream_id}')
+		}
+		// a stream, that was reset or answered already
+		return
+	}
+	if s.recv_done {
+		return h2_error(.stream_closed, 'DATA frame after the end of stream ${f.stream_id}')
+	}
+	if s.responded {
+		// answered early (413), so the rest of the body is discarded
+		return
+	}
+	data := f.data()!
+	if c.config.max_body_size > 0 && s.body.len + data.len > c.config.max_body_size {
+		c.respond_status(mut s, .request_entity_too_large)!
+		return
+	}
+	s.body << data
+	if f.has(h2_flag_end_stream) {
+		s.recv_done = true
+		c.dispatch(mut s)!
+		return
+	}
+	s.recv_unacked += f.payload.len
+	if s.recv_unacked >= h2_recv_window_size / 2 {
+		write_h2_window_update(mut c.out, s.id, u32(s.recv_unacked))
+		s.recv_unacked = 0
+	}
+}
+
+fn (mut c H2ServerConn) on_settings(f H2Frame) ! {
+	if f.stream_id != 0 {
+		return h2_error(.protocol_error, 'SETTINGS frame on stream ${f.stream_id}')
+	}
+	if f.has(h2_flag_ack) {
+		if f.payload.len != 0 {
+			return h2_error(.frame_size_error, 'invalid SETTINGS ack')
+		}
+		return
+	}
+	if f.payload.len % 6 != 0 {
+		return h2_error(.frame_size_error, 'invalid SETTINGS frame')
+	}
+	for i := 0; i < f.payload.len; i += 6 {
+		id := (int(f.payload[i]) << 8) | int(f.payload[i + 1])
+		value := h2_u32(f.payload, i + 2)
+		match id {
+			h2_settings_header_table_size {
+				c.enc.set_max_table_size(if value > hpack_default_table_size {
+					hpack_default_table_size
+				} else {
+					int(value)
+				})
+			}
+			h2_settings_enable_push {
+				if value > 1 {
+					return h2_error(.protocol_error, 'invalid SETTINGS_ENABLE_PUSH')
+				}
+			}
+			h2_settings_initial_window_size {
+				if value > h2_max_window_size {
+					return h2_error(.flow_control_error, 'invalid SETTINGS_INITIAL_WINDOW_SIZE')
+				}
+				delta := i64(value) - c.peer_initial_window
+				c.peer_initial_window = i64(value)
+				for _, mut s in c.streams {
+					s.send_window += delta
+				}
+			}
+			h2_settings_max_frame_size {
+				if value < h2_default_max_frame_size || value > h2_max_frame_size {
+					return h2_error(.protocol_error, 'invalid SETTINGS_MAX_FRAME_SIZE')
+				}
+				// bigger frames do not help much, and would need bigger buffers
+				c.peer_max_frame = if value > 4 * h2_default_max_frame_size {
+					4 * h2_default_max_frame_size
+				} else {
+					int(value)
+				}
+			}
+			else {}
+		}
+	}
+	c.got_settings = true
+	write_h2_frame_header(mut c.out, 0, .settings, h2_flag_ack, 0)
+	// a bigger initial window may let the pending responses continue
+	c.send_pending()!
+}
+
+fn (mut c H2ServerConn) on_window_update(f H2Frame) ! {
+	increment := h2_window_increment(f)!
+	if f.stream_id == 0 {
+		if increment == 0 {
+			return h2_error(.protocol_error, 'WINDOW_UPDATE with a 0 increment')
+		}
+		c.send_window += increment
+		if c.send_window > h2_max_window_size {
+			return h2_error(.flow_control_error, 'the connection window is too large')
+		}
+		c.send_pending()!
+		return
+	}
+	mut s := c.streams[f.stream_id] or { return }
+	if increment == 0 || s.send_window + increment > h2_max_window_size {
+		write_h2_rst_stream(mut c.out, s.id, if increment == 0 {
+			H2ErrorCode.protocol_error
+		} else {
+			H2ErrorCode.flow_control_error
+		})
+		c.streams.delete(s.id)
+		return
+	}
+	s.send_window += increment
+	if s.responded {
+		c.send_data(mut s)!
+	}
+}
+
+// dispatch passes a complete request to the handler, and starts sending its response
+fn (mut c H2ServerConn) dispatch(mut s H2ServerStream) ! {
+	if s.responded {
+		return
+	}
+	req := c.build_request(mut s) or {
+		c.respond_status(mut s, .bad_request)!
+		return
+	}
+	resp := c.handler.handle(req)
+	c.respond(mut s, resp)!
+}
+
+// build_request makes a Request from the decoded header fields and the body of the stream
+fn (c &H2ServerConn) build_request(mut s H2ServerStream) !Request {
+	mut header := new_header()
+	mut method := ''
+	mut path := ''
+	mut scheme := ''
+	mut authority := ''
+	mut regular := false
+	for f in s.fields {
+		if f.name.starts_with(':') {
+			if regular {
+				return error('pseudo-header field after a regular one')
+			}
+			match f.name {
+				':method' { method = f.value }
+				':path' { path = f.value }
+				':scheme' { scheme = f.value }
+				':authority' { authority = f.value }
+				else { return error('unknown pseudo-header field ${f.name}') }
+			}
+			continue
+		}
+		regular = true
+		if f.name in h2_connection_headers || (f.name == 'te' && f.value != 'trailers') {
+			return error('connection-specific header field ${f.name}')
+		}
+		header.add_custom(f.name, f.value)!
+	}
+	if method == '' || (method != 'CONNECT' && (path == '' || scheme == '')) {
+		return error('missing pseudo-header fields')
+	}
+	if authority != '' && !header.contains(.host) {
+		header.add(.host, authority)
+	}
+	header.add_custom('Remote-Addr', c.remote_ip) or {}
+	mut cookies := map[string]string{}
+	for _, cookie in read_cookies(header, '') {
+		cookies[cookie.name] = cookie.value
+	}
+	s.method = method_from_str(method)
+	return Request{
+		method:  s.method
+		url:     path
+		header:  header
+		host:    header.get(.host) or { '' }
+		version: .v2_0
+		data:    s.body.bytestr()
+		cookies: cookies
+	}
+}
+
+fn (mut c H2ServerConn) respond_status(mut s H2ServerStream, status Status) ! {
+	mut resp := Response{}
+	resp.set_status(status)
+	c.respond(mut s, resp)!
+	if !s.recv_done {
+		// the rest of the request is not needed
+		write_h2_rst_stream(mut c.out, s.id, .no_error)
+		c.streams.delete(s.id)
+	}
+}
+
+// respond sends the headers of the response, and as much of its body, as the flow control allows
+fn (mut c H2ServerConn) respond(mut s H2ServerStream, resp Response) ! {
+	mut fields := []HpackField{cap: resp.header.cur_pos + 2}
+	fields << HpackField{
+		name:  ':status'
+		value: if resp.status_code == 0 { '200' } else { resp.status_code.str() }
+	}
+	for i := 0; i < resp.header.cur_pos; i++ {
+		kv := resp.header.data[i]
+		if kv.value == '' {
+			continue
+		}
+		name := kv.key.to_lower()
+		if name in h2_connection_headers {
+			continue
+		}
+		fields << HpackField{
+			name:  name
+			value: kv.value
+		}
+	}
+	if !resp.header.contains(.content_length) {
+		fields << HpackField{
+			name:  'content-length'
+			value: resp.body.len.str()
+		}
+	}
+	mut block := []u8{cap: 256}
+	c.enc.encode(mut block, fields)
+	body_len := if s.method == .head { 0 } else { resp.body.len }
+	write_h2_headers(mut c.out, s.id, block, body_len == 0, c.peer_max_frame)
+	s.responded = true
+	if body_len == 0 {
+		c.finish(mut s)
+		return
+	}
+	s.out = resp.body
+	c.send_data(mut s)!
+}
+
+// send_data sends the pending body of a response, within the flow control windows
+fn (mut c H2ServerConn) send_data(mut s H2ServerStream) ! {
+	for s.out_pos < s.out.len {
+		mut n := s.out.len - s.out_pos
+		if n > c.peer_max_frame {
+			n = c.peer_max_frame
+		}
+		if i64(n) > c.send_window {
+			n = int(c.send_window)
+		}
+		if i64(n) > s.send_window {
+			n = int(s.send_window)
+		}
+		if n <= 0 {
+			// till the next WINDOW_UPDATE
+			return
+		}
+		end := s.out_pos + n == s.out.len
+		write_h2_frame_header(mut c.out, n, .data, if end { h2_flag_end_stream } else { 0 },
+			s.id)
+		unsafe { c.out.write_ptr(s.out.str + s.out_pos, n) }
+		s.out_pos += n
+		c.send_window -= n
+		s.send_window -= n
+		if c.out.len >= worker_buffer_size {
+			c.flush()!
+		}
+	}
+	c.finish(mut s)
+}
+
+// send_pending continues sending the responses, that were waiting for a WINDOW_UPDATE
+fn (mut c H2ServerConn) send_pending() ! {
+	mut ids := []u32{}
+	for id, s in c.streams {
+		if s.responded && s.out_pos < s.out.len {
+			ids << id
+		}
+	}
+	ids.sort()
+	for id in ids {
+		mut s := c.streams[id] or { continue }
+		c.send_data(mut s)!
+	}
+}
+
+// finish forgets a stream, once its response has been sent; if the request is still incoming,
+// it is kept till its end, so that its DATA frames are recognized
+fn (mut c H2ServerConn) finish(mut s H2ServerStream) {
+	if s.recv_done {
+		c.streams.delete(s.id)
+	}
+}
+
+fn (mut c H2ServerConn) close_with_error(err IError) {
+	code := if err.code() > 0 && err.code() <= int(H2ErrorCode.http_1_1_required) {
+		unsafe { H2ErrorCode(err.code()) }
+	} else {
+		H2ErrorCode.internal_error
+	}
+	$if debug {
+		eprintln('http2: closing the connection: ${err}')
+	}
+	write_h2_goaway(mut c.out, c.last_stream_id, code, err.msg())
+	c.goaway = true
+	c.flush() or {}
+}
+
+fn (mut c H2ServerConn) flush() ! {
+	if c.out.len == 0 {
+		return
+	}
+	defer {
+		c.out.go_back_to(0)
+	}
+	c.conn.write_ptr(c.out.data, c.out.len)!
+}
@@ -93,6 +93,12 @@ pub fn (req &Request) cookie(name string) ?Cookie {
 
 // do will send the HTTP request and returns `http.Response` as soon as the response is received
 pub fn (req &Request) do() !Response {
+	return req.do_with_client(unsafe { nil })
+}
+
+// do_with_client sends the request, and follows its redirects, over the pooled connections
+// of `client`, or over new connections, that are closed after each response, when `client` is nil
+fn (req &Request) do_with_client(client &Client) !Response {
 	mut url := urllib.parse(req.url) or { return error('http.Request.do: invalid url ${req.url}') }
 	mut rurl := url
 	mut resp := Response{}
@@ -101,7 +107,7 @@ pub fn (req &Request) do() !Response {
 		if nredirects == max_redirects {
 			return error('http.request.do: maximum number of redirects reached (${max_redirects})')
 		}
-		qresp := req.method_and_url_to_response(req.method, rurl)!
+		qresp := req.method_and_url_to_response(req.method, rurl, client)!
 		resp = qresp
 		if !req.allow_redirect {
 			break
@@ -130,7 +136,7 @@ pub fn (req &Request) do() !Response {
 	return resp
 }
 
-fn (req &Request) method_and_url_to_response(method Method, url urllib.URL) !Response {
+fn (req &Request) method_and_url_to_response(method Method, url urllib.URL, client &Client) !Response {
 	host_name := url.hostname()
 	scheme := url.scheme
 	p := url.escaped_path().trim_left('/')
@@ -145,6 +151,10 @@ fn (req &Request) method_and_url_to_response(method Method, url urllib.URL) !Res
 		}
 	}
 	// println('fetch $method, $scheme, $host_name, $nport, $path ')
+	if client != unsafe { nil } && scheme in ['http', 'https'] && req.can_use_pool() {
+		mut c := unsafe { client }
+		return c.round_trip(req, scheme, host_name, nport, method, path)
+	}
 	if scheme == 'https' && req.proxy == unsafe { nil } {
 		// println('ssl_do( $nport, $method, $host_name, $path )')
 		for i in 0 .. req.max_retries {
@@ -182,6 +192,12 @@ fn (req &Request) method_and_url_to_response(method Method, url urllib.URL) !Res
 }
 
 fn (req &Request) build_request_headers(method Method, host_name string, path string) string {
+	return req.build_request_headers_ex(method, host_name, path, false)
+}
+
+// build_request_headers_ex is build_request_headers, but asks the server to keep the connection
+// open after the response, when `keep_alive` is true
+fn (req &Request) build_request_headers_ex(method Method, host_name string, path string, keep_alive bool) string {
 	mut sb := strings.new_builder(4096)
 	version := if req.version == .unknown { Version.v1_1 } else { req.version }
 	sb.write_string(method.str())
@@ -218,7 +234,11 @@ fn (req &Request) build_request_headers(method Method, host_name string, path st
 		sb.write_string('\r\n')
 	}
 	sb.write_string(req.build_request_cookies_header())
-	sb.write_string('Connection: close\r\n')
+	if !keep_alive {
+		sb.write_string('Connection: close\r\n')
+	} else if !req.header.contains(.connection) {
+		sb.write_string('Connection: keep-alive\r\n')
+	}
 	sb.write_string('\r\n')
 	sb.write_string(req.data)
 	return sb.str()
@@ -365,12 +385,32 @@ pub fn (req &Request) referer() string {
 // parse_request parses a raw HTTP request into a Request object.
 // See also: `parse_request_head`, which parses only the headers.
 pub fn parse_request(mut reader io.BufferedReader) !Request {
-	mut request := parse_request_head(mut reader)!
+	return parse_request_with_limits(mut reader, 0, 0)
+}
+
+// parse_request_with_limits works like parse_request, but fails with an error, whose code is the
+// matching response status, when the request line and the headers take more than `max_header_size`
+// bytes, or when the body is longer than `max_body_size` bytes. 0 means no limit.
+// Only the bodies with a `Content-Length` are read: the requests with a `Transfer-Encoding` are
+// rejected, since their body would otherwise be left in `reader`, and parsed as the next request.
+fn parse_request_with_limits(mut reader io.BufferedReader, max_header_size int, max_body_size int) !Request {
+	mut request := parse_request_head_with_limit(mut reader, max_header_size)!
+
+	if request.header.contains(.transfer_encoding) {
+		if request.header.contains(.content_length) {
+			return error_with_code('request with both Transfer-Encoding and Content-Length',
+				int(Status.bad_request))
+		}
+		return error_with_code('Transfer-Encoding is not supported', int(Status.not_implemented))
+	}
 
 	// body
 	mut body := []u8{}
 	if length := request.header.get(.content_length) {
 		n := length.int()
+		if max_body_size > 0 && n > max_body_size {
+			return error_with_code('request body too large', int(Status.request_entity_too_large))
+		}
 		if n > 0 {
 			body = []u8{len: n}
 			mut count := 0
@@ -386,13 +426,18 @@ pub fn parse_request(mut reader io.BufferedReader) !Request {
 
 // parse_request_head parses *only* the header of a raw HTTP request into a Request object
 pub fn parse_request_head(mut reader io.BufferedReader) !Request {
+	return parse_request_head_with_limit(mut reader, 0)
+}
+
+fn parse_request_head_with_limit(mut reader io.BufferedReader, max_size int) !Request {
+	mut remaining := max_size
 	// request line
-	mut line := reader.read_line()!
+	mut line := read_request_head_line(mut reader, mut remaining, max_size > 0)!
 	method, target, version := parse_request_line(line)!
 
 	// headers
 	mut header := new_header()
-	line = reader.read_line()!
+	line = read_request_head_line(mut reader, mut remaining, max_size > 0)!
 	for line != '' {
 		// key, value := parse_header(line)!
 		mut pos := parse_header_fast(line)!
@@ -407,7 +452,7 @@ pub fn parse_request_head(mut reader io.BufferedReader) !Request {
 		_, _ = key, value
 		// println('key,value=${key},${value}')
 		header.add_custom(key, value)!
-		line = reader.read_line()!
+		line = read_request_head_line(mut reader, mut remaining, max_size > 0)!
 	}
 	// header.coerce(canonicalize: true)
 
@@ -426,6 +471,26 @@ pub fn parse_request_head(mut reader io.BufferedReader) !Request {
 	}
 }
 
+// read_request_head_line reads the next line of the request head; when `limited` is true, it
+// subtracts the length of the line from `remaining`, and fails when there is not enough left.
+@[inline]
+fn read_request_head_line(mut reader io.BufferedReader, mut remaining int, limited bool) !string {
+	if !limited {
+		return reader.read_line()
+	}
+	if remaining <= 0 {
+		return error_with_code('request header too large', int(Status.request_header_fields_too_large))
+	}
+	line := reader.read_line(max_len: remaining) or {
+		if err.code() == -2 && err.msg() == 'line too long' {
+			return error_with_code('request header too large', int(Status.request_header_fields_too_large))
+		}
+		return err
+	}
+	remaining -= line.len + 2
+	return line
+}
+
 fn parse_request_line(s string) !(Method, urllib.URL, Version) {
 	// println('S=${s}')
 	// words := s.split(' ')
@@ -7,6 +7,8 @@ import io
 import net
 import time
 import runtime
+import strings
+
 // ServerStatus is the current status of the server.
 // .closed means that the server is completely inactive (the default on creation, and after calling .close()).
 // .running means that the server is active and serving (after .listen_and_serve()).
@@ -27,7 +29,8 @@ pub const default_server_port = 9009
 
 pub struct Server {
 mut:
-	state ServerStatus = .closed
+	state           ServerStatus = .closed
+	extra_listeners []&net.TcpListener // the other SO_REUSEPORT listeners, when .reuse_port is set
 pub mut:
 	addr               string        = ':${default_server_port}'
 	port               int           = default_server_port @[deprecated: 'use addr']
@@ -39,6 +42,13 @@ pub mut:
 	worker_num         int           = runtime.nr_jobs()
 	listener           net.TcpListener
 
+	keep_alive      bool          = true // serve several requests on each connection (HTTP/1.1 persistent connections, and pipelining). The idle connections wait for their next request in a poller, not on a worker (on linux and macos).
+	idle_timeout    time.Duration = 30 * time.second // how long a kept alive connection can wait for its next request
+	max_header_size int           = 16 * 1024 // the maximum size of the request line and headers; bigger requests get a 431 response
+	max_body_size   int           = 16 * 1024 * 1024 // the maximum size of the request body; bigger requests get a 413 response
+	reuse_port      bool // accept on `listener_num` SO_REUSEPORT listeners, each in its own thread, instead of a single one (not on windows)
+	listener_num    int           = runtime.nr_jobs()
+
 	on_running fn (mut s Server) = unsafe { nil } // Blocking cb. If set, ran by the web server on transitions to its .running state.
 	on_stopped fn (mut s Server) = unsafe { nil } // Blocking cb. If set, ran by the web server on transitions to its .stopped state.
 	on_closed  fn (mut s Server) = unsafe { nil } // Blocking cb. If set, ran by the web server on transitions to its .closed state.
@@ -67,7 +77,7 @@ pub fn (mut s Server) listen_and_serve() {
 		listening_address := if s.addr == '' || s.addr == ':0' { 'localhost:0' } else { s.addr }
 		listen_family := net.AddrFamily.ip
 		// listen_family := $if windows { net.AddrFamily.ip } $else { net.AddrFamily.ip6 }
-		s.listener = net.listen_tcp(listen_family, listening_address) or {
+		s.listener = net.listen_tcp(listen_family, listening_address, reuse_port: s.reuse_port) or {
 			eprintln('Listening on ${s.addr} failed, err: ${err}')
 			return
 		}
@@ -75,16 +85,31 @@ pub fn (mut s Server) listen_and_serve() {
 			eprintln('Failed getting listener address 2, err: ${err}')
 			return
 		}
+		if s.reuse_port {
+			for _ in 1 .. s.listener_num {
+				mut extra := net.listen_tcp(listen_family, l.str(), reuse_port: true) or {
+					eprintln('Listening with SO_REUSEPORT on ${l} failed, err: ${err}')
+					break
+				}
+				extra.set_accept_timeout(s.accept_timeout)
+				s.extra_listeners << extra
+			}
+		}
 	}
 	s.addr = l.str()
 	s.listener.set_accept_timeout(s.accept_timeout)
 
 	// Create tcp connection channel
 	ch := chan &net.TcpConn{cap: s.pool_channel_slots}
+	// the idle kept alive connections go back to the workers through ch, when their next request arrives
+	mut idle := &IdleConns(unsafe { nil })
+	if s.keep_alive {
+		idle = new_idle_conns(ch, s.idle_timeout) or { unsafe { nil } }
+	}
 	// Create workers
 	mut ws := []thread{cap: s.worker_num}
 	for wid in 0 .. s.worker_num {
-		ws << new_handler_worker(wid, ch, s.handler)
+		ws << new_handler_worker(wid, ch, s, idle)
 	}
 
 	if s.show_startup_message {
@@ -97,12 +122,31 @@ pub fn (mut s Server) listen_and_serve() {
 	if s.on_running != unsafe { nil } {
 		s.on_running(mut s)
 	}
+	mut accepters := []thread{cap: s.extra_listeners.len}
+	for mut extra in s.extra_listeners {
+		accepters << spawn s.accept_loop(mut extra, ch)
+	}
+	s.accept_loop(mut s.listener, ch)
+	accepters.wait()
+	if idle != unsafe { nil } {
+		idle.close()
+	}
+	if s.state == .stopped {
+		s.close()
+	}
+}
+
+// accept_loop accepts the connections of `listener`, and hands them to the workers, while the server is running
+fn (s &Server) accept_loop(mut listener net.TcpListener, ch chan &net.TcpConn) {
 	for s.state == .running {
-		mut conn := s.listener.accept() or {
+		mut conn := listener.accept() or {
 			if err.code() == net.err_timed_out_code {
 				// Skip network timeouts, they are normal
 				continue
 			}
+			if s.state != .running {
+				break
+			}
 			eprintln('accept() failed, reason: ${err}; skipping')
 			continue
 		}
@@ -110,9 +154,6 @@ pub fn (mut s Server) listen_and_serve() {
 		conn.set_write_timeout(s.write_timeout)
 		ch <- conn
 	}
-	if s.state == .stopped {
-		s.close()
-	}
 }
 
 // stop signals the server that it should not respond anymore.
@@ -128,6 +169,9 @@ pub fn (mut s Server) stop() {
 @[inline]
 pub fn (mut s Server) close() {
 	s.state = .closed
+	for mut extra in s.extra_listeners {
+		extra.close() or {}
+	}
 	s.listener.close() or { return }
 	if s.on_closed != unsafe { nil } {
 		s.on_closed(mut s)
@@ -165,18 +209,39 @@ pub fn (mut s Server) wait_till_running(params WaitTillRunningParams) !int {
 	return i
 }
 
+// the initial size of the per worker buffers, for reading requests and writing responses
+const worker_buffer_size = 16 * 1024
+
 struct HandlerWorker {
-	id int
-	ch chan &net.TcpConn
+	id              int
+	ch              chan &net.TcpConn
+	keep_alive      bool
+	read_timeout    time.Duration
+	idle_timeout    time.Duration
+	max_header_size int
+	max_body_size   int
 pub mut:
 	handler Handler
+mut:
+	// the poller of the idle kept alive connections; nil, when the worker waits on them instead
+	idle &IdleConns = unsafe { nil }
+	// the buffers are reused for all the connections of the worker
+	reader &io.BufferedReader = unsafe { nil }
+	out    strings.Builder
 }
 
-fn new_handler_worker(wid int, ch chan &net.TcpConn, handler Handler) thread {
+fn new_handler_worker(wid int, ch chan &net.TcpConn, s &Server, idle &IdleConns) thread {
 	mut w := &HandlerWorker{
-		id:      wid
-		ch:      ch
-		handler: handler
+		id:              wid
+		ch:              ch
+		handler:         s.handler
+		idle:            idle
+		keep_alive:      s.keep_alive
+		read_timeout:    s.read_timeout
+		idle_timeout:    s.idle_timeout
+		max_header_size: s.max_header_size
+		max_body_size:   s.max_body_size
+		out:             strings.new_builder(worker_buffer_size)
 	}
 	return spawn w.process_requests()
 }
@@ -184,43 +249,175 @@ fn new_handler_worker(wid int, ch chan &net.TcpConn, handler Handler) thread {
 fn (mut w HandlerWorker) process_requests() {
 	for {
 		mut conn := <-w.ch or { break }
-		w.handle_conn(mut conn)
+		$if is_coroutine ? {
+			// a coroutine is cheap enough to be started for every connection; while it waits
+			// for its socket, the worker thread of the scheduler serves the other connections.
+			// The coroutines of a worker run concurrently, so each gets its own buffers.
+			mut cw := &HandlerWorker{
+				...w
+				reader: unsafe { nil }
+				out:    strings.new_builder(worker_buffer_size)
+			}
+			go cw.handle_conn(mut conn)
+		} $else {
+			w.handle_conn(mut conn)
+		}
 	}
 }
 
+// handle_conn serves the requests of a connection, till the client closes it, or asks for it to be
+// closed, or it becomes idle. An idle connection is parked in w.idle, and served again by any worker,
+// when its next request arrives. Without w.idle, the worker waits for it, for at most w.idle_timeout,
+// and only while no other connection waits for a worker. Pipelined requests are answered in order,
+// and their responses are sent together, with a single write.
 fn (mut w HandlerWorker) handle_conn(mut conn net.TcpConn) {
+	mut parked := false
 	defer {
-		conn.close() or { eprintln('close() failed: ${err}') }
+		if !parked {
+			conn.close() or { eprintln('close() failed: ${err}') }
+		}
 	}
+	if w.reader == unsafe { nil } {
+		w.reader = io.new_buffered_reader(reader: conn, cap: worker_buffer_size)
+	} else {
+		w.reader.reset(conn)
+	}
+	w.out.go_back_to(0)
+	remote_ip := conn.peer_ip() or { '0.0.0.0' }
+	mut nr_requests := 0
+	for {
+		if nr_requests > 0 && w.reader.buffered() == 0 {
+			if w.idle != unsafe { nil } {
+				w.idle.park(mut conn)
+				parked = true
+				return
+			}
+			if !w.wait_for_next_request(mut conn) {
+				return
+			}
+		}
+		mut req := parse_request_with_limits(mut w.reader, w.max_header_size, w.max_body_size) or {
+			code := err.code()
+			if code in [int(Status.request_header_fields_too_large),
+				int(Status.request_entity_too_large), int(Status.bad_request),
+				int(Status.not_implemented)] {
+				// the connection is always closed, since the rest of the request can not be skipped
+				status := status_from_int(code)
+				w.out.write_string('HTTP/1.1 ${code} ${status.str()}\r\nContent-Length: 0\r\nConnection: close\r\n\r\n')
+			} else {
+				$if debug {
+					// only show in debug mode to prevent abuse
+					if nr_requests == 0 {
+						eprintln('error parsing request: ${err}')
+					}
+				}
+			}
+			w.flush(mut conn) or {}
+			return
+		}
+		if nr_requests == 0 && req.version == .v2_0 && req.method == .pri && req.url == '*' {
+			// the client preface of HTTP/2 with prior knowledge (h2c)
+			w.serve_h2(mut conn, remote_ip)
+			return
+		}
+		req.header.add_custom('Remote-Addr', remote_ip) or {}
 
-	mut reader := io.new_buffered_reader(reader: conn)
-	defer {
-		unsafe {
-			reader.free()
+		mut keep_alive := w.keep_alive
+		if keep_alive {
+			connection := req.header.get(.connection) or { '' }
+			keep_alive = if req.version == .v1_0 {
+				connection.to_lower() == 'keep-alive'
+			} else {
+				connection.to_lower() != 'close'
+			}
 		}
-	}
-	mut req := parse_request(mut reader) or {
-		$if debug {
-			// only show in debug mode to prevent abuse
-			eprintln('error parsing request: ${err}')
+
+		mut resp := w.handler.handle(req)
+		if resp.version() == .unknown {
+			resp.set_version(req.version)
 		}
-		return
-	}
 
-	remote_ip := conn.peer_ip() or { '0.0.0.0' }
-	req.header.add_custom('Remote-Addr', remote_ip) or {}
+		// Implemented by developers?
+		if !resp.header.contains(.content_length) {
+			resp.header.set(.content_length, '${resp.body.len}')
+		}
+		if keep_alive {
+			if connection := resp.header.get(.connection) {
+				keep_alive = connection.to_lower() != 'close'
+			}
+		}
+		// Without a poller for the idle connections, do not keep the connection, when other
+		// connections are already waiting for a worker. Otherwise a few idle clients could hold
+		// all the workers.
+		if keep_alive && w.idle == unsafe { nil } && w.ch.len > 0 {
+			keep_alive = false
+		}
+		if !keep_alive {
+			resp.header.set(.connection, 'close')
+		} else if req.version == .v1_0 {
+			resp.header.set(.connection, 'keep-alive')
+		}
 
-	mut resp := w.handler.handle(req)
-	if resp.version() == .unknown {
-		resp.set_version(req.version)
+		w.out.write_string('HTTP/${resp.http_version} ${resp.status_code} ${resp.status_msg}\r\n')
+		resp.header.render_into_sb(mut w.out, version: resp.version())
+		w.out.write_string('\r\n')
+		w.out.write_string(resp.body)
+		// When more pipelined requests are already buffered, their responses are sent together
+		if !keep_alive || w.reader.buffered() == 0 || w.out.len >= worker_buffer_size {
+			w.flush(mut conn) or {
+				eprintln('error sending response: ${err}')
+				return
+			}
+		}
+		if !keep_alive {
+			return
+		}
+		nr_requests++
 	}
+}
 
-	// Implemented by developers?
-	if !resp.header.contains(.content_length) {
-		resp.header.set(.content_length, '${resp.body.len}')
+// the interval, at which a worker waiting on an idle kept alive connection checks for new connections
+const idle_poll_interval = 50 * time.millisecond
+
+// wait_for_next_request is used on the platforms without a poller for the idle connections.
+// It waits for the next request of a kept alive connection, for at most
+// w.idle_timeout. It returns false, when the connection should be closed instead: it stayed idle,
+// it failed, or other connections are waiting for a worker, so that a few idle clients can not
+// hold all the workers.
+fn (mut w HandlerWorker) wait_for_next_request(mut conn net.TcpConn) bool {
+	defer {
+		conn.set_read_timeout(w.read_timeout)
+	}
+	conn.set_read_timeout(idle_poll_interval)
+	mut idle := time.Duration(0)
+	for {
+		if w.ch.len > 0 {
+			return false
+		}
+		conn.wait_for_read() or {
+			if err.code() != net.err_timed_out_code {
+				return false
+			}
+			idle += idle_poll_interval
+			if idle >= w.idle_timeout {
+				return false
+			}
+			continue
+		}
+		return true
 	}
+	return false
+}
 
-	conn.write(resp.bytes()) or { eprintln('error sending response: ${err}') }
+// flush sends all the buffered responses
+fn (mut w HandlerWorker) flush(mut conn net.TcpConn) ! {
+	if w.out.len == 0 {
+		return
+	}
+	defer {
+		w.out.go_back_to(0)
+	}
+	conn.write_ptr(w.out.data, w.out.len)!
 }
 
 // DebugHandler implements the Handler interface by echoing the request
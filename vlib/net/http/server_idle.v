@@ -0,0 +1,136 @@
+module http
+
+import net
+import os.notify
+import sync
+import time
+
+// the interval, at which the poller of the idle connections closes the ones idle for too long.
+// It is below a second, since the kqueue backend of os.notify takes only the nanoseconds of the timeout.
+const idle_sweep_interval = 500 * time.millisecond
+
+// IdleConns parks the idle kept alive connections of a Server in a poller (epoll on linux, kqueue
+// on macos), instead of a worker waiting on each of them, so that the workers serve only the
+// connections with a request. When the next request of a connection arrives, it goes back to the
+// workers, through the same channel as the accepted connections. It is closed, when it stays idle
+// for longer than `idle_timeout`.
+@[heap]
+struct IdleConns {
+	ch           chan &net.TcpConn
+	idle_timeout time.Duration
+mut:
+	notifier notify.FdNotifier
+	mu       &sync.Mutex = sync.new_mutex()
+	conns    map[int]IdleConn // by socket handle
+	closed   bool
+}
+
+struct IdleConn {
+	conn      &net.TcpConn
+	parked_at i64 // time.ticks()
+}
+
+// new_idle_conns starts the poller of the idle connections. It returns an error on the platforms,
+// that os.notify does not support, where the workers keep waiting on the idle connections.
+fn new_idle_conns(ch chan &net.TcpConn, idle_timeout time.Duration) !&IdleConns {
+	$if linux || macos {
+		mut ic := &IdleConns{
+			ch:           ch
+			idle_timeout: idle_timeout
+			notifier:     notify.new()!
+		}
+		spawn ic.poll()
+		return ic
+	} $else {
+		return error('the idle connections can not be polled on this platform')
+	}
+}
+
+// park waits for the next request of `conn` in the poller. The responses of the previous
+// requests must already be sent, and no part of the next one read.
+fn (mut ic IdleConns) park(mut conn net.TcpConn) {
+	fd := conn.sock.handle
+	ic.mu.@lock()
+	if ic.closed {
+		ic.mu.unlock()
+		conn.close() or {}
+		return
+	}
+	// added before the socket is polled, so that an event for it finds it
+	ic.conns[fd] = IdleConn{
+		conn:      conn
+		parked_at: time.ticks()
+	}
+	ic.mu.unlock()
+	ic.notifier.add(fd, .read, .one_shot) or {
+		ic.mu.@lock()
+		ic.conns.delete(fd)
+		ic.mu.unlock()
+		conn.close() or {}
+	}
+}
+
+// poll hands the connections, that became readable, back to the workers, and closes the ones
+// idle for too long, till the server is closed
+fn (mut ic IdleConns) poll() {
+	mut last_sweep := time.ticks()
+	for !ic.closed {
+		events := ic.notifier.wait(idle_sweep_interval)
+		for event in events {
+			if conn := ic.unpark(event.fd) {
+				ic.ch <- conn
+			}
+		}
+		now := time.ticks()
+		if now - last_sweep >= idle_sweep_interval.milliseconds() {
+			last_sweep = now
+			ic.sweep(now)
+		}
+	}
+	ic.notifier.close() or {}
+}
+
+// unpark stops polling the socket `fd`, and returns its connection, unless it was already unparked
+fn (mut ic IdleConns) unpark(fd int) ?&net.TcpConn {
+	ic.mu.@lock()
+	idle := ic.conns[fd] or {
+		ic.mu.unlock()
+		return none
+	}
+	ic.conns.delete(fd)
+	ic.mu.unlock()
+	// a one shot kqueue event is already deleted, when it is reported
+	ic.notifier.remove(fd) or {}
+	return idle.conn
+}
+
+// sweep closes the connections, that have been idle for longer than ic.idle_timeout
+fn (mut ic IdleConns) sweep(now i64) {
+	timeout := ic.idle_timeout.milliseconds()
+	mut expired := []int{}
+	ic.mu.@lock()
+	for fd, idle in ic.conns {
+		if now - idle.parked_at >= timeout {
+			expired << fd
+		}
+	}
+	ic.mu.unlock()
+	for fd in expired {
+		mut conn := ic.unpark(fd) or { continue }
+		conn.close() or {}
+	}
+}
+
+// close closes all the idle connections, and stops the poller
+fn (mut ic IdleConns) close() {
+	ic.mu.@lock()
+	ic.closed = true
+	conns := ic.conns.clone()
+	ic.conns.clear()
+	ic.mu.unlock()
+	for fd, idle in conns {
+		ic.notifier.remove(fd) or {}
+		mut conn := idle.conn
+		conn.close() or {}
+	}
+}
@@ -1,6 +1,8 @@
 import log
 import net
 import net.http
+import net.mbedtls
+import os
 import time
 
 const atimeout = 500 * time.millisecond
@@ -248,3 +250,336 @@ fn test_my_counting_handler_on_random_port() {
 	}
 	assert true
 }
+
+fn read_until_closed(mut conn net.TcpConn) string {
+	mut res := []u8{}
+	mut buf := []u8{len: 4096}
+	for {
+		n := conn.read(mut buf) or { break }
+		if n <= 0 {
+			break
+		}
+		res << buf[..n]
+	}
+	return res.bytestr()
+}
+
+fn test_server_keep_alive_pipelining_and_limits() {
+	log.warn('${@FN} started')
+	defer {
+		log.warn('${@FN} finished')
+	}
+	mut server := &http.Server{
+		accept_timeout:       atimeout
+		handler:              MyCountingHandler{}
+		addr:                 ':18199'
+		max_header_size:      1024
+		show_startup_message: false
+	}
+	t := spawn server.listen_and_serve()
+	server.wait_till_running()!
+	// two pipelined requests on a single connection; the second one asks for the connection to be closed
+	mut conn := net.dial_tcp('localhost:18199')!
+	conn.write_string('GET /count HTTP/1.1\r\nHost: localhost\r\n\r\n' +
+		'GET /count HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n')!
+	responses := read_until_closed(mut conn)
+	conn.close() or {}
+	assert responses.count('HTTP/1.1 200 OK') == 2
+	assert responses.contains(', /count, counter: 1')
+	assert responses.contains(', /count, counter: 2')
+	assert responses.all_after_last('HTTP/1.1 200 OK').contains('Connection: close')
+	// a request with too many headers is rejected
+	conn = net.dial_tcp('localhost:18199')!
+	conn.write_string('GET /count HTTP/1.1\r\nHost: localhost\r\nX-Big: ${'x'.repeat(2000)}\r\n\r\n')!
+	rejected := read_until_closed(mut conn)
+	conn.close() or {}
+	assert rejected.starts_with('HTTP/1.1 431 ')
+	// a chunked body is not read, so it must not be parsed as a second request
+	conn = net.dial_tcp('localhost:18199')!
+	smuggled := 'GET /count HTTP/1.1\r\nHost: localhost\r\n\r\n'
+	conn.write_string('POST /count HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n' +
+		'${smuggled.len:x}\r\n${smuggled}\r\n0\r\n\r\n')!
+	chunked := read_until_closed(mut conn)
+	conn.close() or {}
+	assert chunked.starts_with('HTTP/1.1 501 ')
+	assert chunked.count('HTTP/1.1 ') == 1
+	assert chunked.contains('Connection: close')
+	// with a Content-Length too, the request is ambiguous
+	conn = net.dial_tcp('localhost:18199')!
+	conn.write_string('POST /count HTTP/1.1\r\nHost: localhost\r\nContent-Length: ${smuggled.len}\r\nTransfer-Encoding: chunked\r\n\r\n${smuggled}')!
+	ambiguous := read_until_closed(mut conn)
+	conn.close() or {}
+	assert ambiguous.starts_with('HTTP/1.1 400 ')
+	assert ambiguous.count('HTTP/1.1 ') == 1
+	server.stop()
+	t.wait()
+	if mut server.handler is MyCountingHandler {
+		assert server.handler.counter == 2
+	}
+}
+
+fn test_server_idle_keep_alive_connection_does_not_hold_the_worker() {
+	log.warn('${@FN} started')
+	defer {
+		log.warn('${@FN} finished')
+	}
+	mut server := &http.Server{
+		accept_timeout:       atimeout
+		handler:              MyCountingHandler{}
+		addr:                 ':18202'
+		worker_num:           1
+		idle_timeout:         20 * time.second
+		show_startup_message: false
+	}
+	t := spawn server.listen_and_serve()
+	server.wait_till_running()!
+	// the only worker serves a request on each connection, which then stays idle
+	mut idle_conns := []&net.TcpConn{}
+	mut buf := []u8{len: 4096}
+	for _ in 0 .. 3 {
+		mut idle_conn := net.dial_tcp('localhost:18202')!
+		idle_conn.write_string('GET /count HTTP/1.1\r\nHost: localhost\r\n\r\n')!
+		n := idle_conn.read(mut buf)!
+		assert buf[..n].bytestr().starts_with('HTTP/1.1 200 OK')
+		assert !buf[..n].bytestr().contains('Connection: close')
+		idle_conns << idle_conn
+	}
+	// a new connection is served long before the idle timeout
+	sw := time.new_stopwatch()
+	mut conn := net.dial_tcp('localhost:18202')!
+	conn.write_string('GET /count HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n')!
+	resp := read_until_closed(mut conn)
+	conn.close() or {}
+	assert resp.contains(', /count, counter: 4')
+	assert sw.elapsed() < 5 * time.second
+	$if linux || macos {
+		// the idle connections waited in the poller, so they are still open, and served again
+		for i, mut idle_conn in idle_conns {
+			idle_conn.write_string('GET /count HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n')!
+			assert read_until_closed(mut idle_conn).contains(', /count, counter: ${5 + i}')
+			idle_conn.close() or {}
+		}
+	} $else {
+		// the last idle connection has been closed, to let it in
+		mut last := idle_conns.last()
+		assert read_until_closed(mut last) == ''
+		for mut idle_conn in idle_conns {
+			idle_conn.close() or {}
+		}
+	}
+	server.stop()
+	t.wait()
+}
+
+fn test_server_closes_the_connections_idle_for_longer_than_idle_timeout() {
+	log.warn('${@FN} started')
+	defer {
+		log.warn('${@FN} finished')
+	}
+	mut server := &http.Server{
+		accept_timeout:       atimeout
+		handler:              MyCountingHandler{}
+		addr:                 ':18205'
+		worker_num:           1
+		idle_timeout:         time.second
+		show_startup_message: false
+	}
+	t := spawn server.listen_and_serve()
+	server.wait_till_running()!
+	mut conn := net.dial_tcp('localhost:18205')!
+	conn.write_string('GET /count HTTP/1.1\r\nHost: localhost\r\n\r\n')!
+	mut buf := []u8{len: 4096}
+	n := conn.read(mut buf)!
+	assert buf[..n].bytestr().starts_with('HTTP/1.1 200 OK')
+	sw := time.new_stopwatch()
+	assert read_until_closed(mut conn) == ''
+	conn.close() or {}
+	assert sw.elapsed() >= 900 * time.millisecond
+	assert sw.elapsed() < 5 * time.second
+	server.stop()
+	t.wait()
+}
+
+fn test_client_reuses_keep_alive_connections() {
+	log.warn('${@FN} started')
+	defer {
+		log.warn('${@FN} finished')
+	}
+	mut server := &http.Server{
+		accept_timeout:       atimeout
+		handler:              MyCountingHandler{}
+		addr:                 ':18200'
+		show_startup_message: false
+	}
+	t := spawn server.listen_and_serve()
+	server.wait_till_running()!
+	mut client := http.Client{}
+	for i in 1 .. 6 {
+		resp := client.get('http://localhost:18200/count')!
+		assert resp.status_code == 200
+		assert resp.body.ends_with(', /count, counter: ${i}')
+	}
+	stats := client.stats()
+	assert stats.requests == 5
+	assert stats.dials == 1
+	assert stats.reuses == 4
+	assert stats.idle == 1
+	assert stats.active == 0
+	client.close()
+	assert client.stats().idle == 0
+	server.stop()
+	t.wait()
+}
+
+fn h2_get(mut client http.Client, url string) string {
+	resp := client.get(url) or { return err.msg() }
+	return '${resp.http_version} ${resp.status_code}'
+}
+
+fn test_client_multiplexes_http2_requests() {
+	log.warn('${@FN} started')
+	defer {
+		log.warn('${@FN} finished')
+	}
+	mut server := &http.Server{
+		accept_timeout:       atimeout
+		handler:              MyCountingHandler{}
+		addr:                 ':18201'
+		show_startup_message: false
+	}
+	t := spawn server.listen_and_serve()
+	server.wait_till_running()!
+	mut client := &http.Client{
+		http2: true
+	}
+	first := client.get('http://localhost:18201/count')!
+	assert first.http_version == '2.0'
+	assert first.status_code == 200
+	assert first.body.ends_with(', /count, counter: 1')
+	// the concurrent requests are multiplexed on the connection of the first one
+	mut threads := []thread string{}
+	for _ in 0 .. 8 {
+		threads << spawn h2_get(mut client, 'http://localhost:18201/count')
+	}
+	for result in threads.wait() {
+		assert result == '2.0 200'
+	}
+	missing := client.get('http://localhost:18201/missing')!
+	assert missing.status_code == 404
+	assert missing.body.ends_with(', /missing, counter: 10')
+	stats := client.stats()
+	assert stats.requests == 10
+	assert stats.http2 == 10
+	assert stats.dials == 1
+	client.close()
+	server.stop()
+	t.wait()
+}
+
+// read_raw_request reads a request with its body, framed by Content-Length
+fn read_raw_request(mut conn net.TcpConn) !string {
+	mut buf := []u8{len: 4096}
+	mut req := ''
+	for {
+		n := conn.read(mut buf)!
+		req += buf[..n].bytestr()
+		head_end := req.index('\r\n\r\n') or { continue }
+		cl := req[..head_end].to_lower().all_after('content-length:').all_before('\r\n').trim_space().int()
+		if req.len >= head_end + 4 + cl {
+			return req
+		}
+	}
+	return req
+}
+
+// serve_first_request_only answers the first request of a connection, and closes it, without a response,
+// after reading the second one
+fn serve_first_request_only(mut conn net.TcpConn, seen chan string) {
+	defer {
+		conn.close() or {}
+	}
+	for i in 0 .. 2 {
+		req := read_raw_request(mut conn) or { return }
+		seen <- req.all_before(' ')
+		if i == 0 {
+			conn.write_string('HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok') or { return }
+		}
+	}
+}
+
+fn accept_raw_connections(mut l net.TcpListener, seen chan string) {
+	for {
+		mut conn := l.accept() or { return }
+		spawn serve_first_request_only(mut conn, seen)
+	}
+}
+
+fn test_client_sends_again_only_the_idempotent_requests() {
+	log.warn('${@FN} started')
+	defer {
+		log.warn('${@FN} finished')
+	}
+	mut l := net.listen_tcp(.ip, ':18203')!
+	seen := chan string{cap: 100}
+	spawn accept_raw_connections(mut l, seen)
+	url := 'http://localhost:18203/'
+	mut client := http.Client{}
+	assert client.get(url)!.body == 'ok'
+	// the server may have processed the POST, before it closed the reused connection => it is not sent again
+	if _ := client.post(url, 'data') {
+		assert false
+	}
+	assert client.get(url)!.body == 'ok'
+	// a GET on a reused connection, that is closed before the response, is sent again on a new one
+	assert client.get(url)!.body == 'ok'
+	stats := client.stats()
+	assert stats.dials == 3
+	assert stats.retries == 1
+	mut methods := []string{}
+	for seen.len > 0 {
+		methods << <-seen
+	}
+	assert methods == ['GET', 'POST', 'GET', 'GET', 'GET']
+	client.close()
+	l.close()!
+}
+
+fn serve_tls_requests(mut l mbedtls.SSLListener, n int) {
+	for _ in 0 .. n {
+		mut conn := l.accept() or { return }
+		mut buf := []u8{len: 4096}
+		mut req := ''
+		for !req.contains('\r\n\r\n') {
+			m := conn.read(mut buf) or { break }
+			req += buf[..m].bytestr()
+		}
+		conn.write_string('HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 2\r\n\r\nok') or {}
+		conn.shutdown() or {}
+	}
+}
+
+fn test_client_offers_the_tls_session_of_the_previous_connection() {
+	log.warn('${@FN} started')
+	defer {
+		log.warn('${@FN} finished')
+	}
+	cert_dir := os.join_path(@VEXEROOT, 'examples', 'ssl_server', 'cert')
+	mut l := mbedtls.new_ssl_listener('127.0.0.1:18204',
+		cert:     os.join_path(cert_dir, 'server.crt')
+		cert_key: os.join_path(cert_dir, 'server.key')
+	)!
+	t := spawn serve_tls_requests(mut l, 2)
+	mut client := http.Client{}
+	// the server closes each connection, so the second request does a new handshake, that offers the saved session
+	for _ in 0 .. 2 {
+		resp := client.get('https://127.0.0.1:18204/')!
+		assert resp.status_code == 200
+		assert resp.body == 'ok'
+	}
+	stats := client.stats()
+	assert stats.dials == 2
+	assert stats.tls_resumes == 1
+	client.close()
+	t.wait()
+	l.shutdown()!
+}
@@ -135,6 +135,9 @@ pub struct C.mbedtls_ssl_context {}
 @[typedef]
 pub struct C.mbedtls_ssl_config {}
 
+@[typedef]
+pub struct C.mbedtls_ssl_session {}
+
 @[typedef]
 pub struct C.mbedtls_ssl_send_t {}
 
@@ -186,6 +189,12 @@ fn C.mbedtls_ssl_conf_sni(&C.mbedtls_ssl_config, fn (voidptr, &C.mbedtls_ssl_con
 fn C.mbedtls_ssl_set_hs_ca_chain(&C.mbedtls_ssl_config, &C.mbedtls_x509_crt, &C.mbedtls_x509_crl)
 fn C.mbedtls_ssl_set_hs_own_cert(&C.mbedtls_ssl_context, &C.mbedtls_x509_crt, &C.mbedtls_pk_context) int
 fn C.mbedtls_ssl_set_hs_authmode(&C.mbedtls_ssl_context, int)
+fn C.mbedtls_ssl_session_init(&C.mbedtls_ssl_session)
+fn C.mbedtls_ssl_session_free(&C.mbedtls_ssl_session)
+fn C.mbedtls_ssl_get_session(&C.mbedtls_ssl_context, &C.mbedtls_ssl_session) int
+fn C.mbedtls_ssl_set_session(&C.mbedtls_ssl_context, &C.mbedtls_ssl_session) int
+fn C.mbedtls_ssl_conf_alpn_protocols(&C.mbedtls_ssl_config, &&char) int
+fn C.mbedtls_ssl_get_alpn_protocol(&C.mbedtls_ssl_context) &char
 
 fn C.mbedtls_pk_init(&C.mbedtls_pk_context)
 fn C.mbedtls_pk_free(&C.mbedtls_pk_context)
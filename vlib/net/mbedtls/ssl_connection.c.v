@@ -117,6 +117,8 @@ pub mut:
 	ip        string
 
 	owns_socket bool
+mut:
+	alpn_list []&char // the ALPN protocols, as a nil terminated list; mbedtls keeps a reference to it
 }
 
 // SSLListener listens on a TCP port and accepts connection secured with TLS
@@ -305,7 +307,8 @@ pub:
 	cert_key string // the path to a key.pem file, containing private keys for the client certificate(s)
 	validate bool   // set this to true, if you want to stop requests, when their certificates are found to be invalid
 
-	in_memory_verification bool // if true, verify, cert, and cert_key are read from memory, not from a file
+	in_memory_verification bool     // if true, verify, cert, and cert_key are read from memory, not from a file
+	alpn_protocols         []string // the protocols offered with ALPN, in order of preference, for example ['h2', 'http/1.1']
 
 	get_certificate ?fn (mut SSLListener, string) !&SSLCerts
 }
@@ -426,6 +429,17 @@ fn (mut s SSLConn) init() ! {
 		C.mbedtls_ssl_conf_authmode(&s.conf, C.MBEDTLS_SSL_VERIFY_OPTIONAL)
 	}
 
+	if s.config.alpn_protocols.len > 0 {
+		for p in s.config.alpn_protocols {
+			s.alpn_list << &char(p.clone().str)
+		}
+		s.alpn_list << unsafe { &char(nil) }
+		ret = C.mbedtls_ssl_conf_alpn_protocols(&s.conf, s.alpn_list.data)
+		if ret != 0 {
+			return error_with_code('Failed to set the ALPN protocols', ret)
+		}
+	}
+
 	ret = C.mbedtls_ssl_setup(&s.ssl, &s.conf)
 	if ret != 0 {
 		return error_with_code('Failed to setup SSL connection', ret)
@@ -497,6 +511,53 @@ pub fn (mut s SSLConn) dial(hostname string, port int) ! {
 	s.opened = true
 }
 
+// negotiated_protocol returns the protocol, selected by the server with ALPN, or '' when there is none
+pub fn (s &SSLConn) negotiated_protocol() string {
+	p := C.mbedtls_ssl_get_alpn_protocol(&s.ssl)
+	if p == unsafe { nil } {
+		return ''
+	}
+	return unsafe { cstring_to_vstring(p) }
+}
+
+// session returns a copy of the TLS session of the connection, or nil, if there is none yet.
+// A later connection to the same server can offer it with `set_session`, before
+// `connect`/`dial`, to resume it and skip most of the handshake.
+// The session has to be released with `free_session`, once it is no longer needed.
+pub fn (mut s SSLConn) session() voidptr {
+	if !s.opened {
+		return unsafe { nil }
+	}
+	mut session := &C.mbedtls_ssl_session{}
+	C.mbedtls_ssl_session_init(session)
+	if C.mbedtls_ssl_get_session(&s.ssl, session) != 0 {
+		free_session(session)
+		return unsafe { nil }
+	}
+	return session
+}
+
+// set_session makes the next `connect`/`dial` try to resume `session`,
+// a session returned by `session()` of an earlier connection to the same server.
+pub fn (mut s SSLConn) set_session(session voidptr) ! {
+	if session == unsafe { nil } {
+		return
+	}
+	ret := C.mbedtls_ssl_set_session(&s.ssl, &C.mbedtls_ssl_session(session))
+	if ret != 0 {
+		return error_with_code('Failed to set the TLS session', ret)
+	}
+}
+
+// free_session releases a session, returned by `SSLConn.session()`
+pub fn free_session(session voidptr) {
+	if session == unsafe { nil } {
+		return
+	}
+	C.mbedtls_ssl_session_free(&C.mbedtls_ssl_session(session))
+	unsafe { free(session) }
+}
+
 // addr retrieves the local ip address and port number for this connection
 pub fn (s &SSLConn) addr() !net.Addr {
 	return net.addr_from_socket_handle(s.handle)
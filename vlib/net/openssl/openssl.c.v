@@ -130,6 +130,16 @@ fn C.SSL_shutdown(&C.SSL) int
 
 fn C.SSL_free(&C.SSL)
 
+fn C.SSL_get1_session(ssl &C.SSL) voidptr
+
+fn C.SSL_set_session(ssl &C.SSL, session voidptr) int
+
+fn C.SSL_SESSION_free(session voidptr)
+
+fn C.SSL_CTX_set_alpn_protos(ctx &C.SSL_CTX, protos &u8, protos_len u32) int
+
+fn C.SSL_get0_alpn_selected(ssl &C.SSL, data &&u8, len &u32)
+
 fn C.SSL_write(ssl &C.SSL, buf voidptr, buflen int) int
 
 fn C.SSL_read(ssl &C.SSL, buf voidptr, buflen int) int
@@ -26,7 +26,8 @@ pub:
 	cert_key string // the path to a key.pem file, containing private keys for the client certificate(s)
 	validate bool   // set this to true, if you want to stop requests, when their certificates are found to be invalid
 
-	in_memory_verification bool // if true, verify, cert, and cert_key are read from memory, not from a file
+	in_memory_verification bool     // if true, verify, cert, and cert_key are read from memory, not from a file
+	alpn_protocols         []string // the protocols offered with ALPN, in order of preference, for example ['h2', 'http/1.1']
 }
 
 // new_ssl_conn instance an new SSLCon struct
@@ -108,6 +109,13 @@ fn (mut s SSLConn) init() ! {
 		return error("Couldn't get ssl context")
 	}
 
+	if s.config.alpn_protocols.len > 0 {
+		protos := alpn_wire_format(s.config.alpn_protocols)
+		if C.SSL_CTX_set_alpn_protos(s.sslctx, protos.data, u32(protos.len)) != 0 {
+			return error('cannot set the ALPN protocols')
+		}
+	}
+
 	if s.config.validate {
 		C.SSL_CTX_set_verify_depth(s.sslctx, 4)
 		C.SSL_CTX_set_options(s.sslctx, C.SSL_OP_NO_SSLv2 | C.SSL_OP_NO_SSLv3 | C.SSL_OP_NO_COMPRESSION)
@@ -252,6 +260,56 @@ fn (mut s SSLConn) complete_connect() ! {
 	}
 }
 
+// negotiated_protocol returns the protocol, selected by the server with ALPN, or '' when there is none
+pub fn (s &SSLConn) negotiated_protocol() string {
+	mut data := &u8(unsafe { nil })
+	mut len := u32(0)
+	C.SSL_get0_alpn_selected(voidptr(s.ssl), &data, &len)
+	if data == unsafe { nil } || len == 0 {
+		return ''
+	}
+	return unsafe { tos(data, int(len)) }.clone()
+}
+
+// alpn_wire_format encodes a list of protocols, as each one prefixed by its length
+fn alpn_wire_format(protocols []string) []u8 {
+	mut res := []u8{}
+	for p in protocols {
+		res << u8(p.len)
+		res << p.bytes()
+	}
+	return res
+}
+
+// session returns the TLS session of the connection, or nil, if there is none yet.
+// A later connection to the same server can offer it with `set_session`, before
+// `connect`/`dial`, to resume it and skip most of the handshake.
+// The session has to be released with `free_session`, once it is no longer needed.
+pub fn (s &SSLConn) session() voidptr {
+	if s.ssl == unsafe { nil } {
+		return unsafe { nil }
+	}
+	return C.SSL_get1_session(voidptr(s.ssl))
+}
+
+// set_session makes the next `connect`/`dial` try to resume `session`,
+// a session returned by `session()` of an earlier connection to the same server.
+pub fn (mut s SSLConn) set_session(session voidptr) ! {
+	if session == unsafe { nil } {
+		return
+	}
+	if C.SSL_set_session(voidptr(s.ssl), session) != 1 {
+		return error('cannot set the TLS session')
+	}
+}
+
+// free_session releases a session, returned by `SSLConn.session()`
+pub fn free_session(session voidptr) {
+	if session != unsafe { nil } {
+		C.SSL_SESSION_free(session)
+	}
+}
+
 // addr retrieves the local ip address and port number for this connection
 pub fn (s &SSLConn) addr() !net.Addr {
 	return net.addr_from_socket_handle(s.handle)
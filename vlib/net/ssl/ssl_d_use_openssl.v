@@ -16,3 +16,8 @@ pub fn new_ssl_conn(config SSLConnectConfig) !&SSLConn {
 	c := openssl.new_ssl_conn(config.SSLConnectConfig) or { return err }
 	return &SSLConn{c}
 }
+
+// free_session releases a TLS session, returned by `SSLConn.session()`
+pub fn free_session(session voidptr) {
+	openssl.free_session(session)
+}
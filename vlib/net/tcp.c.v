@@ -140,7 +140,7 @@ pub fn (mut c TcpConn) close() ! {
 pub fn (c TcpConn) read_ptr(buf_ptr &u8, len int) !int {
 	mut should_ewouldblock := false
 	mut res := $if is_coroutine ? {
-		C.photon_recv(c.sock.handle, voidptr(buf_ptr), len, 0, c.read_timeout)
+		C.vcoro_recv(c.sock.handle, voidptr(buf_ptr), len, 0, c.read_timeout)
 	} $else {
 		// The new socket returned by accept() behaves differently in blocking mode and needs special treatment.
 		mut has_data := true
@@ -170,10 +170,15 @@ pub fn (c TcpConn) read_ptr(buf_ptr &u8, len int) !int {
 		return res
 	}
 	code := if should_ewouldblock { int(error_ewouldblock) } else { error_code() }
+	$if is_coroutine ? {
+		if code == C.ETIMEDOUT {
+			return err_timed_out
+		}
+	}
 	if code in [int(error_ewouldblock), int(error_eagain), C.EINTR] {
 		c.wait_for_read()!
 		res = $if is_coroutine ? {
-			C.photon_recv(c.sock.handle, voidptr(buf_ptr), len, 0, c.read_timeout)
+			C.vcoro_recv(c.sock.handle, voidptr(buf_ptr), len, 0, c.read_timeout)
 		} $else {
 			C.recv(c.sock.handle, voidptr(buf_ptr), len, msg_dontwait)
 		}
@@ -230,7 +235,7 @@ pub fn (mut c TcpConn) write_ptr(b &u8, len int) !int {
 			ptr := ptr_base + total_sent
 			remaining := len - total_sent
 			mut sent := $if is_coroutine ? {
-				C.photon_send(c.sock.handle, ptr, remaining, msg_nosignal, c.write_timeout)
+				C.vcoro_send(c.sock.handle, ptr, remaining, msg_nosignal, c.write_timeout)
 			} $else {
 				C.send(c.sock.handle, ptr, remaining, msg_nosignal)
 			}
@@ -239,6 +244,11 @@ pub fn (mut c TcpConn) write_ptr(b &u8, len int) !int {
 			}
 			if sent < 0 {
 				code := error_code()
+				$if is_coroutine ? {
+					if code == C.ETIMEDOUT {
+						return err_timed_out
+					}
+				}
 				if code in [int(error_ewouldblock), int(error_eagain), C.EINTR] {
 					c.wait_for_write()!
 					continue
@@ -350,8 +360,9 @@ pub mut:
 @[params]
 pub struct ListenOptions {
 pub:
-	dualstack bool = true
-	backlog   int  = 128
+	dualstack  bool = true
+	backlog    int  = 128
+	reuse_port bool // allow several listeners on the same address (SO_REUSEPORT); the kernel spreads the new connections between them
 }
 
 pub fn listen_tcp(family AddrFamily, saddr string, options ListenOptions) !&TcpListener {
@@ -360,6 +371,13 @@ pub fn listen_tcp(family AddrFamily, saddr string, options ListenOptions) !&TcpL
 	}
 	mut s := new_tcp_socket(family) or { return error('${err.msg()}; could not create new socket') }
 	s.set_dualstack(options.dualstack) or {}
+	if options.reuse_port {
+		$if windows {
+			return error('listen_tcp: reuse_port is not supported on windows')
+		} $else {
+			s.set_option(C.SOL_SOCKET, C.SO_REUSEPORT, 1)!
+		}
+	}
 
 	addrs := resolve_addrs(saddr, family, .tcp) or {
 		return error('${err.msg()}; could not resolve address ${saddr}')
@@ -449,7 +467,7 @@ pub fn (mut l TcpListener) accept_only() !&TcpConn {
 	}
 
 	mut new_handle := $if is_coroutine ? {
-		C.photon_accept(l.sock.handle, 0, 0, tcp_default_read_timeout)
+		C.vcoro_accept(l.sock.handle, 0, 0, l.accept_timeout)
 	} $else {
 		C.accept(l.sock.handle, 0, 0)
 	}
@@ -459,13 +477,18 @@ pub fn (mut l TcpListener) accept_only() !&TcpConn {
 		if code in [int(error_einprogress), int(error_ewouldblock), int(error_eagain), C.EINTR] {
 			l.wait_for_accept()!
 			new_handle = $if is_coroutine ? {
-				C.photon_accept(l.sock.handle, 0, 0, tcp_default_read_timeout)
+				C.vcoro_accept(l.sock.handle, 0, 0, l.accept_timeout)
 			} $else {
 				C.accept(l.sock.handle, 0, 0)
 			}
 		}
 	}
 	if new_handle <= 0 {
+		$if is_coroutine ? {
+			if error_code() == C.ETIMEDOUT {
+				return err_timed_out
+			}
+		}
 		return error('accept failed')
 	}
 
@@ -517,7 +540,7 @@ struct TcpSocket {
 @[noinline]
 fn new_tcp_socket(family AddrFamily) !TcpSocket {
 	handle := $if is_coroutine ? {
-		socket_error(C.photon_socket(family, SocketType.tcp, 0))!
+		socket_error(C.vcoro_socket(family, SocketType.tcp, 0))!
 	} $else {
 		socket_error(C.socket(family, SocketType.tcp, 0))!
 	}
@@ -635,7 +658,7 @@ const connect_timeout = 5 * time.second
 fn (mut s TcpSocket) connect(a Addr) ! {
 	$if net_nonblocking_sockets ? {
 		res := $if is_coroutine ? {
-			C.photon_connect(s.handle, voidptr(&a), a.len(), tcp_default_read_timeout)
+			C.vcoro_connect(s.handle, voidptr(&a), a.len(), tcp_default_read_timeout)
 		} $else {
 			C.connect(s.handle, voidptr(&a), a.len())
 		}
@@ -675,7 +698,7 @@ fn (mut s TcpSocket) connect(a Addr) ! {
 		return
 	} $else {
 		x := $if is_coroutine ? {
-			C.photon_connect(s.handle, voidptr(&a), a.len(), tcp_default_read_timeout)
+			C.vcoro_connect(s.handle, voidptr(&a), a.len(), tcp_default_read_timeout)
 		} $else {
 			C.connect(s.handle, voidptr(&a), a.len())
 		}
@@ -90,7 +90,7 @@ pub fn (mut c StreamConn) write_ptr(b &u8, len int) !int {
 			ptr := ptr_base + total_sent
 			remaining := len - total_sent
 			mut sent := $if is_coroutine ? {
-				C.photon_send(c.sock.handle, ptr, remaining, net.msg_nosignal, c.write_timeout)
+				C.vcoro_send(c.sock.handle, ptr, remaining, net.msg_nosignal, c.write_timeout)
 			} $else {
 				C.send(c.sock.handle, ptr, remaining, net.msg_nosignal)
 			}
@@ -125,7 +125,7 @@ pub fn (mut c StreamConn) write_string(s string) !int {
 // read_ptr attempts to write all data
 pub fn (mut c StreamConn) read_ptr(buf_ptr &u8, len int) !int {
 	mut res := $if is_coroutine ? {
-		wrap_read_result(C.photon_recv(c.sock.handle, voidptr(buf_ptr), len, 0, c.read_timeout))!
+		wrap_read_result(C.vcoro_recv(c.sock.handle, voidptr(buf_ptr), len, 0, c.read_timeout))!
 	} $else {
 		wrap_read_result(C.recv(c.sock.handle, voidptr(buf_ptr), len, 0))!
 	}
@@ -144,7 +144,7 @@ pub fn (mut c StreamConn) read_ptr(buf_ptr &u8, len int) !int {
 	if code == int(net.error_ewouldblock) {
 		c.wait_for_read()!
 		res = $if is_coroutine ? {
-			wrap_read_result(C.photon_recv(c.sock.handle, voidptr(buf_ptr), len, 0, c.read_timeout))!
+			wrap_read_result(C.vcoro_recv(c.sock.handle, voidptr(buf_ptr), len, 0, c.read_timeout))!
 		} $else {
 			wrap_read_result(C.recv(c.sock.handle, voidptr(buf_ptr), len, 0))!
 		}
@@ -290,14 +290,14 @@ pub fn (mut l StreamListener) accept() !&StreamConn {
 	}
 
 	mut new_handle := $if is_coroutine ? {
-		C.photon_accept(l.sock.handle, 0, 0, unix_default_read_timeout)
+		C.vcoro_accept(l.sock.handle, 0, 0, unix_default_read_timeout)
 	} $else {
 		C.accept(l.sock.handle, 0, 0)
 	}
 	if new_handle <= 0 {
 		l.wait_for_accept()!
 		new_handle = $if is_coroutine ? {
-			C.photon_accept(l.sock.handle, 0, 0, unix_default_read_timeout)
+			C.vcoro_accept(l.sock.handle, 0, 0, unix_default_read_timeout)
 		} $else {
 			C.accept(l.sock.handle, 0, 0)
 		}
@@ -382,7 +382,7 @@ mut:
 
 fn new_stream_socket(socket_path string) !StreamSocket {
 	handle := $if is_coroutine ? {
-		net.socket_error(C.photon_socket(.unix, .tcp, 0))!
+		net.socket_error(C.vcoro_socket(.unix, .tcp, 0))!
 	} $else {
 		net.socket_error(C.socket(.unix, .tcp, 0))!
 	}
@@ -447,7 +447,7 @@ fn (mut s StreamSocket) connect(socket_path string) ! {
 
 	$if net_nonblocking_sockets ? {
 		res := $if is_coroutine ? {
-			C.photon_connect(s.handle, voidptr(&addr), alen, unix_default_read_timeout)
+			C.vcoro_connect(s.handle, voidptr(&addr), alen, unix_default_read_timeout)
 		} $else {
 			C.connect(s.handle, voidptr(&addr), alen)
 		}
@@ -484,7 +484,7 @@ fn (mut s StreamSocket) connect(socket_path string) ! {
 		return
 	} $else {
 		x := $if is_coroutine ? {
-			C.photon_connect(s.handle, voidptr(&addr), alen, unix_default_read_timeout)
+			C.vcoro_connect(s.handle, voidptr(&addr), alen, unix_default_read_timeout)
 		} $else {
 			C.connect(s.handle, voidptr(&addr), alen)
 		}
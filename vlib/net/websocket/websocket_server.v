@@ -78,7 +78,11 @@ pub fn (mut s Server) listen() ! {
 	spawn s.handle_ping()
 	for {
 		mut c := s.accept_new_client() or { continue }
-		spawn s.serve_client(mut c)
+		$if is_coroutine ? {
+			go s.serve_client(mut c)
+		} $else {
+			spawn s.serve_client(mut c)
+		}
 	}
 	s.logger.info('websocket server: end listen on port ${s.port}')
 }
@@ -1,5 +1,6 @@
 module orm
 
+import strings
 import time
 
 pub const num64 = [typeof[i64]().idx, typeof[u64]().idx]
@@ -202,6 +203,139 @@ pub interface Connection {
 	last_id() int
 }
 
+// the rows, that `insert xs into Table` sends in a single statement (or COPY), unless the connection
+// sets another number
+pub const default_batch_size = 1000
+
+// BatchData holds the rows of `insert xs into Table`. The values of each row are in the order of
+// `fields`; auto_fields are the indexes of the fields, where the db should generate a value, when
+// it is absent, like in QueryData.
+pub struct BatchData {
+pub:
+	fields      []string
+	rows        [][]Primitive
+	auto_fields []int
+}
+
+// BatchGroup is a run of consecutive rows of a BatchData, that insert the same columns
+pub struct BatchGroup {
+pub:
+	fields []string
+	rows   [][]Primitive
+}
+
+// BatchConnection is implemented by the connections, that can insert many rows at once, with
+// multi-row VALUES, or COPY, instead of an INSERT per row
+pub interface BatchConnection {
+	insert_batch(table string, data BatchData) !
+}
+
+// insert_batch is used internally by V's ORM for processing `insert xs into Table`, where `xs` is
+// an array. The rows are inserted with `BatchConnection.insert_batch`, when the connection
+// implements it, and one by one with `Connection.insert` otherwise.
+pub fn insert_batch(conn Connection, table string, data BatchData) ! {
+	if conn is BatchConnection {
+		return conn.insert_batch(table, data)
+	}
+	for row in data.rows {
+		conn.insert(table, QueryData{
+			fields:      data.fields
+			data:        row
+			auto_fields: data.auto_fields
+		})!
+	}
+}
+
+// groups splits the rows in runs of at most `max_rows` rows, that insert the same columns: the
+// auto fields without a value are left out of a row, so that the db generates them, and a run
+// ends, where that changes
+pub fn (data BatchData) groups(max_rows int) []BatchGroup {
+	mut groups := []BatchGroup{}
+	mut fields := []string{}
+	mut rows := [][]Primitive{}
+	mut skipped := []int{}
+	for row in data.rows {
+		mut row_skipped := []int{}
+		for i in data.auto_fields {
+			if i < row.len && is_empty_auto_value(row[i]) {
+				row_skipped << i
+			}
+		}
+		if rows.len > 0 && (row_skipped != skipped || rows.len >= max_rows || fields.len == 0) {
+			groups << BatchGroup{
+				fields: fields
+				rows:   rows
+			}
+			rows = [][]Primitive{}
+		}
+		if rows.len == 0 {
+			skipped = row_skipped
+			fields = []string{}
+			for i, field in data.fields {
+				if i !in skipped {
+					fields << field
+				}
+			}
+		}
+		if skipped.len == 0 {
+			rows << row
+		} else {
+			mut values := []Primitive{cap: fields.len}
+			for i, value in row {
+				if i !in skipped {
+					values << value
+				}
+			}
+			rows << values
+		}
+	}
+	if rows.len > 0 {
+		groups << BatchGroup{
+			fields: fields
+			rows:   rows
+		}
+	}
+	return groups
+}
+
+// orm_batch_insert_gen generates an INSERT of the `rows` rows of a BatchGroup with the columns
+// `fields`, with multi-row VALUES. A group without columns is a single row of default values.
+// q, num, qm and start_pos are like in orm_stmt_gen.
+pub fn orm_batch_insert_gen(sql_dialect SQLDialect, table string, q string, fields []string, rows int,
+	num bool, qm string, start_pos int) string {
+	if fields.len == 0 {
+		if sql_dialect == .sqlite {
+			return 'INSERT INTO ${q}${table}${q} DEFAULT VALUES'
+		}
+		return 'INSERT INTO ${q}${table}${q} () VALUES ()'
+	}
+	mut sb := strings.new_builder(64 + rows * fields.len * 4)
+	sb.write_string('INSERT INTO ${q}${table}${q} (')
+	for i, field in fields {
+		if i > 0 {
+			sb.write_string(', ')
+		}
+		sb.write_string('${q}${field}${q}')
+	}
+	sb.write_string(') VALUES ')
+	mut c := start_pos
+	for r in 0 .. rows {
+		if r > 0 {
+			sb.write_string(', ')
+		}
+		sb.write_u8(`(`)
+		for i in 0 .. fields.len {
+			if i > 0 {
+				sb.write_string(', ')
+			}
+			sb.write_string(factory_insert_qm_value(num, qm, c))
+			c++
+		}
+		sb.write_u8(`)`)
+	}
+	return sb.str()
+}
+
 // Generates an sql stmt, from universal parameter
 // q - The quotes character, which can be different in every type, so it's variable
 // num - Stmt uses nums at prepared statements (? or ?1)
@@ -227,20 +361,8 @@ pub fn orm_stmt_gen(sql_dialect SQLDialect, table string, q string, kind StmtKin
 					// skip fields and allow the database to insert default and
 					// serial (auto-increment) values where a default (or no)
 					// value was provided
-					if is_auto_field {
-						mut x := data.data[i]
-						skip_auto_field := match mut x {
-							Null { true }
-							string { x == '' }
-							i8, i16, int, i64, u8, u16, u32, u64 { u64(x) == 0 }
-							f32, f64 { f64(x) == 0 }
-							time.Time { x == time.Time{} }
-							bool { !x }
-							else { false }
-						}
-						if skip_auto_field {
-							continue
-						}
+					if is_auto_field && is_empty_auto_value(data.data[i]) {
+						continue
 					}
 
 					data_data << data.data[i]
@@ -743,6 +865,21 @@ fn infix_to_primitive(b InfixType) Primitive {
 	return Primitive(b)
 }
 
+// is_empty_auto_value returns true, when the value of an auto field is absent, so that the db
+// should generate it
+fn is_empty_auto_value(value Primitive) bool {
+	mut x := value
+	return match mut x {
+		Null { true }
+		string { x == '' }
+		i8, i16, int, i64, u8, u16, u32, u64 { u64(x) == 0 }
+		f32, f64 { f64(x) == 0 }
+		time.Time { x == time.Time{} }
+		bool { !x }
+		else { false }
+	}
+}
+
 fn factory_insert_qm_value(num bool, qm string, c int) string {
 	if num {
 		return '${qm}${c}'
@@ -0,0 +1,146 @@
+import db.sqlite
+import orm
+
+struct Measurement {
+	id     int @[primary; sql: serial]
+	sensor string
+	value  f64
+	note   ?string
+}
+
+struct Box {
+	id    int @[primary; sql: serial]
+	label string
+	items []Item @[fkey: 'box_id']
+}
+
+struct Item {
+	id     int @[primary; sql: serial]
+	box_id int
+	name   string
+}
+
+fn test_batch_insert_array() {
+	mut db := sqlite.connect(':memory:')!
+	db.batch_size = 100
+	sql db {
+		create table Measurement
+	}!
+	mut measurements := []Measurement{}
+	for i in 0 .. 1050 {
+		measurements << Measurement{
+			sensor: 'sensor ${i % 7}'
+			value:  f64(i) / 2
+			note:   if i % 2 == 0 { 'even ${i}' } else { none }
+		}
+	}
+	// an explicit id in the middle: the rows around it are inserted without one
+	measurements << Measurement{
+		id:     5000
+		sensor: 'fixed'
+	}
+	measurements << Measurement{
+		sensor: 'last'
+	}
+	sql db {
+		insert measurements into Measurement
+	}!
+	count := sql db {
+		select count from Measurement
+	}!
+	assert count == 1052
+	rows := sql db {
+		select from Measurement where id == 11
+	}!
+	assert rows[0].sensor == 'sensor 3'
+	assert rows[0].value == 5.0
+	assert rows[0].note or { '' } == 'even 10'
+	fixed := sql db {
+		select from Measurement where sensor == 'fixed'
+	}!
+	assert fixed[0].id == 5000
+	last := sql db {
+		select from Measurement where sensor == 'last'
+	}!
+	assert last[0].id == 5001
+	nulls := sql db {
+		select count from Measurement where note is none
+	}!
+	assert nulls == 527
+}
+
+fn test_batch_insert_rolls_back_on_error() {
+	mut db := sqlite.connect(':memory:')!
+	db.batch_size = 2
+	sql db {
+		create table Measurement
+	}!
+	measurements := [Measurement{
+		id:     1
+		sensor: 'a'
+	}, Measurement{
+		id:     2
+		sensor: 'b'
+	}, Measurement{
+		id:     1
+		sensor: 'duplicate'
+	}]
+	sql db {
+		insert measurements into Measurement
+	} or { assert err.msg().contains('UNIQUE') }
+	count := sql db {
+		select count from Measurement
+	}!
+	assert count == 0
+}
+
+fn test_batch_insert_with_related_tables() {
+	db := sqlite.connect(':memory:')!
+	sql db {
+		create table Box
+		create table Item
+	}!
+	boxes := [Box{
+		label: 'first'
+		items: [Item{
+			name: 'a'
+		}, Item{
+			name: 'b'
+		}]
+	}, Box{
+		label: 'second'
+		items: [Item{
+			name: 'c'
+		}]
+	}]
+	sql db {
+		insert boxes into Box
+	}!
+	second := sql db {
+		select from Box where label == 'second'
+	}!
+	assert second[0].items.len == 1
+	assert second[0].items[0].name == 'c'
+	items := sql db {
+		select count from Item
+	}!
+	assert items == 3
+}
+
+fn test_batch_data_groups() {
+	data := orm.BatchData{
+		fields:      ['id', 'name']
+		rows:        [[orm.Primitive(0), 'a'], [orm.Primitive(0), 'b'], [orm.Primitive(7), 'c'],
+			[orm.Primitive(0), 'd']]
+		auto_fields: [0]
+	}
+	groups := data.groups(10)
+	assert groups.len == 3
+	assert groups[0].fields == ['name']
+	assert groups[0].rows.len == 2
+	assert groups[1].fields == ['id', 'name']
+	assert groups[1].rows == [[orm.Primitive(7), 'c']]
+	assert groups[2].rows == [[orm.Primitive('d')]]
+	assert data.groups(1).len == 4
+	assert orm.orm_batch_insert_gen(.sqlite, 'T', '`', ['a', 'b'], 2, true, '?', 1) == 'INSERT INTO `T` (`a`, `b`) VALUES (?1, ?2), (?3, ?4)'
+}
@@ -34,7 +34,7 @@ fn (mut pv Picoev) update_events(fd int, events int) int {
 
 // performs a single iteration of the select-based event loop
 @[direct_array_access]
-fn (mut pv Picoev) poll_once(max_wait_in_sec int) int {
+fn (mut pv Picoev) poll_once(max_wait_in_ms int) int {
 	// Initializes sets for read, write, and error events
 	readfds, writefds, errorfds := C.fd_set{}, C.fd_set{}, C.fd_set{}
 
@@ -65,8 +65,8 @@ fn (mut pv Picoev) poll_once(max_wait_in_sec int) int {
 
 	// select and handle sockets if any
 	tv := C.timeval{
-		tv_sec:  u64(max_wait_in_sec)
-		tv_usec: 0
+		tv_sec:  u64(max_wait_in_ms / 1000)
+		tv_usec: u64(max_wait_in_ms % 1000) * 1000
 	}
 	r := C.@select(maxfd + 1, &readfds, &writefds, &errorfds, &tv)
 	if r == -1 {
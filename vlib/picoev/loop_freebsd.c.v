@@ -158,10 +158,10 @@ fn (mut pv Picoev) update_events(fd int, events int) int {
 }
 
 @[direct_array_access]
-fn (mut pv Picoev) poll_once(max_wait_in_sec int) int {
+fn (mut pv Picoev) poll_once(max_wait_in_ms int) int {
 	ts := C.timespec{
-		tv_sec:  max_wait_in_sec
-		tv_nsec: 0
+		tv_sec:  max_wait_in_ms / 1000
+		tv_nsec: (max_wait_in_ms % 1000) * 1_000_000
 	}
 
 	mut total, mut nevents := 0, 0
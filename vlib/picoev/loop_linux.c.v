@@ -1,6 +1,12 @@
 module picoev
 
 #include <sys/epoll.h>
+#flag -I @VEXEROOT/vlib/picoev
+// the io_uring loop needs the headers of Linux 5.19 or newer, so it is opt-in
+$if picoev_io_uring ? {
+	#flag -DPICOEV_IO_URING
+}
+#include "vuring.c"
 
 fn C.epoll_create(int) int
 fn C.epoll_wait(int, voidptr, int, int) int
@@ -22,6 +28,40 @@ mut:
 	data   C.epoll_data_t
 }
 
+@[typedef]
+pub struct C.vuring {}
+
+fn C.vuring_init(r &C.vuring, entries u32) int
+fn C.vuring_free(r &C.vuring)
+fn C.vuring_submit(r &C.vuring, wait_nr u32, timeout_ms int) int
+fn C.vuring_next(r &C.vuring, user_data &u64, res &int, flags &u32) int
+fn C.vuring_poll(r &C.vuring, fd int, events u32, user_data u64) int
+fn C.vuring_cancel(r &C.vuring, user_data u64) int
+fn C.vuring_accept_multishot(r &C.vuring, fd int, user_data u64) int
+fn C.vuring_recv_multishot(r &C.vuring, fd int, user_data u64) int
+fn C.vuring_rw(r &C.vuring, write int, fd int, buf voidptr, len u32, offset u64, user_data u64) int
+fn C.vuring_setup_buffers(r &C.vuring, entries u32, size u32) int
+fn C.vuring_buffer(r &C.vuring, bid u32) &u8
+fn C.vuring_recycle_buffer(r &C.vuring, bid u32)
+
+// the size of the submission queue of an io_uring loop
+const uring_entries = 1024
+
+// the number of the buffers, that the kernel picks from for the multishot receives
+const uring_buffers = 256
+
+// the kinds of requests, that an io_uring loop keeps in flight, in the top byte of the user data
+const uring_poll = u64(1)
+const uring_accept = u64(2)
+const uring_recv = u64(3)
+const uring_file = u64(4)
+const uring_cancel = u64(5) // the completions of the cancel requests themselves, see vuring.c
+
+// flags of the completions, from linux/io_uring.h
+const uring_cqe_f_buffer = u32(1)
+const uring_cqe_f_more = u32(2)
+const uring_cqe_buffer_shift = 16
+
 @[heap]
 pub struct EpollLoop {
 mut:
@@ -29,6 +69,14 @@ mut:
 	epoll_fd int
 	events   [1024]C.epoll_event
 	now      i64
+	// set, when the loop runs on io_uring, instead of epoll
+	uring &C.vuring = unsafe { nil }
+	// the request in flight for each fd: its kind, and for polls, the events in the low bits
+	armed [max_fds]u64
+	// bumped, when the request of an fd is cancelled, so that its late completions are ignored
+	gen      [max_fds]u16
+	file_ops []FileOp
+	free_ops []int
 }
 
 type LoopType = EpollLoop
@@ -48,6 +96,89 @@ pub fn create_epoll_loop(id int) !&EpollLoop {
 	return loop
 }
 
+// create_io_uring_loop creates a new io_uring instance, and returns an `EpollLoop` struct with
+// `id`, that polls, accepts and receives on it, instead of epoll. When `recv_buffer_size` is not 0,
+// the connections receive their data into buffers of that size, provided to the kernel up front.
+// It fails on kernels older than 5.19, and where io_uring is disabled.
+pub fn create_io_uring_loop(id int, recv_buffer_size int) !&EpollLoop {
+	$if !picoev_io_uring ? {
+		return error('picoev is compiled without io_uring support, use `-d picoev_io_uring`')
+	}
+	mut uring := &C.vuring{}
+	mut ret := C.vuring_init(uring, uring_entries)
+	if ret != 0 {
+		return error_with_code('could not create io_uring loop!', -ret)
+	}
+	if recv_buffer_size > 0 {
+		ret = C.vuring_setup_buffers(uring, uring_buffers, u32(recv_buffer_size))
+		if ret != 0 {
+			C.vuring_free(uring)
+			return error_with_code('could not register the io_uring buffers!', -ret)
+		}
+	}
+	return &EpollLoop{
+		id:       id
+		epoll_fd: -1
+		uring:    uring
+	}
+}
+
+@[inline]
+fn uring_user_data(kind u64, gen u16, fd int) u64 {
+	return kind << 56 | u64(gen) << 32 | u64(u32(fd))
+}
+
+// uring_arm makes the request in flight for `fd` match the events of its target: a multishot
+// accept for listening sockets, a multishot receive for the connections of the built-in HTTP
+// handling, and a single-shot poll otherwise, since raw callbacks may leave data unread
+@[direct_array_access]
+fn (mut pv Picoev) uring_arm(fd int) {
+	target := pv.file_descriptors[fd]
+	mut want := u64(0)
+	if target.loop_id == pv.loop.id && target.events & picoev_readwrite != 0 {
+		if voidptr(target.cb) == voidptr(accept_callback) {
+			want = uring_accept << 56
+		} else if target.events & picoev_readwrite == picoev_read && isnil(pv.raw_callback) {
+			want = uring_recv << 56
+		} else {
+			want = uring_poll << 56 | u64(target.events & picoev_readwrite)
+		}
+	}
+	armed := pv.loop.armed[fd]
+	if want == armed {
+		return
+	}
+	if armed != 0 {
+		C.vuring_cancel(pv.loop.uring, uring_user_data(armed >> 56, pv.loop.gen[fd], fd))
+		pv.loop.gen[fd]++
+		pv.loop.armed[fd] = 0
+	}
+	if want == 0 {
+		return
+	}
+	kind := want >> 56
+	user_data := uring_user_data(kind, pv.loop.gen[fd], fd)
+	match kind {
+		uring_accept {
+			C.vuring_accept_multishot(pv.loop.uring, fd, user_data)
+		}
+		uring_recv {
+			C.vuring_recv_multishot(pv.loop.uring, fd, user_data)
+		}
+		else {
+			// vfmt off
+			mask := u32(
+				(if want & picoev_read != 0 { C.EPOLLIN } else { 0 })
+					|
+				(if want & picoev_write != 0 { C.EPOLLOUT } else { 0 })
+			)
+			// vfmt on
+			C.vuring_poll(pv.loop.uring, fd, mask, user_data)
+		}
+	}
+	pv.loop.armed[fd] = want
+}
+
 @[direct_array_access]
 fn (mut pv Picoev) update_events(fd int, events int) int {
 	// check if fd is in range
@@ -65,6 +196,12 @@ fn (mut pv Picoev) update_events(fd int, events int) int {
 		return 0
 	}
 
+	if pv.loop.uring != unsafe { nil } {
+		target.events = u32(events)
+		pv.uring_arm(fd)
+		return 0
+	}
+
 	// vfmt off
 	ev.events = u32(
 		(if events & picoev_read != 0 { C.EPOLLIN } else { 0 })
@@ -101,8 +238,11 @@ fn (mut pv Picoev) update_events(fd int, events int) int {
 }
 
 @[direct_array_access]
-fn (mut pv Picoev) poll_once(max_wait_in_sec int) int {
-	nevents := C.epoll_wait(pv.loop.epoll_fd, &pv.loop.events, max_fds, max_wait_in_sec * 1000)
+fn (mut pv Picoev) poll_once(max_wait_in_ms int) int {
+	if pv.loop.uring != unsafe { nil } {
+		return pv.uring_poll_once(max_wait_in_ms)
+	}
+	nevents := C.epoll_wait(pv.loop.epoll_fd, &pv.loop.events, max_fds, max_wait_in_ms)
 
 	if nevents == -1 {
 		// timeout has occurred
@@ -138,3 +278,141 @@ fn (mut pv Picoev) poll_once(max_wait_in_sec int) int {
 	}
 	return 0
 }
+
+// uring_poll_once submits the requests queued since the last call, waits for at least one
+// completion, and handles all the completions that are ready
+@[direct_array_access]
+fn (mut pv Picoev) uring_poll_once(max_wait_in_ms int) int {
+	if C.vuring_submit(pv.loop.uring, 1, max_wait_in_ms) < 0 {
+		return -1
+	}
+
+	mut user_data := u64(0)
+	mut res := 0
+	mut flags := u32(0)
+	for C.vuring_next(pv.loop.uring, &user_data, &res, &flags) != 0 {
+		kind := user_data >> 56
+		fd := int(u32(user_data))
+		if kind == uring_cancel {
+			continue
+		}
+		if kind == uring_file {
+			pv.uring_file_done(fd, res)
+			continue
+		}
+		if fd < 0 || fd >= max_fds {
+			continue
+		}
+		if user_data != uring_user_data(kind, pv.loop.gen[fd], fd) {
+			// a completion of a cancelled request
+			if flags & uring_cqe_f_buffer != 0 {
+				C.vuring_recycle_buffer(pv.loop.uring, flags >> uring_cqe_buffer_shift)
+			}
+			continue
+		}
+		if flags & uring_cqe_f_more == 0 {
+			pv.loop.armed[fd] = 0
+		}
+		target := pv.file_descriptors[fd]
+		match kind {
+			uring_poll {
+				mut read_events := 0
+				if res > 0 {
+					if u32(res) & u32(C.EPOLLIN | C.EPOLLHUP | C.EPOLLERR) != 0 {
+						read_events |= picoev_read
+					}
+					if u32(res) & u32(C.EPOLLOUT | C.EPOLLERR) != 0 {
+						read_events |= picoev_write
+					}
+				}
+				read_events &= int(target.events)
+				if read_events != 0 {
+					unsafe { target.cb(fd, read_events, &pv) }
+				}
+			}
+			uring_accept {
+				if res >= 0 {
+					pv.add_accepted(res)
+				} else if res != -C.EAGAIN && res != -C.ECONNABORTED {
+					eprintln('Error during accept: ${res}')
+				}
+			}
+			uring_recv {
+				if res > 0 {
+					bid := flags >> uring_cqe_buffer_shift
+					pv.handle_recv(fd, C.vuring_buffer(pv.loop.uring, bid), res)
+					C.vuring_recycle_buffer(pv.loop.uring, bid)
+				} else if res != -C.ENOBUFS {
+					// closed by the peer, or failed
+					pv.idx[fd] = 0
+					pv.close_conn(fd)
+				}
+			}
+			else {}
+		}
+		if pv.loop.armed[fd] == 0 {
+			// the single-shot poll, or the multishot request, has ended
+			pv.uring_arm(fd)
+		}
+	}
+	return 0
+}
+
+// handle_recv appends `len` bytes, received on `fd`, to its request buffer, and handles the
+// request, once it is complete
+@[direct_array_access]
+fn (mut pv Picoev) handle_recv(fd int, data &u8, len int) {
+	pv.set_timeout(fd, pv.timeout_secs)
+	room := pv.max_read - pv.idx[fd]
+	if len > room {
+		// The data does not fit in the request buffer. The request is handled with the part that
+		// fits, which fails with RequestIsTooLongError, when it is incomplete, and the connection is
+		// then closed, since the rest of the data can not be kept.
+		unsafe { vmemcpy(pv.buf + fd * pv.max_read + pv.idx[fd], data, room) }
+		pv.idx[fd] += room
+		pv.dispatch_request(fd)
+		pv.idx[fd] = 0
+		pv.close_conn(fd)
+		return
+	}
+	unsafe { vmemcpy(pv.buf + fd * pv.max_read + pv.idx[fd], data, len) }
+	pv.idx[fd] += len
+	if pv.dispatch_request(fd) {
+		pv.idx[fd] = 0
+	}
+}
+
+// start_file_op queues a read or a write on the ring; it returns false, when the loop has no ring
+fn (mut pv Picoev) start_file_op(write bool, fd int, buf []u8, offset u64, cb FileCallback, user_data voidptr) bool {
+	if pv.loop.uring == unsafe { nil } {
+		return false
+	}
+	op := FileOp{
+		cb:        cb
+		user_data: user_data
+		buf:       buf
+	}
+	mut idx := 0
+	if pv.loop.free_ops.len > 0 {
+		idx = pv.loop.free_ops.pop()
+		pv.loop.file_ops[idx] = op
+	} else {
+		idx = pv.loop.file_ops.len
+		pv.loop.file_ops << op
+	}
+	C.vuring_rw(pv.loop.uring, if write { 1 } else { 0 }, fd, buf.data, u32(buf.len), offset,
+		uring_user_data(uring_file, 0, idx))
+	return true
+}
+
+// uring_file_done calls the callback of the finished file operation `idx`
+@[direct_array_access]
+fn (mut pv Picoev) uring_file_done(idx int, res int) {
+	if idx < 0 || idx >= pv.loop.file_ops.len {
+		return
+	}
+	op := pv.loop.file_ops[idx]
+	pv.loop.file_ops[idx] = FileOp{}
+	pv.loop.free_ops << idx
+	op.cb(mut pv, res, op.user_data)
+}
@@ -1,6 +1,7 @@
 module picoev
 
 import net
+import os
 import picohttpparser
 import time
 
@@ -54,6 +55,22 @@ pub:
 	max_write    int                       = 8192
 	family       net.AddrFamily            = .ip6
 	host         string
+	// on Linux, run the loop on io_uring instead of epoll, when compiled with `-d picoev_io_uring`;
+	// it falls back to epoll otherwise, or when the kernel does not support io_uring (it needs 5.19,
+	// or newer)
+	io_uring bool
+}
+
+// FileCallback is called from the loop, when a read or a write started with `read_file_at` or
+// `write_file_at` completes, with the number of bytes transferred, or a negative errno
+pub type FileCallback = fn (mut pv Picoev, result int, user_data voidptr)
+
+struct FileOp {
+mut:
+	cb        FileCallback = unsafe { nil }
+	user_data voidptr
+	result    int
+	buf       []u8 // kept referenced, while the kernel uses it
 }
 
 // Core structure for managing the event loop and connections.
@@ -74,14 +91,21 @@ pub struct Picoev {
 mut:
 	loop             &LoopType = unsafe { nil }
 	file_descriptors [max_fds]&Target
-	timeouts         map[int]i64
 	num_loops        int
+	// the idle timeouts of the connections, and the timers of `add_timer`
+	timers    TimerWheel
+	fd_timers [max_fds]TimerId
+	expired   []TimerId
+	now_ms    i64
 
 	buf &u8 = unsafe { nil }
 	idx [1024]int
 	out &u8 = unsafe { nil }
 
 	date string
+
+	// file operations completed without a ring, waiting for the next iteration of the loop
+	pending_files []FileOp
 pub:
 	user_data voidptr = unsafe { nil }
 }
@@ -91,6 +115,8 @@ pub fn (mut pv Picoev) init() {
 	assert max_fds > 0
 
 	pv.num_loops = 0
+	pv.now_ms = monotonic_ms()
+	pv.timers = new_timer_wheel(pv.now_ms)
 
 	for i in 0 .. max_fds {
 		pv.file_descriptors[i] = &Target{}
@@ -156,17 +182,28 @@ pub fn (mut pv Picoev) delete(fd int) int {
 
 fn (mut pv Picoev) loop_once(max_wait_in_sec int) int {
 	pv.loop.now = get_time()
+	pv.now_ms = monotonic_ms()
 
-	if pv.poll_once(max_wait_in_sec) != 0 {
+	// wake up in time for the next timer, and at once for completed file operations
+	mut max_wait_in_ms := pv.timers.next_timeout(pv.now_ms, max_wait_in_sec * 1000)
+	if pv.pending_files.len > 0 {
+		max_wait_in_ms = 0
+	}
+
+	if pv.poll_once(max_wait_in_ms) != 0 {
 		eprintln('Error during poll_once')
 		return -1
 	}
 
-	if max_wait_in_sec != 0 {
-		pv.loop.now = get_time() // Update loop start time again if waiting occurred
-	} else {
-		// If no waiting, skip timeout handling for potential performance optimization
-		return 0
+	pv.loop.now = get_time()
+	pv.now_ms = monotonic_ms()
+
+	if pv.pending_files.len > 0 {
+		pending := pv.pending_files
+		pv.pending_files = []FileOp{}
+		for op in pending {
+			op.cb(mut pv, op.result, op.user_data)
+		}
 	}
 
 	pv.handle_timeout()
@@ -179,31 +216,59 @@ fn (mut pv Picoev) loop_once(max_wait_in_sec int) int {
 fn (mut pv Picoev) set_timeout(fd int, secs int) {
 	assert fd < max_fds
 	if secs != 0 {
-		pv.timeouts[fd] = pv.loop.now + secs
-	} else {
-		pv.timeouts.delete(fd)
+		deadline := pv.now_ms + i64(secs) * 1000
+		if !pv.timers.reset(pv.fd_timers[fd], deadline) {
+			pv.fd_timers[fd] = pv.timers.add(deadline, fd, unsafe { nil }, unsafe { nil })
+		}
+	} else if pv.fd_timers[fd] != 0 {
+		pv.timers.cancel(pv.fd_timers[fd])
+		pv.fd_timers[fd] = 0
 	}
 }
 
-// handle_timeout loops over all file descriptors and removes them from the loop
-// if they are timed out. Also the file descriptors target callback is called with a
-// timeout event
-@[direct_array_access; inline]
+// handle_timeout expires the timers, that are due. The target callback of a file descriptor,
+// that timed out, is called with a timeout event.
+@[direct_array_access]
 fn (mut pv Picoev) handle_timeout() {
-	mut to_remove := []int{}
-
-	for fd, timeout in pv.timeouts {
-		if timeout <= pv.loop.now {
-			to_remove << fd
+	pv.expired.clear()
+	pv.timers.advance(pv.now_ms, mut pv.expired)
+
+	for id in pv.expired {
+		timer := pv.timers.take(id) or { continue }
+		if timer.fd >= 0 {
+			pv.fd_timers[timer.fd] = 0
+			target := pv.file_descriptors[timer.fd]
+			assert target.loop_id == pv.loop.id
+			unsafe { target.cb(timer.fd, picoev_timeout, &pv) }
+		} else {
+			timer.cb(mut pv, timer.user_data)
 		}
 	}
+}
+
+// add_timer calls `cb` from the loop, once `delay` has passed. The returned id can be passed to
+// `cancel_timer` and `reset_timer`, till the timer expires.
+pub fn (mut pv Picoev) add_timer(delay time.Duration, cb TimerCallback, user_data voidptr) TimerId {
+	return pv.timers.add(monotonic_ms() + delay_ms(delay), -1, cb, user_data)
+}
+
+// cancel_timer stops the timer `id`. It returns false, when the timer has already expired.
+pub fn (mut pv Picoev) cancel_timer(id TimerId) bool {
+	return pv.timers.cancel(id)
+}
 
-	for fd in to_remove {
-		target := pv.file_descriptors[fd]
-		assert target.loop_id == pv.loop.id
-		pv.timeouts.delete(fd)
-		unsafe { target.cb(fd, picoev_timeout, &pv) }
+// reset_timer makes the timer `id` expire, once `delay` has passed from now, instead. It returns
+// false, when the timer has already expired.
+pub fn (mut pv Picoev) reset_timer(id TimerId, delay time.Duration) bool {
+	return pv.timers.reset(id, monotonic_ms() + delay_ms(delay))
+}
+
+@[inline]
+fn delay_ms(delay time.Duration) i64 {
+	if delay <= 0 {
+		return 0
 	}
+	return i64((delay + time.millisecond - 1) / time.millisecond)
 }
 
 // accept_callback accepts a new connection from `listen_fd` and adds it to the event loop
@@ -220,6 +285,11 @@ fn accept_callback(listen_fd int, events int, cb_arg voidptr) {
 		return
 	}
 
+	pv.add_accepted(accepted_fd)
+}
+
+// add_accepted sets up the new connection `accepted_fd`, and adds it to the event loop
+fn (mut pv Picoev) add_accepted(accepted_fd int) {
 	if accepted_fd >= max_fds {
 		// should never happen
 		close_socket(accepted_fd)
@@ -231,7 +301,7 @@ fn accept_callback(listen_fd int, events int, cb_arg voidptr) {
 	}
 
 	setup_sock(accepted_fd) or {
-		eprintln('setup_sock failed, fd: ${accepted_fd}, listen_fd: ${listen_fd}, err: ${err.code()}')
+		eprintln('setup_sock failed, fd: ${accepted_fd}, err: ${err.code()}')
 		pv.error_callback(pv.user_data, picohttpparser.Request{}, mut &picohttpparser.Response{},
 			err)
 		close_socket(accepted_fd) // Close fd on failure
@@ -280,19 +350,6 @@ fn raw_callback(fd int, events int, context voidptr) {
 		unsafe {
 			request_buffer += fd * pv.max_read // pointer magic
 		}
-		mut req := picohttpparser.Request{}
-
-		// Response init
-		mut response_buffer := pv.out
-		unsafe {
-			response_buffer += fd * pv.max_write // pointer magic
-		}
-		mut res := picohttpparser.Response{
-			fd:        fd
-			buf_start: response_buffer
-			buf:       response_buffer
-			date:      pv.date.str
-		}
 
 		for {
 			// Request parsing loop
@@ -314,26 +371,11 @@ fn raw_callback(fd int, events int, context voidptr) {
 			}
 			pv.idx[fd] += r
 
-			mut s := unsafe { tos(request_buffer, pv.idx[fd]) }
-			pret := req.parse_request(s) or {
-				// Parse error
-				pv.error_callback(pv.user_data, req, mut &res, err)
+			if pv.dispatch_request(fd) {
 				return
 			}
-			if pret > 0 { // Success
-				break
-			}
-
-			assert pret == -2
 			// request is incomplete, continue the loop
-			if pv.idx[fd] == sizeof(request_buffer) {
-				pv.error_callback(pv.user_data, req, mut &res, error('RequestIsTooLongError'))
-				return
-			}
 		}
-
-		// Callback (should call .end() itself)
-		pv.cb(pv.user_data, req, mut &res)
 	} else if events & picoev_write != 0 {
 		pv.set_timeout(fd, pv.timeout_secs)
 		if !isnil(pv.raw_callback) {
@@ -343,6 +385,108 @@ fn raw_callback(fd int, events int, context voidptr) {
 	}
 }
 
+// dispatch_request parses the data received so far on `fd`, and passes a complete request to the
+// callback. It returns false, when the request is still incomplete.
+@[direct_array_access]
+fn (mut pv Picoev) dispatch_request(fd int) bool {
+	mut request_buffer := pv.buf
+	unsafe {
+		request_buffer += fd * pv.max_read // pointer magic
+	}
+	mut req := picohttpparser.Request{}
+
+	// Response init
+	mut response_buffer := pv.out
+	unsafe {
+		response_buffer += fd * pv.max_write // pointer magic
+	}
+	mut res := picohttpparser.Response{
+		fd:        fd
+		buf_start: response_buffer
+		buf:       response_buffer
+		date:      pv.date.str
+	}
+
+	s := unsafe { tos(request_buffer, pv.idx[fd]) }
+	pret := req.parse_request(s) or {
+		// Parse error
+		pv.error_callback(pv.user_data, req, mut &res, err)
+		return true
+	}
+	if pret > 0 { // Success
+		// Callback (should call .end() itself)
+		pv.cb(pv.user_data, req, mut &res)
+		return true
+	}
+
+	assert pret == -2
+	if pv.idx[fd] >= pv.max_read {
+		pv.error_callback(pv.user_data, req, mut &res, error('RequestIsTooLongError'))
+		return true
+	}
+	return false
+}
+
+// read_file_at reads from `f`, at `offset`, into `buf`, and calls `cb` from the loop, with the
+// number of bytes read (0 at the end of the file). With io_uring, the kernel does the read on the
+// ring of the loop; otherwise it is done right away, and `cb` is called on the next iteration.
+// `buf` must not be used, before `cb` is called.
+pub fn (mut pv Picoev) read_file_at(f &os.File, mut buf []u8, offset u64, cb FileCallback, user_data voidptr) {
+	$if linux {
+		if pv.start_file_op(false, f.fd, buf, offset, cb, user_data) {
+			return
+		}
+	}
+	mut result := 0
+	$if windows {
+		mut file := unsafe { f }
+		result = file.read_from(offset, mut buf) or { -1 }
+	} $else {
+		result = int(C.pread(f.fd, buf.data, usize(buf.len), offset))
+		if result < 0 {
+			result = -C.errno
+		}
+	}
+	pv.pending_files << FileOp{
+		cb:        cb
+		user_data: user_data
+		result:    result
+	}
+}
+
+// write_file_at writes `buf` to `f`, at `offset`, and calls `cb` from the loop, with the number
+// of bytes written. Like `read_file_at`, it uses the ring of the loop with io_uring.
+pub fn (mut pv Picoev) write_file_at(mut f os.File, buf []u8, offset u64, cb FileCallback, user_data voidptr) {
+	$if linux {
+		if pv.start_file_op(true, f.fd, buf, offset, cb, user_data) {
+			return
+		}
+	}
+	mut result := 0
+	$if windows {
+		result = f.write_to(offset, buf) or { -1 }
+	} $else {
+		result = int(C.pwrite(f.fd, buf.data, usize(buf.len), offset))
+		if result < 0 {
+			result = -C.errno
+		}
+	}
+	pv.pending_files << FileOp{
+		cb:        cb
+		user_data: user_data
+		result:    result
+	}
+}
+
+// uses_io_uring returns true, when the loop runs on io_uring
+pub fn (pv &Picoev) uses_io_uring() bool {
+	$if linux {
+		return pv.loop.uring != unsafe { nil }
+	} $else {
+		return false
+	}
+}
+
 fn default_error_callback(data voidptr, req picohttpparser.Request, mut res picohttpparser.Response, error IError) {
 	eprintln('picoev: ${error}')
 	res.end()
@@ -372,11 +516,21 @@ pub fn new(config Config) !&Picoev {
 		pv.out = unsafe { malloc_noscan(max_fds * config.max_write + 1) }
 	}
 
-	// epoll on linux
+	// epoll, or io_uring, on linux
 	// kqueue on macos and bsd
 	// select on windows and others
 	$if linux {
-		pv.loop = create_epoll_loop(0) or { panic(err) }
+		if config.io_uring {
+			recv_buffer_size := if isnil(pv.raw_callback) { config.max_read } else { 0 }
+			pv.loop = create_io_uring_loop(0, recv_buffer_size) or {
+				$if trace_picoev ? {
+					eprintln('io_uring is not available, using epoll: ${err}')
+				}
+				create_epoll_loop(0) or { panic(err) }
+			}
+		} else {
+			pv.loop = create_epoll_loop(0) or { panic(err) }
+		}
 	} $else $if freebsd || macos {
 		pv.loop = create_kqueue_loop(0) or { panic(err) }
 	} $else {
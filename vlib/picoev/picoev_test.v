@@ -1,5 +1,8 @@
 module picoev
 
+import os
+import picohttpparser
+
 fn test_if_all_file_descriptors_are_properly_initialized() {
 	mut pv := &Picoev{}
 	pv.init()
@@ -10,3 +13,164 @@ fn test_if_all_file_descriptors_are_properly_initialized() {
 		assert unsafe { pv.file_descriptors[i].fd } == 0
 	}
 }
+
+fn test_timer_wheel_expires_timers_at_their_deadline() {
+	start := i64(1_000_000_007)
+	mut w := new_timer_wheel(start)
+	delays := [i64(1), 5, 255, 256, 300, 65_536, 70_000, 1 << 24, 1 << 33]
+	mut ids := map[TimerId]i64{}
+	for delay in delays {
+		ids[w.add(start + delay, -1, unsafe { nil }, unsafe { nil })] = start + delay
+	}
+	cancelled := w.add(start + 400, -1, unsafe { nil }, unsafe { nil })
+	assert w.cancel(cancelled)
+	assert !w.cancel(cancelled)
+	moved := w.add(start + 10, -1, unsafe { nil }, unsafe { nil })
+	assert w.reset(moved, start + 100_000)
+	ids[moved] = start + 100_000
+
+	mut now := start
+	mut expired := []TimerId{}
+	for now < start + (i64(1) << 34) {
+		step := if now - start < 200_000 { i64(997) } else { i64(1) << 20 }
+		now += step
+		expired.clear()
+		w.advance(now, mut expired)
+		for id in expired {
+			deadline := ids[id] or { panic('unexpected timer') }
+			assert deadline <= now && deadline > now - step
+			w.take(id) or { panic('the timer is gone') }
+			ids.delete(id)
+		}
+		if w.count == 0 {
+			break
+		}
+	}
+	assert ids.len == 0
+	assert w.count == 0
+}
+
+struct FileOpResult {
+mut:
+	done   bool
+	result int
+}
+
+fn file_op_done(mut pv Picoev, result int, user_data voidptr) {
+	mut r := unsafe { &FileOpResult(user_data) }
+	r.done = true
+	r.result = result
+}
+
+fn run_file_op(mut pv Picoev, r &FileOpResult) {
+	for _ in 0 .. 10 {
+		if r.done {
+			return
+		}
+		pv.loop_once(1)
+	}
+}
+
+fn check_file_ops(mut pv Picoev) {
+	path := os.join_path(os.vtmp_dir(), 'picoev_file_ops_${os.getpid()}_${pv.uses_io_uring()}.txt')
+	mut f := os.open_file(path, 'w+') or { panic(err) }
+	defer {
+		f.close()
+		os.rm(path) or {}
+	}
+	mut w := &FileOpResult{}
+	pv.write_file_at(mut f, 'hello picoev'.bytes(), 6, file_op_done, w)
+	run_file_op(mut pv, w)
+	assert w.done
+	assert w.result == 12
+
+	mut buf := []u8{len: 32}
+	mut r := &FileOpResult{}
+	pv.read_file_at(&f, mut buf, 0, file_op_done, r)
+	run_file_op(mut pv, r)
+	assert r.done
+	assert r.result == 18
+	assert buf[..6] == []u8{len: 6}
+	assert buf[6..18].bytestr() == 'hello picoev'
+
+	mut eof := &FileOpResult{}
+	pv.read_file_at(&f, mut buf, 100, file_op_done, eof)
+	run_file_op(mut pv, eof)
+	assert eof.done
+	assert eof.result == 0
+}
+
+fn test_file_ops_without_ring() {
+	mut pv := new(port: 18310)!
+	assert !pv.uses_io_uring()
+	check_file_ops(mut pv)
+}
+
+fn test_file_ops_on_io_uring() {
+	// without `-d picoev_io_uring`, or on older kernels, the loop falls back to epoll, and the file
+	// operations are done right away
+	mut pv := new(port: 18311, io_uring: true)!
+	$if !picoev_io_uring ? {
+		assert !pv.uses_io_uring()
+	}
+	check_file_ops(mut pv)
+}
+
+struct RecvState {
+mut:
+	paths  []string
+	errors []string
+}
+
+fn recv_ok_cb(data voidptr, req picohttpparser.Request, mut res picohttpparser.Response) {
+	mut state := unsafe { &RecvState(data) }
+	state.paths << req.path.clone()
+	res.write_string('HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n')
+	res.end()
+}
+
+fn recv_err_cb(data voidptr, req picohttpparser.Request, mut res picohttpparser.Response, error IError) {
+	mut state := unsafe { &RecvState(data) }
+	state.errors << error.msg()
+	res.write_string('HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n')
+	res.end()
+}
+
+fn C.socketpair(domain int, typ int, protocol int, sv &int) int
+
+fn test_handle_recv_does_not_drop_the_data_of_a_long_request() {
+	$if linux {
+		mut state := &RecvState{}
+		mut pv := new(port: 18312, max_read: 64, cb: recv_ok_cb, err_cb: recv_err_cb, user_data: state)!
+		mut fds := [2]int{}
+		assert C.socketpair(C.AF_UNIX, C.SOCK_STREAM, 0, &fds[0]) == 0
+		defer {
+			C.close(fds[1])
+		}
+		pv.add(fds[0], picoev_read, 0, raw_callback)
+		// a request received in two parts, that fit in the buffer
+		part1 := 'GET /short HTTP/1.1\r\n'
+		part2 := 'Host: a\r\n\r\n'
+		pv.handle_recv(fds[0], part1.str, part1.len)
+		assert state.paths.len == 0
+		pv.handle_recv(fds[0], part2.str, part2.len)
+		assert state.paths == ['/short']
+		// a request longer than the buffer is rejected, and the connection is closed
+		long := 'GET /${'x'.repeat(100)} HTTP/1.1\r\nHost: a\r\n\r\n'
+		pv.handle_recv(fds[0], long.str, long.len)
+		assert state.paths == ['/short']
+		assert state.errors == ['RequestIsTooLongError']
+		mut received := []u8{}
+		mut buf := [256]u8{}
+		for {
+			n := C.read(fds[1], &buf[0], 256)
+			if n <= 0 {
+				break
+			}
+			received << buf[..n]
+		}
+		responses := received.bytestr()
+		assert responses.starts_with('HTTP/1.1 200 OK')
+		assert responses.ends_with('HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n')
+	}
+}
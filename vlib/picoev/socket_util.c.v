@@ -17,6 +17,9 @@ $if windows {
 	#include <sys/resource.h>
 }
 
+fn C.pread(fd int, buf voidptr, count usize, offset u64) isize
+fn C.pwrite(fd int, buf voidptr, count usize, offset u64) isize
+
 @[inline]
 fn get_time() i64 {
 	// time.now() is slow
@@ -0,0 +1,298 @@
+module picoev
+
+import math.bits
+import time
+
+// the timing wheel has `wheel_levels` levels of `wheel_slots` slots each; a slot of level `l`
+// spans wheel_slots^l milliseconds, so that timers up to 2^32 ms (about 49 days) away are
+// placed directly, and later ones are placed again, once they come within reach
+const wheel_bits = 8
+const wheel_slots = 1 << wheel_bits
+const wheel_mask = wheel_slots - 1
+const wheel_levels = 4
+const wheel_span = i64(1) << (wheel_bits * wheel_levels)
+
+// TimerId identifies a timer added with `add_timer`. 0 is never a valid id.
+pub type TimerId = u64
+
+// TimerCallback is called from the loop, when a timer added with `add_timer` expires
+pub type TimerCallback = fn (mut pv Picoev, user_data voidptr)
+
+struct TimerNode {
+mut:
+	deadline  i64 // in milliseconds, on the monotonic clock
+	prev      int = -1
+	next      int = -1
+	slot      int = -1 // the list in `heads`, that the timer is in; -1, when it is not scheduled
+	gen       u32      // bumped, when the node is released, to invalidate the ids of the old timer
+	fd        int = -1 // the connection, for idle timeouts; -1 for the timers of `add_timer`
+	cb        TimerCallback = unsafe { nil }
+	user_data voidptr
+}
+
+// TimerWheel is a hierarchical timing wheel, with O(1) insertion, cancellation and rescheduling.
+// Each timer is in a doubly linked list, in the slot of the level, that its deadline falls in.
+// Every time the lowest level wraps around, the timers of the next slot of the level above are
+// moved down (cascaded), so that only the timers, that expire, are ever visited.
+struct TimerWheel {
+mut:
+	now      i64 // the time, in milliseconds, up to which the timers have been expired
+	heads    []int
+	occupied [wheel_levels * wheel_slots / 64]u64 // a bit for each slot, with timers in it
+	nodes    []TimerNode
+	free     []int
+	count    int // the number of scheduled timers
+}
+
+fn new_timer_wheel(now i64) TimerWheel {
+	return TimerWheel{
+		now:   now
+		heads: []int{len: wheel_levels * wheel_slots, init: -1}
+	}
+}
+
+// monotonic_ms returns the time of the monotonic clock, in milliseconds
+@[inline]
+fn monotonic_ms() i64 {
+	return i64(time.sys_mono_now() / 1_000_000)
+}
+
+// add schedules a new timer, expiring at `deadline`
+fn (mut w TimerWheel) add(deadline i64, fd int, cb TimerCallback, user_data voidptr) TimerId {
+	mut idx := 0
+	if w.free.len > 0 {
+		idx = w.free.pop()
+	} else {
+		idx = w.nodes.len
+		w.nodes << TimerNode{}
+	}
+	w.nodes[idx].deadline = deadline
+	w.nodes[idx].fd = fd
+	w.nodes[idx].cb = cb
+	w.nodes[idx].user_data = user_data
+	w.link(idx)
+	return TimerId(u64(w.nodes[idx].gen) << 32 | u64(idx + 1))
+}
+
+// lookup returns the node of `id`, or -1, when the timer has expired, or has been cancelled
+@[direct_array_access; inline]
+fn (w &TimerWheel) lookup(id TimerId) int {
+	idx := int(u32(id)) - 1
+	if idx < 0 || idx >= w.nodes.len || w.nodes[idx].gen != u32(u64(id) >> 32) {
+		return -1
+	}
+	return idx
+}
+
+// reset moves the timer `id` to `deadline`. It returns false, when the timer is gone.
+fn (mut w TimerWheel) reset(id TimerId, deadline i64) bool {
+	idx := w.lookup(id)
+	if idx < 0 {
+		return false
+	}
+	w.unlink(idx)
+	w.nodes[idx].deadline = deadline
+	w.link(idx)
+	return true
+}
+
+// cancel removes the timer `id`. It returns false, when the timer is gone.
+fn (mut w TimerWheel) cancel(id TimerId) bool {
+	idx := w.lookup(id)
+	if idx < 0 {
+		return false
+	}
+	w.unlink(idx)
+	w.release(idx)
+	return true
+}
+
+// take returns the timer `id`, that has expired in `advance`, and releases it; it returns none,
+// when the timer has been cancelled, or rescheduled, since
+fn (mut w TimerWheel) take(id TimerId) ?TimerNode {
+	idx := w.lookup(id)
+	if idx < 0 || w.nodes[idx].slot >= 0 {
+		return none
+	}
+	node := w.nodes[idx]
+	w.release(idx)
+	return node
+}
+
+@[direct_array_access]
+fn (mut w TimerWheel) release(idx int) {
+	gen := w.nodes[idx].gen + 1
+	w.nodes[idx] = TimerNode{
+		gen: gen
+	}
+	w.free << idx
+}
+
+// link puts the node `idx` in the slot of its deadline
+@[direct_array_access]
+fn (mut w TimerWheel) link(idx int) {
+	mut deadline := w.nodes[idx].deadline
+	if deadline <= w.now {
+		// already due: it expires on the next tick
+		deadline = w.now + 1
+	} else if deadline - w.now >= wheel_span {
+		// out of reach: it is placed again, when its slot is cascaded
+		deadline = w.now + wheel_span - 1
+	}
+	delta := deadline - w.now
+	mut level := 0
+	for level < wheel_levels - 1 && delta >= i64(1) << (wheel_bits * (level + 1)) {
+		level++
+	}
+	slot := level * wheel_slots + int((deadline >> (wheel_bits * level)) & wheel_mask)
+	head := w.heads[slot]
+	w.nodes[idx].slot = slot
+	w.nodes[idx].prev = -1
+	w.nodes[idx].next = head
+	if head >= 0 {
+		w.nodes[head].prev = idx
+	}
+	w.heads[slot] = idx
+	w.occupied[slot >> 6] |= u64(1) << (slot & 63)
+	w.count++
+}
+
+// unlink removes the node `idx` from its slot, if it is in one
+@[direct_array_access]
+fn (mut w TimerWheel) unlink(idx int) {
+	node := w.nodes[idx]
+	if node.slot < 0 {
+		return
+	}
+	if node.prev >= 0 {
+		w.nodes[node.prev].next = node.next
+	} else {
+		w.heads[node.slot] = node.next
+		if node.next < 0 {
+			w.occupied[node.slot >> 6] &= ~(u64(1) << (node.slot & 63))
+		}
+	}
+	if node.next >= 0 {
+		w.nodes[node.next].prev = node.prev
+	}
+	w.nodes[idx].slot = -1
+	w.nodes[idx].prev = -1
+	w.nodes[idx].next = -1
+	w.count--
+}
+
+// detach empties the slot `slot`, and returns the first node of its list
+@[direct_array_access]
+fn (mut w TimerWheel) detach(slot int) int {
+	head := w.heads[slot]
+	w.heads[slot] = -1
+	w.occupied[slot >> 6] &= ~(u64(1) << (slot & 63))
+	return head
+}
+
+// first_occupied returns the first slot of `level`, from index `from` on, that has timers, or -1
+@[direct_array_access]
+fn (w &TimerWheel) first_occupied(level int, from int) int {
+	mut i := from
+	for i < wheel_slots {
+		slot := level * wheel_slots + i
+		word := w.occupied[slot >> 6] >> u64(slot & 63)
+		if word != 0 {
+			return i + bits.trailing_zeros_64(word)
+		}
+		i = (i | 63) + 1
+	}
+	return -1
+}
+
+// next_tick returns the next tick after `now`, at which timers expire, or are cascaded. A level
+// is only looked at, when all the levels below it are empty, so that long idle stretches are
+// skipped in a few steps.
+fn (w &TimerWheel) next_tick() i64 {
+	for level in 0 .. wheel_levels {
+		shift := wheel_bits * level
+		current := int((w.now >> shift) & wheel_mask)
+		base := (w.now >> (shift + wheel_bits)) << (shift + wheel_bits)
+		index := w.first_occupied(level, current + 1)
+		if index >= 0 {
+			return base + (i64(index) << shift)
+		}
+		if w.first_occupied(level, 0) >= 0 {
+			// only slots, that come round again, after this level wraps around
+			return base + (i64(1) << (shift + wheel_bits))
+		}
+	}
+	return w.now + 1
+}
+
+// advance moves the wheel to `to`, and appends the ids of the expired timers to `expired`.
+// Ticks without timers are skipped, so the cost is in the number of the expired timers, plus one
+// step per rotation of the lowest level.
+@[direct_array_access]
+fn (mut w TimerWheel) advance(to i64, mut expired []TimerId) {
+	for w.now < to {
+		if w.count == 0 {
+			w.now = to
+			return
+		}
+		tick := w.next_tick()
+		if tick > to {
+			w.now = to
+			return
+		}
+		w.now = tick
+		if tick & wheel_mask == 0 {
+			// the lowest level wrapped around: bring the timers of the next slot of each level
+			// down, as long as that level wraps around too
+			for level in 1 .. wheel_levels {
+				index := int((tick >> (wheel_bits * level)) & wheel_mask)
+				mut idx := w.detach(level * wheel_slots + index)
+				for idx >= 0 {
+					next := w.nodes[idx].next
+					w.count--
+					if w.nodes[idx].deadline <= tick {
+						w.expire(idx, mut expired)
+					} else {
+						w.link(idx)
+					}
+					idx = next
+				}
+				if index != 0 {
+					break
+				}
+			}
+		}
+		mut idx := w.detach(int(tick & wheel_mask))
+		for idx >= 0 {
+			next := w.nodes[idx].next
+			w.count--
+			w.expire(idx, mut expired)
+			idx = next
+		}
+	}
+}
+
+// expire marks the node `idx`, detached from its slot, as expired
+@[direct_array_access; inline]
+fn (mut w TimerWheel) expire(idx int, mut expired []TimerId) {
+	w.nodes[idx].slot = -1
+	w.nodes[idx].prev = -1
+	w.nodes[idx].next = -1
+	expired << TimerId(u64(w.nodes[idx].gen) << 32 | u64(idx + 1))
+}
+
+// next_timeout returns the milliseconds until the next tick with timers to expire, capped at
+// `max_wait`; timers in the higher levels count as due at the end of the current rotation
+fn (w &TimerWheel) next_timeout(now i64, max_wait int) int {
+	if w.count == 0 {
+		return max_wait
+	}
+	wait := w.next_tick() - now
+	if wait <= 0 {
+		return 0
+	}
+	if wait < max_wait {
+		return int(wait)
+	}
+	return max_wait
+}
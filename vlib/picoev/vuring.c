@@ -0,0 +1,483 @@
+// A minimal io_uring wrapper for the picoev loop on Linux, without liburing: the setup of a ring,
+// the preparation of the submission queue entries, that picoev needs, the submission and the reaping
+// of the completions, and a ring of provided buffers for the multishot recvs.
+// The loop is single threaded, so the only synchronization needed is with the kernel, through the
+// head and tail indexes of the rings (acquire/release).
+// It needs the headers of Linux 5.19 or newer, so it is only compiled with `-d picoev_io_uring`,
+// which defines PICOEV_IO_URING; otherwise vuring_init always fails, and picoev uses epoll.
+#ifndef V_VURING_C
+#define V_VURING_C
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if defined(PICOEV_IO_URING)
+
+#include <linux/io_uring.h>
+
+#if defined(__TINYC__)
+	#if defined(__x86_64__)
+		#define VURING_BARRIER() __asm__ volatile("mfence" ::: "memory")
+		#define VURING_LOAD_ACQUIRE(p) ({ unsigned v_ = *(volatile unsigned *)(p); VURING_BARRIER(); v_; })
+		#define VURING_STORE_RELEASE(p, v) do { VURING_BARRIER(); *(volatile unsigned *)(p) = (v); } while (0)
+		#define VURING_STORE_RELEASE16(p, v) do { VURING_BARRIER(); *(volatile unsigned short *)(p) = (v); } while (0)
+	#else
+		#define VURING_UNSUPPORTED 1
+	#endif
+#else
+	#define VURING_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+	#define VURING_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+	#define VURING_STORE_RELEASE16(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+// the opcodes and flags of the kernels newer than the headers, that picoev may be compiled with
+#ifndef IORING_ACCEPT_MULTISHOT
+	#define IORING_ACCEPT_MULTISHOT (1U << 0)
+#endif
+#ifndef IORING_RECV_MULTISHOT
+	#define IORING_RECV_MULTISHOT (1U << 1)
+#endif
+#ifndef IORING_ASYNC_CANCEL_ALL
+	#define IORING_ASYNC_CANCEL_ALL (1U << 0)
+#endif
+#ifndef IORING_ASYNC_CANCEL_FD
+	#define IORING_ASYNC_CANCEL_FD (1U << 1)
+#endif
+
+// the buffer group of the provided buffers, used by the multishot recvs
+#define VURING_BUF_GROUP 0
+
+typedef struct vuring {
+	int fd;
+	unsigned features;
+	// the submission queue
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	unsigned sq_local_tail; // the entries prepared, and not submitted yet, are the ones after *sq_tail
+	struct io_uring_sqe *sqes;
+	// the completion queue
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe *cqes;
+	// the mappings
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+	// the ring of the provided buffers
+	struct io_uring_buf_ring *br;
+	size_t br_size;
+	unsigned br_entries;
+	unsigned short br_tail;
+	unsigned buf_size;
+	char *bufs;
+} vuring;
+
+static int vuring_setup_syscall(unsigned entries, struct io_uring_params *p) {
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int vuring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz) {
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int vuring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+void vuring_free(vuring *r) {
+	if (r->bufs) {
+		free(r->bufs);
+	}
+	if (r->br) {
+		munmap(r->br, r->br_size);
+	}
+	if (r->sqes) {
+		munmap(r->sqes, r->sqes_size);
+	}
+	if (r->cq_ring && r->cq_ring != r->sq_ring) {
+		munmap(r->cq_ring, r->cq_ring_size);
+	}
+	if (r->sq_ring) {
+		munmap(r->sq_ring, r->sq_ring_size);
+	}
+	if (r->fd >= 0) {
+		close(r->fd);
+	}
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+}
+
+// vuring_probe_op reports whether the kernel supports the opcode `op`
+static int vuring_probe_op(vuring *r, int op) {
+	size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+	struct io_uring_probe *probe = calloc(1, size);
+	if (!probe) {
+		return 0;
+	}
+	int ok = 0;
+	if (vuring_register(r->fd, IORING_REGISTER_PROBE, probe, 256) >= 0 && op <= probe->last_op) {
+		ok = (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+	}
+	free(probe);
+	return ok;
+}
+
+// vuring_init creates a ring with `entries` submission entries. It fails with a negative errno,
+// when io_uring is not available (old kernels, or disabled by a seccomp filter or by
+// kernel.io_uring_disabled), or lacks the features the picoev loop relies on.
+int vuring_init(vuring *r, unsigned entries) {
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+#if defined(VURING_UNSUPPORTED)
+	return -ENOSYS;
+#else
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = entries * 4; // the multishot requests can post many completions for a single submission
+	int fd = vuring_setup_syscall(entries, &p);
+	if (fd < 0) {
+		return -errno;
+	}
+	r->fd = fd;
+	r->features = p.features;
+	// EXT_ARG (5.11) for the timeouts of the waits; the multishot accept and the provided buffer rings
+	// came with 5.19, together with the cancelling by fd, which is probed with IORING_OP_SOCKET (5.19 too)
+	if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)
+		|| !vuring_probe_op(r, IORING_OP_SOCKET)) {
+		vuring_free(r);
+		return -EOPNOTSUPP;
+	}
+	r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cq_ring_size > r->sq_ring_size) {
+			r->sq_ring_size = r->cq_ring_size;
+		}
+		r->cq_ring_size = r->sq_ring_size;
+	}
+	r->sq_ring = mmap(0, r->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED) {
+		r->sq_ring = 0;
+		int err = -errno;
+		vuring_free(r);
+		return err;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ring = r->sq_ring;
+	} else {
+		r->cq_ring = mmap(0, r->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (r->cq_ring == MAP_FAILED) {
+			r->cq_ring = 0;
+			int err = -errno;
+			vuring_free(r);
+			return err;
+		}
+	}
+	r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(0, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		r->sqes = 0;
+		int err = -errno;
+		vuring_free(r);
+		return err;
+	}
+	char *sq = (char *)r->sq_ring;
+	r->sq_head = (unsigned *)(sq + p.sq_off.head);
+	r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	r->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+	r->sq_entries = *(unsigned *)(sq + p.sq_off.ring_entries);
+	// the entries are used in order, so the indirection array is set up once, as the identity
+	unsigned *array = (unsigned *)(sq + p.sq_off.array);
+	for (unsigned i = 0; i < r->sq_entries; i++) {
+		array[i] = i;
+	}
+	r->sq_local_tail = *r->sq_tail;
+	char *cq = (char *)r->cq_ring;
+	r->cq_head = (unsigned *)(cq + p.cq_off.head);
+	r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	r->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	return 0;
+#endif
+}
+
+// vuring_submit passes the prepared entries to the kernel, and waits for at least `wait_nr`
+// completions, for at most `timeout_ms` milliseconds (-1 waits without a timeout).
+// It returns the number of the submitted entries, or a negative errno.
+int vuring_submit(vuring *r, unsigned wait_nr, int timeout_ms) {
+#if defined(VURING_UNSUPPORTED)
+	return -ENOSYS;
+#else
+	unsigned to_submit = r->sq_local_tail - *r->sq_tail;
+	VURING_STORE_RELEASE(r->sq_tail, r->sq_local_tail);
+	unsigned flags = 0;
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	void *argp = 0;
+	size_t argsz = 0;
+	if (wait_nr > 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+		if (timeout_ms >= 0) {
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+			memset(&arg, 0, sizeof(arg));
+			arg.ts = (uint64_t)(uintptr_t)&ts;
+			flags |= IORING_ENTER_EXT_ARG;
+			argp = &arg;
+			argsz = sizeof(arg);
+		}
+	}
+	int ret = vuring_enter(r->fd, to_submit, wait_nr, flags, argp, argsz);
+	if (ret >= 0) {
+		return ret;
+	}
+	if (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+		// a timeout, a signal, or a full completion queue, that the caller has to reap first;
+		// the entries, that were not consumed, are submitted by the next call
+		return 0;
+	}
+	return -errno;
+#endif
+}
+
+// vuring_sqe returns a cleared submission queue entry. When the queue is full, the prepared
+// entries are submitted first.
+static struct io_uring_sqe *vuring_sqe(vuring *r) {
+	unsigned head = VURING_LOAD_ACQUIRE(r->sq_head);
+	if (r->sq_local_tail - head >= r->sq_entries) {
+		vuring_submit(r, 0, 0);
+		head = VURING_LOAD_ACQUIRE(r->sq_head);
+		if (r->sq_local_tail - head >= r->sq_entries) {
+			return 0;
+		}
+	}
+	struct io_uring_sqe *sqe = &r->sqes[r->sq_local_tail & r->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	r->sq_local_tail++;
+	return sqe;
+}
+
+// vuring_next takes the next completion, if there is one
+int vuring_next(vuring *r, uint64_t *user_data, int *res, unsigned *flags) {
+	unsigned head = *r->cq_head;
+	if (head == VURING_LOAD_ACQUIRE(r->cq_tail)) {
+		return 0;
+	}
+	struct io_uring_cqe *cqe = &r->cqes[head & r->cq_mask];
+	*user_data = cqe->user_data;
+	*res = cqe->res;
+	*flags = cqe->flags;
+	VURING_STORE_RELEASE(r->cq_head, head + 1);
+	return 1;
+}
+
+// vuring_poll waits once for the `events` (POLLIN/POLLOUT) of `fd`. It is level triggered,
+// like epoll without EPOLLET: it completes at once, when the fd is ready already.
+int vuring_poll(vuring *r, int fd, unsigned events, uint64_t user_data) {
+	struct io_uring_sqe *sqe = vuring_sqe(r);
+	if (!sqe) {
+		return -EBUSY;
+	}
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = events;
+	sqe->user_data = user_data;
+	return 0;
+}
+
+// the user data of the completions of the cancel requests themselves: the kind `uring_cancel` of
+// loop_linux.c.v, in the top byte, so that they are never taken for the requests on fd 0
+#define VURING_CANCEL_USER_DATA ((uint64_t)5 << 56)
+
+// vuring_cancel cancels the requests with `user_data`; their completions have -ECANCELED
+int vuring_cancel(vuring *r, uint64_t user_data) {
+	struct io_uring_sqe *sqe = vuring_sqe(r);
+	if (!sqe) {
+		return -EBUSY;
+	}
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = user_data;
+	sqe->user_data = VURING_CANCEL_USER_DATA;
+	return 0;
+}
+
+// vuring_cancel_fd cancels all the requests on `fd`, before it is closed
+int vuring_cancel_fd(vuring *r, int fd) {
+	struct io_uring_sqe *sqe = vuring_sqe(r);
+	if (!sqe) {
+		return -EBUSY;
+	}
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = fd;
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+	sqe->user_data = VURING_CANCEL_USER_DATA;
+	return 0;
+}
+
+// vuring_accept_multishot accepts the connections of the listening socket `fd`, posting a completion
+// with the new fd for each one, till it fails, or the completion is posted without IORING_CQE_F_MORE
+int vuring_accept_multishot(vuring *r, int fd, uint64_t user_data) {
+	struct io_uring_sqe *sqe = vuring_sqe(r);
+	if (!sqe) {
+		return -EBUSY;
+	}
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->user_data = user_data;
+	return 0;
+}
+
+// vuring_recv_multishot receives the data of `fd` into the provided buffers, posting a completion
+// for each chunk, with the buffer id in the upper 16 bits of the flags (IORING_CQE_BUFFER_SHIFT)
+int vuring_recv_multishot(vuring *r, int fd, uint64_t user_data) {
+	struct io_uring_sqe *sqe = vuring_sqe(r);
+	if (!sqe) {
+		return -EBUSY;
+	}
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = VURING_BUF_GROUP;
+	sqe->user_data = user_data;
+	return 0;
+}
+
+// vuring_rw reads or writes `len` bytes of the file `fd` at `offset`
+int vuring_rw(vuring *r, int write, int fd, void *buf, unsigned len, uint64_t offset, uint64_t user_data) {
+	struct io_uring_sqe *sqe = vuring_sqe(r);
+	if (!sqe) {
+		return -EBUSY;
+	}
+	sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)buf;
+	sqe->len = len;
+	sqe->off = offset;
+	sqe->user_data = user_data;
+	return 0;
+}
+
+// vuring_setup_buffers registers a ring of `entries` (a power of 2) provided buffers of `size` bytes
+// each, for the multishot recvs; the kernel picks one for each chunk of received data
+int vuring_setup_buffers(vuring *r, unsigned entries, unsigned size) {
+	r->br_size = entries * sizeof(struct io_uring_buf);
+	void *mem = mmap(0, r->br_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (mem == MAP_FAILED) {
+		return -errno;
+	}
+	r->br = (struct io_uring_buf_ring *)mem;
+	r->bufs = malloc((size_t)entries * size);
+	if (!r->bufs) {
+		return -ENOMEM;
+	}
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)mem;
+	reg.ring_entries = entries;
+	reg.bgid = VURING_BUF_GROUP;
+	if (vuring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		return -errno;
+	}
+	r->br_entries = entries;
+	r->buf_size = size;
+	r->br_tail = 0;
+	for (unsigned i = 0; i < entries; i++) {
+		struct io_uring_buf *b = &r->br->bufs[r->br_tail & (entries - 1)];
+		b->addr = (uint64_t)(uintptr_t)(r->bufs + (size_t)i * size);
+		b->len = size;
+		b->bid = (unsigned short)i;
+		r->br_tail++;
+	}
+	VURING_STORE_RELEASE16(&r->br->tail, r->br_tail);
+	return 0;
+}
+
+// vuring_buffer returns the provided buffer `bid`, that a recv completion has filled
+char *vuring_buffer(vuring *r, unsigned bid) {
+	return r->bufs + (size_t)bid * r->buf_size;
+}
+
+// vuring_recycle_buffer gives the buffer `bid` back to the kernel, once its data has been used
+void vuring_recycle_buffer(vuring *r, unsigned bid) {
+	struct io_uring_buf *b = &r->br->bufs[r->br_tail & (r->br_entries - 1)];
+	b->addr = (uint64_t)(uintptr_t)(r->bufs + (size_t)bid * r->buf_size);
+	b->len = r->buf_size;
+	b->bid = (unsigned short)bid;
+	r->br_tail++;
+	VURING_STORE_RELEASE16(&r->br->tail, r->br_tail);
+}
+
+#else // !PICOEV_IO_URING
+
+typedef struct vuring {
+	int fd;
+} vuring;
+
+int vuring_init(vuring *r, unsigned entries) {
+	r->fd = -1;
+	return -ENOSYS;
+}
+
+void vuring_free(vuring *r) {}
+
+int vuring_submit(vuring *r, unsigned wait_nr, int timeout_ms) {
+	return -ENOSYS;
+}
+
+int vuring_next(vuring *r, uint64_t *user_data, int *res, unsigned *flags) {
+	return 0;
+}
+
+int vuring_poll(vuring *r, int fd, unsigned events, uint64_t user_data) {
+	return -ENOSYS;
+}
+
+int vuring_cancel(vuring *r, uint64_t user_data) {
+	return -ENOSYS;
+}
+
+int vuring_cancel_fd(vuring *r, int fd) {
+	return -ENOSYS;
+}
+
+int vuring_accept_multishot(vuring *r, int fd, uint64_t user_data) {
+	return -ENOSYS;
+}
+
+int vuring_recv_multishot(vuring *r, int fd, uint64_t user_data) {
+	return -ENOSYS;
+}
+
+int vuring_rw(vuring *r, int write, int fd, void *buf, unsigned len, uint64_t offset, uint64_t user_data) {
+	return -ENOSYS;
+}
+
+int vuring_setup_buffers(vuring *r, unsigned entries, unsigned size) {
+	return -ENOSYS;
+}
+
+char *vuring_buffer(vuring *r, unsigned bid) {
+	return 0;
+}
+
+void vuring_recycle_buffer(vuring *r, unsigned bid) {}
+
+#endif // PICOEV_IO_URING
+
+#endif
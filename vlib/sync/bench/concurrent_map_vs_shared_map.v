@@ -0,0 +1,90 @@
+// ConcurrentMap Benchmark
+//
+// `nthreads` threads each do `nops` operations on a map of `nkeys` integer
+// keys, `reads` percent of them reads, the others writes. The same work is
+// done on a `shared map[int]int`, with its single lock, and on a
+// `sync.ConcurrentMap[int, int]`, with one lock per shard.
+// The thread counts 1, 2, 4, ... up to `nthreads` are measured, to show how
+// both scale.
+import os
+import sync
+import time
+
+fn shared_map_worker(shared m map[int]int, id int, nops int, nkeys int, reads int) i64 {
+	mut x := u32(id) * 2654435761 + 1
+	mut found := i64(0)
+	for _ in 0 .. nops {
+		x ^= x << 13
+		x ^= x >> 17
+		x ^= x << 5
+		key := int(x % u32(nkeys))
+		if int(x % 100) < reads {
+			rlock m {
+				if key in m {
+					found++
+				}
+			}
+		} else {
+			lock m {
+				m[key] = id
+			}
+		}
+	}
+	return found
+}
+
+fn concurrent_map_worker(mut m sync.ConcurrentMap[int, int], id int, nops int, nkeys int,
+	reads int) i64 {
+	mut x := u32(id) * 2654435761 + 1
+	mut found := i64(0)
+	for _ in 0 .. nops {
+		x ^= x << 13
+		x ^= x >> 17
+		x ^= x << 5
+		key := int(x % u32(nkeys))
+		if int(x % 100) < reads {
+			if _ := m.get(key) {
+				found++
+			}
+		} else {
+			m.set(key, id)
+		}
+	}
+	return found
+}
+
+fn main() {
+	if os.args.len != 5 {
+		eprintln('usage:\n\t${os.args[0]} <nthreads> <nops> <nkeys> <reads>')
+		eprintln('example:\n\t${os.args[0]} 32 1000000 100000 90')
+		exit(1)
+	}
+	max_threads := os.args[1].int()
+	nops := os.args[2].int()
+	nkeys := os.args[3].int()
+	reads := os.args[4].int()
+	println('threads, shared map Mops/s, ConcurrentMap Mops/s')
+	mut nthreads := 1
+	for nthreads <= max_threads {
+		shared sm := map[int]int{}
+		mut sw := time.new_stopwatch()
+		mut shared_threads := []thread i64{}
+		for id in 0 .. nthreads {
+			shared_threads << spawn shared_map_worker(shared sm, id, nops, nkeys, reads)
+		}
+		shared_threads.wait()
+		shared_mops := f64(nthreads) * f64(nops) / f64(sw.elapsed().microseconds())
+
+		mut cm := sync.new_concurrent_map[int, int]()
+		sw.restart()
+		mut cm_threads := []thread i64{}
+		for id in 0 .. nthreads {
+			cm_threads << spawn concurrent_map_worker(mut cm, id, nops, nkeys, reads)
+		}
+		cm_threads.wait()
+		cm_mops := f64(nthreads) * f64(nops) / f64(sw.elapsed().microseconds())
+
+		println('${nthreads:7}, ${shared_mops:20.3f}, ${cm_mops:20.3f}')
+		nthreads *= 2
+	}
+}
@@ -0,0 +1,199 @@
+module sync
+
+import hash
+
+// ConcurrentMapConfig configures a `ConcurrentMap`
+@[params]
+pub struct ConcurrentMapConfig {
+pub:
+	// the number of shards, rounded up to a power of 2. More shards mean less waiting on the locks,
+	// when many threads use the map at once.
+	shards int = 64
+}
+
+// ConcurrentMap is a hash map, that can be used by several threads at once, without a `shared`
+// map and its single lock. The keys are spread over shards (lock striping) by their hash, and each
+// shard is a plain map with its own read/write lock, so that threads working on different keys
+// rarely wait for each other, and readers of the same shard never do.
+// The keys can be of the types accepted as keys by the builtin maps, except structs.
+// Example:
+// ```v
+// import sync
+//
+// mut m := sync.new_concurrent_map[string, int]()
+// m.set('a', 1)
+// v, loaded := m.get_or_insert('a', 2)
+// assert v == 1 && loaded
+// ```
+@[heap]
+pub struct ConcurrentMap[K, V] {
+	mask u64
+mut:
+	shards []&MapShard[K, V]
+}
+
+@[heap]
+struct MapShard[K, V] {
+mut:
+	mu &RwMutex = new_rwmutex()
+	m  map[K]V
+}
+
+// new_concurrent_map creates an empty `ConcurrentMap`
+pub fn new_concurrent_map[K, V](config ConcurrentMapConfig) &ConcurrentMap[K, V] {
+	mut nr_shards := 1
+	for nr_shards < config.shards {
+		nr_shards <<= 1
+	}
+	mut cm := &ConcurrentMap[K, V]{
+		mask: u64(nr_shards - 1)
+	}
+	for _ in 0 .. nr_shards {
+		cm.shards << &MapShard[K, V]{}
+	}
+	return cm
+}
+
+@[inline]
+fn (cm &ConcurrentMap[K, V]) shard(key K) &MapShard[K, V] {
+	$if K is string {
+		return cm.shards[hash.sum64_string(key, 0) & cm.mask]
+	} $else {
+		return cm.shards[hash.wyhash_c(unsafe { &u8(&key) }, u64(sizeof(K)), 0) & cm.mask]
+	}
+}
+
+// get returns the value of `key`, or `none` if it is not in the map
+pub fn (mut cm ConcurrentMap[K, V]) get(key K) ?V {
+	mut shard := cm.shard(key)
+	shard.mu.@rlock()
+	defer {
+		shard.mu.runlock()
+	}
+	if value := shard.m[key] {
+		return value
+	}
+	return none
+}
+
+// exists checks if `key` is in the map
+pub fn (mut cm ConcurrentMap[K, V]) exists(key K) bool {
+	mut shard := cm.shard(key)
+	shard.mu.@rlock()
+	res := key in shard.m
+	shard.mu.runlock()
+	return res
+}
+
+// set stores `value` for `key`, replacing its previous value
+pub fn (mut cm ConcurrentMap[K, V]) set(key K, value V) {
+	mut shard := cm.shard(key)
+	shard.mu.@lock()
+	shard.m[key] = value
+	shard.mu.unlock()
+}
+
+// get_or_insert returns the value of `key` and true, if it is already in the map. Otherwise, it
+// stores `value` for `key`, and returns it with false. Both are done atomically.
+pub fn (mut cm ConcurrentMap[K, V]) get_or_insert(key K, value V) (V, bool) {
+	mut shard := cm.shard(key)
+	shard.mu.@rlock()
+	if existing := shard.m[key] {
+		shard.mu.runlock()
+		return existing, true
+	}
+	shard.mu.runlock()
+	shard.mu.@lock()
+	defer {
+		shard.mu.unlock()
+	}
+	// another thread may have inserted it, between the two locks
+	if existing := shard.m[key] {
+		return existing, true
+	}
+	shard.m[key] = value
+	return value, false
+}
+
+// compute_if_absent returns the value of `key`, if it is in the map. Otherwise, it calls `f(key)`,
+// stores the result for `key`, and returns it. `f` is called at most once for each missing key, even
+// when several threads ask for it at the same time: the other threads of the shard wait for it, so `f`
+// should be short, and must not use the map.
+pub fn (mut cm ConcurrentMap[K, V]) compute_if_absent(key K, f fn (K) V) V {
+	mut shard := cm.shard(key)
+	shard.mu.@rlock()
+	if existing := shard.m[key] {
+		shard.mu.runlock()
+		return existing
+	}
+	shard.mu.runlock()
+	shard.mu.@lock()
+	defer {
+		shard.mu.unlock()
+	}
+	if existing := shard.m[key] {
+		return existing
+	}
+	value := f(key)
+	shard.m[key] = value
+	return value
+}
+
+// delete removes `key` from the map, and returns true if it was in it
+pub fn (mut cm ConcurrentMap[K, V]) delete(key K) bool {
+	mut shard := cm.shard(key)
+	shard.mu.@lock()
+	defer {
+		shard.mu.unlock()
+	}
+	if key !in shard.m {
+		return false
+	}
+	shard.m.delete(key)
+	return true
+}
+
+// len returns the number of keys. The shards are counted one after the other, so the result may
+// be out of date, when other threads change the map at the same time.
+pub fn (mut cm ConcurrentMap[K, V]) len() int {
+	mut n := 0
+	for mut shard in cm.shards {
+		shard.mu.@rlock()
+		n += shard.m.len
+		shard.mu.runlock()
+	}
+	return n
+}
+
+// keys returns all the keys, shard by shard, like `len`
+pub fn (mut cm ConcurrentMap[K, V]) keys() []K {
+	mut res := []K{}
+	for mut shard in cm.shards {
+		shard.mu.@rlock()
+		res << shard.m.keys()
+		shard.mu.runlock()
+	}
+	return res
+}
+
+// to_map returns a copy of the content of the map in a builtin map, shard by shard, like `len`
+pub fn (mut cm ConcurrentMap[K, V]) to_map() map[K]V {
+	mut res := map[K]V{}
+	for mut shard in cm.shards {
+		shard.mu.@rlock()
+		for k, v in shard.m {
+			res[k] = v
+		}
+		shard.mu.runlock()
+	}
+	return res
+}
+
+// clear removes all the keys
+pub fn (mut cm ConcurrentMap[K, V]) clear() {
+	for mut shard in cm.shards {
+		shard.mu.@lock()
+		shard.m.clear()
+		shard.mu.unlock()
+	}
+}
@@ -0,0 +1,69 @@
+import sync
+
+fn test_set_get_delete() {
+	mut m := sync.new_concurrent_map[string, int](shards: 3)
+	assert m.len() == 0
+	m.set('a', 1)
+	m.set('b', 2)
+	m.set('a', 3)
+	assert m.get('a')? == 3
+	assert m.get('b')? == 2
+	if _ := m.get('c') {
+		assert false
+	}
+	assert m.exists('b')
+	assert m.len() == 2
+	assert m.delete('b')
+	assert !m.delete('b')
+	assert !m.exists('b')
+	mut keys := m.keys()
+	keys.sort()
+	assert keys == ['a']
+	assert m.to_map() == {
+		'a': 3
+	}
+	m.clear()
+	assert m.len() == 0
+}
+
+fn test_get_or_insert_and_compute_if_absent() {
+	mut m := sync.new_concurrent_map[int, string]()
+	v1, loaded1 := m.get_or_insert(7, 'seven')
+	assert v1 == 'seven' && !loaded1
+	v2, loaded2 := m.get_or_insert(7, 'other')
+	assert v2 == 'seven' && loaded2
+	assert m.compute_if_absent(8, fn (k int) string {
+		return 'n${k}'
+	}) == 'n8'
+	assert m.compute_if_absent(8, fn (k int) string {
+		panic('should not be called for an existing key')
+	}) == 'n8'
+}
+
+fn insert_range(mut m sync.ConcurrentMap[int, int], mut calls sync.ConcurrentMap[int, int], start int,
+	end int) {
+	for i in start .. end {
+		m.compute_if_absent(i % 1000, fn [mut calls] (k int) int {
+			_, loaded := calls.get_or_insert(k, 1)
+			assert !loaded
+			return k * 2
+		})
+		m.set(1000 + i, i)
+	}
+}
+
+fn test_concurrent_use() {
+	mut m := sync.new_concurrent_map[int, int](shards: 8)
+	// the keys, for which the function of compute_if_absent was called
+	mut calls := sync.new_concurrent_map[int, int]()
+	mut threads := []thread{}
+	for t in 0 .. 8 {
+		threads << spawn insert_range(mut m, mut calls, t * 2000, (t + 1) * 2000)
+	}
+	threads.wait()
+	assert calls.len() == 1000
+	assert m.len() == 1000 + 8 * 2000
+	for k in 0 .. 1000 {
+		assert m.get(k)? == k * 2
+	}
+}
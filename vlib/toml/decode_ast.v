@@ -0,0 +1,258 @@
+// Copyright (c) 2021 Lars Pontoppidan. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+module toml
+
+import toml.ast
+
+// decode_struct decodes the fields of `typ` directly from the parsed TOML table `table`,
+// without converting the whole document to `toml.Any` first.
+// The values are converted like the corresponding `toml.Any` methods do, e.g. `Any.int()`.
+fn decode_struct[T](table ast.Value, mut typ T) {
+	$for field in T.fields {
+		mut field_name := field.name
+		mut skip := false
+		for attr in field.attrs {
+			if attr == 'skip' {
+				skip = true
+				break
+			}
+			if attr.starts_with('toml:') {
+				field_name = attr.all_after(':').trim_space()
+			}
+		}
+		if !skip {
+			value := ast_value_of(table, field_name)
+			$if field.is_enum {
+				typ.$(field.name) = ast_int(value)
+			} $else $if field.typ is string {
+				typ.$(field.name) = ast_string(value)
+			} $else $if field.typ is bool {
+				typ.$(field.name) = ast_bool(value)
+			} $else $if field.typ is int {
+				typ.$(field.name) = ast_int(value)
+			} $else $if field.typ is i64 {
+				typ.$(field.name) = ast_i64(value)
+			} $else $if field.typ is u64 {
+				typ.$(field.name) = ast_u64(value)
+			} $else $if field.typ is f32 {
+				typ.$(field.name) = ast_f32(value)
+			} $else $if field.typ is f64 {
+				typ.$(field.name) = ast_f64(value)
+			} $else $if field.typ is DateTime {
+				typ.$(field.name) = ast_datetime(value)
+			} $else $if field.typ is Date {
+				typ.$(field.name) = ast_date(value)
+			} $else $if field.typ is Time {
+				typ.$(field.name) = ast_time(value)
+			} $else $if field.typ is Any {
+				typ.$(field.name) = ast_to_any(value)
+			} $else $if field.is_array {
+				match field.typ {
+					[]string { typ.$(field.name) = ast_array[string](value, ast_string) }
+					[]int { typ.$(field.name) = ast_array[int](value, ast_int) }
+					[]i64 { typ.$(field.name) = ast_array[i64](value, ast_i64) }
+					[]u64 { typ.$(field.name) = ast_array[u64](value, ast_u64) }
+					[]f32 { typ.$(field.name) = ast_array[f32](value, ast_f32) }
+					[]f64 { typ.$(field.name) = ast_array[f64](value, ast_f64) }
+					[]bool { typ.$(field.name) = ast_array[bool](value, ast_bool) }
+					[]DateTime { typ.$(field.name) = ast_array[DateTime](value, ast_datetime) }
+					[]Date { typ.$(field.name) = ast_array[Date](value, ast_date) }
+					[]Time { typ.$(field.name) = ast_array[Time](value, ast_time) }
+					[]Any { typ.$(field.name) = ast_array[Any](value, ast_to_any) }
+					else {}
+				}
+			} $else $if field.is_map {
+				match field.typ {
+					map[string]string { typ.$(field.name) = ast_map[string](value, ast_string) }
+					map[string]int { typ.$(field.name) = ast_map[int](value, ast_int) }
+					map[string]i64 { typ.$(field.name) = ast_map[i64](value, ast_i64) }
+					map[string]u64 { typ.$(field.name) = ast_map[u64](value, ast_u64) }
+					map[string]f32 { typ.$(field.name) = ast_map[f32](value, ast_f32) }
+					map[string]f64 { typ.$(field.name) = ast_map[f64](value, ast_f64) }
+					map[string]bool { typ.$(field.name) = ast_map[bool](value, ast_bool) }
+					map[string]DateTime { typ.$(field.name) = ast_map[DateTime](value, ast_datetime) }
+					map[string]Date { typ.$(field.name) = ast_map[Date](value, ast_date) }
+					map[string]Time { typ.$(field.name) = ast_map[Time](value, ast_time) }
+					map[string]Any { typ.$(field.name) = ast_map[Any](value, ast_to_any) }
+					else {}
+				}
+			} $else $if field.is_struct {
+				mut s := typ.$(field.name)
+				decode_struct(value, mut s)
+				typ.$(field.name) = s
+			}
+		}
+	}
+}
+
+// ast_value_of returns the value of `key` in the table `table`, or `ast.Null` if there is none.
+// Like `Doc.value`, `key` can be a dotted key, or index arrays.
+fn ast_value_of(table ast.Value, key string) ast.Value {
+	if table is map[string]ast.Value {
+		if !key.contains_any('."\'[') {
+			return table[key] or { ast.Value(ast.Null{}) }
+		}
+	}
+	key_split := parse_dotted_key(key) or { return ast.Null{} }
+	mut value := table
+	for part in key_split {
+		k, index := parse_array_key(part)
+		if k != '' {
+			value = ast_table_get(value, k) or { return ast.Null{} }
+		}
+		if index > -1 {
+			value = ast_array_get(value, index) or { return ast.Null{} }
+		}
+	}
+	return value
+}
+
+fn ast_table_get(value ast.Value, key string) ?ast.Value {
+	if value is map[string]ast.Value {
+		if v := value[key] {
+			return v
+		}
+	}
+	return none
+}
+
+fn ast_array_get(value ast.Value, index int) ?ast.Value {
+	if value is []ast.Value {
+		if v := value[index] {
+			return v
+		}
+	}
+	return none
+}
+
+// ast_number_is_integer returns true for the numbers, that `ast_to_any` converts to `i64`.
+fn ast_number_is_integer(n ast.Number) bool {
+	if n.text.starts_with('0x') {
+		return true
+	}
+	for c in n.text {
+		if c in [`.`, `e`, `E`, `i`, `n`] {
+			return false
+		}
+	}
+	return true
+}
+
+fn ast_string(value ast.Value) string {
+	if value is ast.Quoted {
+		return value.text.clone()
+	}
+	return ast_to_any(value).string()
+}
+
+fn ast_bool(value ast.Value) bool {
+	if value is ast.Bool {
+		return value.text == 'true'
+	}
+	return ast_to_any(value).bool()
+}
+
+fn ast_int(value ast.Value) int {
+	if value is ast.Number && ast_number_is_integer(value) {
+		return int(value.i64())
+	}
+	return ast_to_any(value).int()
+}
+
+fn ast_i64(value ast.Value) i64 {
+	if value is ast.Number && ast_number_is_integer(value) {
+		return value.i64()
+	}
+	return ast_to_any(value).i64()
+}
+
+fn ast_u64(value ast.Value) u64 {
+	if value is ast.Number && ast_number_is_integer(value) {
+		return u64(value.i64())
+	}
+	return ast_to_any(value).u64()
+}
+
+fn ast_f32(value ast.Value) f32 {
+	return f32(ast_f64(value))
+}
+
+fn ast_f64(value ast.Value) f64 {
+	if value is ast.Number {
+		if ast_number_is_integer(value) {
+			return f64(value.i64())
+		}
+		if !value.text.contains_any('in') {
+			return value.f64()
+		}
+	}
+	return ast_to_any(value).f64()
+}
+
+fn ast_datetime(value ast.Value) DateTime {
+	if value is ast.DateTime {
+		return DateTime{value.text.clone()}
+	}
+	return DateTime{''}
+}
+
+fn ast_date(value ast.Value) Date {
+	if value is ast.Date {
+		return Date{value.text.clone()}
+	}
+	return Date{''}
+}
+
+fn ast_time(value ast.Value) Time {
+	if value is ast.Time {
+		return Time{value.text.clone()}
+	}
+	return Time{''}
+}
+
+// ast_array converts a TOML array to `[]T`. Like `Any.array()`, a table gives its values,
+// and any other value gives an array with it alone.
+fn ast_array[T](value ast.Value, conv fn (ast.Value) T) []T {
+	match value {
+		[]ast.Value {
+			mut arr := []T{cap: value.len}
+			for v in value {
+				arr << conv(v)
+			}
+			return arr
+		}
+		map[string]ast.Value {
+			mut arr := []T{cap: value.len}
+			for _, v in value {
+				arr << conv(v)
+			}
+			return arr
+		}
+		else {
+			return [conv(value)]
+		}
+	}
+}
+
+// ast_map converts a TOML table to `map[string]T`. Like `Any.as_map()`, an array is keyed by
+// the indexes of its values, and any other value gives a map with it alone, at key `0`.
+fn ast_map[T](value ast.Value, conv fn (ast.Value) T) map[string]T {
+	mut res := map[string]T{}
+	match value {
+		map[string]ast.Value {
+			for k, v in value {
+				res[k] = conv(v)
+			}
+		}
+		[]ast.Value {
+			for i, v in value {
+				res['${i}'] = conv(v)
+			}
+		}
+		else {
+			res['0'] = conv(value)
+		}
+	}
+	return res
+}
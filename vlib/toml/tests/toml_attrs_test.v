@@ -13,3 +13,18 @@ fn test_toml_attr_encode() {
 fn test_toml_attr_decode() {
 	assert toml.decode[TestStruct]('foo = 0\nbarbaz = "def"')! == TestStruct{}
 }
+
+struct DottedStruct {
+	port  int    @[toml: 'server.port']
+	host  string @[toml: 'server.host']
+	first string @[toml: 'users[0].name']
+}
+
+fn test_toml_attr_dotted_decode() {
+	s := '[server]\nport = 8080\nhost = "localhost"\n\n[[users]]\nname = "first"\n\n[[users]]\nname = "second"'
+	assert toml.decode[DottedStruct](s)! == DottedStruct{
+		port:  8080
+		host:  'localhost'
+		first: 'first'
+	}
+}
@@ -509,6 +509,7 @@ pub mut:
 	has_update_expr      bool // has `...a`
 	init_fields          []StructInitField
 	generic_types        []Type
+	is_stack_alloc       bool // `x := &Foo{}`, where `x` does not escape the fn => cgen can place it on the stack, instead of the heap
 }
 
 pub enum StructInitKind {
@@ -2064,6 +2065,7 @@ pub:
 	scope        &Scope = unsafe { nil }
 pub mut:
 	object_var      string   // `user`
+	is_batch        bool     // `insert users into User`, where `users` is an array of `User`
 	updated_columns []string // for `update set x=y`
 	table_expr      TypeNode
 	fields          []StructField
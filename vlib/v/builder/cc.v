@@ -284,6 +284,11 @@ fn (mut v Builder) setup_ccompiler_options(ccompiler string) {
 	if v.pref.sanitize {
 		ccoptions.args << '-fsanitize=leak'
 	}
+	if v.pref.is_prof_sampling && v.pref.os == .linux && ccoptions.cc in [.gcc, .clang] {
+		// the vendored libbacktrace can not find the symbols of position independent executables,
+		// and without them, the samples of `-profile-sampling` would be just addresses
+		ccoptions.args << '-no-pie'
+	}
 	if v.pref.is_o {
 		ccoptions.args << '-c'
 	}
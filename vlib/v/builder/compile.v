@@ -335,7 +335,7 @@ pub fn (v &Builder) get_user_files() []string {
 			user_files << os.join_path(preludes_path, 'stats_import.js.v')
 		}
 	}
-	if v.pref.is_prof {
+	if v.pref.is_prof || v.pref.is_prof_sampling {
 		user_files << os.join_path(preludes_path, 'profiled_program.v')
 	}
 	is_test := v.pref.is_test
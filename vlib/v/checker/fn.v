@@ -3177,7 +3177,7 @@ fn (mut c Checker) array_builtin_method_call(mut node ast.CallExpr, left_type as
 				}
 			}
 		}
-	} else if method_name in ['sort_with_compare', 'sorted_with_compare'] {
+	} else if method_name in ['sort_with_compare', 'sort_stable_with_compare', 'sorted_with_compare'] {
 		if node.args.len != 1 {
 			c.error('`.${method_name}()` expected 1 argument, but got ${node.args.len}',
 				node.pos)
@@ -3212,7 +3212,7 @@ fn (mut c Checker) array_builtin_method_call(mut node ast.CallExpr, left_type as
 						node.args[0].pos)
 				}
 			}
-			if method_name == 'sort_with_compare' {
+			if method_name in ['sort_with_compare', 'sort_stable_with_compare'] {
 				node.return_type = ast.void_type
 				node.receiver_type = node.left_type.ref()
 			} else {
@@ -3332,7 +3332,7 @@ fn (mut c Checker) array_builtin_method_call(mut node ast.CallExpr, left_type as
 		c.ensure_same_array_return_type(mut node, left_type)
 	} else if method_name == 'sorted' {
 		c.ensure_same_array_return_type(mut node, left_type)
-	} else if method_name in ['sort_with_compare', 'sorted_with_compare'] {
+	} else if method_name in ['sort_with_compare', 'sort_stable_with_compare', 'sorted_with_compare'] {
 		if method_name == 'sorted_with_compare' {
 			c.ensure_same_array_return_type(mut node, left_type)
 		}
@@ -254,9 +254,13 @@ fn (mut c Checker) sql_stmt_line(mut node ast.SqlStmtLine) ast.Type {
 			inserting_object_type = inserting_object.typ.deref()
 		}
 
-		if inserting_object_type != node.table_expr.typ {
+		inserting_sym := c.table.sym(inserting_object_type)
+		if inserting_sym.info is ast.Array && inserting_sym.info.elem_type == node.table_expr.typ {
+			// `insert users into User`: all the elements are inserted at once
+			node.is_batch = true
+		} else if inserting_object_type != node.table_expr.typ {
 			table_name := table_sym.name
-			inserting_type_name := c.table.sym(inserting_object_type).name
+			inserting_type_name := inserting_sym.name
 
 			c.error('cannot use `${inserting_type_name}` as `${table_name}`', node.pos)
 			return ast.void_type
@@ -753,11 +753,197 @@ fn (mut g Gen) gen_array_sort(node ast.CallExpr) {
 	g.definitions.writeln('\tif (${c_condition}) return -1;')
 	g.definitions.writeln('\telse return 1;')
 	g.definitions.writeln('}\n')
+	if !g.is_array_sort_via_qsort(info.elem_type) {
+		g.gen_array_sort_fn(compare_fn, stype_arg)
+	}
 
 	// write call to the generated function
 	g.gen_array_sort_call(node, compare_fn)
 }
 
+// is_array_sort_via_qsort reports whether arrays of `elem_type` are sorted with libc's qsort,
+// instead of a specialized `compare_xxx_sort` function. C arrays can not be assigned, so
+// fixed array elements can not be moved around by the generated code.
+fn (mut g Gen) is_array_sort_via_qsort(elem_type ast.Type) bool {
+	return g.table.final_sym(elem_type).kind == .array_fixed
+}
+
+// gen_array_sort_fn generates `${compare_fn}_sort(T* v, int len)`, a pattern-defeating quicksort
+// (an introsort, that uses insertion sort for small runs, detects already sorted partitions, and
+// breaks up the patterns, that lead to unbalanced partitions, before falling back to heapsort),
+// specialized for the element type, with direct (inlinable) calls to the `compare_fn` comparator.
+// All loops are bounds checked, so a comparator, that is not a strict weak ordering (for example
+// a lambda that uses `<=`), leads to an unsorted result, but never to an out of bounds access.
+fn (mut g Gen) gen_array_sort_fn(compare_fn string, styp string) {
+	f := compare_fn
+	sm := g.static_modifier
+	g.definitions.writeln('#define VSORT_LESS(x, y) (${f}((x), (y)) < 0)
+#define VSORT_SWAP(x, y) do { ${styp} _t = (x); (x) = (y); (y) = _t; } while (0)
+VV_LOCAL_SYMBOL ${sm} void ${f}_insertion_sort(${styp}* v, int begin, int end) {
+	for (int i = begin + 1; i < end; i++) {
+		if (VSORT_LESS(&v[i], &v[i - 1])) {
+			${styp} tmp = v[i];
+			int j = i;
+			do { v[j] = v[j - 1]; j--; } while (j > begin && VSORT_LESS(&tmp, &v[j - 1]));
+			v[j] = tmp;
+		}
+	}
+}
+// attempts an insertion sort, and gives up when too many elements have to be moved
+VV_LOCAL_SYMBOL ${sm} bool ${f}_partial_insertion_sort(${styp}* v, int begin, int end) {
+	int moved = 0;
+	for (int i = begin + 1; i < end; i++) {
+		if (VSORT_LESS(&v[i], &v[i - 1])) {
+			${styp} tmp = v[i];
+			int j = i;
+			do { v[j] = v[j - 1]; j--; } while (j > begin && VSORT_LESS(&tmp, &v[j - 1]));
+			v[j] = tmp;
+			moved += i - j;
+			if (moved > 8) return false;
+		}
+	}
+	return true;
+}
+VV_LOCAL_SYMBOL ${sm} void ${f}_sift_down(${styp}* v, int n, int i) {
+	for (;;) {
+		int child = 2 * i + 1;
+		if (child >= n) return;
+		if (child + 1 < n && VSORT_LESS(&v[child], &v[child + 1])) child++;
+		if (!VSORT_LESS(&v[i], &v[child])) return;
+		VSORT_SWAP(v[i], v[child]);
+		i = child;
+	}
+}
+VV_LOCAL_SYMBOL ${sm} void ${f}_heapsort(${styp}* v, int n) {
+	for (int i = n / 2 - 1; i >= 0; i--) ${f}_sift_down(v, n, i);
+	for (int i = n - 1; i > 0; i--) {
+		VSORT_SWAP(v[0], v[i]);
+		${f}_sift_down(v, i, 0);
+	}
+}
+VV_LOCAL_SYMBOL ${sm} void ${f}_sort3(${styp}* v, int a, int b, int c) {
+	if (VSORT_LESS(&v[b], &v[a])) VSORT_SWAP(v[a], v[b]);
+	if (VSORT_LESS(&v[c], &v[b])) VSORT_SWAP(v[b], v[c]);
+	if (VSORT_LESS(&v[b], &v[a])) VSORT_SWAP(v[a], v[b]);
+}
+// partitions [begin, end) around the pivot v[begin]; the elements equal to the pivot go to the right
+VV_LOCAL_SYMBOL ${sm} int ${f}_partition_right(${styp}* v, int begin, int end, bool* already_partitioned) {
+	${styp} pivot = v[begin];
+	int first = begin;
+	int last = end;
+	while (++first < end && VSORT_LESS(&v[first], &pivot));
+	if (first - 1 == begin) {
+		while (first < last && !VSORT_LESS(&v[--last], &pivot));
+	} else {
+		while (--last > begin && !VSORT_LESS(&v[last], &pivot));
+	}
+	*already_partitioned = first >= last;
+	while (first < last) {
+		VSORT_SWAP(v[first], v[last]);
+		while (++first < end && VSORT_LESS(&v[first], &pivot));
+		while (--last > begin && !VSORT_LESS(&v[last], &pivot));
+	}
+	int pivot_pos = first - 1;
+	v[begin] = v[pivot_pos];
+	v[pivot_pos] = pivot;
+	return pivot_pos;
+}
+// like partition_right, but the elements equal to the pivot go to the left. It is used when the pivot
+// is equal to the element before the partition, so all of them can be skipped at once.
+VV_LOCAL_SYMBOL ${sm} int ${f}_partition_left(${styp}* v, int begin, int end) {
+	${styp} pivot = v[begin];
+	int first = begin;
+	int last = end;
+	while (--last > begin && VSORT_LESS(&pivot, &v[last]));
+	if (last + 1 == end) {
+		while (first < last && !VSORT_LESS(&pivot, &v[++first]));
+	} else {
+		while (++first < end && !VSORT_LESS(&pivot, &v[first]));
+	}
+	while (first < last) {
+		VSORT_SWAP(v[first], v[last]);
+		while (--last > begin && VSORT_LESS(&pivot, &v[last]));
+		while (++first < end && !VSORT_LESS(&pivot, &v[first]));
+	}
+	int pivot_pos = last;
+	v[begin] = v[pivot_pos];
+	v[pivot_pos] = pivot;
+	return pivot_pos;
+}
+VV_LOCAL_SYMBOL ${sm} void ${f}_pdqsort(${styp}* v, int begin, int end, int bad_allowed, bool leftmost) {
+	for (;;) {
+		int size = end - begin;
+		if (size < 24) {
+			${f}_insertion_sort(v, begin, end);
+			return;
+		}
+		// choose the pivot as the median of 3, or the pseudomedian of 9 for big partitions, and move it to v[begin]
+		int s2 = size / 2;
+		if (size > 128) {
+			${f}_sort3(v, begin, begin + s2, end - 1);
+			${f}_sort3(v, begin + 1, begin + s2 - 1, end - 2);
+			${f}_sort3(v, begin + 2, begin + s2 + 1, end - 3);
+			${f}_sort3(v, begin + s2 - 1, begin + s2, begin + s2 + 1);
+			VSORT_SWAP(v[begin], v[begin + s2]);
+		} else {
+			${f}_sort3(v, begin + s2, begin, end - 1);
+		}
+		// many equal elements: put all the elements equal to the pivot on the left, and skip them
+		if (!leftmost && !VSORT_LESS(&v[begin - 1], &v[begin])) {
+			begin = ${f}_partition_left(v, begin, end) + 1;
+			continue;
+		}
+		bool already_partitioned = false;
+		int pivot_pos = ${f}_partition_right(v, begin, end, &already_partitioned);
+		int l_size = pivot_pos - begin;
+		int r_size = end - (pivot_pos + 1);
+		if (l_size < size / 8 || r_size < size / 8) {
+			// a bad partition: after too many of them, switch to heapsort, otherwise shuffle some elements around
+			if (--bad_allowed == 0) {
+				${f}_heapsort(v + begin, size);
+				return;
+			}
+			if (l_size >= 24) {
+				VSORT_SWAP(v[begin], v[begin + l_size / 4]);
+				VSORT_SWAP(v[pivot_pos - 1], v[pivot_pos - l_size / 4]);
+				if (l_size > 128) {
+					VSORT_SWAP(v[begin + 1], v[begin + (l_size / 4 + 1)]);
+					VSORT_SWAP(v[begin + 2], v[begin + (l_size / 4 + 2)]);
+					VSORT_SWAP(v[pivot_pos - 2], v[pivot_pos - (l_size / 4 + 1)]);
+					VSORT_SWAP(v[pivot_pos - 3], v[pivot_pos - (l_size / 4 + 2)]);
+				}
+			}
+			if (r_size >= 24) {
+				VSORT_SWAP(v[pivot_pos + 1], v[pivot_pos + (1 + r_size / 4)]);
+				VSORT_SWAP(v[end - 1], v[end - r_size / 4]);
+				if (r_size > 128) {
+					VSORT_SWAP(v[pivot_pos + 2], v[pivot_pos + (2 + r_size / 4)]);
+					VSORT_SWAP(v[pivot_pos + 3], v[pivot_pos + (3 + r_size / 4)]);
+					VSORT_SWAP(v[end - 2], v[end - (1 + r_size / 4)]);
+					VSORT_SWAP(v[end - 3], v[end - (2 + r_size / 4)]);
+				}
+			}
+		} else if (already_partitioned && ${f}_partial_insertion_sort(v, begin, pivot_pos)
+			&& ${f}_partial_insertion_sort(v, pivot_pos + 1, end)) {
+			// the input was (almost) sorted already
+			return;
+		}
+		// recurse into the left partition, and loop for the right one
+		${f}_pdqsort(v, begin, pivot_pos, bad_allowed, leftmost);
+		begin = pivot_pos + 1;
+		leftmost = false;
+	}
+}
+VV_LOCAL_SYMBOL ${sm} void ${f}_sort(${styp}* v, int len) {
+	int log2_len = 0;
+	while ((len >> log2_len) > 1) log2_len++;
+	${f}_pdqsort(v, 0, len, log2_len, true);
+}
+#undef VSORT_SWAP
+#undef VSORT_LESS
+')
+}
+
 fn (mut g Gen) gen_array_sort_call(node ast.CallExpr, compare_fn string) {
 	deref_field := if node.receiver_type.nr_muls() > node.left_type.nr_muls()
 		&& node.left_type.is_ptr() {
@@ -770,13 +956,22 @@ fn (mut g Gen) gen_array_sort_call(node ast.CallExpr, compare_fn string) {
 	g.write('if (')
 	g.expr(node.left)
 	g.write('${deref_field}len > 0) { ')
-	g.write('qsort(')
-	g.expr(node.left)
-	g.write('${deref_field}data, ')
-	g.expr(node.left)
-	g.write('${deref_field}len, ')
-	g.expr(node.left)
-	g.write('${deref_field}element_size, (int (*)(const void *, const void *))&${compare_fn});')
+	elem_type := (g.table.final_sym(node.receiver_type).info as ast.Array).elem_type
+	if g.is_array_sort_via_qsort(elem_type) {
+		g.write('qsort(')
+		g.expr(node.left)
+		g.write('${deref_field}data, ')
+		g.expr(node.left)
+		g.write('${deref_field}len, ')
+		g.expr(node.left)
+		g.write('${deref_field}element_size, (int (*)(const void *, const void *))&${compare_fn});')
+	} else {
+		g.write('${compare_fn}_sort((${g.typ(elem_type)}*)')
+		g.expr(node.left)
+		g.write('${deref_field}data, ')
+		g.expr(node.left)
+		g.write('${deref_field}len);')
+	}
 	g.write(' }')
 }
 
@@ -548,7 +548,7 @@ pub fn gen(files []&ast.File, mut table ast.Table, pref_ &pref.Preferences) (str
 
 	mut b := strings.new_builder(g.out.len + 200_000)
 	b.write_string(g.hashes())
-	if g.use_segfault_handler || g.pref.is_prof {
+	if g.use_segfault_handler || g.pref.is_prof || g.pref.is_prof_sampling {
 		b.writeln('\n#define V_USE_SIGNAL_H')
 	}
 	b.writeln('\n// V comptime_definitions:')
@@ -560,6 +560,11 @@ pub fn gen(files []&ast.File, mut table ast.Table, pref_ &pref.Preferences) (str
 	b.writeln('\n// V cheaders:')
 	b.write_string(g.cheaders.str())
 	if g.pcs_declarations.len > 0 {
+		if g.pref.profile_callgraph {
+			b.writeln('\n// V profile call graph helpers:')
+			b.writeln('#include "${g.pref.vroot}/vlib/builtin/thread_local.h"')
+			b.writeln(c_profile_callgraph_helpers)
+		}
 		b.writeln('\n// V profile counters:')
 		b.write_string(g.pcs_declarations.str())
 	}
@@ -6372,7 +6377,7 @@ fn (mut g Gen) global_decl(node ast.GlobalDecl) {
 			} else if default_initializer == '{EMPTY_STRUCT_INITIALIZATION}' && should_init {
 				init = '\tmemcpy(${field.name}, (${styp}){${g.type_default(field.typ)}}, sizeof(${styp})); // global'
 			} else {
-				if field.name !in ['as_cast_type_indexes', 'g_memory_block', 'global_allocator'] {
+				if field.name !in ['as_cast_type_indexes', 'global_allocator'] {
 					init = '\t${field.name} = *(${styp}*)&((${styp}[]){${g.type_default(field.typ)}}[0]); // global'
 				}
 			}
@@ -6591,9 +6596,6 @@ fn (mut g Gen) write_init_function() {
 	for x in cleaning_up_array.reverse() {
 		g.writeln(x)
 	}
-	if g.pref.use_coroutines {
-		g.writeln('\tdelete_photon_work_pool();')
-	}
 	if g.pref.is_coverage {
 		g.write_coverage_stats()
 		g.writeln('\tvprint_coverage_stats();')
@@ -267,6 +267,17 @@ pub fn (mut g Gen) gen_c_main_profile_hook() {
 		g.writeln('\tatexit(vprint_profile_stats);')
 		g.writeln('')
 	}
+	if g.pref.is_prof_sampling {
+		hz := if g.pref.prof_sampling_hz > 0 { g.pref.prof_sampling_hz } else { 99 }
+		g.writeln('')
+		if !g.pref.is_prof {
+			g.writeln('\tsignal(SIGINT, vsampling_on_exit_signal);')
+			g.writeln('\tsignal(SIGTERM, vsampling_on_exit_signal);')
+		}
+		g.writeln('\tvsampling_start(((char**)g_main_argv)[0], "${cesc(g.pref.prof_sampling_file)}", ${hz});')
+		g.writeln('\tatexit(vsampling_write_profile);')
+		g.writeln('')
+	}
 	if g.pref.profile_file != '' {
 		if 'no_profile_startup' in g.pref.compile_defines {
 			g.writeln('vreset_profile_stats();')
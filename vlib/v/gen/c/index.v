@@ -366,7 +366,8 @@ fn (mut g Gen) index_of_fixed_array(node ast.IndexExpr, sym ast.TypeSymbol) {
 		}
 	}
 	g.write('[')
-	if g.is_direct_array_access || g.pref.translated || node.index is ast.IntegerLiteral {
+	if g.is_direct_array_access || node.is_direct || g.pref.translated
+		|| node.index is ast.IntegerLiteral {
 		g.expr(node.index)
 	} else {
 		// bounds check
@@ -224,6 +224,11 @@ fn (mut g Gen) write_orm_drop_table(table_name string, connection_var_name strin
 // write_orm_insert writes C code that calls ORM functions for inserting structs into a table.
 fn (mut g Gen) write_orm_insert(node &ast.SqlStmtLine, table_name string, connection_var_name string, result_var_name string,
 	or_expr &ast.OrExpr) {
+	if node.is_batch {
+		g.write_orm_insert_batch(node, table_name, connection_var_name, result_var_name,
+			or_expr)
+		return
+	}
 	last_ids_variable_name := g.new_tmp_var()
 
 	g.writeln('Array_orm__Primitive ${last_ids_variable_name} = __new_array_with_default_noscan(0, 0, sizeof(orm__Primitive), 0);')
@@ -402,27 +407,13 @@ fn (mut g Gen) write_orm_insert_with_last_ids(node ast.SqlStmtLine, connection_v
 				g.writeln('${pid}, ')
 				continue
 			}
-			mut sym := g.table.sym(field.typ)
-			mut typ := sym.cname
-			mut ctyp := sym.cname
-			if sym.kind == .struct_ && typ != 'time__Time' {
+			sym := g.table.sym(field.typ)
+			if sym.kind == .struct_ && sym.cname != 'time__Time' {
 				g.writeln('(*(orm__Primitive*) array_get(${last_ids_arr}, ${structs})),')
 				structs++
 				continue
 			}
-			// fields processed hereafter can be NULL...
-			if typ == 'time__Time' {
-				ctyp = 'time__Time'
-				typ = 'time'
-			} else if sym.kind == .enum_ {
-				typ = 'i64'
-			}
-			var := '${node.object_var}${member_access_type}${c_name(field.name)}'
-			if field.typ.has_flag(.option) {
-				g.writeln('${var}.state == 2? _const_orm__null_primitive : orm__${typ}_to_primitive(*(${ctyp}*)(${var}.data)),')
-			} else {
-				g.writeln('orm__${typ}_to_primitive(${var}),')
-			}
+			g.write_orm_field_to_primitive(field, '${node.object_var}${member_access_type}${c_name(field.name)}')
 		}
 		g.indent--
 		g.writeln('})')
@@ -513,6 +504,129 @@ fn (mut g Gen) write_orm_insert_with_last_ids(node ast.SqlStmtLine, connection_v
 	}
 }
 
+// write_orm_field_to_primitive writes C code, that converts the value `var` of a primitive,
+// time.Time or enum field into an orm.Primitive; the option fields can be NULL
+fn (mut g Gen) write_orm_field_to_primitive(field ast.StructField, var string) {
+	sym := g.table.sym(field.typ)
+	mut typ := sym.cname
+	mut ctyp := sym.cname
+	if typ == 'time__Time' {
+		ctyp = 'time__Time'
+		typ = 'time'
+	} else if sym.kind == .enum_ {
+		typ = 'i64'
+	}
+	if field.typ.has_flag(.option) {
+		g.writeln('${var}.state == 2? _const_orm__null_primitive : orm__${typ}_to_primitive(*(${ctyp}*)(${var}.data)),')
+	} else {
+		g.writeln('orm__${typ}_to_primitive(${var}),')
+	}
+}
+
+// write_orm_insert_batch writes C code for `insert users into User`, where `users` is an array.
+// The rows of the elements are collected, and inserted with a single call of `orm.insert_batch`,
+// so that the connections, that implement `orm.BatchConnection`, can insert them in a few
+// statements. The structs with related tables are inserted one by one, like with `insert user into User`.
+fn (mut g Gen) write_orm_insert_batch(node &ast.SqlStmtLine, table_name string, connection_var_name string,
+	result_var_name string, or_expr &ast.OrExpr) {
+	mut arr_var := node.object_var
+	if node.scope != unsafe { nil } {
+		inserting_object := node.scope.find(node.object_var) or {
+			verror('`${node.object_var}` is not found in scope')
+		}
+		if inserting_object.typ.is_ptr() {
+			arr_var = '(*${node.object_var})'
+		}
+	}
+	elem_ctyp := g.typ(node.table_expr.typ)
+	idx := g.new_tmp_var()
+	elem_var := g.new_tmp_var()
+	has_relations := node.fields.any(g.table.sym(it.typ).kind == .array
+		|| (g.table.sym(it.typ).kind == .struct_ && g.table.sym(it.typ).name != 'time.Time'))
+
+	g.writeln('// sql { insert into `${table_name}` }, for each element')
+	g.writeln('${result_name}_void ${result_var_name} = {0};')
+	if has_relations {
+		g.writeln('for (int ${idx} = 0; ${idx} < ${arr_var}.len; ${idx}++) {')
+		g.indent++
+		g.writeln('${elem_ctyp} ${elem_var} = ((${elem_ctyp}*)${arr_var}.data)[${idx}];')
+		elem_node := ast.SqlStmtLine{
+			kind:        node.kind
+			pos:         node.pos
+			object_var:  elem_var
+			table_expr:  node.table_expr
+			fields:      node.fields
+			sub_structs: node.sub_structs
+		}
+		g.write_orm_insert(elem_node, table_name, connection_var_name, g.new_tmp_var(),
+			or_expr)
+		g.indent--
+		g.writeln('}')
+		return
+	}
+
+	fields := node.fields
+	auto_fields := get_auto_field_idxs(fields)
+	rows_var := g.new_tmp_var()
+	g.writeln('Array_Array_orm__Primitive ${rows_var} = __new_array_with_default(0, ${arr_var}.len, sizeof(Array_orm__Primitive), 0);')
+	g.writeln('for (int ${idx} = 0; ${idx} < ${arr_var}.len; ${idx}++) {')
+	g.indent++
+	g.writeln('${elem_ctyp} ${elem_var} = ((${elem_ctyp}*)${arr_var}.data)[${idx}];')
+	if fields.len > 0 {
+		g.writeln('array_push(&${rows_var}, _MOV((Array_orm__Primitive[1]){ new_array_from_c_array(${fields.len}, ${fields.len}, sizeof(orm__Primitive),')
+		g.indent++
+		g.writeln('_MOV((orm__Primitive[${fields.len}]){')
+		g.indent++
+		for field in fields {
+			g.write_orm_field_to_primitive(field, '${elem_var}.${c_name(field.name)}')
+		}
+		g.indent--
+		g.writeln('})) }));')
+		g.indent--
+	} else {
+		g.writeln('array_push(&${rows_var}, _MOV((Array_orm__Primitive[1]){ __new_array_with_default_noscan(0, 0, sizeof(orm__Primitive), 0) }));')
+	}
+	g.indent--
+	g.writeln('}')
+	g.writeln('${result_var_name} = orm__insert_batch(')
+	g.indent++
+	g.writeln('${connection_var_name}, // Connection object')
+	g.writeln('_SLIT("${table_name}"),')
+	g.writeln('(orm__BatchData){')
+	g.indent++
+	if fields.len > 0 {
+		g.writeln('.fields = new_array_from_c_array(${fields.len}, ${fields.len}, sizeof(string),')
+		g.indent++
+		g.writeln('_MOV((string[${fields.len}]){ ')
+		g.indent++
+		for f in fields {
+			g.writeln('_SLIT("${g.get_orm_column_name_from_struct_field(f)}"),')
+		}
+		g.indent--
+		g.writeln('})),')
+		g.indent--
+	} else {
+		g.writeln('.fields = __new_array_with_default_noscan(0, 0, sizeof(string), 0),')
+	}
+	g.writeln('.rows = ${rows_var},')
+	if auto_fields.len > 0 {
+		g.writeln('.auto_fields = new_array_from_c_array(${auto_fields.len}, ${auto_fields.len}, sizeof(${ast.int_type_name}),')
+		g.indent++
+		g.write('_MOV((int[${auto_fields.len}]){')
+		for i in auto_fields {
+			g.write(' ${i},')
+		}
+		g.writeln(' })),')
+		g.indent--
+	} else {
+		g.writeln('.auto_fields = __new_array_with_default_noscan(0, 0, sizeof(${ast.int_type_name}), 0),')
+	}
+	g.indent--
+	g.writeln('}')
+	g.indent--
+	g.writeln(');')
+}
+
 // write_orm_expr_to_primitive writes C code for casting expressions into a primitive type
 // by checking support expressions and their types.
 fn (mut g Gen) write_orm_expr_to_primitive(expr ast.Expr) {
@@ -2,6 +2,212 @@ module c
 
 import v.ast
 
+// c_profile_callgraph_helpers is used for `-profile-callgraph`. It is emitted before the profile counters.
+const c_profile_callgraph_helpers = '
+// -profile-callgraph helpers: every thread keeps a shadow call stack, and a table of
+// caller->callee edges, with the number of calls, the inclusive and the self time of the callee.
+// The edges of a thread are changed only by that thread, while it holds its lock; vpcg_reset and
+// vpcg_write take the lock of each thread in turn, since the other threads may still be running.
+#if !defined(_WIN32)
+	#include <sched.h>
+#endif
+#define VPCG_MAX_DEPTH 1024
+typedef struct VProfCgFn { const char* name; int written; } VProfCgFn;
+typedef struct VProfCgEdge { VProfCgFn* caller; VProfCgFn* callee; u64 calls; double incl; double self; } VProfCgEdge;
+typedef struct VProfCgFrame { VProfCgFn* fn; double start; double child; } VProfCgFrame;
+typedef struct VProfCgThread {
+	struct VProfCgThread* next;
+	volatile long lock;
+	VProfCgEdge* edges; // open addressing, keyed by (caller, callee)
+	u32 cap;
+	u32 len;
+	int depth;
+	VProfCgFrame stack[VPCG_MAX_DEPTH];
+} VProfCgThread;
+static VProfCgThread* vpcg_threads = NULL;
+static V_THREAD_LOCAL VProfCgThread* vpcg_self = NULL;
+
+static inline u32 vpcg_edge_slot(VProfCgFn* caller, VProfCgFn* callee, u32 cap) {
+	u64 h = ((u64)(uintptr_t)caller * 0x9E3779B97F4A7C15ULL) ^ ((u64)(uintptr_t)callee * 0xC2B2AE3D27D4EB4FULL);
+	return (u32)(h >> 32) & (cap - 1);
+}
+
+static VProfCgEdge* vpcg_edge(VProfCgEdge** edges, u32* cap, u32* len, VProfCgFn* caller, VProfCgFn* callee) {
+	if ((*len + 1) * 2 > *cap) {
+		u32 ncap = *cap == 0 ? 256 : *cap * 2;
+		VProfCgEdge* nedges = (VProfCgEdge*)calloc(ncap, sizeof(VProfCgEdge));
+		for (u32 i = 0; i < *cap; i++) {
+			VProfCgEdge* e = &(*edges)[i];
+			if (e->callee == NULL) {
+				continue;
+			}
+			u32 idx = vpcg_edge_slot(e->caller, e->callee, ncap);
+			while (nedges[idx].callee != NULL) {
+				idx = (idx + 1) & (ncap - 1);
+			}
+			nedges[idx] = *e;
+		}
+		free(*edges);
+		*edges = nedges;
+		*cap = ncap;
+	}
+	u32 idx = vpcg_edge_slot(caller, callee, *cap);
+	while ((*edges)[idx].callee != NULL) {
+		VProfCgEdge* e = &(*edges)[idx];
+		if (e->caller == caller && e->callee == callee) {
+			return e;
+		}
+		idx = (idx + 1) & (*cap - 1);
+	}
+	VProfCgEdge* e = &(*edges)[idx];
+	e->caller = caller;
+	e->callee = callee;
+	(*len)++;
+	return e;
+}
+
+#if defined(_MSC_VER)
+static inline void vpcg_lock(VProfCgThread* t) {
+	while (InterlockedCompareExchange(&t->lock, 1, 0) != 0) {
+		SwitchToThread();
+	}
+}
+static inline void vpcg_unlock(VProfCgThread* t) { InterlockedExchange(&t->lock, 0); }
+static inline VProfCgThread* vpcg_first(void) { return (VProfCgThread*)InterlockedCompareExchangePointer((void* volatile*)&vpcg_threads, NULL, NULL); }
+#else
+static inline void vpcg_lock(VProfCgThread* t) {
+	long unlocked = 0;
+	while (!__atomic_compare_exchange_n(&t->lock, &unlocked, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		unlocked = 0;
+		sched_yield();
+	}
+}
+static inline void vpcg_unlock(VProfCgThread* t) { __atomic_store_n(&t->lock, 0, __ATOMIC_RELEASE); }
+static inline VProfCgThread* vpcg_first(void) { return __atomic_load_n(&vpcg_threads, __ATOMIC_ACQUIRE); }
+#endif
+
+static VProfCgThread* vpcg_thread(void) {
+	if (vpcg_self == NULL) {
+		VProfCgThread* t = (VProfCgThread*)calloc(1, sizeof(VProfCgThread));
+#if defined(_MSC_VER)
+		VProfCgThread* head;
+		do {
+			head = vpcg_threads;
+			t->next = head;
+		} while (InterlockedCompareExchangePointer((void* volatile*)&vpcg_threads, t, head) != head);
+#else
+		VProfCgThread* head = __atomic_load_n(&vpcg_threads, __ATOMIC_ACQUIRE);
+		do {
+			t->next = head;
+		} while (!__atomic_compare_exchange_n(&vpcg_threads, &head, t, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+#endif
+		vpcg_self = t;
+	}
+	return vpcg_self;
+}
+
+static void vpcg_enter(VProfCgFn* fn, double now) {
+	VProfCgThread* t = vpcg_thread();
+	if (t->depth < VPCG_MAX_DEPTH) {
+		VProfCgFrame* f = &t->stack[t->depth];
+		f->fn = fn;
+		f->start = now;
+		f->child = 0;
+	}
+	t->depth++;
+}
+
+static void vpcg_exit(VProfCgFn* fn, double now) {
+	VProfCgThread* t = vpcg_thread();
+	// pop the frames, that were left by longjmp/panics, until the frame of fn:
+	while (t->depth > 0 && t->depth <= VPCG_MAX_DEPTH && t->stack[t->depth - 1].fn != fn) {
+		t->depth--;
+	}
+	if (t->depth <= 0) {
+		return;
+	}
+	t->depth--;
+	if (t->depth >= VPCG_MAX_DEPTH) {
+		return;
+	}
+	VProfCgFrame* f = &t->stack[t->depth];
+	double incl = now - f->start;
+	VProfCgFn* caller = t->depth > 0 ? t->stack[t->depth - 1].fn : NULL;
+	if (t->depth > 0) {
+		t->stack[t->depth - 1].child += incl;
+	}
+	vpcg_lock(t);
+	VProfCgEdge* e = vpcg_edge(&t->edges, &t->cap, &t->len, caller, fn);
+	e->calls++;
+	e->incl += incl;
+	e->self += incl - f->child;
+	vpcg_unlock(t);
+}
+
+static void vpcg_reset(void) {
+	for (VProfCgThread* t = vpcg_first(); t != NULL; t = t->next) {
+		vpcg_lock(t);
+		for (u32 i = 0; i < t->cap; i++) {
+			t->edges[i].calls = 0;
+			t->edges[i].incl = 0;
+			t->edges[i].self = 0;
+		}
+		vpcg_unlock(t);
+	}
+}
+
+// vpcg_write merges the edges of all threads, and writes them in the callgrind format, that
+// kcachegrind/qcachegrind, gprof2dot and other tools can read. The costs are in nanoseconds.
+static void vpcg_write(FILE* fp) {
+	VProfCgEdge* all = NULL;
+	u32 cap = 0, len = 0;
+	for (VProfCgThread* t = vpcg_first(); t != NULL; t = t->next) {
+		vpcg_lock(t);
+		for (u32 i = 0; i < t->cap; i++) {
+			VProfCgEdge* e = &t->edges[i];
+			if (e->callee == NULL || e->calls == 0) {
+				continue;
+			}
+			VProfCgEdge* m = vpcg_edge(&all, &cap, &len, e->caller, e->callee);
+			m->calls += e->calls;
+			m->incl += e->incl;
+			m->self += e->self;
+		}
+		vpcg_unlock(t);
+	}
+	for (u32 i = 0; i < cap; i++) {
+		if (all[i].callee != NULL) {
+			all[i].callee->written = 0;
+		}
+	}
+	fprintf(fp, "# callgrind format\\n");
+	fprintf(fp, "version: 1\\n");
+	fprintf(fp, "creator: v -profile-callgraph\\n");
+	fprintf(fp, "events: Nanoseconds\\n\\n");
+	for (u32 i = 0; i < cap; i++) {
+		VProfCgFn* fn = all[i].callee;
+		if (fn == NULL || fn->written) {
+			continue;
+		}
+		fn->written = 1;
+		double self = 0;
+		for (u32 j = 0; j < cap; j++) {
+			if (all[j].callee == fn) {
+				self += all[j].self;
+			}
+		}
+		fprintf(fp, "fn=%s\\n0 %.0f\\n", fn->name, self);
+		for (u32 j = 0; j < cap; j++) {
+			if (all[j].callee != NULL && all[j].caller == fn) {
+				fprintf(fp, "cfn=%s\\ncalls=%llu 0\\n0 %.0f\\n", all[j].callee->name, (unsigned long long)all[j].calls, all[j].incl);
+			}
+		}
+		fprintf(fp, "\\n");
+	}
+	free(all);
+}
+'
+
 pub struct ProfileCounterMeta {
 	fn_name   string
 	vpc_name  string
@@ -33,12 +239,24 @@ fn (mut g Gen) profile_fn(fn_decl ast.FnDecl) {
 		}
 		g.writeln('\tdouble _PROF_FN_START = ${measure_fn_name}();')
 		g.writeln('\tif(v__profile_enabled) { ${fn_profile_counter_name_calls}++; } // ${fn_name}')
+		if g.pref.profile_callgraph {
+			// the state at the start of the function is used at its end too, so that
+			// the shadow call stack stays balanced, even if the fn calls profile.on()
+			g.writeln('\tbool _PROF_CG = v__profile_enabled;')
+			g.writeln('\tif(_PROF_CG) { vpcg_enter(&vpcg_${cfn_name}, _PROF_FN_START); }')
+		}
 		g.writeln('')
 		g.defer_profile_code = '\tif(v__profile_enabled) { ${fn_profile_counter_name} += ${measure_fn_name}() - _PROF_FN_START; }'
+		if g.pref.profile_callgraph {
+			g.defer_profile_code += '\n\t\tif(_PROF_CG) { vpcg_exit(&vpcg_${cfn_name}, ${measure_fn_name}()); }'
+		}
 		if should_restore_v__profile_enabled {
 			g.defer_profile_code += '\n\t\tv__profile_enabled = _prev_v__profile_enabled;'
 		}
 		g.pcs_declarations.writeln('double ${fn_profile_counter_name} = 0.0; u64 ${fn_profile_counter_name_calls} = 0;')
+		if g.pref.profile_callgraph {
+			g.pcs_declarations.writeln('VProfCgFn vpcg_${cfn_name} = {"${cfn_name}", 0};')
+		}
 		g.pcs << ProfileCounterMeta{
 			fn_name:   cfn_name
 			vpc_name:  fn_profile_counter_name
@@ -50,7 +268,16 @@ fn (mut g Gen) profile_fn(fn_decl ast.FnDecl) {
 pub fn (mut g Gen) gen_vprint_profile_stats() {
 	g.pcs_declarations.writeln('void vprint_profile_stats(){')
 	fstring := '"%14llu %14.3fms %14.0fns %s \\n"'
-	if g.pref.profile_file == '-' {
+	if g.pref.profile_callgraph {
+		if g.pref.profile_file == '-' {
+			g.pcs_declarations.writeln('\tvpcg_write(stdout);')
+		} else {
+			g.pcs_declarations.writeln('\tFILE * fp;')
+			g.pcs_declarations.writeln('\tfp = fopen ("${g.pref.profile_file}", "w+");')
+			g.pcs_declarations.writeln('\tvpcg_write(fp);')
+			g.pcs_declarations.writeln('\tfclose(fp);')
+		}
+	} else if g.pref.profile_file == '-' {
 		for pc_meta in g.pcs {
 			g.pcs_declarations.writeln('\tif (${pc_meta.vpc_calls}) printf(${fstring}, ${pc_meta.vpc_calls}, ${pc_meta.vpc_name}/1000000.0, ${pc_meta.vpc_name}/${pc_meta.vpc_calls}, "${pc_meta.fn_name}" );')
 		}
@@ -69,6 +296,9 @@ pub fn (mut g Gen) gen_vprint_profile_stats() {
 		g.pcs_declarations.writeln('\t${pc_meta.vpc_calls} = 0;')
 		g.pcs_declarations.writeln('\t${pc_meta.vpc_name} = 0.0;')
 	}
+	if g.pref.profile_callgraph {
+		g.pcs_declarations.writeln('\tvpcg_reset();')
+	}
 	g.pcs_declarations.writeln('}')
 	g.pcs_declarations.writeln('')
 
@@ -82,12 +82,8 @@ fn (mut g Gen) spawn_and_go_expr(node ast.SpawnExpr, mode SpawnGoMode) {
 	wrapper_struct_name := 'thread_arg_' + name
 	wrapper_fn_name := name + '_thread_wrapper'
 	arg_tmp_var := 'arg_' + tmp
-	if is_spawn {
-		g.writeln('${wrapper_struct_name} *${arg_tmp_var} = (${wrapper_struct_name} *) _v_malloc(sizeof(thread_arg_${name}));')
-	} else if is_go {
-		g.writeln('${wrapper_struct_name} ${arg_tmp_var};')
-	}
-	dot := if is_spawn { '->' } else { '.' }
+	// the arguments are on the heap for coroutines too, since a coroutine can start after the current function returned
+	g.writeln('${wrapper_struct_name} *${arg_tmp_var} = (${wrapper_struct_name} *) _v_malloc(sizeof(thread_arg_${name}));')
 	fn_name := if use_tmp_fn_var {
 		tmp_fn
 	} else if expr.is_fn_var {
@@ -97,15 +93,15 @@ fn (mut g Gen) spawn_and_go_expr(node ast.SpawnExpr, mode SpawnGoMode) {
 	}
 	if !(expr.is_method && (g.table.sym(expr.receiver_type).kind == .interface_
 		|| (g.table.sym(expr.receiver_type).kind == .struct_ && expr.is_field))) {
-		g.writeln('${arg_tmp_var}${dot}fn = ${fn_name};')
+		g.writeln('${arg_tmp_var}->fn = ${fn_name};')
 	}
 	if expr.is_method {
-		g.write('${arg_tmp_var}${dot}arg0 = ')
+		g.write('${arg_tmp_var}->arg0 = ')
 		g.expr(expr.left)
 		g.writeln(';')
 	}
 	for i, arg in expr.args {
-		g.write('${arg_tmp_var}${dot}arg${i + 1} = ')
+		g.write('${arg_tmp_var}->arg${i + 1} = ')
 		g.expr(arg.expr)
 		g.writeln(';')
 	}
@@ -164,11 +160,7 @@ fn (mut g Gen) spawn_and_go_expr(node ast.SpawnExpr, mode SpawnGoMode) {
 			}
 		}
 	} else if is_go {
-		if util.nr_jobs > 1 {
-			g.writeln('photon_thread_create_and_migrate_to_work_pool((void*)${wrapper_fn_name}, &${arg_tmp_var});')
-		} else {
-			g.writeln('photon_thread_create((void*)${wrapper_fn_name}, &${arg_tmp_var}, 8 * 1024);')
-		}
+		g.writeln('vcoro_go((void*)${wrapper_fn_name}, ${arg_tmp_var});')
 	}
 	g.writeln('// end go')
 	if node.is_expr {
@@ -387,9 +379,7 @@ fn (mut g Gen) spawn_and_go_expr(node ast.SpawnExpr, mode SpawnGoMode) {
 			}
 		}
 		g.gowrappers.writeln(');')
-		if is_spawn {
-			g.gowrappers.writeln('\t_v_free(arg);')
-		}
+		g.gowrappers.writeln('\t_v_free(arg);')
 		if g.pref.os != .windows && node.call_expr.return_type != ast.void_type {
 			g.gowrappers.writeln('\treturn ret_ptr;')
 		} else {
@@ -43,6 +43,8 @@ fn (mut g Gen) struct_init(node ast.StructInit) {
 		return
 	}
 	is_amp := g.is_amp
+	// a non escaping `&Foo{}` (see v.transformer.escape_analysis), is a compound literal on the stack:
+	is_stack_amp := is_amp && node.is_stack_alloc && g.inside_cast_in_heap == 0 && !g.is_shared
 	is_multiline := node.init_fields.len > 5
 	g.is_amp = false // reset the flag immediately so that other struct inits in this expr are handled correctly
 	if is_amp {
@@ -75,6 +77,8 @@ fn (mut g Gen) struct_init(node ast.StructInit) {
 		mut shared_typ := node.typ.set_flag(.shared_f)
 		shared_styp = g.typ(shared_typ)
 		g.writeln('(${shared_styp}*)__dup${shared_styp}(&(${shared_styp}){.mtx = {0}, .val =(${styp}){')
+	} else if is_stack_amp {
+		g.write('&(${styp}){')
 	} else if is_amp || g.inside_cast_in_heap > 0 {
 		if node.typ.has_flag(.option) {
 			basetyp := g.base_type(node.typ)
@@ -370,7 +374,7 @@ fn (mut g Gen) struct_init(node ast.StructInit) {
 	}
 	if g.is_shared && !g.inside_opt_data && !g.is_arraymap_set {
 		g.write('}, sizeof(${shared_styp}))')
-	} else if is_amp || g.inside_cast_in_heap > 0 {
+	} else if (is_amp && !is_stack_amp) || g.inside_cast_in_heap > 0 {
 		if node.typ.has_flag(.option) {
 			basetyp := g.base_type(node.typ)
 			g.write(', sizeof(${basetyp}))')
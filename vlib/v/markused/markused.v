@@ -319,6 +319,7 @@ pub fn mark_used(mut table ast.Table, mut pref_ pref.Preferences, ast_files []&a
 		for orm_type in orm_connection_implementations {
 			all_fn_root_names << '${int(orm_type)}.select'
 			all_fn_root_names << '${int(orm_type)}.insert'
+			all_fn_root_names << '${int(orm_type)}.insert_batch'
 			all_fn_root_names << '${int(orm_type)}.update'
 			all_fn_root_names << '${int(orm_type)}.delete'
 			all_fn_root_names << '${int(orm_type)}.create'
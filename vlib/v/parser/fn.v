@@ -1193,7 +1193,10 @@ fn (mut p Parser) go_expr() ast.GoExpr {
 		}
 	}
 	pos := spos.extend(p.prev_tok.pos())
-	// p.register_auto_import('coroutines')
+	if p.pref.use_coroutines {
+		// the scheduler of the coroutines is started by the init() of the module
+		p.register_auto_import('coroutines')
+	}
 	p.table.gostmts++
 	return ast.GoExpr{
 		call_expr: call_expr
@@ -153,6 +153,15 @@ pub fn (mut p Preferences) fill_with_defaults() {
 	}
 	p.find_cc_if_cross_compiling()
 	p.ccompiler_type = cc_from_string(p.ccompiler)
+	if p.profile_callgraph {
+		if !p.is_prof {
+			eprintln_exit('-profile-callgraph is used together with `-profile file.out`, for example: `v -profile-callgraph -profile callgrind.out run file.v`')
+		}
+		if p.ccompiler_type == .tinyc {
+			// the shadow call stacks are thread local, and tcc has no TLS support
+			eprintln_exit('-profile-callgraph needs a C compiler with thread local storage support, use `-cc gcc` or `-cc clang`')
+		}
+	}
 	p.is_test = p.path.ends_with('_test.v') || p.path.ends_with('_test.vv')
 		|| p.path.all_before_last('.v').all_before_last('.').ends_with('_test')
 	p.is_vsh = p.path.ends_with('.vsh') || p.raw_vsh_tmp_prefix != ''
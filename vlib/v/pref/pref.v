@@ -124,6 +124,10 @@ pub mut:
 	coverage_dir       string   // the coverage files will be stored inside coverage_dir
 	profile_no_inline  bool     // when true, @[inline] functions would not be profiled
 	profile_fns        []string // when set, profiling will be off by default, but inside these functions (and what they call) it will be on.
+	profile_callgraph  bool     // `-profile-callgraph`, track the self and inclusive time of each caller->callee edge, and write a callgrind file
+	is_prof_sampling   bool     // `-profile-sampling file.folded`, take periodic stack samples, instead of instrumenting every function
+	prof_sampling_file string   // the collapsed stacks will be stored in that file, and a pprof profile in `file.folded.pprof`
+	prof_sampling_hz   int      // how many stack samples per second of CPU time will be taken. 0 means the default (99)
 	translated         bool     // `v translate doom.v` are we running V code translated from C? allow globals, ++ expressions, etc
 	translated_go      bool = true // Are we running V code translated from Go? Allow err shadowing
 	obfuscate          bool // `v -obf program.v`, renames functions to "f_XXX"
@@ -138,6 +142,7 @@ pub mut:
 	show_c_output          bool   // -show-c-output, print all cc output even if the code was compiled correctly
 	show_callgraph         bool   // -show-callgraph, print the program callgraph, in a Graphviz DOT format to stdout
 	show_depgraph          bool   // -show-depgraph, print the program module dependency graph, in a Graphviz DOT format to stdout
+	show_bce               bool   // -show-bce, print the array/string indexes, whose bounds checks were removed by the compiler
 	dump_c_flags           string // `-dump-c-flags file.txt` - let V store all C flags, passed to the backend C compiler in `file.txt`, one C flag/value per line.
 	dump_modules           string // `-dump-modules modules.txt` - let V store all V modules, that were used by the compiled program in `modules.txt`, one module per line.
 	dump_files             string // `-dump-files files.txt` - let V store all V or .template file paths, that were used by the compiled program in `files.txt`, one path per line.
@@ -636,6 +641,22 @@ pub fn parse_args_and_show_errors(known_external_commands []string, args []strin
 			'-profile-no-inline' {
 				res.profile_no_inline = true
 			}
+			'-profile-callgraph' {
+				res.profile_callgraph = true
+				res.build_options << arg
+			}
+			'-profile-sampling' {
+				res.prof_sampling_file = cmdline.option(args[i..], arg, '-')
+				res.is_prof_sampling = true
+				res.parse_define('profile_sampling')
+				res.parse_define('use_libbacktrace')
+				res.build_options << '${arg} ${res.prof_sampling_file}'
+				i++
+			}
+			'-profile-sampling-hz' {
+				res.prof_sampling_hz = cmdline.option(args[i..], arg, '99').int()
+				i++
+			}
 			'-prod' {
 				res.is_prod = true
 				res.build_options << arg
@@ -686,6 +707,9 @@ pub fn parse_args_and_show_errors(known_external_commands []string, args []strin
 			'-show-depgraph' {
 				res.show_depgraph = true
 			}
+			'-show-bce' {
+				res.show_bce = true
+			}
 			'-run-only' {
 				res.run_only = cmdline.option(args[i..], arg, os.getenv('VTEST_ONLY_FN')).split_any(',')
 				i++
@@ -929,20 +953,6 @@ pub fn parse_args_and_show_errors(known_external_commands []string, args []strin
 			'-use-coroutines' {
 				res.use_coroutines = true
 				$if macos || linux {
-					arch := $if arm64 { 'arm64' } $else { 'amd64' }
-					vexe := vexe_path()
-					vroot := os.dir(vexe)
-					so_path := os.join_path(vroot, 'thirdparty', 'photon', 'photonwrapper.so')
-					so_url := 'https://github.com/vlang/photonbin/raw/master/photonwrapper_${os.user_os()}_${arch}.so'
-					if !os.exists(so_path) {
-						println('coroutines .so not found, downloading...')
-						os.execute_opt('wget -O "${so_path}" "${so_url}"') or {
-							os.execute_opt('curl -o "${so_path}" "${so_url}"') or {
-								panic('coroutines .so could not be downloaded with wget or curl. Download ${so_url}, place it in ${so_path} then try again.')
-							}
-						}
-						println('done!')
-					}
 					res.compile_defines << 'is_coroutine'
 					res.compile_defines_all << 'is_coroutine'
 				} $else {
@@ -11,3 +11,12 @@ pub fn state() bool {
 pub fn on(state bool) {
 	v__profile_enabled = state
 }
+
+// sampling_write stops the `-profile-sampling` profiler, and writes the collected samples immediately.
+// It is useful for programs that do not exit normally, like servers. Later calls do nothing.
+// Without `-profile-sampling`, it does nothing.
+pub fn sampling_write() {
+	$if profile_sampling ? {
+		C.vsampling_write_profile()
+	}
+}
@@ -0,0 +1,480 @@
+// A low overhead sampling profiler, used by `v -profile-sampling file.folded program.v` .
+// Each thread that consumes CPU time, is interrupted periodically by SIGPROF (see setitimer).
+// The signal handler captures the call stack with libbacktrace's backtrace_simple, and
+// aggregates identical stacks in a thread local hash table, that is mmap-ed on first use,
+// and registered in a global list with a CAS, so no locks are taken while sampling.
+// At exit, the program counters are symbolized, and both a collapsed stack file
+// (for flamegraph.pl/speedscope/inferno), and a pprof profile.proto file are written.
+#ifndef V_PROFILE_SAMPLING_H
+#define V_PROFILE_SAMPLING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(_WIN32) || defined(__TINYC__) || defined(__EMSCRIPTEN__) || defined(__ANDROID__)
+
+static void vsampling_start(const char *argv0, const char *fpath, int hz) {
+	(void)argv0; (void)fpath; (void)hz;
+	fprintf(stderr, "-profile-sampling is not supported on this platform/compiler; no samples will be taken.\n");
+}
+static void vsampling_write_profile(void) {}
+static void vsampling_on_exit_signal(int sig) { (void)sig; exit(130); }
+
+#else
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <backtrace.h>
+
+#ifndef VSAMPLING_MAX_FRAMES
+#define VSAMPLING_MAX_FRAMES 64
+#endif
+#ifndef VSAMPLING_THREAD_SLOTS
+#define VSAMPLING_THREAD_SLOTS 4096 // must be a power of 2
+#endif
+
+typedef struct VSamplingStack {
+	uint64_t hash;
+	uint64_t count;
+	int nframes;
+	uintptr_t pcs[VSAMPLING_MAX_FRAMES]; // pcs[0] is the leaf frame
+} VSamplingStack;
+
+typedef struct VSamplingThread {
+	struct VSamplingThread *next;
+	uint64_t dropped; // samples that did not fit in the table
+	int in_handler;
+	VSamplingStack slots[VSAMPLING_THREAD_SLOTS];
+} VSamplingThread;
+
+static struct backtrace_state *vsampling_bt_state = NULL;
+static VSamplingThread *vsampling_threads = NULL;
+static __thread VSamplingThread *vsampling_self = NULL;
+static const char *vsampling_fpath = NULL;
+static int vsampling_hz = 99;
+static int vsampling_running = 0;
+
+static void vsampling_bt_error(void *data, const char *msg, int errnum) {
+	(void)data; (void)msg; (void)errnum;
+}
+
+static VSamplingThread *vsampling_thread(void) {
+	VSamplingThread *t = vsampling_self;
+	if (t != NULL) {
+		return t;
+	}
+	// mmap is async signal safe, unlike malloc; the pages are touched lazily
+	void *mem = mmap(NULL, sizeof(VSamplingThread), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+	t = (VSamplingThread *)mem;
+	VSamplingThread *head = __atomic_load_n(&vsampling_threads, __ATOMIC_ACQUIRE);
+	do {
+		t->next = head;
+	} while (!__atomic_compare_exchange_n(&vsampling_threads, &head, t, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+	vsampling_self = t;
+	return t;
+}
+
+static int vsampling_collect_pc(void *data, uintptr_t pc) {
+	VSamplingStack *st = (VSamplingStack *)data;
+	if (st->nframes >= VSAMPLING_MAX_FRAMES) {
+		return 1;
+	}
+	if (pc == 0 || pc == (uintptr_t)-1) {
+		// the end of the stack
+		return 1;
+	}
+	st->pcs[st->nframes++] = pc;
+	st->hash = (st->hash ^ (uint64_t)pc) * 0x100000001b3ULL; // FNV-1a over the pcs
+	return 0;
+}
+
+static void vsampling_record(VSamplingThread *t, VSamplingStack *st) {
+	uint64_t mask = VSAMPLING_THREAD_SLOTS - 1;
+	uint64_t idx = st->hash & mask;
+	for (int probe = 0; probe < 64; probe++, idx = (idx + 1) & mask) {
+		VSamplingStack *slot = &t->slots[idx];
+		if (slot->count == 0) {
+			memcpy(slot->pcs, st->pcs, st->nframes * sizeof(uintptr_t));
+			slot->nframes = st->nframes;
+			slot->hash = st->hash;
+			__atomic_store_n(&slot->count, 1, __ATOMIC_RELEASE);
+			return;
+		}
+		if (slot->hash == st->hash && slot->nframes == st->nframes
+			&& memcmp(slot->pcs, st->pcs, st->nframes * sizeof(uintptr_t)) == 0) {
+			__atomic_store_n(&slot->count, slot->count + 1, __ATOMIC_RELEASE);
+			return;
+		}
+	}
+	t->dropped++;
+}
+
+static void vsampling_on_sigprof(int sig, siginfo_t *info, void *ucontext) {
+	(void)sig; (void)info; (void)ucontext;
+	if (!__atomic_load_n(&vsampling_running, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+	int saved_errno = errno;
+	VSamplingThread *t = vsampling_thread();
+	if (t != NULL && !t->in_handler) {
+		t->in_handler = 1;
+		VSamplingStack st;
+		st.hash = 0xcbf29ce484222325ULL;
+		st.nframes = 0;
+		// skip the frames of the signal handler itself, and of the signal trampoline:
+		backtrace_simple(vsampling_bt_state, 2, vsampling_collect_pc, vsampling_bt_error, &st);
+		if (st.nframes > 0) {
+			vsampling_record(t, &st);
+		}
+		t->in_handler = 0;
+	}
+	errno = saved_errno;
+}
+
+static void vsampling_set_timer(int hz) {
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	if (hz > 0) {
+		timer.it_interval.tv_usec = 1000000 / hz;
+		timer.it_value = timer.it_interval;
+	}
+	setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+static void vsampling_start(const char *argv0, const char *fpath, int hz) {
+	vsampling_fpath = fpath;
+	vsampling_hz = hz > 0 && hz <= 10000 ? hz : 99;
+	vsampling_bt_state = backtrace_create_state(argv0, 1, vsampling_bt_error, NULL);
+	// register the main thread, before the first signal arrives:
+	vsampling_thread();
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = vsampling_on_sigprof;
+	sa.sa_flags = SA_RESTART | SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGPROF, &sa, NULL);
+	__atomic_store_n(&vsampling_running, 1, __ATOMIC_RELEASE);
+	vsampling_set_timer(vsampling_hz);
+}
+
+static void vsampling_on_exit_signal(int sig) {
+	(void)sig;
+	exit(130);
+}
+
+//
+// Symbolization, and writing of the results. Everything below runs at exit, outside of signal handlers.
+//
+
+typedef struct VSamplingBuf {
+	uint8_t *data;
+	size_t len;
+	size_t cap;
+} VSamplingBuf;
+
+static void vsb_bytes(VSamplingBuf *b, const void *p, size_t n) {
+	if (n == 0) {
+		return;
+	}
+	if (b->len + n > b->cap) {
+		size_t ncap = b->cap == 0 ? 256 : b->cap * 2;
+		while (ncap < b->len + n) {
+			ncap *= 2;
+		}
+		b->data = (uint8_t *)realloc(b->data, ncap);
+		b->cap = ncap;
+	}
+	memcpy(b->data + b->len, p, n);
+	b->len += n;
+}
+
+static void vsb_varint(VSamplingBuf *b, uint64_t v) {
+	uint8_t tmp[10];
+	int n = 0;
+	do {
+		tmp[n] = (uint8_t)(v & 0x7f);
+		v >>= 7;
+		if (v) {
+			tmp[n] |= 0x80;
+		}
+		n++;
+	} while (v);
+	vsb_bytes(b, tmp, n);
+}
+
+// protobuf wire types: 0 is varint, 2 is length delimited
+static void vsb_field_varint(VSamplingBuf *b, int field, uint64_t v) {
+	vsb_varint(b, ((uint64_t)field << 3) | 0);
+	vsb_varint(b, v);
+}
+
+static void vsb_field_bytes(VSamplingBuf *b, int field, const void *p, size_t n) {
+	vsb_varint(b, ((uint64_t)field << 3) | 2);
+	vsb_varint(b, n);
+	vsb_bytes(b, p, n);
+}
+
+static void vsb_field_msg(VSamplingBuf *b, int field, VSamplingBuf *msg) {
+	vsb_field_bytes(b, field, msg->data, msg->len);
+	msg->len = 0;
+}
+
+typedef struct VSamplingStrings {
+	char **items;
+	int len;
+	int cap;
+} VSamplingStrings;
+
+// vsampling_intern returns the index of s in the string table, adding a copy of it, when it is missing.
+// The number of distinct function names in a profile is small, so a linear search is fine.
+static int vsampling_intern(VSamplingStrings *t, const char *s) {
+	for (int i = 0; i < t->len; i++) {
+		if (strcmp(t->items[i], s) == 0) {
+			return i;
+		}
+	}
+	if (t->len == t->cap) {
+		t->cap = t->cap == 0 ? 64 : t->cap * 2;
+		t->items = (char **)realloc(t->items, t->cap * sizeof(char *));
+	}
+	t->items[t->len] = strdup(s);
+	return t->len++;
+}
+
+typedef struct VSamplingLocation {
+	uintptr_t pc;
+	int id; // the pprof location and function id
+	int name; // index in the string table
+	int file; // index in the string table
+	int line;
+} VSamplingLocation;
+
+typedef struct VSamplingSymbols {
+	VSamplingLocation *locs; // open addressing, keyed by pc
+	int cap;
+	int len;
+	int *order; // the slot index of each location, in insertion order
+	VSamplingStrings strings;
+} VSamplingSymbols;
+
+typedef struct VSamplingPcInfo {
+	const char *fn;
+	const char *file;
+	int line;
+} VSamplingPcInfo;
+
+static int vsampling_pcinfo_cb(void *data, uintptr_t pc, const char *filename, int lineno, const char *function) {
+	(void)pc;
+	VSamplingPcInfo *pi = (VSamplingPcInfo *)data;
+	if (function != NULL) {
+		// keep the outermost frame, when the pc is in an inlined function
+		pi->fn = function;
+		pi->file = filename;
+		pi->line = lineno;
+	}
+	return 0;
+}
+
+static void vsampling_syminfo_cb(void *data, uintptr_t pc, const char *symname, uintptr_t symval, uintptr_t symsize) {
+	(void)pc; (void)symval; (void)symsize;
+	VSamplingPcInfo *pi = (VSamplingPcInfo *)data;
+	if (symname != NULL) {
+		pi->fn = symname;
+	}
+}
+
+// vsampling_demangle turns `main__Point_str` into `main.Point_str`, like the V panic backtraces do
+static void vsampling_demangle(const char *cname, char *out, size_t outlen) {
+	size_t j = 0;
+	for (size_t i = 0; cname[i] != 0 && j + 1 < outlen; i++) {
+		if (cname[i] == '_' && cname[i + 1] == '_' && i > 0) {
+			out[j++] = '.';
+			i++;
+			continue;
+		}
+		// `;` and ` ` are separators in the collapsed stack format
+		out[j++] = (cname[i] == ';' || cname[i] == ' ') ? '_' : cname[i];
+	}
+	out[j] = 0;
+}
+
+static VSamplingLocation *vsampling_location(VSamplingSymbols *s, uintptr_t pc) {
+	if ((s->len + 1) * 2 > s->cap) {
+		int ncap = s->cap == 0 ? 1024 : s->cap * 2;
+		VSamplingLocation *nlocs = (VSamplingLocation *)calloc(ncap, sizeof(VSamplingLocation));
+		int *norder = (int *)malloc(ncap * sizeof(int));
+		for (int i = 0; i < s->len; i++) {
+			VSamplingLocation *old = &s->locs[s->order[i]];
+			int idx = (int)((old->pc * 0x9E3779B97F4A7C15ULL) >> 7) & (ncap - 1);
+			while (nlocs[idx].pc != 0) {
+				idx = (idx + 1) & (ncap - 1);
+			}
+			nlocs[idx] = *old;
+			norder[i] = idx;
+		}
+		free(s->locs);
+		free(s->order);
+		s->locs = nlocs;
+		s->order = norder;
+		s->cap = ncap;
+	}
+	int idx = (int)((pc * 0x9E3779B97F4A7C15ULL) >> 7) & (s->cap - 1);
+	while (s->locs[idx].pc != 0) {
+		if (s->locs[idx].pc == pc) {
+			return &s->locs[idx];
+		}
+		idx = (idx + 1) & (s->cap - 1);
+	}
+	VSamplingPcInfo pi = {NULL, NULL, 0};
+	// pcs in a stack (except the leaf) are return addresses => look at the call instruction before them:
+	backtrace_pcinfo(vsampling_bt_state, pc - 1, vsampling_pcinfo_cb, vsampling_bt_error, &pi);
+	if (pi.fn == NULL) {
+		backtrace_syminfo(vsampling_bt_state, pc - 1, vsampling_syminfo_cb, vsampling_bt_error, &pi);
+	}
+	char name[512];
+	if (pi.fn != NULL) {
+		vsampling_demangle(pi.fn, name, sizeof(name));
+	} else {
+		snprintf(name, sizeof(name), "0x%llx", (unsigned long long)pc);
+	}
+	VSamplingLocation *loc = &s->locs[idx];
+	loc->pc = pc;
+	loc->name = vsampling_intern(&s->strings, name);
+	loc->file = vsampling_intern(&s->strings, pi.file != NULL ? pi.file : "");
+	loc->line = pi.line;
+	s->order[s->len++] = idx;
+	loc->id = s->len;
+	return loc;
+}
+
+static void vsampling_write_collapsed(FILE *out, VSamplingSymbols *syms) {
+	for (VSamplingThread *t = __atomic_load_n(&vsampling_threads, __ATOMIC_ACQUIRE); t != NULL; t = t->next) {
+		for (int i = 0; i < VSAMPLING_THREAD_SLOTS; i++) {
+			VSamplingStack *st = &t->slots[i];
+			if (st->count == 0) {
+				continue;
+			}
+			// the root frame goes first in the collapsed format:
+			for (int f = st->nframes - 1; f >= 0; f--) {
+				VSamplingLocation *loc = vsampling_location(syms, st->pcs[f]);
+				fprintf(out, "%s%s", syms->strings.items[loc->name], f > 0 ? ";" : "");
+			}
+			fprintf(out, " %llu\n", (unsigned long long)st->count);
+		}
+		if (t->dropped > 0) {
+			fprintf(out, "[dropped] %llu\n", (unsigned long long)t->dropped);
+		}
+	}
+}
+
+static void vsampling_write_pprof(FILE *out, VSamplingSymbols *syms) {
+	int64_t period = 1000000000LL / vsampling_hz;
+	VSamplingBuf profile = {0}, msg = {0}, packed = {0};
+	int s_samples = vsampling_intern(&syms->strings, "samples");
+	int s_count = vsampling_intern(&syms->strings, "count");
+	int s_cpu = vsampling_intern(&syms->strings, "cpu");
+	int s_ns = vsampling_intern(&syms->strings, "nanoseconds");
+	// Profile.sample_type = 1
+	vsb_field_varint(&msg, 1, s_samples);
+	vsb_field_varint(&msg, 2, s_count);
+	vsb_field_msg(&profile, 1, &msg);
+	vsb_field_varint(&msg, 1, s_cpu);
+	vsb_field_varint(&msg, 2, s_ns);
+	vsb_field_msg(&profile, 1, &msg);
+	// Profile.sample = 2
+	for (VSamplingThread *t = __atomic_load_n(&vsampling_threads, __ATOMIC_ACQUIRE); t != NULL; t = t->next) {
+		for (int i = 0; i < VSAMPLING_THREAD_SLOTS; i++) {
+			VSamplingStack *st = &t->slots[i];
+			if (st->count == 0) {
+				continue;
+			}
+			// Sample.location_id = 1, the leaf goes first:
+			for (int f = 0; f < st->nframes; f++) {
+				VSamplingLocation *loc = vsampling_location(syms, st->pcs[f]);
+				vsb_varint(&packed, loc->id);
+			}
+			vsb_field_bytes(&msg, 1, packed.data, packed.len);
+			packed.len = 0;
+			// Sample.value = 2
+			vsb_varint(&packed, st->count);
+			vsb_varint(&packed, st->count * period);
+			vsb_field_bytes(&msg, 2, packed.data, packed.len);
+			packed.len = 0;
+			vsb_field_msg(&profile, 2, &msg);
+		}
+	}
+	// Profile.location = 4 and Profile.function = 5; there is a function per location, with the same id
+	VSamplingBuf line = {0};
+	for (int i = 0; i < syms->len; i++) {
+		VSamplingLocation *loc = &syms->locs[syms->order[i]];
+		vsb_field_varint(&line, 1, loc->id);
+		vsb_field_varint(&line, 2, loc->line);
+		vsb_field_varint(&msg, 1, loc->id);
+		vsb_field_varint(&msg, 3, loc->pc);
+		vsb_field_msg(&msg, 4, &line);
+		vsb_field_msg(&profile, 4, &msg);
+		vsb_field_varint(&msg, 1, loc->id);
+		vsb_field_varint(&msg, 2, loc->name);
+		vsb_field_varint(&msg, 3, loc->name);
+		vsb_field_varint(&msg, 4, loc->file);
+		vsb_field_msg(&profile, 5, &msg);
+	}
+	// Profile.string_table = 6
+	for (int i = 0; i < syms->strings.len; i++) {
+		vsb_field_bytes(&profile, 6, syms->strings.items[i], strlen(syms->strings.items[i]));
+	}
+	// Profile.period_type = 11, Profile.period = 12
+	vsb_field_varint(&msg, 1, s_cpu);
+	vsb_field_varint(&msg, 2, s_ns);
+	vsb_field_msg(&profile, 11, &msg);
+	vsb_field_varint(&profile, 12, period);
+	fwrite(profile.data, 1, profile.len, out);
+	free(profile.data);
+	free(msg.data);
+	free(packed.data);
+	free(line.data);
+}
+
+static void vsampling_write_profile(void) {
+	if (!__atomic_exchange_n(&vsampling_running, 0, __ATOMIC_ACQ_REL)) {
+		return;
+	}
+	vsampling_set_timer(0);
+	signal(SIGPROF, SIG_IGN);
+	VSamplingSymbols syms;
+	memset(&syms, 0, sizeof(syms));
+	// the pprof string table must start with "", so reserve it first:
+	vsampling_intern(&syms.strings, "");
+	if (vsampling_fpath == NULL || strcmp(vsampling_fpath, "-") == 0) {
+		vsampling_write_collapsed(stdout, &syms);
+		fflush(stdout);
+		return;
+	}
+	FILE *fp = fopen(vsampling_fpath, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "-profile-sampling: can not open %s for writing\n", vsampling_fpath);
+		return;
+	}
+	vsampling_write_collapsed(fp, &syms);
+	fclose(fp);
+	char pprof_path[4096];
+	snprintf(pprof_path, sizeof(pprof_path), "%s.pprof", vsampling_fpath);
+	fp = fopen(pprof_path, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "-profile-sampling: can not open %s for writing\n", pprof_path);
+		return;
+	}
+	vsampling_write_pprof(fp, &syms);
+	fclose(fp);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+module profile
+
+// This file is compiled only for `v -profile-sampling file.folded program.v`, which also
+// passes `-d profile_sampling` and `-d use_libbacktrace`. The sampler itself is written in C,
+// since it runs inside a signal handler. The generated C `main` function starts it, and
+// registers `vsampling_write_profile` to be called at exit.
+#include "@VEXEROOT/vlib/v/profile/sampling.h"
+
+fn C.vsampling_write_profile()
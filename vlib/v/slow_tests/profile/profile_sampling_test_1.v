@@ -0,0 +1,14 @@
+fn fib(n int) int {
+	if n < 2 {
+		return n
+	}
+	return fib(n - 1) + fib(n - 2)
+}
+
+fn main() {
+	mut total := 0
+	for _ in 0 .. 5 {
+		total += fib(30)
+	}
+	println(total)
+}
@@ -115,6 +115,85 @@ fn test_v_profile_fns_option_works() {
 	})
 }
 
+fn test_v_profile_callgraph_works() {
+	println(@FN)
+	sfile := 'vlib/v/slow_tests/profile/profile_test_3.v'
+	os.chdir(vroot) or {}
+	program_source := os.join_path(vroot, sfile)
+	res := os.execute('${os.quoted_path(vexe)} -cc gcc -profile-callgraph -profile - run ${os.quoted_path(program_source)}')
+	if res.exit_code != 0 && res.output.contains('gcc') {
+		eprintln('> skipping ${@FN}, since gcc is not available')
+		return
+	}
+	assert res.exit_code == 0, res.output
+	lines := res.output.split_into_lines()
+	assert lines.contains('# callgrind format')
+	assert lines.contains('events: Nanoseconds')
+	// main calls abc once, abc calls xyz twice:
+	abc_idx := lines.index('fn=main__abc')
+	assert abc_idx > 0
+	assert lines[abc_idx + 2] == 'cfn=main__xyz'
+	assert lines[abc_idx + 3] == 'calls=2 0'
+	main_idx := lines.index('fn=main__main')
+	assert main_idx > 0
+	assert lines[main_idx + 2..].contains('cfn=main__abc')
+	// the self time of each function is on the line after its fn= line:
+	assert lines[abc_idx + 1].starts_with('0 ')
+	// with -profile-fns, only main__xyz and the functions that it calls are recorded:
+	res2 := os.execute('${os.quoted_path(vexe)} -cc gcc -profile-callgraph -profile-fns main__xyz -profile - run ${os.quoted_path(program_source)}')
+	assert res2.exit_code == 0, res2.output
+	lines2 := res2.output.split_into_lines()
+	assert lines2.contains('fn=main__xyz')
+	assert !lines2.contains('fn=main__abc')
+	assert !lines2.contains('fn=main__main')
+}
+
+fn test_v_profile_callgraph_rejects_bad_options() {
+	println(@FN)
+	os.chdir(vroot) or {}
+	program_source := os.join_path(vroot, 'vlib/v/slow_tests/profile/profile_test_3.v')
+	res := os.execute('${os.quoted_path(vexe)} -profile-callgraph run ${os.quoted_path(program_source)}')
+	assert res.exit_code != 0
+	assert res.output.contains('-profile-callgraph is used together with `-profile file.out`')
+	res2 := os.execute('${os.quoted_path(vexe)} -cc tcc -profile-callgraph -profile - run ${os.quoted_path(program_source)}')
+	assert res2.exit_code != 0
+	assert res2.output.contains('-profile-callgraph needs a C compiler with thread local storage support')
+}
+
+fn test_v_profile_sampling_works() {
+	println(@FN)
+	$if windows {
+		eprintln('> skipping ${@FN} on windows, since there is no SIGPROF there')
+		return
+	}
+	sfile := 'vlib/v/slow_tests/profile/profile_sampling_test_1.v'
+	program_source := os.join_path(vroot, sfile)
+	pid := os.getpid()
+	program_profile := os.join_path(os.cache_dir(), 'profile_sampling_test_pid_${pid}.folded')
+	os.rm(program_profile) or {}
+	os.rm('${program_profile}.pprof') or {}
+	os.chdir(vroot) or {}
+	res := os.execute('${os.quoted_path(vexe)} -cc gcc -profile-sampling ${os.quoted_path(program_profile)} -profile-sampling-hz 997 run ${os.quoted_path(program_source)}')
+	if res.exit_code != 0 && res.output.contains('gcc') {
+		eprintln('> skipping ${@FN}, since gcc is not available')
+		return
+	}
+	assert res.exit_code == 0, res.output
+	assert res.output.trim_space() == '4160200'
+	folded := os.read_lines(program_profile)!
+	assert folded.len > 0
+	fib_samples := folded.filter(it.contains('main.fib'))
+	assert fib_samples.len > 0, folded.str()
+	// the collapsed stacks start from the root, and end with the sample count:
+	assert fib_samples.all(it.contains('main.main;main.fib'))
+	assert fib_samples.all(it.all_after_last(' ').int() > 0)
+	pprof := os.read_bytes('${program_profile}.pprof')!
+	assert pprof.len > 0
+	assert pprof.bytestr().contains('main.fib')
+	os.rm(program_profile) or {}
+	os.rm('${program_profile}.pprof') or {}
+}
+
 fn counter_value(lines []string, what string) int {
 	res := lines.filter(it.contains(what))
 	if res.len == 0 {
@@ -0,0 +1,36 @@
+import os
+
+const vexe = os.getenv('VEXE')
+
+const vroot = os.dir(vexe)
+
+fn test_trace_allocs_writes_a_heap_profile() {
+	os.chdir(vroot) or {}
+	program_source := os.join_path(vroot, 'vlib/v/slow_tests/profile/trace_allocs_test_1.v')
+	res := os.execute('${os.quoted_path(vexe)} -d trace_allocs run ${os.quoted_path(program_source)}')
+	assert res.exit_code == 0, res.output
+	// the output may start with the warnings for targets without backtrace(), like tcc:
+	lines := res.output.split_into_lines()
+	start := lines.index('points: 1000')
+	assert start >= 0, res.output
+	assert lines[start + 1].starts_with('heap profile: ')
+	assert lines[start + 1].ends_with('@ heapprofile')
+	assert lines.contains('MAPPED_LIBRARIES:')
+	// each bucket line is `count: bytes [count: bytes] @ pc1 pc2 ...`:
+	buckets := lines[start + 2..lines.index('MAPPED_LIBRARIES:')].filter(it.len > 0)
+	assert buckets.len > 0
+	mut total := u64(0)
+	for b in buckets {
+		assert b.contains(' @ ')
+		total += b.all_before(':').u64()
+	}
+	assert total >= 1000
+}
+
+fn test_trace_allocs_api_works_without_the_define() {
+	trace_allocs_reset()
+	trace_allocs_write('-')
+	stats := trace_allocs_stats()
+	assert stats.count == 0
+	assert stats.bytes == 0
+}
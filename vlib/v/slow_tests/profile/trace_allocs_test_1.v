@@ -0,0 +1,26 @@
+struct Point {
+	x int
+	y int
+}
+
+@[noinline]
+fn make_points(n int) []&Point {
+	mut points := []&Point{}
+	for i in 0 .. n {
+		points << &Point{
+			x: i
+			y: i * 2
+		}
+	}
+	return points
+}
+
+fn main() {
+	trace_allocs_reset()
+	points := make_points(1000)
+	stats := trace_allocs_stats()
+	println('points: ${points.len}')
+	assert stats.count >= 1000
+	assert stats.bytes >= u64(1000 * sizeof(Point))
+	trace_allocs_write('-')
+}
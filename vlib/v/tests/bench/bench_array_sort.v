@@ -0,0 +1,81 @@
+// Compares the specialized sort, that V generates for `.sort()`, with `.sort_with_compare()`
+// (libc's qsort), and with `.sort_stable_with_compare()`, on ints, strings and structs.
+// Run with: `v -prod run vlib/v/tests/bench/bench_array_sort.v`
+import benchmark
+import rand
+
+const maxn = 1_000_000
+
+struct Point {
+	x int
+	y int
+	z f64
+}
+
+fn compare_ints(a &int, b &int) int {
+	return if *a < *b {
+		-1
+	} else if *a > *b {
+		1
+	} else {
+		0
+	}
+}
+
+fn compare_strings(a &string, b &string) int {
+	return a.compare(b)
+}
+
+fn compare_points(a &Point, b &Point) int {
+	return compare_ints(&a.x, &b.x)
+}
+
+fn main() {
+	rand.seed([u32(42), 0])
+	ints := []int{len: maxn, init: rand.int()}
+	texts := []string{len: maxn / 4, init: rand.string(12)}
+	points := []Point{len: maxn, init: Point{
+		x: rand.int()
+		y: index
+	}}
+	mut bmark := benchmark.start()
+
+	mut nums := ints.clone()
+	bmark.step_restart()
+	nums.sort()
+	bmark.measure('ints    .sort()')
+	nums = ints.clone()
+	bmark.step_restart()
+	nums.sort_with_compare(compare_ints)
+	bmark.measure('ints    .sort_with_compare()')
+	nums = ints.clone()
+	bmark.step_restart()
+	nums.sort_stable_with_compare(compare_ints)
+	bmark.measure('ints    .sort_stable_with_compare()')
+	nums.sort()
+	bmark.step_restart()
+	nums.sort()
+	bmark.measure('ints    .sort() of sorted')
+
+	mut words := texts.clone()
+	bmark.step_restart()
+	words.sort()
+	bmark.measure('strings .sort()')
+	words = texts.clone()
+	bmark.step_restart()
+	words.sort_with_compare(compare_strings)
+	bmark.measure('strings .sort_with_compare()')
+
+	mut pts := points.clone()
+	bmark.step_restart()
+	pts.sort(a.x < b.x)
+	bmark.measure('structs .sort(a.x < b.x)')
+	pts = points.clone()
+	bmark.step_restart()
+	pts.sort_with_compare(compare_points)
+	bmark.measure('structs .sort_with_compare()')
+	pts = points.clone()
+	bmark.step_restart()
+	pts.sort_stable_with_compare(compare_points)
+	bmark.measure('structs .sort_stable_with_compare()')
+}
@@ -0,0 +1,58 @@
+// Measures the string search methods of builtin, on a big text with rare matches,
+// and on one where the first and last bytes of the needle match almost everywhere.
+// Run with: `v -prod run vlib/v/tests/bench/bench_string_search.v`
+import benchmark
+
+const repeats = 200
+
+fn main() {
+	line := 'The quick brown fox jumps over the lazy dog, again and again.'
+	text := (line + '\n').repeat(20_000) + 'needle in the haystack'
+	worst := 'a'.repeat(1_000_000) + 'b'
+	mut sum := i64(0)
+	mut bmark := benchmark.start()
+	for _ in 0 .. repeats {
+		sum += text.index_u8(`k`)
+		sum += text.index_u8(`#`)
+	}
+	bmark.measure('index_u8')
+	for _ in 0 .. repeats {
+		sum += text.last_index_u8(`#`)
+	}
+	bmark.measure('last_index_u8')
+	for _ in 0 .. repeats {
+		sum += text.count('\n')
+	}
+	bmark.measure('count (1 byte)')
+	for _ in 0 .. repeats {
+		sum += text.count('again')
+	}
+	bmark.measure('count (5 bytes)')
+	for _ in 0 .. repeats {
+		if text.contains('needle') {
+			sum++
+		}
+		if text.contains('haystack!') {
+			sum++
+		}
+	}
+	bmark.measure('contains')
+	for _ in 0 .. repeats {
+		sum += text.index('aab') or { -1 }
+		sum += worst.index('aaaaaaaaab') or { -1 }
+	}
+	bmark.measure('index (many first byte matches)')
+	for _ in 0 .. repeats / 10 {
+		sum += text.split_into_lines().len
+	}
+	bmark.measure('split_into_lines')
+	for _ in 0 .. repeats / 10 {
+		sum += text.split(', ').len
+	}
+	bmark.measure('split')
+	for _ in 0 .. repeats / 10 {
+		sum += text.replace('fox', 'cat').len
+	}
+	bmark.measure('replace')
+	dump(sum)
+}
@@ -0,0 +1,812 @@
+module transformer
+
+import v.ast
+import v.token
+import v.util
+
+// Bounds check elimination (BCE) for array, fixed array and string indexes.
+// Each `a[i]` is normally compiled to `array_get(a, i)` (or `string_at`, `v_fixed_index`), that
+// panics when `i` is out of range. This pass proves some of the indexes safe, and marks their
+// `IndexExpr` with `is_direct`, so that cgen emits a raw `((T*)a.data)[i]` for them.
+
+// The analysis keeps a list of facts, that hold for the code being walked:
+//  * `i >= 0`, from `i >= 0` conditions, unsigned types and `for i in 0 .. n` / `for i := 0; ...; i++` loops
+//  * `i < a.len`, from `i < a.len` conditions, `for i in 0 .. a.len`, `for i, x in a` and `for i := a.len - 1; i >= 0; i--` loops
+//  * `a.len >= n`, from `a.len > 3` style conditions, used for constant indexes
+// Facts come from the conditions of `if`/`for` statements, and from early exits like `if i >= a.len { return }`,
+// that guard the rest of the block. Facts are only recorded for local variables, whose values can not change
+// after the check, i.e. that are never assigned, modified, or have their address taken in the function
+// (except by the increment of their own `for i := 0; ...; i++` loop, which happens after the body).
+// An array counts as unmodified even if it is appended to with `<<`, since that can only grow it.
+// Functions containing `goto`, `$for`, `asm` or ORM statements are not analysed.
+// `-show-bce` prints every index, whose bounds check was removed.
+
+struct BceFact {
+	name  string // `i`, or '' for `a.len >= val`
+	array string // `a`, or '' for `i >= 0`
+	val   int
+}
+
+struct Bce {
+	table     &ast.Table
+	file_path string
+	show      bool
+mut:
+	changed map[string]bool // the `mut` variables, that are modified somewhere in the fn
+	failed  bool
+	facts   []BceFact
+}
+
+// bounds_check_elimination marks the indexes in the fn `node`, that are proven to be in bounds.
+fn (mut t Transformer) bounds_check_elimination(mut node ast.FnDecl) {
+	if (!t.pref.is_prod && !t.pref.show_bce) || t.pref.no_bounds_checking
+		|| t.table == unsafe { nil } || node.no_body {
+		// with `-no-bounds-checking`, there are no bounds checks left to remove
+		return
+	}
+	mut b := Bce{
+		table:     t.table
+		file_path: t.file.path
+		show:      t.pref.show_bce
+	}
+	b.scan_stmts(node.stmts)
+	if b.failed {
+		return
+	}
+	b.stmts(mut node.stmts)
+}
+
+// report_bce prints the bounds checks removed by the transformer, for `-show-bce`
+fn report_bce(file_path string, node ast.IndexExpr, reason string) {
+	println('${util.path_styled_for_error_messages(file_path)}:${node.pos.line_nr + 1}:${node.pos.col + 1}: bounds check removed for `${node.left}[${node.index}]` (${reason})')
+}
+
+fn (b &Bce) has_fact(name string, array string, val int) bool {
+	for fact in b.facts {
+		if fact.name == name && fact.array == array && (name != '' || fact.val >= val) {
+			return true
+		}
+	}
+	return false
+}
+
+// is_stable returns true, when the value of the variable `node` can not change after it was checked
+fn (b &Bce) is_stable(node ast.Ident) bool {
+	if node.obj is ast.Var {
+		if node.obj.is_mut && (node.obj.is_arg || node.obj.is_auto_deref) {
+			// `mut a []int` parameters may be changed through other references
+			return false
+		}
+		return node.name !in b.changed
+	}
+	return false
+}
+
+// len_of returns `a` for `a.len`, when `a` is a stable array, fixed array or string variable
+fn (b &Bce) len_of(node ast.Expr) string {
+	if node is ast.SelectorExpr {
+		if node.field_name == 'len' && node.expr is ast.Ident && !node.expr_type.is_ptr() {
+			kind := b.table.final_sym(node.expr_type).kind
+			if kind == .array_fixed || (kind in [.array, .string] && b.is_stable(node.expr)) {
+				return node.expr.name
+			}
+		}
+	}
+	return ''
+}
+
+// len_bound returns `a` for `a.len` and `a.len - k`, where k >= 0, i.e. for expressions that are <= `a.len`
+fn (b &Bce) len_bound(node ast.Expr) string {
+	if node is ast.InfixExpr {
+		if node.op == .minus && int_literal(node.right) >= 0 {
+			return b.len_of(node.left)
+		}
+		return ''
+	}
+	return b.len_of(node)
+}
+
+// int_literal returns the value of a non negative integer literal, or -1
+fn int_literal(node ast.Expr) int {
+	if node is ast.IntegerLiteral {
+		if node.val.len > 0 && node.val[0].is_digit() && !node.val.starts_with('0x')
+			&& !node.val.starts_with('0o') && !node.val.starts_with('0b') {
+			return node.val.int()
+		}
+	}
+	return -1
+}
+
+// stable_ident returns the name of `node`, when it is a stable integer variable
+fn (b &Bce) stable_ident(node ast.Expr) string {
+	if node is ast.Ident {
+		if node.obj is ast.Var && node.obj.typ.is_int() && b.is_stable(node) {
+			return node.name
+		}
+	}
+	return ''
+}
+
+// cond_facts records the facts, that hold when `node` evaluates to `!negated`
+fn (mut b Bce) cond_facts(node ast.Expr, negated bool) {
+	match node {
+		ast.ParExpr {
+			b.cond_facts(node.expr, negated)
+		}
+		ast.PrefixExpr {
+			if node.op == .not {
+				b.cond_facts(node.right, !negated)
+			}
+		}
+		ast.InfixExpr {
+			if (node.op == .and && !negated) || (node.op == .logical_or && negated) {
+				b.cond_facts(node.left, negated)
+				b.cond_facts(node.right, negated)
+				return
+			}
+			op := if negated { negated_comparison(node.op) } else { node.op }
+			if op !in [.lt, .gt, .le, .ge, .eq, .ne] {
+				return
+			}
+			b.comparison_facts(node.left, op, node.right)
+			// `3 < a.len` is `a.len > 3`:
+			rop := match op {
+				.lt { token.Kind.gt }
+				.gt { token.Kind.lt }
+				.le { token.Kind.ge }
+				.ge { token.Kind.le }
+				else { op }
+			}
+			b.comparison_facts(node.right, rop, node.left)
+		}
+		else {}
+	}
+}
+
+// negated_comparison returns `>=` for `<`, `!=` for `==` etc
+fn negated_comparison(op token.Kind) token.Kind {
+	return match op {
+		.lt { .ge }
+		.ge { .lt }
+		.gt { .le }
+		.le { .gt }
+		.eq { .ne }
+		.ne { .eq }
+		else { .unknown }
+	}
+}
+
+// comparison_facts records the facts, that follow from `left op right` being true
+fn (mut b Bce) comparison_facts(left ast.Expr, op token.Kind, right ast.Expr) {
+	name := b.stable_ident(left)
+	if name != '' {
+		if op == .lt {
+			array := b.len_bound(right)
+			if array != '' {
+				b.facts << BceFact{
+					name:  name
+					array: array
+				}
+			}
+		} else if op in [.gt, .ge] && int_literal(right) >= 0 {
+			b.facts << BceFact{
+				name: name
+			}
+		}
+		return
+	}
+	array := b.len_of(left)
+	val := int_literal(right)
+	if array != '' && val >= 0 {
+		min_len := match op {
+			.gt { val + 1 }
+			.ge, .eq { val }
+			.ne { if val == 0 { 1 } else { -1 } }
+			else { -1 }
+		}
+		if min_len > 0 {
+			b.facts << BceFact{
+				array: array
+				val:   min_len
+			}
+		}
+	}
+}
+
+// for_c_loop_var returns `i` and the direction of the loop, for `for i := x; cond; i++ {` and
+// `for i := x; cond; i -= 2 {` style loops, or '' for other loops
+fn for_c_loop_var(node ast.ForCStmt) (string, int) {
+	if node.is_multi || !node.has_init || !node.has_inc {
+		return '', 0
+	}
+	init := node.init
+	if init !is ast.AssignStmt {
+		return '', 0
+	}
+	decl := init as ast.AssignStmt
+	if decl.op != .decl_assign || decl.left.len != 1 || decl.left[0] !is ast.Ident {
+		return '', 0
+	}
+	name := (decl.left[0] as ast.Ident).name
+	inc := node.inc
+	if inc is ast.ExprStmt {
+		expr := inc.expr
+		if expr is ast.PostfixExpr {
+			var := expr.expr
+			if var is ast.Ident && var.name == name {
+				if expr.op == .inc {
+					return name, 1
+				} else if expr.op == .dec {
+					return name, -1
+				}
+			}
+		}
+	} else if inc is ast.AssignStmt {
+		if inc.left.len == 1 && inc.right.len == 1 && int_literal(inc.right[0]) >= 1 {
+			var := inc.left[0]
+			if var is ast.Ident && var.name == name {
+				if inc.op == .plus_assign {
+					return name, 1
+				} else if inc.op == .minus_assign {
+					return name, -1
+				}
+			}
+		}
+	}
+	return '', 0
+}
+
+// is_noreturn_block returns true for `{ ... return }`, `{ ... continue }`, `{ ... panic(err) }` etc
+fn is_noreturn_block(stmts []ast.Stmt) bool {
+	if stmts.len == 0 {
+		return false
+	}
+	last := stmts.last()
+	match last {
+		ast.Return, ast.BranchStmt {
+			return true
+		}
+		ast.ExprStmt {
+			if last.expr is ast.CallExpr {
+				return last.expr.is_noreturn
+			}
+		}
+		else {}
+	}
+	return false
+}
+
+// The first pass collects the `mut` variables, that are modified in the fn, by assignments, `++`, `&x`,
+// `mut x` arguments, methods with a `mut` receiver, closures etc.
+
+fn (mut b Bce) change(node ast.Expr) {
+	name := root_name(node)
+	if name != '' {
+		b.changed[name] = true
+	}
+}
+
+fn (mut b Bce) scan_stmts(stmts []ast.Stmt) {
+	for stmt in stmts {
+		if b.failed {
+			return
+		}
+		b.scan_stmt(stmt)
+	}
+}
+
+fn (mut b Bce) scan_stmt(node ast.Stmt) {
+	match node {
+		ast.AssertStmt {
+			b.scan_expr(node.expr)
+			b.scan_expr(node.extra)
+		}
+		ast.AssignStmt {
+			for left in node.left {
+				if node.op != .decl_assign && left !is ast.IndexExpr {
+					// `x = y`, `x += 2`, `unsafe { a.len = 0 }`; `a[i] = x` does not change `a.len`
+					b.change(left)
+				}
+				b.scan_expr(left)
+			}
+			for right in node.right {
+				b.scan_expr(right)
+			}
+		}
+		ast.Block {
+			b.scan_stmts(node.stmts)
+		}
+		ast.BranchStmt, ast.DebuggerStmt, ast.EmptyStmt, ast.SemicolonStmt {}
+		ast.DeferStmt {
+			b.scan_stmts(node.stmts)
+		}
+		ast.ExprStmt {
+			b.scan_expr(node.expr)
+		}
+		ast.ForCStmt {
+			if node.has_init {
+				b.scan_stmt(node.init)
+			}
+			b.scan_expr(node.cond)
+			name, _ := for_c_loop_var(node)
+			if name == '' && node.has_inc {
+				b.scan_stmt(node.inc)
+			}
+			b.scan_stmts(node.stmts)
+		}
+		ast.ForInStmt {
+			b.scan_expr(node.cond)
+			b.scan_expr(node.high)
+			b.scan_stmts(node.stmts)
+		}
+		ast.ForStmt {
+			b.scan_expr(node.cond)
+			b.scan_stmts(node.stmts)
+		}
+		ast.Return {
+			for expr in node.exprs {
+				b.scan_expr(expr)
+			}
+		}
+		else {
+			// `goto` breaks the assumption that conditions dominate the code after them;
+			// `$for`, `asm` and ORM statements are not analysed
+			b.failed = true
+		}
+	}
+}
+
+fn (mut b Bce) scan_exprs(exprs []ast.Expr) {
+	for expr in exprs {
+		b.scan_expr(expr)
+	}
+}
+
+fn (mut b Bce) scan_expr(node ast.Expr) {
+	if b.failed {
+		return
+	}
+	match node {
+		ast.AnonFn {
+			for var in node.inherited_vars {
+				b.changed[var.name] = true
+			}
+		}
+		ast.ArrayDecompose, ast.AsCast, ast.DumpExpr, ast.Likely, ast.ParExpr, ast.UnsafeExpr {
+			b.scan_expr(node.expr)
+		}
+		ast.ArrayInit {
+			b.scan_exprs(node.exprs)
+			b.scan_expr(node.len_expr)
+			b.scan_expr(node.cap_expr)
+			b.scan_expr(node.init_expr)
+		}
+		ast.AtExpr, ast.BoolLiteral, ast.CharLiteral, ast.Comment, ast.EmptyExpr, ast.EnumVal,
+		ast.FloatLiteral, ast.IntegerLiteral, ast.IsRefType, ast.Nil, ast.None, ast.OffsetOf, ast.SizeOf,
+		ast.StringLiteral, ast.TypeNode, ast.TypeOf {}
+		ast.CallExpr {
+			b.scan_call_expr(node)
+		}
+		ast.CastExpr {
+			b.scan_expr(node.expr)
+			b.scan_expr(node.arg)
+		}
+		ast.ChanInit {
+			b.scan_expr(node.cap_expr)
+		}
+		ast.ConcatExpr {
+			b.scan_exprs(node.vals)
+		}
+		ast.GoExpr {
+			b.scan_call_expr(node.call_expr)
+		}
+		ast.Ident {}
+		ast.IfExpr {
+			for branch in node.branches {
+				b.scan_expr(branch.cond)
+				b.scan_stmts(branch.stmts)
+			}
+		}
+		ast.IfGuardExpr {
+			b.scan_expr(node.expr)
+		}
+		ast.IndexExpr {
+			b.scan_expr(node.left)
+			b.scan_expr(node.index)
+			b.scan_stmts(node.or_expr.stmts)
+		}
+		ast.InfixExpr {
+			b.scan_expr(node.left)
+			b.scan_expr(node.right)
+			b.scan_stmts(node.or_block.stmts)
+		}
+		ast.LambdaExpr {
+			if node.func != unsafe { nil } {
+				for var in node.func.inherited_vars {
+					b.changed[var.name] = true
+				}
+			}
+			b.scan_expr(node.expr)
+		}
+		ast.LockExpr {
+			for locked in node.lockeds {
+				b.change(locked)
+			}
+			b.scan_stmts(node.stmts)
+		}
+		ast.MapInit {
+			b.scan_exprs(node.keys)
+			b.scan_exprs(node.vals)
+			b.scan_expr(node.update_expr)
+		}
+		ast.MatchExpr {
+			b.scan_expr(node.cond)
+			for branch in node.branches {
+				b.scan_exprs(branch.exprs)
+				b.scan_stmts(branch.stmts)
+			}
+		}
+		ast.OrExpr {
+			b.scan_stmts(node.stmts)
+		}
+		ast.PostfixExpr {
+			if node.op in [.inc, .dec] {
+				b.change(node.expr)
+			}
+			b.scan_expr(node.expr)
+		}
+		ast.PrefixExpr {
+			if node.op == .amp {
+				b.change(node.right)
+			}
+			b.scan_expr(node.right)
+			b.scan_stmts(node.or_block.stmts)
+		}
+		ast.RangeExpr {
+			b.scan_expr(node.low)
+			b.scan_expr(node.high)
+		}
+		ast.SelectExpr {
+			for branch in node.branches {
+				b.scan_stmt(branch.stmt)
+				b.scan_stmts(branch.stmts)
+			}
+		}
+		ast.SelectorExpr {
+			b.scan_expr(node.expr)
+		}
+		ast.SpawnExpr {
+			b.scan_call_expr(node.call_expr)
+		}
+		ast.StringInterLiteral {
+			b.scan_exprs(node.exprs)
+		}
+		ast.StructInit {
+			b.scan_expr(node.update_expr)
+			for field in node.init_fields {
+				b.scan_expr(field.expr)
+			}
+		}
+		else {
+			b.failed = true
+		}
+	}
+}
+
+fn (mut b Bce) scan_call_expr(node ast.CallExpr) {
+	if node.is_method && !node.is_field && (node.receiver_type == 0 || node.receiver_type.is_ptr()) {
+		// `a.delete(0)`, `a.clear()` etc
+		b.change(node.left)
+	}
+	b.scan_expr(node.left)
+	for arg in node.args {
+		if arg.is_mut || arg.should_be_ptr {
+			b.change(arg.expr)
+		}
+		b.scan_expr(arg.expr)
+	}
+	b.scan_stmts(node.or_block.stmts)
+}
+
+// The second pass walks the fn, collecting the facts from the conditions, and marking the safe indexes.
+
+fn (mut b Bce) stmts(mut stmts []ast.Stmt) {
+	start := b.facts.len
+	for mut stmt in stmts {
+		b.stmt(mut stmt)
+		b.guard_facts(stmt)
+	}
+	b.facts.trim(start)
+}
+
+// guard_facts handles `if i >= a.len { return }`: the rest of the block runs only when the condition was false
+fn (mut b Bce) guard_facts(node ast.Stmt) {
+	if node is ast.ExprStmt {
+		expr := node.expr
+		if expr is ast.IfExpr {
+			if !expr.is_comptime && expr.branches.len == 1
+				&& is_noreturn_block(expr.branches[0].stmts) {
+				b.cond_facts(expr.branches[0].cond, true)
+			}
+		}
+	}
+}
+
+fn (mut b Bce) stmt(mut node ast.Stmt) {
+	match mut node {
+		ast.AssertStmt {
+			b.expr(mut node.expr)
+			b.expr(mut node.extra)
+		}
+		ast.AssignStmt {
+			for mut right in node.right {
+				b.expr(mut right)
+			}
+			for mut left in node.left {
+				b.expr(mut left)
+			}
+		}
+		ast.Block {
+			b.stmts(mut node.stmts)
+		}
+		ast.DeferStmt {
+			// deferred statements run at the end of the fn, outside of the current conditions
+			saved_facts := b.facts
+			b.facts = []BceFact{}
+			b.stmts(mut node.stmts)
+			b.facts = saved_facts
+		}
+		ast.ExprStmt {
+			b.expr(mut node.expr)
+		}
+		ast.ForCStmt {
+			if node.has_init {
+				b.stmt(mut node.init)
+			}
+			b.expr(mut node.cond)
+			start := b.facts.len
+			name, direction := for_c_loop_var(node)
+			if name != '' && name !in b.changed {
+				decl := node.init as ast.AssignStmt
+				init := decl.right[0]
+				if direction > 0 && int_literal(init) >= 0 {
+					b.facts << BceFact{
+						name: name
+					}
+				} else if direction < 0 && init is ast.InfixExpr && init.op == .minus
+					&& int_literal(init.right) >= 1 {
+					array := b.len_of(init.left)
+					if array != '' {
+						b.facts << BceFact{
+							name:  name
+							array: array
+						}
+					}
+				}
+			}
+			if node.has_cond {
+				b.cond_facts(node.cond, false)
+			}
+			b.stmts(mut node.stmts)
+			b.facts.trim(start)
+			if node.has_inc {
+				b.stmt(mut node.inc)
+			}
+		}
+		ast.ForInStmt {
+			b.expr(mut node.cond)
+			b.expr(mut node.high)
+			start := b.facts.len
+			if node.is_range && node.val_var != '_' {
+				// `for i in 0 .. a.len {`
+				if int_literal(node.cond) >= 0 {
+					b.facts << BceFact{
+						name: node.val_var
+					}
+				}
+				array := b.len_bound(node.high)
+				if array != '' {
+					b.facts << BceFact{
+						name:  node.val_var
+						array: array
+					}
+				}
+			} else if !node.is_range && node.key_var !in ['', '_']
+				&& node.kind in [.array, .array_fixed, .string] && !node.cond_type.is_ptr() {
+				// `for i, x in a {`
+				cond := node.cond
+				if cond is ast.Ident {
+					if node.kind == .array_fixed || b.is_stable(cond) {
+						b.facts << BceFact{
+							name: node.key_var
+						}
+						b.facts << BceFact{
+							name:  node.key_var
+							array: cond.name
+						}
+					}
+				}
+			}
+			b.stmts(mut node.stmts)
+			b.facts.trim(start)
+		}
+		ast.ForStmt {
+			b.expr(mut node.cond)
+			start := b.facts.len
+			if !node.is_inf {
+				b.cond_facts(node.cond, false)
+			}
+			b.stmts(mut node.stmts)
+			b.facts.trim(start)
+		}
+		ast.Return {
+			for mut expr in node.exprs {
+				b.expr(mut expr)
+			}
+		}
+		else {}
+	}
+}
+
+fn (mut b Bce) exprs(mut exprs []ast.Expr) {
+	for mut expr in exprs {
+		b.expr(mut expr)
+	}
+}
+
+fn (mut b Bce) expr(mut node ast.Expr) {
+	match mut node {
+		ast.ArrayInit {
+			b.exprs(mut node.exprs)
+			b.expr(mut node.len_expr)
+			b.expr(mut node.cap_expr)
+			b.expr(mut node.init_expr)
+		}
+		ast.AsCast {
+			b.expr(mut node.expr)
+		}
+		ast.CallExpr {
+			b.expr(mut node.left)
+			for mut arg in node.args {
+				b.expr(mut arg.expr)
+			}
+			b.stmts(mut node.or_block.stmts)
+		}
+		ast.CastExpr {
+			b.expr(mut node.expr)
+			b.expr(mut node.arg)
+		}
+		ast.DumpExpr {
+			b.expr(mut node.expr)
+		}
+		ast.IfExpr {
+			start := b.facts.len
+			for mut branch in node.branches {
+				b.expr(mut branch.cond)
+				branch_start := b.facts.len
+				if !node.is_comptime {
+					b.cond_facts(branch.cond, false)
+				}
+				b.stmts(mut branch.stmts)
+				b.facts.trim(branch_start)
+				// the next branches are reached only when this condition was false
+				if !node.is_comptime {
+					b.cond_facts(branch.cond, true)
+				}
+			}
+			b.facts.trim(start)
+		}
+		ast.IfGuardExpr {
+			b.expr(mut node.expr)
+		}
+		ast.IndexExpr {
+			b.expr(mut node.left)
+			b.expr(mut node.index)
+			b.stmts(mut node.or_expr.stmts)
+			b.index_expr(mut node)
+		}
+		ast.InfixExpr {
+			b.expr(mut node.left)
+			start := b.facts.len
+			// `i < a.len && a[i] == 0` and `i >= a.len || a[i] == 0`
+			if node.op == .and {
+				b.cond_facts(node.left, false)
+			} else if node.op == .logical_or {
+				b.cond_facts(node.left, true)
+			}
+			b.expr(mut node.right)
+			b.facts.trim(start)
+			b.stmts(mut node.or_block.stmts)
+		}
+		ast.Likely {
+			b.expr(mut node.expr)
+		}
+		ast.LockExpr {
+			b.stmts(mut node.stmts)
+		}
+		ast.MapInit {
+			b.exprs(mut node.keys)
+			b.exprs(mut node.vals)
+		}
+		ast.MatchExpr {
+			b.expr(mut node.cond)
+			for mut branch in node.branches {
+				b.stmts(mut branch.stmts)
+			}
+		}
+		ast.OrExpr {
+			b.stmts(mut node.stmts)
+		}
+		ast.ParExpr {
+			b.expr(mut node.expr)
+		}
+		ast.PostfixExpr {
+			b.expr(mut node.expr)
+		}
+		ast.PrefixExpr {
+			b.expr(mut node.right)
+			b.stmts(mut node.or_block.stmts)
+		}
+		ast.RangeExpr {
+			b.expr(mut node.low)
+			b.expr(mut node.high)
+		}
+		ast.SelectorExpr {
+			b.expr(mut node.expr)
+		}
+		ast.StringInterLiteral {
+			b.exprs(mut node.exprs)
+		}
+		ast.StructInit {
+			for mut field in node.init_fields {
+				b.expr(mut field.expr)
+			}
+		}
+		ast.UnsafeExpr {
+			b.expr(mut node.expr)
+		}
+		else {
+			// closures are analysed separately, as their own fns;
+			// the remaining expressions do not contain indexes, that can be optimised
+		}
+	}
+}
+
+fn (mut b Bce) index_expr(mut node ast.IndexExpr) {
+	if node.is_direct || node.is_gated || node.is_option || node.or_expr.kind != .absent
+		|| node.left_type.is_ptr() || node.left_type.has_flag(.shared_f) {
+		return
+	}
+	left := node.left
+	if left !is ast.Ident {
+		return
+	}
+	array := (left as ast.Ident).name
+	kind := b.table.final_sym(node.left_type).kind
+	if kind !in [.array, .array_fixed, .string] {
+		return
+	}
+	mut reason := ''
+	index := node.index
+	if index is ast.Ident {
+		name := b.stable_ident(index)
+		if name != '' && b.has_fact(name, array, 0) {
+			if (index.obj as ast.Var).typ.is_unsigned() || b.has_fact(name, '', 0) {
+				reason = '0 <= ${name} < ${array}.len'
+			}
+		}
+	} else if index is ast.IntegerLiteral && kind != .array_fixed {
+		// constant indexes of fixed arrays are checked at compile time
+		val := int_literal(index)
+		if val >= 0 && b.has_fact('', array, val + 1) {
+			reason = '${array}.len > ${val}'
+		}
+	}
+	if reason == '' {
+		return
+	}
+	node.is_direct = true
+	if b.show {
+		report_bce(b.file_path, node, reason)
+	}
+}
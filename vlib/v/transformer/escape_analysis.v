@@ -0,0 +1,435 @@
+module transformer
+
+import v.ast
+
+// Escape analysis for `x := &Foo{...}` declarations.
+// By default, cgen places every `&Foo{...}` value on the heap (with `memdup`), even when the pointer
+// never leaves the function that created it. For the declarations found here, the pointer is only
+// ever used to read and write fields (`x.a`, `x.a.b = 1`, `x.arr[i]`), so the struct can live in the
+// stack frame instead: the `StructInit` is marked with `is_stack_alloc` and cgen emits a compound
+// literal `&(Foo){...}` in place of the heap allocation.
+
+// The analysis is intraprocedural and deliberately conservative, a variable escapes when:
+//  * it is used directly, i.e. not as the root of a field access (assigned, returned, passed as an argument, compared etc)
+//  * the address of any part of it is taken (`&x.a`), or a part of it is passed as a `mut` argument
+//  * a method with a reference receiver is called on it, or on any of its fields
+//  * a fixed array field is sliced or used as a whole, or a method value `x.method` is created
+//  * it is captured by a closure, used in a lambda, in a `defer` block, or in `spawn`/`go`
+// Variables are tracked by name, so an escape of any variable with the same name, disables the
+// optimisation for all of them in the function. Functions using nodes that are not understood by the
+// walker below (`goto`, `$for`, `asm`, ORM, templates ...), are not optimised at all.
+
+// stack_alloc_max_size is the largest struct (in bytes), that will be placed on the stack
+const stack_alloc_max_size = 1024
+
+@[if trace_escape_analysis ?]
+fn trace_escape_analysis(str string) {
+	eprintln(str)
+}
+
+struct EscapeAnalysis {
+	table &ast.Table
+mut:
+	candidates map[string]bool // names of the variables declared with `:= &Foo{...}`
+	escaped    map[string]bool // names of the variables, that are used in a way that may let them escape
+	escape_all bool // inside `defer`, `spawn` and lambdas, every use of a variable is an escape
+	failed     bool // the function contains nodes, that the analysis does not handle
+}
+
+// escape_analysis returns the names of the variables in the function `node`, whose `&Foo{...}`
+// initialisation can be done on the stack.
+fn (mut t Transformer) escape_analysis(node &ast.FnDecl) map[string]bool {
+	if !t.pref.is_prod || t.table == unsafe { nil } || node.no_body || node.generic_names.len > 0 {
+		return map[string]bool{}
+	}
+	mut e := EscapeAnalysis{
+		table: t.table
+	}
+	e.stmts(node.stmts)
+	if e.failed || e.candidates.len == 0 {
+		return map[string]bool{}
+	}
+	mut res := map[string]bool{}
+	for name, _ in e.candidates {
+		if name in e.escaped {
+			trace_escape_analysis('escape analysis: ${node.name}: `${name}` escapes')
+			continue
+		}
+		trace_escape_analysis('escape analysis: ${node.name}: `${name}` is allocated on the stack')
+		res[name] = true
+	}
+	return res
+}
+
+// mark_stack_alloc sets `is_stack_alloc` on the `&Foo{...}` of the declaration `node`,
+// when the escape analysis of the current function found that it does not escape.
+fn (mut t Transformer) mark_stack_alloc(mut node ast.AssignStmt) {
+	name := stack_alloc_candidate(t.table, node)
+	if name == '' || name !in t.stack_allocs {
+		return
+	}
+	mut right := node.right[0]
+	if mut right is ast.PrefixExpr {
+		if mut right.right is ast.StructInit {
+			right.right.is_stack_alloc = true
+		}
+	}
+}
+
+// stack_alloc_candidate returns the name of the declared variable, for `x := &Foo{...}`,
+// where `Foo` is a small plain V struct, or '' for any other statement.
+fn stack_alloc_candidate(table &ast.Table, node ast.AssignStmt) string {
+	if node.op != .decl_assign || node.left.len != 1 || node.right.len != 1 {
+		return ''
+	}
+	left := node.left[0]
+	right := node.right[0]
+	if left !is ast.Ident || right !is ast.PrefixExpr {
+		return ''
+	}
+	name := (left as ast.Ident).name
+	prefix := right as ast.PrefixExpr
+	if name == '_' || prefix.op != .amp || prefix.right !is ast.StructInit {
+		return ''
+	}
+	init := prefix.right as ast.StructInit
+	typ := init.typ
+	if typ == 0 || typ.is_ptr() || typ.has_flag(.option) || typ.has_flag(.result)
+		|| typ.has_flag(.shared_f) || typ.has_flag(.atomic_f) || typ.has_flag(.generic) {
+		return ''
+	}
+	sym := table.final_sym(typ)
+	if sym.kind != .struct_ || sym.language != .v || sym.is_heap() {
+		return ''
+	}
+	if sym.info is ast.Struct {
+		if sym.info.is_generic || sym.info.generic_types.len > 0 {
+			return ''
+		}
+	}
+	size, _ := table.type_size(typ)
+	if size <= 0 || size > stack_alloc_max_size {
+		return ''
+	}
+	return name
+}
+
+fn (mut e EscapeAnalysis) escape(name string) {
+	if name != '' {
+		e.escaped[name] = true
+	}
+}
+
+// root_name returns `x` for `x`, `x.a.b`, `x.a[i]` and `(*x).a`, or '' when the expression is not rooted at a variable
+fn root_name(node ast.Expr) string {
+	return match node {
+		ast.Ident { node.name }
+		ast.SelectorExpr { root_name(node.expr) }
+		ast.IndexExpr { root_name(node.left) }
+		ast.ParExpr { root_name(node.expr) }
+		ast.PrefixExpr { if node.op == .mul { root_name(node.right) } else { '' } }
+		else { '' }
+	}
+}
+
+fn (mut e EscapeAnalysis) stmts(stmts []ast.Stmt) {
+	for stmt in stmts {
+		if e.failed {
+			return
+		}
+		e.stmt(stmt)
+	}
+}
+
+fn (mut e EscapeAnalysis) stmt(node ast.Stmt) {
+	match node {
+		ast.AssertStmt {
+			e.expr(node.expr)
+			e.expr(node.extra)
+		}
+		ast.AssignStmt {
+			if stack_alloc_candidate(e.table, node) != '' {
+				e.candidates[(node.left[0] as ast.Ident).name] = true
+				e.expr(node.right[0])
+				return
+			}
+			for left in node.left {
+				if node.op == .decl_assign && left is ast.Ident {
+					// a new variable, not a use of an existing one
+					continue
+				}
+				e.expr(left)
+			}
+			for right in node.right {
+				e.expr(right)
+			}
+		}
+		ast.Block {
+			e.stmts(node.stmts)
+		}
+		ast.BranchStmt, ast.DebuggerStmt, ast.EmptyStmt, ast.SemicolonStmt {}
+		ast.DeferStmt {
+			old_escape_all := e.escape_all
+			e.escape_all = true
+			e.stmts(node.stmts)
+			e.escape_all = old_escape_all
+		}
+		ast.ExprStmt {
+			e.expr(node.expr)
+		}
+		ast.ForCStmt {
+			if node.has_init {
+				e.stmt(node.init)
+			}
+			e.expr(node.cond)
+			if node.has_inc {
+				e.stmt(node.inc)
+			}
+			e.stmts(node.stmts)
+		}
+		ast.ForInStmt {
+			if node.val_is_mut {
+				e.escape(root_name(node.cond))
+			}
+			e.expr(node.cond)
+			e.expr(node.high)
+			e.stmts(node.stmts)
+		}
+		ast.ForStmt {
+			e.expr(node.cond)
+			e.stmts(node.stmts)
+		}
+		ast.Return {
+			for expr in node.exprs {
+				e.expr(expr)
+			}
+		}
+		else {
+			// `goto`, `$for`, `asm`, ORM statements, nested declarations etc
+			e.failed = true
+		}
+	}
+}
+
+fn (mut e EscapeAnalysis) exprs(exprs []ast.Expr) {
+	for expr in exprs {
+		e.expr(expr)
+	}
+}
+
+fn (mut e EscapeAnalysis) expr(node ast.Expr) {
+	if e.failed {
+		return
+	}
+	match node {
+		ast.AnonFn {
+			// the body is analysed separately, when the transformer reaches its FnDecl
+			for var in node.inherited_vars {
+				e.escape(var.name)
+			}
+		}
+		ast.ArrayDecompose {
+			e.expr(node.expr)
+		}
+		ast.ArrayInit {
+			e.exprs(node.exprs)
+			e.expr(node.len_expr)
+			e.expr(node.cap_expr)
+			e.expr(node.init_expr)
+		}
+		ast.AsCast {
+			e.expr(node.expr)
+		}
+		ast.AtExpr, ast.BoolLiteral, ast.CharLiteral, ast.Comment, ast.EmptyExpr, ast.EnumVal,
+		ast.FloatLiteral, ast.IntegerLiteral, ast.Nil, ast.None, ast.StringLiteral, ast.TypeNode {}
+		ast.CallExpr {
+			e.call_expr(node)
+		}
+		ast.CastExpr {
+			e.expr(node.expr)
+			e.expr(node.arg)
+		}
+		ast.ChanInit {
+			e.expr(node.cap_expr)
+		}
+		ast.ConcatExpr {
+			e.exprs(node.vals)
+		}
+		ast.DumpExpr {
+			e.expr(node.expr)
+		}
+		ast.GoExpr {
+			old_escape_all := e.escape_all
+			e.escape_all = true
+			e.call_expr(node.call_expr)
+			e.escape_all = old_escape_all
+		}
+		ast.Ident {
+			e.escape(node.name)
+		}
+		ast.IfExpr {
+			for branch in node.branches {
+				e.expr(branch.cond)
+				e.stmts(branch.stmts)
+			}
+		}
+		ast.IfGuardExpr {
+			e.expr(node.expr)
+		}
+		ast.IndexExpr {
+			if node.index is ast.RangeExpr {
+				// slicing a fixed array field, gives an array that points inside the struct
+				e.escape(root_name(node.left))
+			}
+			e.base_expr(node.left)
+			e.expr(node.index)
+			e.expr(ast.Expr(node.or_expr))
+		}
+		ast.InfixExpr {
+			e.expr(node.left)
+			e.expr(node.right)
+			e.expr(ast.Expr(node.or_block))
+		}
+		ast.IsRefType, ast.OffsetOf, ast.SizeOf, ast.TypeOf {
+			// only the type of the expression is used
+		}
+		ast.LambdaExpr {
+			if node.func != unsafe { nil } {
+				for var in node.func.inherited_vars {
+					e.escape(var.name)
+				}
+			}
+			old_escape_all := e.escape_all
+			e.escape_all = true
+			e.expr(node.expr)
+			e.escape_all = old_escape_all
+		}
+		ast.Likely {
+			e.expr(node.expr)
+		}
+		ast.LockExpr {
+			for locked in node.lockeds {
+				e.escape(root_name(locked))
+				e.expr(locked)
+			}
+			e.stmts(node.stmts)
+		}
+		ast.MapInit {
+			e.exprs(node.keys)
+			e.exprs(node.vals)
+			e.expr(node.update_expr)
+		}
+		ast.MatchExpr {
+			e.expr(node.cond)
+			for branch in node.branches {
+				e.exprs(branch.exprs)
+				e.stmts(branch.stmts)
+			}
+		}
+		ast.OrExpr {
+			e.stmts(node.stmts)
+		}
+		ast.ParExpr {
+			e.expr(node.expr)
+		}
+		ast.PostfixExpr {
+			e.expr(node.expr)
+		}
+		ast.PrefixExpr {
+			if node.op == .amp {
+				e.escape(root_name(node.right))
+			}
+			if node.op == .mul && node.right is ast.Ident && !e.escape_all {
+				// `*x` copies the whole struct
+			} else {
+				e.expr(node.right)
+			}
+			e.expr(ast.Expr(node.or_block))
+		}
+		ast.RangeExpr {
+			e.expr(node.low)
+			e.expr(node.high)
+		}
+		ast.SelectExpr {
+			for branch in node.branches {
+				e.stmt(branch.stmt)
+				e.stmts(branch.stmts)
+			}
+		}
+		ast.SelectorExpr {
+			e.selector(node, false)
+		}
+		ast.SpawnExpr {
+			old_escape_all := e.escape_all
+			e.escape_all = true
+			e.call_expr(node.call_expr)
+			e.escape_all = old_escape_all
+		}
+		ast.StringInterLiteral {
+			e.exprs(node.exprs)
+		}
+		ast.StructInit {
+			e.expr(node.update_expr)
+			for field in node.init_fields {
+				e.expr(field.expr)
+			}
+		}
+		ast.UnsafeExpr {
+			e.expr(node.expr)
+		}
+		else {
+			// `$tmpl`, `$embed_file`, comptime selectors, ORM queries etc
+			e.failed = true
+		}
+	}
+}
+
+// base_expr handles the left side of a field access or of an index, i.e. `x.a` in `x.a.b` or `x.a[i]`
+fn (mut e EscapeAnalysis) base_expr(node ast.Expr) {
+	match node {
+		ast.Ident {
+			if e.escape_all {
+				e.escape(node.name)
+			}
+		}
+		ast.SelectorExpr {
+			e.selector(node, true)
+		}
+		else {
+			e.expr(node)
+		}
+	}
+}
+
+fn (mut e EscapeAnalysis) selector(node ast.SelectorExpr, is_base bool) {
+	if e.escape_all {
+		e.escape(root_name(node.expr))
+	} else if !is_base {
+		// a fixed array field used as a whole may decay to a pointer in C,
+		// and a method value `x.method` keeps its receiver
+		kind := e.table.final_sym(node.typ).kind
+		if kind in [.array_fixed, .function] {
+			e.escape(root_name(node.expr))
+		}
+	}
+	e.base_expr(node.expr)
+}
+
+fn (mut e EscapeAnalysis) call_expr(node ast.CallExpr) {
+	if node.is_method {
+		if !node.is_field && (node.receiver_type == 0 || node.receiver_type.is_ptr()) {
+			// the method gets a reference to the receiver, that it may keep
+			e.escape(root_name(node.left))
+		}
+		e.base_expr(node.left)
+	} else {
+		e.expr(node.left)
+	}
+	for arg in node.args {
+		if arg.is_mut || arg.should_be_ptr {
+			e.escape(root_name(arg.expr))
+		}
+		e.expr(arg.expr)
+	}
+	e.expr(ast.Expr(node.or_block))
+}
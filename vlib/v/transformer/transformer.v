@@ -11,8 +11,9 @@ pub mut:
 	table &ast.Table = unsafe { nil }
 	file  &ast.File  = unsafe { nil }
 mut:
-	is_assert   bool
-	inside_dump bool
+	is_assert    bool
+	inside_dump  bool
+	stack_allocs map[string]bool // the `x := &Foo{}` variables of the current fn, that do not escape
 }
 
 fn (mut t Transformer) trace[T](fbase string, x &T) {
@@ -135,6 +136,9 @@ pub fn (mut t Transformer) check_safe_array(mut node ast.IndexExpr) {
 		ast.IntegerLiteral {
 			is_direct := t.index.safe_access(name.str(), index.val.int())
 			node.is_direct = is_direct
+			if is_direct && t.pref.show_bce {
+				report_bce(t.file.path, node, '${name}.len > ${index.val}')
+			}
 		}
 		ast.RangeExpr {
 			if index.has_high {
@@ -187,6 +191,9 @@ pub fn (mut t Transformer) stmt(mut node ast.Stmt) ast.Stmt {
 			return t.assert_stmt(mut node)
 		}
 		ast.AssignStmt {
+			if t.stack_allocs.len > 0 {
+				t.mark_stack_alloc(mut node)
+			}
 			t.find_new_array_len(node)
 			t.find_new_range(node)
 			t.find_mut_self_assign(node)
@@ -249,11 +256,15 @@ pub fn (mut t Transformer) stmt(mut node ast.Stmt) ast.Stmt {
 			if t.pref.trace_calls {
 				t.fn_decl_trace_calls(mut node)
 			}
+			old_stack_allocs := t.stack_allocs
+			t.stack_allocs = t.escape_analysis(node)
 			t.index.indent(true)
 			for mut stmt in node.stmts {
 				stmt = t.stmt(mut stmt)
 			}
 			t.index.unindent()
+			t.stack_allocs = old_stack_allocs
+			t.bounds_check_elimination(mut node)
 		}
 		ast.ForCStmt {
 			return t.for_c_stmt(mut node)
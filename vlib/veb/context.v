@@ -37,6 +37,8 @@ mut:
 	return_file string
 	// If the `Connection: close` header is present the connection should always be closed
 	client_wants_to_close bool
+	// the request came over HTTP/2, so `conn` is shared by its streams and must not be written to
+	is_h2 bool
 pub:
 	// TODO: move this to `handle_request`
 	// time.ticks() from start of veb connection handle.
@@ -116,7 +118,7 @@ pub fn (mut ctx Context) send_response_to_client(mimetype string, response strin
 		ctx.res.set_status(.ok)
 	}
 
-	if ctx.takeover {
+	if ctx.takeover && !ctx.is_h2 {
 		fast_send_resp(mut ctx.conn, ctx.res) or {}
 	}
 	// result is send in `veb.v`, `handle_route`
@@ -281,10 +283,20 @@ pub fn (mut ctx Context) set_content_type(mime string) {
 // send over the connection and you can send multiple responses.
 // This function is useful when you want to keep the connection alive and/or
 // send multiple responses. Like with the SSE.
+// Over HTTP/2 the connection is shared by the streams, so it cannot be taken over:
+// the request is then answered with `505 HTTP Version Not Supported`.
 pub fn (mut ctx Context) takeover_conn() {
+	if ctx.is_h2 {
+		eprintln('[veb] error: the route of "${ctx.req.url}" takes over the connection, which needs HTTP/1.x')
+	}
 	ctx.takeover = true
 }
 
+// is_http2 returns true, when the request came over HTTP/2
+pub fn (ctx &Context) is_http2() bool {
+	return ctx.is_h2
+}
+
 // user_agent returns the user-agent header for the current client
 pub fn (ctx &Context) user_agent() string {
 	return ctx.req.header.get(.user_agent) or { '' }
@@ -129,26 +129,17 @@ pub fn encode_gzip[T]() MiddlewareOptions[T] {
 			if ctx.return_type == .file {
 				return true
 			}
-			// first try compressions, because if it fails we can still send a response
-			// before taking over the connection
 			compressed := gzip.compress(ctx.res.body.bytes()) or {
 				eprintln('[veb] error while compressing with gzip: ${err.msg()}')
 				return true
 			}
-			// enables us to have full control over what response is send over the connection
-			// and how.
-			ctx.takeover_conn()
-
-			// set HTTP headers for gzip
+			// only the response is changed, and veb sends it, so that it works over HTTP/2 too,
+			// where the connection is shared by the streams
+			ctx.res.body = compressed.bytestr()
 			ctx.res.header.add(.content_encoding, 'gzip')
 			ctx.res.header.set(.vary, 'Accept-Encoding')
 			ctx.res.header.set(.content_length, compressed.len.str())
-
-			fast_send_resp_header(mut ctx.Context.conn, ctx.res) or {}
-			ctx.Context.conn.write_ptr(&u8(compressed.data), compressed.len) or {}
-			ctx.Context.conn.close() or {}
-
-			return false
+			return true
 		}
 	}
 }
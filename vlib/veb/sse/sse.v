@@ -33,10 +33,22 @@ pub mut:
 pub struct SSEConnection {
 pub mut:
 	conn &net.TcpConn @[required]
+mut:
+	// the request came over HTTP/2, where the connection is shared by the streams
+	is_h2 bool
 }
 
-// start an SSE connection
+// start an SSE connection.
+// The events are written to the connection directly, so they need HTTP/1.x: over HTTP/2,
+// `send_message` returns an error, and the request is answered with `505 HTTP Version Not Supported`.
 pub fn start_connection(mut ctx veb.Context) &SSEConnection {
+	if ctx.is_http2() {
+		eprintln('[veb] error: server-sent events need HTTP/1.x')
+		return &SSEConnection{
+			conn:  ctx.conn
+			is_h2: true
+		}
+	}
 	ctx.res.header.set(.connection, 'keep-alive')
 	ctx.res.header.set(.cache_control, 'no-cache')
 	ctx.send_response_to_client('text/event-stream', '')
@@ -49,6 +61,9 @@ pub fn start_connection(mut ctx veb.Context) &SSEConnection {
 // send_message sends a single message to the http client that listens for SSE.
 // It does not close the connection, so you can use it many times in a loop.
 pub fn (mut sse SSEConnection) send_message(message SSEMessage) ! {
+	if sse.is_h2 {
+		return error('server-sent events need HTTP/1.x')
+	}
 	mut sb := strings.new_builder(512)
 	if message.id != '' {
 		sb.write_string('id: ${message.id}\n')
@@ -68,6 +83,9 @@ pub fn (mut sse SSEConnection) send_message(message SSEMessage) ! {
 
 // send a 'close' event and close the tcp connection.
 pub fn (mut sse SSEConnection) close() {
+	if sse.is_h2 {
+		return
+	}
 	sse.send_message(event: 'close', data: 'Closing the connection', retry: -1) or {}
 	sse.conn.close() or {}
 }
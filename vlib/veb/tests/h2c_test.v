@@ -0,0 +1,91 @@
+// vtest retry: 3
+import veb
+import net.http
+import compress.gzip
+import time
+
+const port = 13013
+
+const localserver = 'http://127.0.0.1:${port}'
+
+const exit_after = time.second * 10
+
+const body = 'hello from veb over HTTP/2 '.repeat(20)
+
+pub struct Context {
+	veb.Context
+}
+
+@[heap]
+pub struct App {
+	veb.Middleware[Context]
+mut:
+	started chan bool
+}
+
+pub fn (mut app App) before_accept_loop() {
+	app.started <- true
+}
+
+pub fn (app &App) index(mut ctx Context) veb.Result {
+	return ctx.text(body)
+}
+
+pub fn (app &App) takeover(mut ctx Context) veb.Result {
+	ctx.takeover_conn()
+	return veb.no_result()
+}
+
+fn testsuite_begin() {
+	mut app := &App{}
+	app.use(veb.encode_gzip[Context]())
+
+	spawn veb.run_at[App, Context](mut app, port: port, timeout_in_seconds: 2, family: .ip)
+	// app startup time
+	_ := <-app.started
+
+	spawn fn () {
+		time.sleep(exit_after)
+		assert true == false, 'timeout reached!'
+		exit(1)
+	}()
+}
+
+fn test_encode_gzip_over_http2() {
+	mut client := http.Client{
+		http2: true
+	}
+	defer {
+		client.close()
+	}
+	for _ in 0 .. 3 {
+		x := client.get(localserver)!
+		assert x.status() == .ok
+		assert x.header.get(.content_encoding)! == 'gzip'
+		assert gzip.decompress(x.body.bytes())!.bytestr() == body
+	}
+	// all of the requests are served over the same, still open connection
+	stats := client.stats()
+	assert stats.http2 == 3
+	assert stats.dials == 1
+}
+
+fn test_encode_gzip_over_http1() {
+	x := http.get(localserver)!
+	assert x.header.get(.content_encoding)! == 'gzip'
+	assert gzip.decompress(x.body.bytes())!.bytestr() == body
+}
+
+fn test_takeover_is_refused_over_http2() {
+	mut client := http.Client{
+		http2: true
+	}
+	defer {
+		client.close()
+	}
+	x := client.get('${localserver}/takeover')!
+	assert x.status() == .http_version_not_supported
+	// the connection is still usable by the other streams
+	y := client.get(localserver)!
+	assert gzip.decompress(y.body.bytes())!.bytestr() == body
+}
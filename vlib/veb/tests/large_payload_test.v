@@ -1,6 +1,7 @@
 // vtest flaky: true
 // vtest retry: 3
 import veb
+import net
 import net.http
 import time
 import os
@@ -9,7 +10,7 @@ const port = 13002
 
 const localserver = 'http://127.0.0.1:${port}'
 
-const exit_after = time.second * 10
+const exit_after = time.second * 20
 
 const tmp_file = os.join_path(os.vtmp_dir(), 'veb_large_payload.txt')
 
@@ -112,6 +113,31 @@ fn test_smaller_content_length() {
 	assert x.body == 'Mismatch of body length and Content-Length header'
 }
 
+fn test_partial_body_and_disconnect() {
+	// the client disconnects in the middle of the body, so the request never completes
+	mut conn1 := net.dial_tcp('127.0.0.1:${port}')!
+	conn1.write_string('POST /post_request HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 20\r\n\r\n12345')!
+	time.sleep(100 * time.millisecond)
+	conn1.close()!
+	time.sleep(900 * time.millisecond)
+	// The next connection most likely gets the same fd on the server, since the fd of the client
+	// side of the first connection, that was lower, is free again. Its request arrives in parts,
+	// and is complete after the deadline of the first request, but before its own, so it must not
+	// be timed out by the first one.
+	mut conn2 := net.dial_tcp('127.0.0.1:${port}')!
+	defer {
+		conn2.close() or {}
+	}
+	conn2.write_string('POST /post_request HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 10\r\n\r\n12345')!
+	time.sleep(1500 * time.millisecond)
+	conn2.write_string('67890')!
+	mut buf := []u8{len: 4096}
+	n := conn2.read(mut buf)!
+	resp := buf[..n].bytestr()
+	assert resp.starts_with('HTTP/1.1 200 OK'), resp
+	assert resp.ends_with('1234567890')
+}
+
 fn test_sendfile() {
 	mut buf := []u8{len: veb.max_write * 10, init: `a`}
 	os.write_file(tmp_file, buf.bytestr())!
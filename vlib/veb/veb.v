@@ -7,6 +7,8 @@ import net.urllib
 import os
 import time
 import strings
+import sync
+import sync.stdatomic
 import picoev
 
 // A type which doesn't get filtered inside templates
@@ -72,6 +74,9 @@ pub:
 	port                 int  = 8080
 	show_startup_message bool = true
 	timeout_in_seconds   int  = 30
+	// on Linux, run the event loop on io_uring, when the kernel supports it, and the program is
+	// compiled with `-d picoev_io_uring`
+	io_uring bool
 }
 
 struct FileResponse {
@@ -124,6 +129,17 @@ mut:
 	incomplete_requests []http.Request
 	file_responses      []FileResponse
 	string_responses    []StringResponse
+	// the deadline of the request, that is arriving in parts, on each fd, see `request_deadline`;
+	// it is cancelled, when the request is done, or its connection is closed
+	deadline_timers []picoev.TimerId
+	// bumped for each request that is done, so that a deadline, that could not be cancelled, is
+	// ignored anyway
+	deadline_gen []u16
+	// the HTTP/2 connections are served by threads of their own, so the app is locked, while handling
+	// one of their requests, to keep it used by one request at a time
+	app_mu &sync.Mutex = sync.new_mutex()
+	// the HTTP/2 connections being served; the HTTP/1 requests lock `app_mu` only while there are some
+	h2_conns u64
 }
 
 // reset request parameters for `fd`:
@@ -131,6 +147,32 @@ mut:
 pub fn (mut params RequestParams) request_done(fd int) {
 	params.incomplete_requests[fd] = http.Request{}
 	params.idx[fd] = 0
+	params.deadline_gen[fd]++
+}
+
+// end_request resets the request parameters for `fd`, like `request_done`, and cancels the
+// deadline of its request. It is called, when a request is done, and on every path, that closes
+// a connection, so that no timer outlives its request, and fires for the next connection, that
+// gets the same fd.
+fn (mut params RequestParams) end_request(mut pv picoev.Picoev, fd int) {
+	if params.deadline_timers[fd] != 0 {
+		pv.cancel_timer(params.deadline_timers[fd])
+		params.deadline_timers[fd] = 0
+	}
+	params.request_done(fd)
+}
+
+// request_deadline is called, when a request, that arrives in parts, is not complete after
+// `timeout_in_seconds`. Unlike the idle timeout of picoev, it is not extended by each part.
+fn request_deadline(mut pv picoev.Picoev, user_data voidptr) {
+	mut params := unsafe { &RequestParams(pv.user_data) }
+	fd := int(usize(user_data) & 0xffff)
+	if params.deadline_gen[fd] != u16(usize(user_data) >> 16) {
+		// the request is done
+		return
+	}
+	params.deadline_timers[fd] = 0
+	handle_timeout(mut pv, mut params, fd)
 }
 
 interface BeforeAcceptApp {
@@ -173,6 +215,8 @@ pub fn run_at[A, X](mut global_app A, params RunParams) ! {
 	pico_context.incomplete_requests = []http.Request{len: picoev.max_fds}
 	pico_context.file_responses = []FileResponse{len: picoev.max_fds}
 	pico_context.string_responses = []StringResponse{len: picoev.max_fds}
+	pico_context.deadline_timers = []picoev.TimerId{len: picoev.max_fds}
+	pico_context.deadline_gen = []u16{len: picoev.max_fds}
 
 	mut pico := picoev.new(
 		port:         params.port
@@ -181,6 +225,7 @@ pub fn run_at[A, X](mut global_app A, params RunParams) ! {
 		timeout_secs: params.timeout_in_seconds
 		family:       params.family
 		host:         params.host
+		io_uring:     params.io_uring
 	)!
 
 	$if A is BeforeAcceptApp {
@@ -241,7 +286,7 @@ fn handle_timeout(mut pv picoev.Picoev, mut params RequestParams, fd int) {
 	fast_send_resp(mut conn, http_408) or {}
 	pv.close_conn(fd)
 
-	params.request_done(fd)
+	params.end_request(mut pv, fd)
 }
 
 // handle_write_file reads data from a file and sends that data over the socket.
@@ -362,7 +407,7 @@ fn handle_read[A, X](mut pv picoev.Picoev, mut params RequestParams, fd int) {
 			// the buffered reader was empty meaning that the client probably
 			// closed the connection.
 			pv.close_conn(fd)
-			params.incomplete_requests[fd] = http.Request{}
+			params.end_request(mut pv, fd)
 			return
 		}
 		if reader.total_read >= max_read {
@@ -372,7 +417,12 @@ fn handle_read[A, X](mut pv picoev.Picoev, mut params RequestParams, fd int) {
 			fast_send_resp(mut conn, http_413) or {}
 
 			pv.close_conn(fd)
-			params.incomplete_requests[fd] = http.Request{}
+			params.end_request(mut pv, fd)
+			return
+		}
+		if req.version == .v2_0 && req.method == .pri && req.url == '*' {
+			// the client preface of HTTP/2 with prior knowledge (h2c)
+			handle_h2_preface[A, X](mut pv, mut params, fd, mut conn, mut reader)
 			return
 		}
 	}
@@ -397,8 +447,7 @@ fn handle_read[A, X](mut pv picoev.Picoev, mut params RequestParams, fd int) {
 		n := reader.read(mut buf) or {
 			eprintln('[veb] error parsing request: ${err}')
 			pv.close_conn(fd)
-			params.incomplete_requests[fd] = http.Request{}
-			params.idx[fd] = 0
+			params.end_request(mut pv, fd)
 			return
 		}
 
@@ -416,11 +465,14 @@ fn handle_read[A, X](mut pv picoev.Picoev, mut params RequestParams, fd int) {
 			)) or {}
 
 			pv.close_conn(fd)
-			params.incomplete_requests[fd] = http.Request{}
-			params.idx[fd] = 0
+			params.end_request(mut pv, fd)
 			return
 		} else if n < bytes_to_read || params.idx[fd] + n < content_length.int() {
 			// request is incomplete wait until the socket becomes ready to read again
+			if params.idx[fd] == 0 {
+				params.deadline_timers[fd] = pv.add_timer(params.timeout_in_seconds * time.second,
+					request_deadline, voidptr(usize(params.deadline_gen[fd]) << 16 | usize(fd)))
+			}
 			params.idx[fd] += n
 			// TODO: change this to a memcpy function?
 			req.data += buf[0..n].bytestr()
@@ -434,10 +486,19 @@ fn handle_read[A, X](mut pv picoev.Picoev, mut params RequestParams, fd int) {
 	}
 
 	defer {
-		params.request_done(fd)
+		params.end_request(mut pv, fd)
 	}
 
-	if completed_context := handle_request[A, X](mut conn, req, params) {
+	// h2_conns is only increased on this thread, so no HTTP/2 request can start, while it is 0
+	lock_app := stdatomic.load_u64(&params.h2_conns) > 0
+	if lock_app {
+		params.app_mu.@lock()
+	}
+	completed := handle_request[A, X](mut conn, req, params)
+	if lock_app {
+		params.app_mu.unlock()
+	}
+	if completed_context := completed {
 		if completed_context.takeover {
 			// the connection should be kept open, but removed from the picoev loop.
 			// This way veb can continue handling other connections and the user can
@@ -514,6 +575,66 @@ fn handle_read[A, X](mut pv picoev.Picoev, mut params RequestParams, fd int) {
 	}
 }
 
+// handle_h2_preface takes the connection out of the picoev loop, after the `PRI * HTTP/2.0` line of
+// the HTTP/2 client preface, and serves it with `http.serve_http2` on a thread of its own.
+// The routes, that take over the connection (`Context.takeover_conn`, and the server-sent events),
+// need HTTP/1.x, since they write to the connection directly.
+fn handle_h2_preface[A, X](mut pv picoev.Picoev, mut params RequestParams, fd int, mut conn net.TcpConn, mut reader io.BufferedReader) {
+	// the rest of the preface is `SM\r\n\r\n`
+	sm := reader.read_line() or { '' }
+	empty := reader.read_line() or { '-' }
+	if sm != 'SM' || empty != '' {
+		pv.close_conn(fd)
+		params.end_request(mut pv, fd)
+		return
+	}
+	mut preread := []u8{len: reader.buffered()}
+	if preread.len > 0 {
+		reader.read(mut preread) or {}
+	}
+	pv.delete(fd)
+	params.end_request(mut pv, fd)
+	mut handler := &H2Handler[A, X]{
+		params: params
+		conn:   conn
+	}
+	stdatomic.add_u64(&params.h2_conns, 1)
+	spawn serve_h2_conn(mut conn, preread, mut handler, mut params)
+}
+
+fn serve_h2_conn(mut conn net.TcpConn, preread []u8, mut handler http.Handler, mut params RequestParams) {
+	timeout := params.timeout_in_seconds * time.second
+	http.serve_http2(mut conn, preread, mut handler, read_timeout: timeout, idle_timeout: timeout)
+	// the handler is called on this thread only, so all the requests of the connection are done
+	stdatomic.sub_u64(&params.h2_conns, 1)
+}
+
+// H2Handler handles the requests of an HTTP/2 connection with the routes of the app
+struct H2Handler[A, X] {
+	params &RequestParams
+mut:
+	conn &net.TcpConn
+}
+
+fn (mut h H2Handler[A, X]) handle(req http.Request) http.Response {
+	mut params := unsafe { h.params }
+	params.app_mu.@lock()
+	completed := handle_request[A, X](mut h.conn, req, h.params)
+	params.app_mu.unlock()
+	ctx := completed or { return http.new_response(status: .bad_request) }
+	if ctx.takeover {
+		// takeover_conn has already reported it
+		return http.new_response(status: .http_version_not_supported)
+	}
+	mut resp := ctx.res
+	if ctx.return_type == .file {
+		resp.body = os.read_file(ctx.return_file) or {
+			return http.new_response(status: .internal_server_error)
+		}
+	}
+	return resp
+}
+
 // close the connection when `should_close` is true.
 @[inline]
 fn handle_complete_request(should_close bool, mut pv picoev.Picoev, fd int) {
@@ -546,7 +667,10 @@ fn handle_request[A, X](mut conn net.TcpConn, req http.Request, params &RequestP
 	form, files := parse_form_from_request(req) or {
 		// Bad request
 		eprintln('[veb] error parsing form: ${err.msg()}')
-		conn.write(http_400.bytes()) or {}
+		if req.version != .v2_0 {
+			// over HTTP/2, the stream is answered by H2Handler instead
+			conn.write(http_400.bytes()) or {}
+		}
 		return none
 	}
 
@@ -562,6 +686,7 @@ fn handle_request[A, X](mut conn net.TcpConn, req http.Request, params &RequestP
 		query:          query
 		form:           form
 		files:          files
+		is_h2:          req.version == .v2_0
 	}
 
 	if connection_header := req.header.get(.connection) {
@@ -0,0 +1,250 @@
+module sessions
+
+import hash
+import sync
+import sync.stdatomic
+import time
+
+// ShardedStoreConfig configures a `ShardedMemoryStore`
+@[params]
+pub struct ShardedStoreConfig {
+pub:
+	// the number of shards, rounded up to a power of 2. More shards mean less waiting on the
+	// locks, when many threads use the store at once.
+	shards int = 64
+	// the maximum number of sessions; when it is reached, the sessions, that have not been used
+	// for the longest time, are evicted. 0 means no limit.
+	max_sessions int
+	// the sessions older than that are removed by the sweeps, even if they are never asked for
+	// again. It should be the `max_age` of `Sessions`. 0 means that they are kept forever.
+	max_age time.Duration = time.hour * 24 * 30
+	// how often each shard is swept for expired sessions. The sweeps are lazy: a shard is only
+	// swept, when it is written to.
+	sweep_interval time.Duration = time.minute
+}
+
+// ShardedMemoryStore stores sessions in memory, like `MemoryStore`, but it can be used by several
+// threads at once. The sessions are spread over shards by the hash of their id, and each shard has
+// its own read/write lock, so that `get` calls on different sessions rarely wait for each other.
+// The expired sessions are swept out lazily, and the memory is bounded by `max_sessions`, with an
+// approximate LRU (CLOCK) eviction.
+// Example:
+// ```v ignore
+// mut app := &App{
+// 	sessions: &sessions.Sessions[User]{
+// 		store:  sessions.new_sharded_memory_store[User](max_sessions: 1_000_000)
+// 		secret: 'my secret'.bytes()
+// 	}
+// }
+// ```
+@[heap]
+pub struct ShardedMemoryStore[T] {
+	max_age        i64 // in nanoseconds, like the time of `time.sys_mono_now`
+	sweep_interval i64
+	shard_limit    int // the maximum number of sessions of each shard; 0 means no limit
+	mask           u64
+mut:
+	shards []&SessionShard[T]
+}
+
+@[heap]
+struct SessionShard[T] {
+mut:
+	mu         &sync.RwMutex = sync.new_rwmutex()
+	index      map[string]int // the entry of each session id
+	entries    []SessionEntry[T]
+	free       []int // the unused entries
+	hand       int   // the next entry, that the CLOCK eviction looks at
+	next_sweep u64
+}
+
+struct SessionEntry[T] {
+mut:
+	sid        string
+	created_at u64 // from `time.sys_mono_now`
+	data       T
+	used       bool
+	// set to 1 by `get`, and cleared by the eviction, which passes over the entries with it set once.
+	// `get` sets it under the read lock, so it is an u64, written with an atomic store.
+	referenced u64
+}
+
+// new_sharded_memory_store creates a `ShardedMemoryStore` for session data of type `T`
+pub fn new_sharded_memory_store[T](config ShardedStoreConfig) &ShardedMemoryStore[T] {
+	mut nr_shards := 1
+	for nr_shards < config.shards {
+		nr_shards <<= 1
+	}
+	mut store := &ShardedMemoryStore[T]{
+		max_age:        i64(config.max_age)
+		sweep_interval: i64(config.sweep_interval)
+		shard_limit:    if config.max_sessions > 0 {
+			(config.max_sessions + nr_shards - 1) / nr_shards
+		} else {
+			0
+		}
+		mask:           u64(nr_shards - 1)
+	}
+	for _ in 0 .. nr_shards {
+		store.shards << &SessionShard[T]{}
+	}
+	return store
+}
+
+@[inline]
+fn (store &ShardedMemoryStore[T]) shard(sid string) &SessionShard[T] {
+	return store.shards[hash.sum64_string(sid, 0) & store.mask]
+}
+
+// get session for session id `sid`. The session can be `max_age` old.
+// `max_age` will be ignored when set to `0`
+pub fn (mut store ShardedMemoryStore[T]) get(sid string, max_age time.Duration) !T {
+	mut shard := store.shard(sid)
+	shard.mu.@rlock()
+	idx := shard.index[sid] or {
+		shard.mu.runlock()
+		return error('session does not exist')
+	}
+	created_at := shard.entries[idx].created_at
+	if max_age != 0 && time.sys_mono_now() - created_at > u64(max_age) {
+		shard.mu.runlock()
+		shard.mu.@lock()
+		// the session may have been destroyed, and created again, between the two locks
+		if new_idx := shard.index[sid] {
+			if shard.entries[new_idx].created_at == created_at {
+				shard.remove(new_idx)
+			}
+		}
+		shard.mu.unlock()
+		return error('session is expired')
+	}
+	// the other readers of the shard may set it at the same time
+	stdatomic.store_u64(&shard.entries[idx].referenced, 1)
+	data := shard.entries[idx].data
+	shard.mu.runlock()
+	return data
+}
+
+// destroy data for session id `sid`
+pub fn (mut store ShardedMemoryStore[T]) destroy(sid string) ! {
+	mut shard := store.shard(sid)
+	shard.mu.@lock()
+	if idx := shard.index[sid] {
+		shard.remove(idx)
+	}
+	shard.mu.unlock()
+}
+
+// set session data for session id `sid`
+pub fn (mut store ShardedMemoryStore[T]) set(sid string, val T) ! {
+	mut shard := store.shard(sid)
+	now := time.sys_mono_now()
+	shard.mu.@lock()
+	defer {
+		shard.mu.unlock()
+	}
+	if store.max_age > 0 && now >= shard.next_sweep {
+		shard.sweep(now, u64(store.max_age))
+		shard.next_sweep = now + u64(store.sweep_interval)
+	}
+	if idx := shard.index[sid] {
+		// like `MemoryStore`, the session keeps its creation time
+		shard.entries[idx].data = val
+		shard.entries[idx].referenced = 1
+		return
+	}
+	if store.shard_limit > 0 && shard.index.len >= store.shard_limit {
+		shard.evict()
+	}
+	entry := SessionEntry[T]{
+		sid:        sid
+		created_at: now
+		data:       val
+		used:       true
+	}
+	mut idx := 0
+	if shard.free.len > 0 {
+		idx = shard.free.pop()
+		shard.entries[idx] = entry
+	} else {
+		idx = shard.entries.len
+		shard.entries << entry
+	}
+	shard.index[sid] = idx
+}
+
+// get data from all sessions
+pub fn (mut store ShardedMemoryStore[T]) all() ![]T {
+	mut res := []T{}
+	for mut shard in store.shards {
+		shard.mu.@rlock()
+		for entry in shard.entries {
+			if entry.used {
+				res << entry.data
+			}
+		}
+		shard.mu.runlock()
+	}
+	return res
+}
+
+// clear all sessions
+pub fn (mut store ShardedMemoryStore[T]) clear() ! {
+	for mut shard in store.shards {
+		shard.mu.@lock()
+		shard.index.clear()
+		shard.entries.clear()
+		shard.free.clear()
+		shard.hand = 0
+		shard.mu.unlock()
+	}
+}
+
+// len returns the number of the stored sessions
+pub fn (mut store ShardedMemoryStore[T]) len() int {
+	mut n := 0
+	for mut shard in store.shards {
+		shard.mu.@rlock()
+		n += shard.index.len
+		shard.mu.runlock()
+	}
+	return n
+}
+
+// remove frees the entry `idx`; the write lock has to be held
+fn (mut shard SessionShard[T]) remove(idx int) {
+	shard.index.delete(shard.entries[idx].sid)
+	shard.entries[idx] = SessionEntry[T]{}
+	shard.free << idx
+}
+
+// sweep removes the sessions older than `max_age`; the write lock has to be held
+fn (mut shard SessionShard[T]) sweep(now u64, max_age u64) {
+	for idx in 0 .. shard.entries.len {
+		if shard.entries[idx].used && now - shard.entries[idx].created_at > max_age {
+			shard.remove(idx)
+		}
+	}
+}
+
+// evict removes a session, that has not been used recently: the clock hand goes over the entries,
+// and takes the first one, that has not been referenced since the hand passed it last time.
+// The write lock has to be held.
+fn (mut shard SessionShard[T]) evict() {
+	for _ in 0 .. 2 * shard.entries.len {
+		if shard.hand >= shard.entries.len {
+			shard.hand = 0
+		}
+		idx := shard.hand
+		shard.hand++
+		if !shard.entries[idx].used {
+			continue
+		}
+		if shard.entries[idx].referenced != 0 {
+			shard.entries[idx].referenced = 0
+			continue
+		}
+		shard.remove(idx)
+		return
+	}
+}
@@ -0,0 +1,81 @@
+import time
+import x.sessions
+
+pub struct User {
+	name string
+	age  int
+}
+
+const default_user = User{
+	name: 'john'
+	age:  99
+}
+
+fn test_sharded_store_set_get_destroy() {
+	mut store := sessions.new_sharded_memory_store[User](shards: 4)
+	store.set('a', default_user)!
+	assert store.get('a', 0)! == default_user
+	store.set('a', User{ age: 100 })!
+	assert store.get('a', time.hour)!.age == 100
+	assert store.len() == 1
+	store.destroy('a')!
+	if _ := store.get('a', 0) {
+		assert false, 'session should be destroyed'
+	}
+	store.set('b', default_user)!
+	store.set('c', default_user)!
+	assert store.all()!.len == 2
+	store.clear()!
+	assert store.len() == 0
+}
+
+fn test_sharded_store_expiry() {
+	mut store := sessions.new_sharded_memory_store[User](
+		shards:         1
+		max_age:        50 * time.millisecond
+		sweep_interval: 10 * time.millisecond
+	)
+	store.set('a', default_user)!
+	store.set('b', default_user)!
+	time.sleep(100 * time.millisecond)
+	if _ := store.get('a', 50 * time.millisecond) {
+		assert false, 'session should be expired'
+	}
+	// `b` is never asked for: it is swept out, when the shard is written to
+	store.set('c', default_user)!
+	assert store.len() == 1
+}
+
+fn test_sharded_store_eviction() {
+	mut store := sessions.new_sharded_memory_store[User](shards: 1, max_sessions: 100)
+	for i in 0 .. 100 {
+		store.set('s${i}', User{ age: i })!
+	}
+	// `s0` is used, and survives the eviction of the others
+	assert store.get('s0', 0)!.age == 0
+	for i in 100 .. 150 {
+		store.set('s${i}', User{ age: i })!
+	}
+	assert store.len() == 100
+	assert store.get('s0', 0)!.age == 0
+	assert store.get('s149', 0)!.age == 149
+	if _ := store.get('s1', 0) {
+		assert false, 'the least recently used session should be evicted'
+	}
+}
+
+fn test_sharded_store_threads() {
+	mut store := sessions.new_sharded_memory_store[User]()
+	mut threads := []thread{}
+	for t in 0 .. 8 {
+		threads << spawn fn (mut store sessions.ShardedMemoryStore[User], t int) {
+			for i in 0 .. 1000 {
+				sid := 't${t}-${i}'
+				store.set(sid, User{ age: i }) or { panic(err) }
+				assert store.get(sid, 0) or { panic(err) }.age == i
+			}
+		}(mut store, t)
+	}
+	threads.wait()
+	assert store.len() == 8000
+}
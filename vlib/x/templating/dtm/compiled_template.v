@@ -0,0 +1,336 @@
+module dtm
+
+import os
+import regex
+import strings
+
+// Pairs to restore the allowed HTML tags in an escaped placeholder value, see `include_html_key_tag`.
+const allowed_tags_unescape = unescape_pairs(allowed_tags)
+
+// A template compiled once by `compile_template_file`: the literal text is kept as is, and the
+// placeholders of each line are cut out into slots. Rendering it is then a single pass over the
+// segments, instead of reading, escaping and searching the whole template again on each request.
+@[heap]
+struct CompiledTemplate {
+	path          string
+	is_compressed bool
+mut:
+	segments []TemplateSegment
+	// The real paths of the template and of its included files, with their modification times at compilation.
+	deps     []string
+	dep_mods []i64
+	// The most recent modification time of the template and of its includes.
+	last_mod i64
+	// Size of all the literal text, used to pre-size the rendering buffer.
+	text_len  int
+	nr_slots  int
+	text      strings.Builder = strings.new_builder(1024)
+	html_trim regex.RE
+}
+
+type TemplateSegment = TemplateLine | string
+
+// A template line containing placeholders. `parts` holds the literal text around the slots, so there is
+// always one part more than slots.
+struct TemplateLine {
+	parts []string
+	slots []TemplateSlot
+	// The line has a '$' that is not a placeholder, so it is always escaped, like the lines with an unknown placeholder.
+	has_stray_dollar bool
+	// HTML can be included in the values of the '_#includehtml' placeholders.
+	allow_html bool
+}
+
+struct TemplateSlot {
+	name string
+	// The key of the placeholder, when it allows HTML to be included.
+	html_key string
+}
+
+fn new_compiled_template(path string, is_compressed bool) !&CompiledTemplate {
+	mut ct := &CompiledTemplate{
+		path:          path
+		is_compressed: is_compressed
+	}
+	if is_compressed {
+		ct.html_trim = regex.regex_opt(r'>(\s+)<') or {
+			eprintln('${message_signature_error} with regular expression for HTML light compression. Please check the syntax of the regex pattern : ${err.msg()}')
+			return error(internat_server_error)
+		}
+	}
+	ct.add_dependency(path)
+	return ct
+}
+
+fn (mut ct CompiledTemplate) write_string(s string) {
+	ct.text.write_string(s)
+}
+
+fn (mut ct CompiledTemplate) writeln(s string) {
+	ct.text.writeln(s)
+}
+
+fn (mut ct CompiledTemplate) go_back(n int) {
+	ct.text.go_back(n)
+}
+
+// add_dependency records a file, whose modification invalidates the compiled template.
+fn (mut ct CompiledTemplate) add_dependency(path string) {
+	real_path := os.real_path(path)
+	if real_path in ct.deps {
+		return
+	}
+	mod := os.file_last_mod_unix(real_path)
+	ct.deps << real_path
+	ct.dep_mods << mod
+	if mod > ct.last_mod {
+		ct.last_mod = mod
+	}
+}
+
+// add_line adds an escaped template line (see `escape_template_line`). Placeholders are matched by whole names,
+// made of letters, digits and '_'.
+fn (mut ct CompiledTemplate) add_line(line string, state State) {
+	if !line.contains_u8(`$`) {
+		ct.text.writeln(line)
+		return
+	}
+	mut parts := []string{}
+	mut slots := []TemplateSlot{}
+	mut has_stray_dollar := false
+	mut start := 0
+	mut i := 0
+	for i < line.len {
+		if line[i] != `$` {
+			i++
+			continue
+		}
+		mut end := i + 1
+		for end < line.len && (line[end].is_letter() || line[end].is_digit() || line[end] == `_`) {
+			end++
+		}
+		if end == i + 1 {
+			has_stray_dollar = true
+			i++
+			continue
+		}
+		name := line[i + 1..end]
+		parts << ct.compress(line[start..i])
+		slots << TemplateSlot{
+			name:     name
+			html_key: name + include_html_key_tag
+		}
+		start = end
+		i = end
+	}
+	if slots.len == 0 {
+		// Without data, the line is escaped as a whole, as for any line with a '$' left in it.
+		ct.text.writeln(filter(line))
+		return
+	}
+	parts << ct.compress(line[start..])
+	ct.flush_text()
+	for part in parts {
+		ct.text_len += part.len
+	}
+	ct.nr_slots += slots.len
+	ct.segments << TemplateLine{
+		parts:            parts
+		slots:            slots
+		has_stray_dollar: has_stray_dollar
+		allow_html:       state == .html
+	}
+	ct.text.write_u8(`\n`)
+}
+
+// finish adds the remaining literal text, once the whole template has been compiled.
+fn (mut ct CompiledTemplate) finish() {
+	ct.flush_text()
+}
+
+fn (mut ct CompiledTemplate) flush_text() {
+	if ct.text.len == 0 {
+		return
+	}
+	text := ct.compress(ct.text.str())
+	if text.len > 0 {
+		ct.text_len += text.len
+		ct.segments << text
+	}
+}
+
+// compress performs a light compression of the literal HTML text by removing useless spaces, newlines, and tabs,
+// when the user selected this option. The placeholder values are inserted as they are.
+fn (mut ct CompiledTemplate) compress(s string) string {
+	if !ct.is_compressed {
+		return s
+	}
+	mut res := s.replace_each(['\n', '', '\t', '', '  ', ' '])
+	res = ct.html_trim.replace(res, '><')
+	for res.contains('  ') {
+		res = res.replace('  ', ' ')
+	}
+	return res
+}
+
+// render writes the template, with the placeholders replaced by their escaped values, in a single pass.
+fn (ct &CompiledTemplate) render(data &map[string]DtmMultiTypeMap) string {
+	mut sb := strings.new_builder(ct.text_len + ct.nr_slots * 32)
+	for segment in ct.segments {
+		match segment {
+			string {
+				sb.write_string(segment)
+			}
+			TemplateLine {
+				segment.render(mut sb, data)
+			}
+		}
+	}
+	return sb.str()
+}
+
+fn (line &TemplateLine) render(mut sb strings.Builder, data &map[string]DtmMultiTypeMap) {
+	start := sb.len
+	mut need_escape := line.has_stray_dollar
+	for i, slot in line.slots {
+		sb.write_string(line.parts[i])
+		val := placeholder_value(data, slot, line.allow_html) or {
+			// If no output is found for the placeholder, it is kept, and the whole line is escaped.
+			sb.write_u8(`$`)
+			sb.write_string(slot.name)
+			need_escape = true
+			continue
+		}
+		if val.contains_u8(`$`) {
+			need_escape = true
+		}
+		sb.write_string(val)
+	}
+	sb.write_string(line.parts[line.parts.len - 1])
+	if need_escape {
+		rendered := sb.cut_to(start)
+		sb.write_string(filter(rendered))
+	}
+}
+
+fn placeholder_value(data &map[string]DtmMultiTypeMap, slot TemplateSlot, allow_html bool) ?string {
+	if value := data[slot.name] {
+		return filter(placeholder_str(value))
+	}
+	if value := data[slot.html_key] {
+		if allow_html && value is string {
+			// Only the allowed HTML tags are restored in the escaped value.
+			return filter(value).replace_each(allowed_tags_unescape)
+		}
+		return filter(placeholder_str(value))
+	}
+	return none
+}
+
+fn placeholder_str(value DtmMultiTypeMap) string {
+	return match value {
+		string { value }
+		i8 { value.str() }
+		i16 { value.str() }
+		int { value.str() }
+		i64 { value.str() }
+		u8 { value.str() }
+		u16 { value.str() }
+		u32 { value.str() }
+		u64 { value.str() }
+		f32 { value.str() }
+		f64 { value.str() }
+	}
+}
+
+fn unescape_pairs(tags []string) []string {
+	mut pairs := []string{cap: tags.len * 2}
+	for tag in tags {
+		pairs << filter(tag)
+		pairs << tag
+	}
+	return pairs
+}
+
+// is_outdated checks the modification times of the template and of its includes. It is used only when no file
+// watcher is available, see `TemplateWatcher`.
+fn (ct &CompiledTemplate) is_outdated() bool {
+	for i, dep in ct.deps {
+		if os.file_last_mod_unix(dep) != ct.dep_mods[i] {
+			return true
+		}
+	}
+	return false
+}
+
+// fn (mut DynamicTemplateManager) get_compiled_template(string, string, bool) return !&CompiledTemplate
+//
+// Returns the compiled template from the memory, compiling it when it is not there yet, or when the template
+// or one of its included files has been modified since. The modifications are reported by the template watcher,
+// or, when it is not available, found by checking the modification times of the files.
+//
+fn (mut tm DynamicTemplateManager) get_compiled_template(file_path string, tmpl_name string, is_compressed bool) !&CompiledTemplate {
+	tm.drop_changed_templates()
+	rlock tm.compiled_templates {
+		if ct := tm.compiled_templates[file_path] {
+			if ct.is_compressed == is_compressed
+				&& (tm.template_watcher != unsafe { nil } || !ct.is_outdated()) {
+				return ct
+			}
+		}
+	}
+	if tm.template_watcher != unsafe { nil } {
+		// Watch the template before reading it, so that no modification is missed.
+		lock tm.compiled_templates {
+			tm.template_watcher.watch(file_path)
+		}
+	}
+	ct := compile_template_file(file_path, tmpl_name, is_compressed)!
+	lock tm.compiled_templates {
+		tm.compiled_templates[file_path] = ct
+		if tm.template_watcher != unsafe { nil } {
+			for dep in ct.deps {
+				tm.template_watcher.watch(dep)
+			}
+		}
+	}
+	return ct
+}
+
+// fn (mut DynamicTemplateManager) drop_changed_templates()
+//
+// Removes from the memory the compiled templates, whose files have been reported as modified by the template watcher.
+//
+fn (mut tm DynamicTemplateManager) drop_changed_templates() {
+	if tm.template_watcher == unsafe { nil } || !tm.template_watcher.has_changes() {
+		return
+	}
+	lock tm.compiled_templates {
+		changed, overflow := tm.template_watcher.read_changes()
+		if overflow {
+			// Some events have been lost, so any template may have changed.
+			tm.compiled_templates.clear()
+			return
+		}
+		mut outdated := []string{}
+		for key, ct in tm.compiled_templates {
+			if ct.deps.any(it in changed) {
+				outdated << key
+			}
+		}
+		for key in outdated {
+			tm.compiled_templates.delete(key)
+		}
+	}
+}
+
+// fn (mut DynamicTemplateManager) template_last_mod(string, string, TemplateType) return i64
+//
+// Returns the most recent modification time of a template and of its included files, from its compiled form.
+//
+fn (mut tm DynamicTemplateManager) template_last_mod(file_path string, tmpl_name string, tmpl_type TemplateType) i64 {
+	ct := tm.get_compiled_template(file_path, tmpl_name, tm.compress_html && tmpl_type == .html) or {
+		return os.file_last_mod_unix(file_path)
+	}
+	return ct.last_mod
+}
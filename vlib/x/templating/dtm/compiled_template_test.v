@@ -0,0 +1,74 @@
+module dtm
+
+import os
+
+const ct_test_dir = os.join_path(os.vtmp_dir(), 'dtm_compiled_template_test')
+
+fn testsuite_begin() {
+	os.mkdir_all(ct_test_dir)!
+}
+
+fn testsuite_end() {
+	os.rmdir_all(ct_test_dir) or {}
+}
+
+fn new_test_dtm() &DynamicTemplateManager {
+	return initialize(active_cache_server: false, test_template_dir: ct_test_dir)
+}
+
+fn test_render_placeholders() {
+	path := os.join_path(ct_test_dir, 'page.html')
+	os.write_file(path, '<h1>@title</h1>\n<p>@count @title_2</p>\n<div>@body</div>\n')!
+	ct := compile_template_file(path, 'page', false)!
+	assert ct.deps == [os.real_path(path)]
+
+	mut data := map[string]DtmMultiTypeMap{}
+	data['title'] = 'a <b>'
+	data['count'] = 42
+	data['title_2'] = 'second'
+	data['body_#includehtml'] = '<p>kept</p><script>escaped</script>'
+	assert ct.render(&data) == '<h1>a &lt;b&gt;</h1>\n<p>42 second</p>\n<div><p>kept</p>&lt;script&gt;escaped&lt;/script&gt;</div>\n'
+
+	// the template is rendered again, without being compiled again
+	data['title'] = 'other'
+	assert ct.render(&data).starts_with('<h1>other</h1>\n')
+}
+
+fn test_unknown_placeholder_escapes_the_line() {
+	path := os.join_path(ct_test_dir, 'unknown.html')
+	os.write_file(path, '<p>@missing</p>\n<p>ok</p>\n')!
+	ct := compile_template_file(path, 'unknown', false)!
+	data := map[string]DtmMultiTypeMap{}
+	assert ct.render(&data) == '&lt;p&gt;\$missing&lt;/p&gt;\n<p>ok</p>\n'
+}
+
+fn test_compressed_template() {
+	path := os.join_path(ct_test_dir, 'compressed.html')
+	os.write_file(path, '<div>\n\t<span>  @name  </span>\n</div>\n')!
+	ct := compile_template_file(path, 'compressed', true)!
+	mut data := map[string]DtmMultiTypeMap{}
+	data['name'] = 'v'
+	assert ct.render(&data) == '<div><span> v </span></div>'
+}
+
+fn test_compiled_template_is_reused_and_invalidated() {
+	path := os.join_path(ct_test_dir, 'reused.html')
+	include_path := os.join_path(ct_test_dir, 'part.html')
+	os.write_file(include_path, '<p>part one</p>')!
+	os.write_file(path, "<h1>@title</h1>\n@include 'part'\n")!
+	mut dtmi := new_test_dtm()
+	first := dtmi.get_compiled_template(path, 'reused', false)!
+	second := dtmi.get_compiled_template(path, 'reused', false)!
+	assert voidptr(first) == voidptr(second)
+	assert first.deps.len == 2
+
+	$if linux {
+		// the watcher reports the modification of the included file
+		os.write_file(include_path, '<p>part two</p>')!
+		third := dtmi.get_compiled_template(path, 'reused', false)!
+		assert voidptr(third) != voidptr(first)
+		mut data := map[string]DtmMultiTypeMap{}
+		data['title'] = 'T'
+		assert third.render(&data) == '<h1>T</h1>\n<p>part two</p>\n'
+	}
+}
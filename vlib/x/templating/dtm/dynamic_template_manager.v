@@ -4,7 +4,6 @@ import os
 import crypto.md5
 import hash.fnv1a
 import time
-import regex
 
 // These are all the types of dynamic values that the DTM allows to be returned in the context of a map
 type DtmMultiTypeMap = f32 | f64 | i16 | i64 | i8 | int | string | u16 | u32 | u64 | u8
@@ -88,6 +87,10 @@ mut:
 	ch_stop_dtm_clock chan bool = chan bool{cap: 5}
 	// Store small information about already cached pages to improve the verification speed of the check_tmpl_and_placeholders_size function.
 	html_file_info shared map[string]HtmlFileInfo = map[string]HtmlFileInfo{}
+	// Templates compiled once into literal text and placeholder slots, by full path of the template file. (See compiled_template.v)
+	compiled_templates shared map[string]&CompiledTemplate = map[string]&CompiledTemplate{}
+	// Reports the modifications of the compiled templates. It is nil when file watching is not available, the modification times are checked instead.
+	template_watcher &TemplateWatcher = unsafe { nil }
 	// Indicates whether the cache file storage directory is located in a temporary OS area
 	cache_folder_is_temporary_storage bool
 	// Handler for all threads used in the DTM
@@ -263,6 +266,7 @@ pub fn initialize(dtm_init_params DynamicTemplateManagerInitialisationParams) &D
 		c_time:                            get_current_unix_micro_timestamp()
 		dtm_init_is_ok:                    system_ready
 		cache_folder_is_temporary_storage: cache_temporary_bool
+		template_watcher:                  new_template_watcher() or { unsafe { nil } }
 	}
 	if system_ready {
 		// Disable cache handler if user doesn't required. Else, new thread is used to start the cache system. ( By default is ON )
@@ -310,12 +314,14 @@ pub fn (mut tm DynamicTemplateManager) expand(tmpl_path string, tmpl_var Templat
 		// `last_template_mod` is set to 0 and `test_current_template_mod` to `i64(0)` when a new cache needs to be created.
 		// `test_current_template_mod` is utilized for updating the cache.
 		mut test_current_template_mod := i64(0)
+		// The compiled template knows the last modification timestamp of the HTML template and of its includes, and is kept up to date by the template watcher.
+		template_mod := tm.template_last_mod(file_path, tmpl_name, tmpl_type)
 		if last_template_mod == 0 {
 			// Get last modification timestamp of HTML template to adding info for the creation of cache.
-			last_template_mod = os.file_last_mod_unix(file_path)
+			last_template_mod = template_mod
 		} else {
 			// Get last modification timestamp of HTML template to compare with cache info already existent.
-			test_current_template_mod = os.file_last_mod_unix(file_path)
+			test_current_template_mod = template_mod
 		}
 
 		// From this point, all the previously encountered variables are used to determine the routing in rendering the HTML template and creating/using its cache.
@@ -978,9 +984,10 @@ fn (mut tm DynamicTemplateManager) chandler_remaining_cache_template_used(cr Cac
 	return true
 }
 
-// fn (mut DynamicTemplateManager) parse_tmpl_file(string, string, &map[string]DtmMultiTypeMap, bool, TemplateType) return (string, string)
+// fn (mut DynamicTemplateManager) parse_tmpl_file(string, string, &map[string]DtmMultiTypeMap, bool, TemplateType) return string
 //
-// Parses and generates template file content.
+// Generates template file content from its compiled form, which is parsed only once and kept in memory until the template or one of its includes is modified.
+// The light compression of the HTML is also done at compile time, so that rendering only writes the literal text and the escaped placeholder values in a pre-sized buffer.
 // It ensures template format compatibility necessary for proper compilation and execution in its typical usage outside of DTM like managing various states,
 // processing template tags, and supporting string interpolation...
 // including dynamic content with the possibility of adding HTML code but only for certain specified tags and can also light compress HTML if required ( Removing usless spaces ).
@@ -999,23 +1006,10 @@ const include_html_key_tag = '_#includehtml'
 
 fn (mut tm DynamicTemplateManager) parse_tmpl_file(file_path string, tmpl_name string, placeholders &map[string]DtmMultiTypeMap,
 	is_compressed bool, tmpl_type TemplateType) string {
-	mut tmpl_ := compile_template_file(file_path, tmpl_name, placeholders)
-
-	// Performs a light compression of the HTML output by removing usless spaces, newlines, and tabs if user selected this option.
-	if is_compressed && tmpl_type == TemplateType.html && tmpl_ != internat_server_error {
-		tmpl_ = tmpl_.replace_each(['\n', '', '\t', '', '  ', ' '])
-		mut r := regex.regex_opt(r'>(\s+)<') or {
-			tm.stop_cache_handler()
-			eprintln('${message_signature_error} with regular expression for HTML light compression in parse_tmpl_file() function. Please check the syntax of the regex pattern : ${err.msg()}')
-			return internat_server_error
-		}
-		tmpl_ = r.replace(tmpl_, '><')
-		for tmpl_.contains('  ') {
-			tmpl_ = tmpl_.replace('  ', ' ')
-		}
+	ct := tm.get_compiled_template(file_path, tmpl_name, is_compressed && tmpl_type == TemplateType.html) or {
+		return internat_server_error
 	}
-
-	return tmpl_
+	return ct.render(placeholders)
 }
 
 // fn check_if_cache_delay_iscorrect(i64, string) return !
@@ -0,0 +1,19 @@
+module dtm
+
+// TemplateWatcher is only implemented on Linux. Elsewhere, the modification times of the compiled templates
+// and of their included files are checked instead.
+struct TemplateWatcher {}
+
+fn new_template_watcher() ?&TemplateWatcher {
+	return none
+}
+
+fn (mut w TemplateWatcher) watch(path string) {}
+
+fn (mut w TemplateWatcher) has_changes() bool {
+	return false
+}
+
+fn (mut w TemplateWatcher) read_changes() ([]string, bool) {
+	return []string{}, false
+}
@@ -0,0 +1,103 @@
+module dtm
+
+import os
+import os.notify
+
+#include <sys/inotify.h>
+
+struct C.inotify_event {
+	wd     int
+	mask   u32
+	cookie u32
+	len    u32
+}
+
+fn C.inotify_init1(flags int) int
+
+fn C.inotify_add_watch(fd int, pathname &char, mask u32) int
+
+const inotify_mask = u32(C.IN_MODIFY | C.IN_ATTRIB | C.IN_CLOSE_WRITE | C.IN_MOVED_TO | C.IN_CREATE | C.IN_DELETE)
+
+// TemplateWatcher reports the modifications of the compiled templates and of their included files, with inotify.
+// The directories of the files are watched, rather than the files, so that the files replaced by renaming,
+// as many editors do, are still seen. The inotify descriptor is polled without waiting, through `os.notify`,
+// so no thread is needed.
+@[heap]
+struct TemplateWatcher {
+	fd int
+mut:
+	notifier notify.FdNotifier
+	// The watched directories, by watch descriptor.
+	dirs map[int]string
+	wds  map[string]int
+	buf  []u8 = []u8{len: 4096}
+}
+
+fn new_template_watcher() ?&TemplateWatcher {
+	fd := C.inotify_init1(C.IN_NONBLOCK | C.IN_CLOEXEC)
+	if fd < 0 {
+		eprintln('${message_signature_info} Cannot watch the templates for changes, their modification times will be checked instead : ${os.posix_get_error_msg(C.errno)}')
+		return none
+	}
+	mut notifier := notify.new() or {
+		os.fd_close(fd)
+		return none
+	}
+	notifier.add(fd, .read) or {
+		os.fd_close(fd)
+		notifier.close() or {}
+		return none
+	}
+	return &TemplateWatcher{
+		fd:       fd
+		notifier: notifier
+	}
+}
+
+// watch starts watching the directory of a template file, if it is not watched yet.
+fn (mut w TemplateWatcher) watch(path string) {
+	dir := os.dir(os.real_path(path))
+	if dir in w.wds {
+		return
+	}
+	wd := C.inotify_add_watch(w.fd, &char(dir.str), inotify_mask)
+	if wd < 0 {
+		eprintln('${message_signature_warn} Cannot watch the template directory ${dir} for changes : ${os.posix_get_error_msg(C.errno)}')
+		return
+	}
+	w.dirs[wd] = dir
+	w.wds[dir] = wd
+}
+
+// has_changes checks, without waiting, if some changes are waiting to be read.
+fn (mut w TemplateWatcher) has_changes() bool {
+	return w.notifier.wait(0).len > 0
+}
+
+// read_changes returns the paths of the modified files, and whether some events have been lost,
+// in which case any file may have been modified.
+fn (mut w TemplateWatcher) read_changes() ([]string, bool) {
+	mut changed := []string{}
+	mut overflow := false
+	header_size := int(sizeof(C.inotify_event))
+	for {
+		n := C.read(w.fd, w.buf.data, w.buf.len)
+		if n <= 0 {
+			break
+		}
+		mut pos := 0
+		for pos + header_size <= n {
+			event := unsafe { &C.inotify_event(&w.buf[pos]) }
+			if event.mask & u32(C.IN_Q_OVERFLOW) != 0 {
+				overflow = true
+			} else if event.len > 0 {
+				if dir := w.dirs[event.wd] {
+					name := unsafe { cstring_to_vstring(&char(&w.buf[pos + header_size])) }
+					changed << os.join_path_single(dir, name)
+				}
+			}
+			pos += header_size + int(event.len)
+		}
+	}
+	return changed, overflow
+}
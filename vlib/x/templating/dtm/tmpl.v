@@ -77,61 +77,9 @@ fn is_html_open_tag(name string, s string) bool {
 	}
 }
 
-fn replace_placeholders_with_data(line string, data &map[string]DtmMultiTypeMap, state State) string {
-	mut rline := line
-	mut need_include_html := false
-
-	for key, value in data {
-		mut placeholder := '$${key}'
-
-		if placeholder.ends_with(include_html_key_tag) {
-			placeholder = placeholder.all_before_last(include_html_key_tag)
-			need_include_html = true
-		}
-		if !rline.contains(placeholder) {
-			need_include_html = false
-			continue
-		}
-		mut val_str := ''
-		match value {
-			i8, i16, int, i64, u8, u16, u32, u64, f32, f64 {
-				// Converts value to string
-				temp_val := value.str()
-				// Filters the string value for safe insertion
-				val_str = filter(temp_val)
-			}
-			string {
-				// Checks if the placeholder allows HTML inclusion
-				if need_include_html {
-					if state == State.html {
-						// Iterates over allowed HTML tags for inclusion
-						for tag in allowed_tags {
-							// Escapes the HTML tag
-							escaped_tag := filter(tag)
-							// Replaces the escaped tags with actual HTML tags in the value
-							val_str = value.replace(escaped_tag, tag)
-						}
-					} else {
-						val_str = filter(value)
-					}
-					need_include_html = false
-				} else {
-					// Filters the string value for safe insertion
-					val_str = filter(value)
-				}
-			}
-		}
-		rline = rline.replace(placeholder, val_str)
-	}
-	// If no output is found for the placeholder being processed, then the placeholder is escaped
-	if rline.contains('$') {
-		rline = filter(rline)
-	}
-	return rline
-}
-
-fn insert_template_code(fn_name string, tmpl_str_start string, line string, data &map[string]DtmMultiTypeMap,
-	state State) string {
+// escape_template_line does the escaping of a template line, that does not depend on the placeholder data.
+// The placeholders are left in it as `$name`, to be cut into slots by `CompiledTemplate.add_line`.
+fn escape_template_line(fn_name string, tmpl_str_start string, line string) string {
 	// HTML, may include `@var`
 	// escaped by cgen, unless it's a `vweb.RawHtml` string
 	trailing_bs := tmpl_str_end + 'sb_${fn_name}.write_u8(92)\n' + tmpl_str_start
@@ -145,23 +93,22 @@ fn insert_template_code(fn_name string, tmpl_str_start string, line string, data
 	if rline.ends_with('\\') {
 		rline = rline[0..rline.len - 2] + trailing_bs
 	}
-	if rline.contains('$') {
-		rline = replace_placeholders_with_data(rline, data, state)
-	}
 	return rline
 }
 
-// compile_file compiles the content of a file by the given path as a template
-fn compile_template_file(template_file string, fn_name string, data &map[string]DtmMultiTypeMap) string {
+// compile_template_file compiles the content of a file by the given path as a template, into a list of
+// literal text segments and placeholder slots, that can then be rendered for any placeholder data.
+// If `is_compressed` is set, the light HTML compression is applied to the literal text here, once.
+fn compile_template_file(template_file string, fn_name string, is_compressed bool) !&CompiledTemplate {
 	mut lines := os.read_lines(template_file) or {
 		eprintln('${message_signature_error} Template generator can not reading from ${template_file} file')
-		return internat_server_error
+		return error(internat_server_error)
 	}
 
 	basepath := os.dir(template_file)
 
 	tmpl_str_start := "\tsb_${fn_name}.write_string('"
-	mut source := strings.new_builder(1000)
+	mut source := new_compiled_template(template_file, is_compressed)!
 
 	mut state := State.simple
 	template_ext := os.file_ext(template_file)
@@ -205,7 +152,7 @@ fn compile_template_file(template_file string, fn_name string, data &map[string]
 				s := '@include '
 				position := line.index(s) or { 0 }
 				eprintln("${message_signature_error} path for @include must be quoted with ' or \" without line breaks or extraneous characters between @include and the quotes, position : ${position}")
-				return internat_server_error
+				return error(internat_server_error)
 			}
 			mut file_ext := os.file_ext(file_name)
 			if file_ext == '' {
@@ -225,8 +172,9 @@ fn compile_template_file(template_file string, fn_name string, data &map[string]
 			file_content := os.read_file(file_path) or {
 				position := line.index('@include ') or { 0 } + '@include '.len
 				eprintln('${message_signature_error} Reading @include file "${file_name}" from path: ${file_path} failed, position : ${position}')
-				return internat_server_error
+				return error(internat_server_error)
 			}
+			source.add_dependency(file_path)
 
 			file_splitted := file_content.split_into_lines().reverse()
 			for f in file_splitted {
@@ -268,7 +216,7 @@ fn compile_template_file(template_file string, fn_name string, data &map[string]
 		}
 		if state == .simple {
 			// by default, just copy 1:1
-			source.writeln(insert_template_code(fn_name, tmpl_str_start, line, data, state))
+			source.add_line(escape_template_line(fn_name, tmpl_str_start, line), state)
 			continue
 		}
 		// The .simple mode ends here. The rest handles .html/.css/.js state transitions.
@@ -324,8 +272,7 @@ fn compile_template_file(template_file string, fn_name string, data &map[string]
 			}
 			.js {
 				// if line.contains('//V_TEMPLATE') {
-				source.writeln(insert_template_code(fn_name, tmpl_str_start, line, data,
-					state))
+				source.add_line(escape_template_line(fn_name, tmpl_str_start, line), state)
 				//} else {
 				// replace `$` to `\$` at first to escape JavaScript template literal syntax
 				// source.writeln(line.replace(r'$', r'\$').replace(r'$$', r'@').replace(r'.$',
@@ -342,15 +289,15 @@ fn compile_template_file(template_file string, fn_name string, data &map[string]
 			else {}
 		}
 		// by default, just copy 1:1
-		source.writeln(insert_template_code(fn_name, tmpl_str_start, line, data, state))
+		source.add_line(escape_template_line(fn_name, tmpl_str_start, line), state)
 	}
 
-	result := source.str()
+	source.finish()
 	$if trace_tmpl_expansion ? {
-		eprintln('>>>>>>> template expanded to:')
-		eprintln(result)
+		eprintln('>>>>>>> template compiled to ${source.segments.len} segments:')
+		eprintln(source.segments)
 		eprintln('-----------------------------')
 	}
 
-	return result
+	return source
 }